@@ -103,6 +103,59 @@ p = subprocess.run(
 if p.returncode != 0:
     raise Exception("编译失败")
 
+#####################################################################
+#
+# 生成预编译效果包
+#
+#####################################################################
+
+# magpiefx-pack 在本机运行，字节码和架构无关，因此总是编译 x64 版本
+p = subprocess.run(
+    vswherePath
+    + " -latest -find Common7\\IDE\\CommonExtensions\\Microsoft\\CMake\\CMake\\bin\\cmake.exe",
+    capture_output=True,
+)
+cmakePath = str(p.stdout, encoding="utf-8").splitlines()[0]
+if not os.access(cmakePath, os.X_OK):
+    raise Exception("未找到 cmake")
+
+packBuildDir = "obj\\MagpieFXPack"
+
+# 使用和 Magpie.Core 相同版本的 fmt
+with open("src\\Magpie.Core\\conanfile.txt", encoding="utf-8") as f:
+    fmtRef = next(line.strip() for line in f if line.startswith("fmt/"))
+
+p = subprocess.run(
+    f"conan install --requires {fmtRef} -g CMakeDeps -pr:a=src\\_ConanDeps\\conanprofile.txt --output-folder {packBuildDir}\\conan --build=missing -s build_type=Release -s arch=x86_64"
+)
+if p.returncode != 0:
+    raise Exception("conan install 失败")
+
+# conanprofile.txt 静态链接 CRT
+p = subprocess.run(
+    f'"{cmakePath}" -S tools\\MagpieFXBench -B {packBuildDir} -A x64 -DCMAKE_PREFIX_PATH={os.getcwd()}\\{packBuildDir}\\conan -DCMAKE_MSVC_RUNTIME_LIBRARY=MultiThreaded'
+)
+if p.returncode != 0:
+    raise Exception("配置 magpiefx-pack 失败")
+
+p = subprocess.run(
+    f'"{cmakePath}" --build {packBuildDir} --config Release --target magpiefx-pack'
+)
+if p.returncode != 0:
+    raise Exception("编译 magpiefx-pack 失败")
+
+# 从发布的 effects 文件夹打包，使效果包中记录的哈希和发布的源码一致
+effectsDir = f"publish\\{platform}\\effects"
+p = subprocess.run(
+    f'"{packBuildDir}\\Release\\magpiefx-pack.exe" {effectsDir} {packBuildDir}\\effects.mfxb'
+)
+if p.returncode != 0:
+    raise Exception("生成效果包失败")
+
+shutil.copy(f"{packBuildDir}\\effects.mfxb", effectsDir)
+
+print("已生成效果包", flush=True)
+
 #####################################################################
 #
 # 清理不需要的文件
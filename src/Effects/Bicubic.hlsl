@@ -38,6 +38,7 @@ SamplerState sam;
 //!STYLE PS
 //!IN INPUT
 //!OUT OUTPUT
+//!FOOTPRINT 2
 
 float weight(float x) {
 	const float B = paramB;
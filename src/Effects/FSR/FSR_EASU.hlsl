@@ -20,6 +20,7 @@ SamplerState sam;
 //!OUT OUTPUT
 //!BLOCK_SIZE 16
 //!NUM_THREADS 64
+//!FOOTPRINT 2
 
 #define min3(a, b, c) min(a, min(b, c))
 #define max3(a, b, c) max(a, max(b, c))
@@ -31,6 +31,7 @@ SamplerState sam;
 //!OUT OUTPUT
 //!BLOCK_SIZE 16
 //!NUM_THREADS 64
+//!FOOTPRINT 1
 
 #define min3(a, b, c) min(a, min(b, c))
 #define max3(a, b, c) max(a, max(b, c))
@@ -101,6 +101,7 @@ SamplerState sam;
 //!STYLE PS
 //!IN INPUT
 //!OUT OUTPUT
+//!FOOTPRINT 0
 
 float3 RGBtoHSV(float3 c) {
     float4 K = float4(0.0, -1.0 / 3.0, 2.0 / 3.0, -1.0);
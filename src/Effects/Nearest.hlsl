@@ -15,6 +15,7 @@ SamplerState sam;
 //!STYLE PS
 //!IN INPUT
 //!OUT OUTPUT
+//!FOOTPRINT 1
 float4 Pass1(float2 pos) {
 	return INPUT.SampleLevel(sam, pos, 0);
 }
@@ -99,6 +99,8 @@ static void WriteProfile(rapidjson::PrettyWriter<rapidjson::StringBuffer>& write
 	writer.Bool(profile.IsShowFPS());
 	writer.Key("captureTitleBar");
 	writer.Bool(profile.IsCaptureTitleBar());
+	writer.Key("autoCropping");
+	writer.Bool(profile.IsAutoCropping());
 	writer.Key("adjustCursorSpeed");
 	writer.Bool(profile.IsAdjustCursorSpeed());
 	writer.Key("drawCursor");
@@ -398,8 +400,10 @@ void AppSettings::IsDeveloperMode(bool value) noexcept {
 		_isFontCacheDisabled = false;
 		_isSaveEffectSources = false;
 		_isWarningsAreErrors = false;
+		_isEffectHotReloadEnabled = false;
 		_duplicateFrameDetectionMode = DuplicateFrameDetectionMode::Dynamic;
 		_isStatisticsForDynamicDetectionEnabled = false;
+		_framePacingMode = FramePacingMode::Off;
 	}
 
 	SaveAsync();
@@ -517,6 +521,8 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 	writer.Bool(data._isSaveEffectSources);
 	writer.Key("warningsAreErrors");
 	writer.Bool(data._isWarningsAreErrors);
+	writer.Key("effectHotReload");
+	writer.Bool(data._isEffectHotReloadEnabled);
 	writer.Key("allowScalingMaximized");
 	writer.Bool(data._isAllowScalingMaximized);
 	writer.Key("simulateExclusiveFullscreen");
@@ -537,6 +543,12 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 	writer.Uint((uint32_t)data._duplicateFrameDetectionMode);
 	writer.Key("enableStatisticsForDynamicDetection");
 	writer.Bool(data._isStatisticsForDynamicDetectionEnabled);
+	writer.Key("framePacingMode");
+	writer.Uint((uint32_t)data._framePacingMode);
+	writer.Key("replayPath");
+	writer.String(StrUtils::UTF16ToUTF8(data._replayPath).c_str());
+	writer.Key("replayFrameRate");
+	writer.Double(data._replayFrameRate);
 
 	ScalingModesService::Get().Export(writer);
 
@@ -670,6 +682,7 @@ void AppSettings::_LoadSettings(const rapidjson::GenericObject<true, rapidjson::
 	JsonHelper::ReadBool(root, "disableFontCache", _isFontCacheDisabled);
 	JsonHelper::ReadBool(root, "saveEffectSources", _isSaveEffectSources);
 	JsonHelper::ReadBool(root, "warningsAreErrors", _isWarningsAreErrors);
+	JsonHelper::ReadBool(root, "effectHotReload", _isEffectHotReloadEnabled);
 	JsonHelper::ReadBool(root, "allowScalingMaximized", _isAllowScalingMaximized);
 	JsonHelper::ReadBool(root, "simulateExclusiveFullscreen", _isSimulateExclusiveFullscreen);
 	if (!JsonHelper::ReadBool(root, "alwaysRunAsAdmin", _isAlwaysRunAsAdmin, true)) {
@@ -699,6 +712,19 @@ void AppSettings::_LoadSettings(const rapidjson::GenericObject<true, rapidjson::
 		_duplicateFrameDetectionMode = (::Magpie::Core::DuplicateFrameDetectionMode)duplicateFrameDetectionMode;
 	}
 	JsonHelper::ReadBool(root, "enableStatisticsForDynamicDetection", _isStatisticsForDynamicDetectionEnabled);
+	{
+		uint32_t framePacingMode = (uint32_t)FramePacingMode::Off;
+		JsonHelper::ReadUInt(root, "framePacingMode", framePacingMode);
+		if (framePacingMode > 2) {
+			framePacingMode = (uint32_t)FramePacingMode::Off;
+		}
+		_framePacingMode = (::Magpie::Core::FramePacingMode)framePacingMode;
+	}
+	JsonHelper::ReadString(root, "replayPath", _replayPath);
+	JsonHelper::ReadFloat(root, "replayFrameRate", _replayFrameRate);
+	if (_replayFrameRate < 0) {
+		_replayFrameRate = 60.0f;
+	}
 
 	[[maybe_unused]] bool result = ScalingModesService::Get().Import(root, true);
 	assert(result);
@@ -785,7 +811,7 @@ bool AppSettings::_LoadProfile(
 			JsonHelper::ReadUInt(profileObj, "captureMode", captureMethod);
 		}
 		
-		if (captureMethod > 3) {
+		if (captureMethod > 4) {
 			captureMethod = (uint32_t)CaptureMethod::GraphicsCapture;
 		} else if (captureMethod == (uint32_t)CaptureMethod::DesktopDuplication) {
 			// Desktop Duplication 捕获模式要求 Win10 20H1+
@@ -825,6 +851,7 @@ bool AppSettings::_LoadProfile(
 		// v0.10.0-preview1 使用 reserveTitleBar
 		JsonHelper::ReadBoolFlag(profileObj, "reserveTitleBar", ScalingFlags::CaptureTitleBar, profile.scalingFlags);
 	}
+	JsonHelper::ReadBoolFlag(profileObj, "autoCropping", ScalingFlags::AutoCropping, profile.scalingFlags);
 	JsonHelper::ReadBoolFlag(profileObj, "adjustCursorSpeed", ScalingFlags::AdjustCursorSpeed, profile.scalingFlags);
 	JsonHelper::ReadBoolFlag(profileObj, "drawCursor", ScalingFlags::DrawCursor, profile.scalingFlags);
 	JsonHelper::ReadBoolFlag(profileObj, "disableDirectFlip", ScalingFlags::DisableDirectFlip, profile.scalingFlags);
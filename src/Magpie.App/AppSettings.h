@@ -50,6 +50,11 @@ struct _AppSettingsData {
 
 	::Magpie::Core::DuplicateFrameDetectionMode _duplicateFrameDetectionMode =
 		::Magpie::Core::DuplicateFrameDetectionMode::Dynamic;
+	::Magpie::Core::FramePacingMode _framePacingMode = ::Magpie::Core::FramePacingMode::Off;
+
+	// 回放的图像文件夹和帧率，见 CaptureMethod::Replay。只能在配置文件中修改
+	std::wstring _replayPath;
+	float _replayFrameRate = 60.0f;
 	
 	bool _isPortableMode = false;
 	bool _isAlwaysRunAsAdmin = false;
@@ -59,6 +64,7 @@ struct _AppSettingsData {
 	bool _isFontCacheDisabled = false;
 	bool _isSaveEffectSources = false;
 	bool _isWarningsAreErrors = false;
+	bool _isEffectHotReloadEnabled = false;
 	bool _isAllowScalingMaximized = false;
 	bool _isSimulateExclusiveFullscreen = false;
 	bool _isInlineParams = false;
@@ -187,6 +193,15 @@ public:
 		SaveAsync();
 	}
 
+	bool IsEffectHotReloadEnabled() const noexcept {
+		return _isEffectHotReloadEnabled;
+	}
+
+	void IsEffectHotReloadEnabled(bool value) noexcept {
+		_isEffectHotReloadEnabled = value;
+		SaveAsync();
+	}
+
 	bool IsAllowScalingMaximized() const noexcept {
 		return _isAllowScalingMaximized;
 	}
@@ -274,6 +289,15 @@ public:
 		SaveAsync();
 	}
 
+	::Magpie::Core::FramePacingMode FramePacingMode() const noexcept {
+		return _framePacingMode;
+	}
+
+	void FramePacingMode(::Magpie::Core::FramePacingMode value) noexcept {
+		_framePacingMode = value;
+		SaveAsync();
+	}
+
 	bool IsStatisticsForDynamicDetectionEnabled() const noexcept {
 		return _isStatisticsForDynamicDetectionEnabled;
 	}
@@ -283,6 +307,14 @@ public:
 		SaveAsync();
 	}
 
+	const std::wstring& ReplayPath() const noexcept {
+		return _replayPath;
+	}
+
+	float ReplayFrameRate() const noexcept {
+		return _replayFrameRate;
+	}
+
 	WinRTUtils::Event<delegate<Magpie::App::Theme>> ThemeChanged;
 	WinRTUtils::Event<delegate<ShortcutAction>> ShortcutChanged;
 	WinRTUtils::Event<delegate<bool>> IsAutoRestoreChanged;
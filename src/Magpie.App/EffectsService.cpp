@@ -5,7 +5,6 @@
 #include "Win32Utils.h"
 #include "CommonSharedConstants.h"
 #include "Logger.h"
-#include <d3dcompiler.h>	// ID3DBlob
 #include <Magpie.Core.h>
 
 using namespace Magpie::Core;
@@ -16,7 +15,13 @@ EffectInfo::EffectInfo() {}
 
 EffectInfo::~EffectInfo() {}
 
-static void ListEffects(std::vector<std::wstring>& result, std::wstring_view prefix = {}) {
+struct EffectFileInfo {
+	std::wstring name;
+	uint64_t fileSize = 0;
+	uint64_t lastWriteTime = 0;
+};
+
+static void ListEffects(std::vector<EffectFileInfo>& result, std::wstring_view prefix = {}) {
 	result.reserve(80);
 
 	WIN32_FIND_DATA findData{};
@@ -30,7 +35,7 @@ static void ListEffects(std::vector<std::wstring>& result, std::wstring_view pre
 				continue;
 			}
 
-			if (Win32Utils::DirExists(StrUtils::Concat(CommonSharedConstants::EFFECTS_DIR, prefix, fileName).c_str())) {
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
 				ListEffects(result, StrUtils::Concat(prefix, fileName, L"\\"));
 				continue;
 			}
@@ -39,64 +44,135 @@ static void ListEffects(std::vector<std::wstring>& result, std::wstring_view pre
 				continue;
 			}
 
-			result.emplace_back(StrUtils::Concat(prefix, fileName.substr(0, fileName.size() - 5)));
+			// 文件大小和修改时间用于检查元数据索引是否过期
+			result.push_back({
+				StrUtils::Concat(prefix, fileName.substr(0, fileName.size() - 5)),
+				((uint64_t)findData.nFileSizeHigh << 32) | findData.nFileSizeLow,
+				((uint64_t)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime
+			});
 		} while (FindNextFile(hFind.get(), &findData));
 	} else {
 		Logger::Get().Win32Error("查找缓存文件失败");
 	}
 }
 
+// 解析效果并填充 metadata 中除文件信息外的部分
+static bool ParseEffectMetadata(const std::wstring& effectName, EffectMetadata& metadata) {
+	EffectDesc effectDesc;
+	effectDesc.name = StrUtils::UTF16ToUTF8(effectName);
+	if (EffectCompiler::Compile(effectDesc, EffectCompilerFlags::NoCompile)) {
+		return false;
+	}
+
+	metadata.sortName = std::move(effectDesc.sortName);
+	metadata.params = std::move(effectDesc.params);
+	metadata.canScale = effectDesc.GetOutputSizeExpr().first.empty();
+	return true;
+}
+
 fire_and_forget EffectsService::StartInitialize() {
 	co_await resume_background();
 
-	std::vector<std::wstring> effectNames;
-	ListEffects(effectNames);
+	std::vector<EffectFileInfo> effectFiles;
+	ListEffects(effectFiles);
 
-	const uint32_t nEffect = (uint32_t)effectNames.size();
+	const uint32_t nEffect = (uint32_t)effectFiles.size();
 	_effectsMap.reserve(nEffect);
 	_effects.reserve(nEffect);
 
-	// 用于同步 _effectsMap 和 _effects 的初始化
+	// 上次启动时保存的元数据，只读，因此可以并行访问
+	phmap::flat_hash_map<std::wstring, EffectMetadata> oldIndex;
+	EffectMetadataIndex::Load(oldIndex);
+
+	phmap::flat_hash_map<std::wstring, EffectMetadata> newIndex;
+	newIndex.reserve(nEffect);
+	std::atomic<uint32_t> reparsedCount = 0;
+
+	// 用于同步 _effectsMap、_effects 和 newIndex 的初始化
 	wil::srwlock srwLock;
 
 	// 并行解析效果
 	Win32Utils::RunParallel([&](uint32_t id) {
-		EffectDesc effectDesc;
+		EffectFileInfo& effectFile = effectFiles[id];
+
+		EffectMetadata metadata;
+		auto it = oldIndex.find(effectFile.name);
+		if (it != oldIndex.end() && it->second.fileSize == effectFile.fileSize
+			&& it->second.lastWriteTime == effectFile.lastWriteTime) {
+			// 未修改
+			metadata = it->second;
+		} else {
+			std::string source;
+			if (!Win32Utils::ReadTextFile(StrUtils::Concat(
+				CommonSharedConstants::EFFECTS_DIR, effectFile.name, L".hlsl").c_str(), source)) {
+				Logger::Get().Error("读取源文件失败");
+				return;
+			}
 
-		effectDesc.name = StrUtils::UTF16ToUTF8(effectNames[id]);
-		if (EffectCompiler::Compile(effectDesc, EffectCompilerFlags::NoCompile)) {
-			return;
+			const uint64_t contentHash = EffectMetadataIndex::HashContent(source);
+			if (it != oldIndex.end() && it->second.contentHash == contentHash) {
+				// 只有修改时间改变
+				metadata = it->second;
+			} else {
+				if (!ParseEffectMetadata(effectFile.name, metadata)) {
+					return;
+				}
+				++reparsedCount;
+			}
+
+			metadata.fileSize = effectFile.fileSize;
+			metadata.lastWriteTime = effectFile.lastWriteTime;
+			metadata.contentHash = contentHash;
 		}
 
 		EffectInfo effect;
-		effect.name = std::move(effectNames[id]);
+		effect.name = effectFile.name;
 
-		if (effectDesc.sortName.empty()) {
+		if (metadata.sortName.empty()) {
 			effect.sortName = effect.name;
 		} else {
 			size_t pos = effect.name.find_last_of(L'\\');
 			if (pos == std::wstring::npos) {
-				effect.sortName = StrUtils::UTF8ToUTF16(effectDesc.sortName);
+				effect.sortName = StrUtils::UTF8ToUTF16(metadata.sortName);
 			} else {
 				effect.sortName = StrUtils::Concat(
 					std::wstring_view(effect.name.c_str(), pos + 1),
-					StrUtils::UTF8ToUTF16(effectDesc.sortName)
+					StrUtils::UTF8ToUTF16(metadata.sortName)
 				);
 			}
 		}
 
-		effect.params = std::move(effectDesc.params);
-		if (effectDesc.GetOutputSizeExpr().first.empty()) {
+		effect.params = metadata.params;
+		if (metadata.canScale) {
 			effect.flags |= EffectInfoFlags::CanScale;
 		}
 
 		auto lock = srwLock.lock_exclusive();
 		_effectsMap.emplace(effect.name, (uint32_t)_effects.size());
 		_effects.emplace_back(std::move(effect));
+		newIndex.emplace(std::move(effectFile.name), std::move(metadata));
 	}, nEffect);
 
 	_initialized.store(true, std::memory_order_release);
 	_initialized.notify_one();
+
+	// 有效果被修改、添加或删除时更新索引
+	bool indexChanged = newIndex.size() != oldIndex.size();
+	if (!indexChanged) {
+		for (const auto& [name, metadata] : newIndex) {
+			auto it = oldIndex.find(name);
+			if (it == oldIndex.end() || it->second.lastWriteTime != metadata.lastWriteTime
+				|| it->second.fileSize != metadata.fileSize) {
+				indexChanged = true;
+				break;
+			}
+		}
+	}
+
+	if (indexChanged) {
+		Logger::Get().Info(fmt::format("重新解析了 {} 个效果", reparsedCount.load()));
+		EffectMetadataIndex::Save(newIndex);
+	}
 }
 
 void EffectsService::WaitForInitialize() {
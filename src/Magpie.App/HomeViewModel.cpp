@@ -358,6 +358,21 @@ void HomeViewModel::IsWarningsAreErrors(bool value) {
 	RaisePropertyChanged(L"IsWarningsAreErrors");
 }
 
+bool HomeViewModel::IsEffectHotReloadEnabled() const noexcept {
+	return AppSettings::Get().IsEffectHotReloadEnabled();
+}
+
+void HomeViewModel::IsEffectHotReloadEnabled(bool value) {
+	AppSettings& settings = AppSettings::Get();
+
+	if (settings.IsEffectHotReloadEnabled() == value) {
+		return;
+	}
+
+	settings.IsEffectHotReloadEnabled(value);
+	RaisePropertyChanged(L"IsEffectHotReloadEnabled");
+}
+
 int HomeViewModel::DuplicateFrameDetectionMode() const noexcept {
 	return (int)AppSettings::Get().DuplicateFrameDetectionMode();
 }
@@ -404,6 +419,26 @@ void HomeViewModel::IsStatisticsForDynamicDetectionEnabled(bool value) {
 	RaisePropertyChanged(L"IsStatisticsForDynamicDetectionEnabled");
 }
 
+int HomeViewModel::FramePacingMode() const noexcept {
+	return (int)AppSettings::Get().FramePacingMode();
+}
+
+void HomeViewModel::FramePacingMode(int value) {
+	if (value < 0) {
+		return;
+	}
+
+	const auto mode = (::Magpie::Core::FramePacingMode)value;
+
+	AppSettings& settings = AppSettings::Get();
+	if (settings.FramePacingMode() == mode) {
+		return;
+	}
+
+	settings.FramePacingMode(mode);
+	RaisePropertyChanged(L"FramePacingMode");
+}
+
 void HomeViewModel::_ScalingService_IsTimerOnChanged(bool value) {
 	if (!value) {
 		RaisePropertyChanged(L"TimerProgressRingValue");
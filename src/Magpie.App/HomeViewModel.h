@@ -84,6 +84,9 @@ struct HomeViewModel : HomeViewModelT<HomeViewModel>, wil::notify_property_chang
 	bool IsWarningsAreErrors() const noexcept;
 	void IsWarningsAreErrors(bool value);
 
+	bool IsEffectHotReloadEnabled() const noexcept;
+	void IsEffectHotReloadEnabled(bool value);
+
 	int DuplicateFrameDetectionMode() const noexcept;
 	void DuplicateFrameDetectionMode(int value);
 
@@ -91,6 +94,9 @@ struct HomeViewModel : HomeViewModelT<HomeViewModel>, wil::notify_property_chang
 
 	bool IsStatisticsForDynamicDetectionEnabled() const noexcept;
 	void IsStatisticsForDynamicDetectionEnabled(bool value);
+
+	int FramePacingMode() const noexcept;
+	void FramePacingMode(int value);
 private:
 	void _ScalingService_IsTimerOnChanged(bool value);
 
@@ -0,0 +1,208 @@
+﻿#include "pch.h"
+#include "OfflineRenderHelper.h"
+#if __has_include("OfflineRenderHelper.g.cpp")
+#include "OfflineRenderHelper.g.cpp"
+#endif
+#include "Logger.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include "AppSettings.h"
+#include "ScalingModesService.h"
+#include "ScalingMode.h"
+#include <Magpie.Core.h>
+
+using namespace ::Magpie::Core;
+
+namespace winrt::Magpie::App::implementation {
+
+static constexpr const wchar_t* USAGE = L"用法: Magpie.exe -render -m <缩放模式名称或序号> -i <输入图像或文件夹> "
+	L"-o <输出图像或文件夹> [-s <宽>x<高>] [-n <渲染次数>] [-warp]\n";
+
+// Magpie.exe 是窗口程序，从命令行启动时需附加到父进程的控制台才能输出
+static void WriteToConsole(std::wstring_view text) noexcept {
+	static const bool isAttached = AttachConsole(ATTACH_PARENT_PROCESS);
+	if (!isAttached) {
+		return;
+	}
+
+	wil::unique_hfile hConsole(CreateFile(L"CONOUT$", GENERIC_WRITE,
+		FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr));
+	if (hConsole) {
+		WriteConsole(hConsole.get(), text.data(), (DWORD)text.size(), nullptr, nullptr);
+	}
+}
+
+static std::wstring ResolvePath(std::wstring_view currentDir, const wchar_t* path) noexcept {
+	if (!PathIsRelative(path)) {
+		return path;
+	}
+	return StrUtils::Concat(currentDir, L"\\", path);
+}
+
+static bool IsImageFile(std::wstring_view fileName) noexcept {
+	const size_t dotPos = fileName.find_last_of(L'.');
+	if (dotPos == std::wstring_view::npos) {
+		return false;
+	}
+
+	// 和 TextureLoader 支持的格式相同
+	const std::wstring suffix = StrUtils::ToLowerCase(fileName.substr(dotPos + 1));
+	return suffix == L"bmp" || suffix == L"jpg" || suffix == L"jpeg" || suffix == L"png"
+		|| suffix == L"tif" || suffix == L"tiff" || suffix == L"dds";
+}
+
+static std::wstring_view GetStem(std::wstring_view fileName) noexcept {
+	const size_t slashPos = fileName.find_last_of(L'\\');
+	if (slashPos != std::wstring_view::npos) {
+		fileName.remove_prefix(slashPos + 1);
+	}
+	return fileName.substr(0, fileName.find_last_of(L'.'));
+}
+
+// 输入为文件夹时按文件名顺序渲染其中所有图像，可以用作图像序列；输出也必须是文件夹，保存为同名 png 文件
+static bool FillPaths(const std::wstring& input, const std::wstring& output, OfflineRenderOptions& options) noexcept {
+	if (!Win32Utils::DirExists(input.c_str())) {
+		options.inputPaths.push_back(input);
+		options.outputPaths.push_back(Win32Utils::DirExists(output.c_str()) ?
+			StrUtils::Concat(output, L"\\", GetStem(input), L".png") : output);
+		return true;
+	}
+
+	if (!Win32Utils::DirExists(output.c_str()) && !CreateDirectory(output.c_str(), nullptr)) {
+		Logger::Get().Win32Error("创建输出文件夹失败");
+		return false;
+	}
+
+	std::vector<std::wstring> fileNames;
+	WIN32_FIND_DATA findData{};
+	wil::unique_hfind hFind(FindFirstFileEx(StrUtils::Concat(input, L"\\*").c_str(),
+		FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
+	if (hFind) {
+		do {
+			if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && IsImageFile(findData.cFileName)) {
+				fileNames.emplace_back(findData.cFileName);
+			}
+		} while (FindNextFile(hFind.get(), &findData));
+	}
+
+	if (fileNames.empty()) {
+		Logger::Get().Error("输入文件夹中没有图像");
+		return false;
+	}
+
+	std::sort(fileNames.begin(), fileNames.end());
+	for (const std::wstring& fileName : fileNames) {
+		options.inputPaths.push_back(StrUtils::Concat(input, L"\\", fileName));
+		options.outputPaths.push_back(StrUtils::Concat(output, L"\\", GetStem(fileName), L".png"));
+	}
+	return true;
+}
+
+static const ScalingMode* FindScalingMode(std::wstring_view nameOrIdx) noexcept {
+	ScalingModesService& scalingModesService = ScalingModesService::Get();
+	const uint32_t count = scalingModesService.GetScalingModeCount();
+
+	for (uint32_t i = 0; i < count; ++i) {
+		const ScalingMode& mode = scalingModesService.GetScalingMode(i);
+		if (mode.name == nameOrIdx) {
+			return &mode;
+		}
+	}
+
+	// 找不到同名的缩放模式则视为序号
+	if (nameOrIdx.empty() || !std::all_of(nameOrIdx.begin(), nameOrIdx.end(), iswdigit)) {
+		return nullptr;
+	}
+	const uint32_t idx = (uint32_t)_wtoi(nameOrIdx.data());
+	return idx < count ? &scalingModesService.GetScalingMode(idx) : nullptr;
+}
+
+int32_t OfflineRenderHelper::Run(const hstring& arguments, const hstring& currentDir) {
+	int argc = 0;
+	wil::unique_hlocal_ptr<wchar_t*> argv(CommandLineToArgvW(arguments.c_str(), &argc));
+	if (!argv) {
+		Logger::Get().Win32Error("CommandLineToArgvW 失败");
+		return 1;
+	}
+
+	std::wstring_view modeName;
+	std::wstring input;
+	std::wstring output;
+	OfflineRenderOptions options;
+
+	// 第一个参数为 -render
+	for (int i = 1; i < argc; ++i) {
+		const std::wstring_view arg(argv.get()[i]);
+		const bool hasValue = i + 1 < argc;
+
+		if (hasValue && arg == L"-m") {
+			modeName = argv.get()[++i];
+		} else if (hasValue && arg == L"-i") {
+			input = ResolvePath(currentDir, argv.get()[++i]);
+		} else if (hasValue && arg == L"-o") {
+			output = ResolvePath(currentDir, argv.get()[++i]);
+		} else if (hasValue && arg == L"-s") {
+			if (swscanf_s(argv.get()[++i], L"%dx%d", &options.targetSize.cx, &options.targetSize.cy) != 2
+				|| options.targetSize.cx <= 0 || options.targetSize.cy <= 0) {
+				WriteToConsole(L"目标尺寸不合法\n");
+				return 1;
+			}
+		} else if (hasValue && arg == L"-n") {
+			options.repeatCount = (uint32_t)std::max(1, _wtoi(argv.get()[++i]));
+		} else if (arg == L"-warp") {
+			options.isWarp = true;
+		} else {
+			WriteToConsole(USAGE);
+			return 1;
+		}
+	}
+
+	if (modeName.empty() || input.empty() || output.empty()) {
+		WriteToConsole(USAGE);
+		return 1;
+	}
+
+	AppSettings& settings = AppSettings::Get();
+	if (!settings.Initialize()) {
+		WriteToConsole(L"读取配置失败\n");
+		return 1;
+	}
+
+	const ScalingMode* scalingMode = FindScalingMode(modeName);
+	if (!scalingMode) {
+		WriteToConsole(fmt::format(L"找不到缩放模式 {}\n", modeName));
+		return 1;
+	}
+
+	if (!FillPaths(input, output, options)) {
+		WriteToConsole(L"找不到输入图像\n");
+		return 1;
+	}
+
+	// 和 ScalingService 相同地应用全局配置，显卡使用默认配置中的设置
+	options.effects = scalingMode->effects;
+	options.graphicsCard = settings.DefaultProfile().graphicsCard;
+	if (settings.IsInlineParams()) {
+		for (EffectOption& effect : options.effects) {
+			effect.flags |= EffectOptionFlags::InlineParams;
+		}
+	}
+
+	if (settings.IsEffectCacheDisabled()) {
+		options.compileFlags |= EffectCompilerFlags::NoCache;
+	}
+	if (settings.IsSaveEffectSources()) {
+		options.compileFlags |= EffectCompilerFlags::SaveSources;
+	}
+	if (settings.IsWarningsAreErrors()) {
+		options.compileFlags |= EffectCompilerFlags::WarningsAreErrors;
+	}
+
+	std::string report;
+	const bool success = OfflineRenderer::Run(options, report);
+	// 初始化失败时没有报告
+	WriteToConsole(report.empty() ? L"离线渲染失败，详见日志\n" : StrUtils::UTF8ToUTF16(report));
+	return success ? 0 : 1;
+}
+
+}
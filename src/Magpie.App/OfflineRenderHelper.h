@@ -0,0 +1,19 @@
+#pragma once
+#include "OfflineRenderHelper.g.h"
+
+namespace winrt::Magpie::App::implementation {
+
+struct OfflineRenderHelper : OfflineRenderHelperT<OfflineRenderHelper> {
+    OfflineRenderHelper() = default;
+
+    static int32_t Run(const hstring& arguments, const hstring& currentDir);
+};
+
+}
+
+namespace winrt::Magpie::App::factory_implementation {
+
+struct OfflineRenderHelper : OfflineRenderHelperT<OfflineRenderHelper, implementation::OfflineRenderHelper> {
+};
+
+}
@@ -107,7 +107,7 @@ ProfileViewModel::ProfileViewModel(int profileIdx) : _isDefaultProfile(profileId
 
 	{
 		std::vector<IInspectable> captureMethods;
-		captureMethods.reserve(4);
+		captureMethods.reserve(5);
 		captureMethods.push_back(box_value(L"Graphics Capture"));
 		if (Win32Utils::GetOSVersion().Is20H1OrNewer()) {
 			// Desktop Duplication 要求 Win10 20H1+
@@ -115,6 +115,7 @@ ProfileViewModel::ProfileViewModel(int profileIdx) : _isDefaultProfile(profileId
 		}
 		captureMethods.push_back(box_value(L"GDI"));
 		captureMethods.push_back(box_value(L"DwmSharedSurface"));
+		captureMethods.push_back(box_value(L"Replay"));
 
 		_captureMethods = single_threaded_vector(std::move(captureMethods));
 	}
@@ -634,6 +635,21 @@ bool ProfileViewModel::CanCaptureTitleBar() const noexcept {
 		|| _data->captureMethod == CaptureMethod::DesktopDuplication;
 }
 
+bool ProfileViewModel::IsAutoCropping() const noexcept {
+	return _data->IsAutoCropping();
+}
+
+void ProfileViewModel::IsAutoCropping(bool value) {
+	if (_data->IsAutoCropping() == value) {
+		return;
+	}
+
+	_data->IsAutoCropping(value);
+	AppSettings::Get().SaveAsync();
+
+	RaisePropertyChanged(L"IsAutoCropping");
+}
+
 bool ProfileViewModel::IsCroppingEnabled() const noexcept {
 	return _data->isCroppingEnabled;
 }
@@ -104,6 +104,9 @@ struct ProfileViewModel : ProfileViewModelT<ProfileViewModel>,
 
 	bool CanCaptureTitleBar() const noexcept;
 
+	bool IsAutoCropping() const noexcept;
+	void IsAutoCropping(bool value);
+
 	bool IsCroppingEnabled() const noexcept;
 	void IsCroppingEnabled(bool value);
 
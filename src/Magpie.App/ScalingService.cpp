@@ -308,9 +308,13 @@ bool ScalingService::_StartScale(HWND hWnd, const Profile& profile) {
 	options.IsFontCacheDisabled(settings.IsFontCacheDisabled());
 	options.IsSaveEffectSources(settings.IsSaveEffectSources());
 	options.IsWarningsAreErrors(settings.IsWarningsAreErrors());
+	options.IsEffectHotReloadEnabled(settings.IsEffectHotReloadEnabled());
 	options.IsAllowScalingMaximized(settings.IsAllowScalingMaximized());
 	options.IsSimulateExclusiveFullscreen(settings.IsSimulateExclusiveFullscreen());
 	options.duplicateFrameDetectionMode = settings.DuplicateFrameDetectionMode();
+	options.framePacingMode = settings.FramePacingMode();
+	options.replayPath = settings.ReplayPath();
+	options.replayFrameRate = settings.ReplayFrameRate();
 	options.IsStatisticsForDynamicDetectionEnabled(settings.IsStatisticsForDynamicDetectionEnabled());
 
 	_isAutoScaling = profile.isAutoScale;
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "AutoCropper.h"
+#include "DeviceResources.h"
+#include "BackendDescriptorStore.h"
+#include "Logger.h"
+#include "shaders/LetterboxCS.h"
+
+namespace Magpie::Core {
+
+// 同时等待取回的归约结果数
+static constexpr uint32_t READBACK_RING_DEPTH = 3;
+
+bool AutoCropper::Initialize(
+	DeviceResources& deviceResources,
+	BackendDescriptorStore& descriptorStore,
+	SIZE frameSize,
+	POINT offset
+) noexcept {
+	_d3dDC = deviceResources.GetD3DDC();
+	ID3D11Device5* d3dDevice = deviceResources.GetD3DDevice();
+
+	_detector.Initialize((uint32_t)frameSize.cx, (uint32_t)frameSize.cy);
+	_rowCount = LetterboxDetector::RowCount((uint32_t)frameSize.cy);
+	_columnCount = LetterboxDetector::ColumnCount((uint32_t)frameSize.cx);
+
+	const uint32_t elementCount = _rowCount + _columnCount;
+	D3D11_BUFFER_DESC bd{
+		.ByteWidth = elementCount * 4,
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+		.StructureByteStride = 4
+	};
+	HRESULT hr = d3dDevice->CreateBuffer(&bd, nullptr, _resultBuffer.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateBuffer 失败", hr);
+		return false;
+	}
+
+	_resultBufferUav = descriptorStore.GetUnorderedAccessView(
+		_resultBuffer.get(), elementCount, DXGI_FORMAT_R32_UINT);
+	if (!_resultBufferUav) {
+		Logger::Get().Error("GetUnorderedAccessView 失败");
+		return false;
+	}
+
+	bd.Usage = D3D11_USAGE_STAGING;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	bd.BindFlags = 0;
+	_readBackBuffers.resize(READBACK_RING_DEPTH);
+	for (winrt::com_ptr<ID3D11Buffer>& readBackBuffer : _readBackBuffers) {
+		hr = d3dDevice->CreateBuffer(&bd, nullptr, readBackBuffer.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
+	_readbackRing.Initialize(READBACK_RING_DEPTH);
+
+	hr = d3dDevice->CreateComputeShader(LetterboxCS, sizeof(LetterboxCS), nullptr, _shader.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateComputeShader 失败", hr);
+		return false;
+	}
+
+	{
+		// cbuffer __CB1 : register(b0) { uint2 offset; uint2 size; uint rowCount; };
+		const uint32_t constants[8] = {
+			(uint32_t)offset.x,
+			(uint32_t)offset.y,
+			(uint32_t)frameSize.cx,
+			(uint32_t)frameSize.cy,
+			_rowCount
+		};
+
+		const D3D11_BUFFER_DESC cbDesc{
+			.ByteWidth = sizeof(constants),
+			.Usage = D3D11_USAGE_IMMUTABLE,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER
+		};
+		const D3D11_SUBRESOURCE_DATA initData{ .pSysMem = constants };
+		hr = d3dDevice->CreateBuffer(&cbDesc, &initData, _constantBuffer.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
+	// 每个线程组处理 2x2 个单元
+	constexpr uint32_t GROUP_SIZE = LetterboxDetector::CELL_SIZE * 2;
+	_dispatchCount.first = ((uint32_t)frameSize.cx + GROUP_SIZE - 1) / GROUP_SIZE;
+	_dispatchCount.second = ((uint32_t)frameSize.cy + GROUP_SIZE - 1) / GROUP_SIZE;
+
+	return true;
+}
+
+void AutoCropper::Submit(ID3D11ShaderResourceView* input) noexcept {
+	const std::optional<uint32_t> slot = _readbackRing.Submit(_frameIndex++);
+	if (!slot) {
+		// GPU 落后太多，跳过这一帧。检测本就需要多帧，少一帧无妨
+		return;
+	}
+
+	_d3dDC->CSSetShaderResources(0, 1, &input);
+
+	{
+		ID3D11Buffer* t = _constantBuffer.get();
+		_d3dDC->CSSetConstantBuffers(0, 1, &t);
+	}
+
+	// 将缓冲区置零
+	static constexpr UINT ZERO[4]{};
+	_d3dDC->ClearUnorderedAccessViewUint(_resultBufferUav, ZERO);
+	_d3dDC->CSSetUnorderedAccessViews(0, 1, &_resultBufferUav, nullptr);
+
+	_d3dDC->CSSetShader(_shader.get(), nullptr, 0);
+	_d3dDC->Dispatch(_dispatchCount.first, _dispatchCount.second, 1);
+
+	// 解绑，之后的效果可能将帧源的输出作为 SRV 读取
+	ID3D11UnorderedAccessView* nullUav = nullptr;
+	_d3dDC->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+
+	_d3dDC->CopyResource(_readBackBuffers[*slot].get(), _resultBuffer.get());
+}
+
+bool AutoCropper::Poll() noexcept {
+	bool isChanged = false;
+
+	_readbackRing.Poll([&](uint32_t slot, uint64_t) {
+		ID3D11Buffer* readBackBuffer = _readBackBuffers[slot].get();
+
+		D3D11_MAPPED_SUBRESOURCE ms;
+		HRESULT hr = _d3dDC->Map(readBackBuffer, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &ms);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+			return false;
+		}
+
+		if (FAILED(hr)) {
+			// 丢弃这次结果
+			Logger::Get().ComError("Map 失败", hr);
+			return true;
+		}
+
+		const uint32_t* data = (const uint32_t*)ms.pData;
+		if (_detector.Update({ data, _rowCount }, { data + _rowCount, _columnCount })) {
+			isChanged = true;
+		}
+
+		_d3dDC->Unmap(readBackBuffer, 0);
+		return true;
+	});
+
+	return isChanged;
+}
+
+}
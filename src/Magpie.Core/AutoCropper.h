@@ -0,0 +1,62 @@
+#pragma once
+#include "LetterboxDetector.h"
+#include "ReadbackRing.h"
+
+namespace Magpie::Core {
+
+class DeviceResources;
+class BackendDescriptorStore;
+
+// 自动裁剪黑边，见 ScalingFlags::AutoCropping。每帧在 GPU 上把帧源的输出归约为每行和每列单元的最大值，
+// 异步取回后交给 LetterboxDetector，后端线程从不等待结果
+class AutoCropper {
+public:
+	AutoCropper() = default;
+	AutoCropper(const AutoCropper&) = delete;
+	AutoCropper(AutoCropper&&) = delete;
+
+	// frameSize 为帧源的输出尺寸，offset 为输出在 Submit 传入的纹理中的起点
+	bool Initialize(
+		DeviceResources& deviceResources,
+		BackendDescriptorStore& descriptorStore,
+		SIZE frameSize,
+		POINT offset
+	) noexcept;
+
+	// 归约一帧，结果在之后的 Poll 中取回。GPU 落后太多时跳过这一帧
+	void Submit(ID3D11ShaderResourceView* input) noexcept;
+
+	// 取回所有已完成的归约，不会等待 GPU。返回 true 表示 ActiveRect 变化
+	bool Poll() noexcept;
+
+	const LetterboxDetector::Rect& ActiveRect() const noexcept {
+		return _detector.ActiveRect();
+	}
+
+	bool IsCropped() const noexcept {
+		return _detector.IsCropped();
+	}
+
+	const LetterboxDetector::Statistics& GetStatistics() const noexcept {
+		return _detector.GetStatistics();
+	}
+
+private:
+	ID3D11DeviceContext4* _d3dDC = nullptr;
+
+	winrt::com_ptr<ID3D11ComputeShader> _shader;
+	winrt::com_ptr<ID3D11Buffer> _constantBuffer;
+	winrt::com_ptr<ID3D11Buffer> _resultBuffer;
+	ID3D11UnorderedAccessView* _resultBufferUav = nullptr;
+	// 见 _readbackRing
+	std::vector<winrt::com_ptr<ID3D11Buffer>> _readBackBuffers;
+	ReadbackRing _readbackRing;
+	uint64_t _frameIndex = 0;
+
+	LetterboxDetector _detector;
+	uint32_t _rowCount = 0;
+	uint32_t _columnCount = 0;
+	std::pair<uint32_t, uint32_t> _dispatchCount;
+};
+
+}
@@ -23,6 +23,12 @@ public:
 		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN
 	) noexcept;
 
+	// 纹理释放前调用，否则之后在同一地址创建的纹理会得到旧的视图
+	void ReleaseViews(ID3D11Texture2D* texture) noexcept {
+		_srvMap.erase(texture);
+		_uavMap.erase(texture);
+	}
+
 private:
 	ID3D11Device5* _d3dDevice = nullptr;
 
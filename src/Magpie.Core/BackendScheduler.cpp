@@ -0,0 +1,107 @@
+// 不使用预编译头，以便在其他平台构建
+#include "BackendScheduler.h"
+#include <algorithm>
+
+namespace Magpie::Core {
+
+// sorted 为升序且不为空
+static int64_t Percentile(std::span<const int64_t> sorted, double p) noexcept {
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+void BackendScheduler::Initialize(SourceKind kind, int64_t pollPeriod) noexcept {
+	_kind = kind;
+	_pollPeriod = pollPeriod > 0 ? pollPeriod : 1'000'000'000 / 60;
+	_lastCaptureTime = INT64_MIN;
+	_lastNewFrameTime = INT64_MIN;
+	_expectedFrameTime = INT64_MIN;
+	_intervals.clear();
+	_intervalCount = 0;
+	_statistics = {};
+}
+
+int64_t BackendScheduler::NextCaptureTime(int64_t now) const noexcept {
+	if (_kind != SourceKind::Polled || _lastCaptureTime == INT64_MIN) {
+		return now;
+	}
+
+	// 轮询间隔不小于 _pollPeriod，预计的下一个内容帧之前无需轮询
+	return std::max(_lastCaptureTime + _pollPeriod, _expectedFrameTime);
+}
+
+void BackendScheduler::OnCaptured(int64_t captureTime, bool isNewFrame) noexcept {
+	++_statistics.captureCount;
+
+	// 推迟了轮询时新帧可能在这段时间内的任何时候到达，无法得知内容帧的准确时间
+	const bool isAccurate = _kind != SourceKind::Polled || _lastCaptureTime == INT64_MIN
+		|| captureTime - _lastCaptureTime <= _pollPeriod * 3 / 2;
+	_lastCaptureTime = captureTime;
+
+	if (!isNewFrame) {
+		return;
+	}
+
+	++_statistics.newFrameCount;
+
+	if (!isAccurate) {
+		// 推迟轮询后的第一次捕获就有新帧，内容帧率可能已经提高，重新统计
+		_intervals.clear();
+		_intervalCount = 0;
+		_lastNewFrameTime = INT64_MIN;
+	} else {
+		if (_lastNewFrameTime != INT64_MIN) {
+			const int64_t interval = captureTime - _lastNewFrameTime;
+			if (_intervals.size() < HISTORY_SIZE) {
+				_intervals.push_back(interval);
+			} else {
+				_intervals[_intervalCount % HISTORY_SIZE] = interval;
+			}
+			++_intervalCount;
+		}
+		_lastNewFrameTime = captureTime;
+	}
+
+	_expectedFrameTime = INT64_MIN;
+	if (_kind == SourceKind::Polled && _intervals.size() >= MIN_HISTORY_SIZE) {
+		// 只在内容帧的间隔稳定时推迟轮询，如帧率固定的游戏和视频。光标闪烁和打字等不规则的变化无法预测，
+		// 推迟轮询会使新帧的延迟大幅增加
+		std::array<int64_t, HISTORY_SIZE> buffer;
+		const std::span<const int64_t> sorted = _SortIntervals(buffer);
+		const int64_t minInterval = Percentile(sorted, 0.1);
+		const int64_t maxInterval = Percentile(sorted, 0.9);
+		if (minInterval >= 2 * _pollPeriod && maxInterval - minInterval <= _pollPeriod) {
+			// 轮询得到的时间有 _pollPeriod 的误差，提前一个周期开始轮询。最多跳过一次轮询，
+			// 预测错误时新帧最多推迟一个周期
+			_expectedFrameTime = captureTime + std::min(minInterval - _pollPeriod, 2 * _pollPeriod);
+		}
+	}
+}
+
+std::span<const int64_t> BackendScheduler::_SortIntervals(std::array<int64_t, HISTORY_SIZE>& buffer) const noexcept {
+	// 在栈上排序，每次捕获都会调用，不能分配内存
+	const auto end = std::copy(_intervals.begin(), _intervals.end(), buffer.begin());
+	std::sort(buffer.begin(), end);
+	return { buffer.data(), _intervals.size() };
+}
+
+float BackendScheduler::ContentFrameRate() const noexcept {
+	if (_intervals.size() < MIN_HISTORY_SIZE) {
+		return 0.0f;
+	}
+
+	// 计算平均间隔，轮询的误差在多帧之间抵消。忽略内容静止造成的长间隔
+	std::array<int64_t, HISTORY_SIZE> buffer;
+	const int64_t limit = 2 * Percentile(_SortIntervals(buffer), 0.5);
+	int64_t sum = 0;
+	uint32_t count = 0;
+	for (int64_t interval : _intervals) {
+		if (interval <= limit) {
+			sum += interval;
+			++count;
+		}
+	}
+
+	return sum > 0 ? float(count * 1e9 / sum) : 0.0f;
+}
+
+}
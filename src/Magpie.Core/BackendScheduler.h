@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 决定后端线程何时捕获，并测量帧源的内容帧率。时间均为同一个单调时钟的纳秒数
+class BackendScheduler {
+public:
+	enum class SourceKind {
+		// 有新帧时唤醒后端，如 Graphics Capture 通过后端线程的消息队列通知
+		Event,
+		// 只能主动捕获，如 GDI 和 DwmSharedSurface
+		Polled,
+		// 捕获时可以阻塞等待新帧，但无法和消息一起等待，如 Desktop Duplication
+		Blocking
+	};
+
+	// 阻塞等待新帧的最长时间，期间到达的消息最多推迟这么久
+	static constexpr int64_t MAX_BLOCKING_WAIT = 16'000'000;
+	// 统计最近多少个内容帧的间隔
+	static constexpr uint32_t HISTORY_SIZE = 64;
+	// 统计到这么多间隔后才按内容帧率安排轮询
+	static constexpr uint32_t MIN_HISTORY_SIZE = 8;
+
+	// pollPeriod 为轮询的最小间隔，通常为刷新周期，不大于 0 时使用 1/60 秒
+	void Initialize(SourceKind kind, int64_t pollPeriod) noexcept;
+
+	SourceKind Kind() const noexcept {
+		return _kind;
+	}
+
+	// 最早何时应再次捕获，晚于 now 时后端应等待到这个时间（同时等待消息）。
+	// 只有 Polled 会推迟捕获，其他帧源有新帧时才会唤醒后端
+	int64_t NextCaptureTime(int64_t now) const noexcept;
+
+	// Blocking 帧源捕获时最多等待新帧多久，单位为毫秒
+	uint32_t BlockingTimeout() const noexcept {
+		return uint32_t(MAX_BLOCKING_WAIT / 1'000'000);
+	}
+
+	// 一次捕获有了结果，重复帧检查完成后才算有结果。captureTime 为开始捕获的时间，
+	// isNewFrame 表示内容有变化
+	void OnCaptured(int64_t captureTime, bool isNewFrame) noexcept;
+
+	// 最近的内容帧率，尚未统计到足够的帧时为 0
+	float ContentFrameRate() const noexcept;
+
+	struct Statistics {
+		// 以下为开始以来的总数
+		uint64_t captureCount = 0;
+		uint64_t newFrameCount = 0;
+	};
+
+	const Statistics& GetStatistics() const noexcept {
+		return _statistics;
+	}
+
+private:
+	// 把内容帧的间隔复制到 buffer 中排序
+	std::span<const int64_t> _SortIntervals(std::array<int64_t, HISTORY_SIZE>& buffer) const noexcept;
+
+	SourceKind _kind = SourceKind::Event;
+	int64_t _pollPeriod = 0;
+
+	int64_t _lastCaptureTime = INT64_MIN;
+	int64_t _lastNewFrameTime = INT64_MIN;
+	// 下一个内容帧最早可能的时间，不推迟轮询时为 INT64_MIN
+	int64_t _expectedFrameTime = INT64_MIN;
+
+	// 内容帧的间隔，环形缓冲区
+	std::vector<int64_t> _intervals;
+	uint64_t _intervalCount = 0;
+
+	Statistics _statistics;
+};
+
+}
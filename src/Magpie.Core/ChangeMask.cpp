@@ -0,0 +1,110 @@
+// 不使用预编译头，以便在其他平台构建
+#include "ChangeMask.h"
+#include <algorithm>
+
+namespace Magpie::Core {
+
+static uint32_t TileCount(uint32_t size) noexcept {
+	return (size + ChangeMask::TILE_SIZE - 1) / ChangeMask::TILE_SIZE;
+}
+
+uint32_t ChangeMask::WordCount(uint32_t width, uint32_t height) noexcept {
+	return 1 + (TileCount(width) * TileCount(height) + 31) / 32;
+}
+
+void ChangeMask::Compute(
+	const uint32_t* cur,
+	const uint32_t* prev,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pitch,
+	std::span<uint32_t> result,
+	uint32_t compareMask
+) noexcept {
+	std::fill(result.begin(), result.end(), 0);
+
+	const uint32_t tilesX = TileCount(width);
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint32_t* curRow = cur + (size_t)y * pitch;
+		const uint32_t* prevRow = prev + (size_t)y * pitch;
+
+		for (uint32_t x = 0; x < width; ++x) {
+			if (((curRow[x] ^ prevRow[x]) & compareMask) == 0) {
+				continue;
+			}
+
+			const uint32_t tileIdx = (y / TILE_SIZE) * tilesX + x / TILE_SIZE;
+			result[0] = 1;
+			result[1 + tileIdx / 32] |= 1u << (tileIdx % 32);
+
+			// 跳到下一个块
+			x = (x / TILE_SIZE + 1) * TILE_SIZE - 1;
+		}
+	}
+}
+
+bool ChangeMask::IsTileChanged(std::span<const uint32_t> mask, uint32_t width, uint32_t tileX, uint32_t tileY) noexcept {
+	const uint32_t tileIdx = tileY * TileCount(width) + tileX;
+	return mask[1 + tileIdx / 32] & (1u << (tileIdx % 32));
+}
+
+void ChangeMask::ToRects(
+	std::span<const uint32_t> mask,
+	uint32_t width,
+	uint32_t height,
+	SmallVector<RegionPropagator::Rect>& rects
+) noexcept {
+	rects.clear();
+
+	if (mask.empty() || mask[0] == 0) {
+		return;
+	}
+
+	const uint32_t tilesX = TileCount(width);
+	const uint32_t tilesY = TileCount(height);
+
+	// 上一行的矩形在 rects 中的索引
+	SmallVector<uint32_t> prevRow;
+	SmallVector<uint32_t> curRow;
+
+	for (uint32_t ty = 0; ty < tilesY; ++ty) {
+		const int32_t top = int32_t(ty * TILE_SIZE);
+		const int32_t bottom = (int32_t)std::min((ty + 1) * TILE_SIZE, height);
+
+		curRow.clear();
+		// 上一行的矩形按 left 递增，因此可以和当前行同步遍历
+		uint32_t prevPos = 0;
+
+		for (uint32_t tx = 0; tx < tilesX;) {
+			if (!IsTileChanged(mask, width, tx, ty)) {
+				++tx;
+				continue;
+			}
+
+			const uint32_t begin = tx;
+			while (tx < tilesX && IsTileChanged(mask, width, tx, ty)) {
+				++tx;
+			}
+
+			const int32_t left = int32_t(begin * TILE_SIZE);
+			const int32_t right = (int32_t)std::min(tx * TILE_SIZE, width);
+
+			while (prevPos < prevRow.size() && rects[prevRow[prevPos]].left < left) {
+				++prevPos;
+			}
+
+			if (prevPos < prevRow.size() && rects[prevRow[prevPos]].left == left
+				&& rects[prevRow[prevPos]].right == right) {
+				rects[prevRow[prevPos]].bottom = bottom;
+				curRow.push_back(prevRow[prevPos]);
+			} else {
+				curRow.push_back((uint32_t)rects.size());
+				rects.push_back({ left, top, right, bottom });
+			}
+		}
+
+		std::swap(prevRow, curRow);
+	}
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include "RegionPropagator.h"
+
+namespace Magpie::Core {
+
+// 帧源相邻两次输出的逐块比较结果，布局和 DuplicateFrameCS 的输出相同：第一个元素非零表示有变化，
+// 之后按行优先每个块占一位
+struct ChangeMask {
+	static constexpr uint32_t TILE_SIZE = 16;
+
+	// 包括第一个元素
+	static uint32_t WordCount(uint32_t width, uint32_t height) noexcept;
+
+	// DuplicateFrameCS 的 CPU 参考实现。cur 和 prev 为 32 位像素，pitch 为每行的像素数，
+	// 只比较 compareMask 中的位，默认忽略 Alpha 通道
+	static void Compute(
+		const uint32_t* cur,
+		const uint32_t* prev,
+		uint32_t width,
+		uint32_t height,
+		uint32_t pitch,
+		std::span<uint32_t> result,
+		uint32_t compareMask = 0x00FFFFFF
+	) noexcept;
+
+	static bool IsTileChanged(std::span<const uint32_t> mask, uint32_t width, uint32_t tileX, uint32_t tileY) noexcept;
+
+	// 把变化的块转换为互不重叠的矩形，已裁剪到 width 和 height。同一行相邻的块合并为一个矩形，
+	// 上下相邻且左右边界相同的矩形再合并
+	static void ToRects(
+		std::span<const uint32_t> mask,
+		uint32_t width,
+		uint32_t height,
+		SmallVector<RegionPropagator::Rect>& rects
+	) noexcept;
+};
+
+}
@@ -136,8 +136,8 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 
 	DXGI_OUTDUPL_FRAME_INFO info;
 	winrt::com_ptr<IDXGIResource> dxgiRes;
-	// 等待 1ms
-	HRESULT hr = _outputDup->AcquireNextFrame(1, &info, dxgiRes.put());
+	// 没有新帧时阻塞等待，由后端决定最长等待时间
+	HRESULT hr = _outputDup->AcquireNextFrame(_frameWaitTimeout, &info, dxgiRes.put());
 	if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
 		return UpdateState::Waiting;
 	}
@@ -152,7 +152,22 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 	bool noUpdate = true;
 
 	// 检索 move rects 和 dirty rects
-	// 这些区域如果和窗口客户区有重叠则表明画面有变化
+	// 这些区域如果和窗口客户区有重叠则表明画面有变化，重叠部分即为输出中变化的区域
+	const auto addRect = [&](const RECT& rect) {
+		RECT overlap;
+		if (!IntersectRect(&overlap, &_srcClientInMonitor, &rect)) {
+			return;
+		}
+
+		noUpdate = false;
+		_AddDirtyRect({
+			overlap.left - _srcClientInMonitor.left,
+			overlap.top - _srcClientInMonitor.top,
+			overlap.right - _srcClientInMonitor.left,
+			overlap.bottom - _srcClientInMonitor.top
+		});
+	};
+
 	if (info.TotalMetadataBufferSize) {
 		if (info.TotalMetadataBufferSize > _dupMetaData.size()) {
 			_dupMetaData.resize(info.TotalMetadataBufferSize);
@@ -160,7 +175,7 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 
 		uint32_t bufSize = info.TotalMetadataBufferSize;
 
-		// Move rects
+		// Move rects，移动的源区域如有变化会包含在 dirty rects 中
 		hr = _outputDup->GetFrameMoveRects(
 			bufSize, (DXGI_OUTDUPL_MOVE_RECT*)_dupMetaData.data(), &bufSize);
 		if (FAILED(hr)) {
@@ -170,33 +185,22 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 
 		uint32_t nRect = bufSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
 		for (uint32_t i = 0; i < nRect; ++i) {
-			const DXGI_OUTDUPL_MOVE_RECT& rect = 
-				((DXGI_OUTDUPL_MOVE_RECT*)_dupMetaData.data())[i];
-			if (Win32Utils::CheckOverlap(_srcClientInMonitor, rect.DestinationRect)) {
-				noUpdate = false;
-				break;
-			}
+			addRect(((DXGI_OUTDUPL_MOVE_RECT*)_dupMetaData.data())[i].DestinationRect);
 		}
 
-		if (noUpdate) {
-			bufSize = info.TotalMetadataBufferSize;
+		bufSize = info.TotalMetadataBufferSize;
 
-			// Dirty rects
-			hr = _outputDup->GetFrameDirtyRects(
-				bufSize, (RECT*)_dupMetaData.data(), &bufSize);
-			if (FAILED(hr)) {
-				Logger::Get().ComError("GetFrameDirtyRects 失败", hr);
-				return UpdateState::Error;
-			}
+		// Dirty rects
+		hr = _outputDup->GetFrameDirtyRects(
+			bufSize, (RECT*)_dupMetaData.data(), &bufSize);
+		if (FAILED(hr)) {
+			Logger::Get().ComError("GetFrameDirtyRects 失败", hr);
+			return UpdateState::Error;
+		}
 
-			nRect = bufSize / sizeof(RECT);
-			for (uint32_t i = 0; i < nRect; ++i) {
-				const RECT& rect = ((RECT*)_dupMetaData.data())[i];
-				if (Win32Utils::CheckOverlap(_srcClientInMonitor, rect)) {
-					noUpdate = false;
-					break;
-				}
-			}
+		nRect = bufSize / sizeof(RECT);
+		for (uint32_t i = 0; i < nRect; ++i) {
+			addRect(((RECT*)_dupMetaData.data())[i]);
 		}
 	}
 
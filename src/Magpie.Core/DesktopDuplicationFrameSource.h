@@ -19,6 +19,10 @@ public:
 		return "Desktop Duplication";
 	}
 
+	bool CanReportDirtyRects() const noexcept override {
+		return true;
+	}
+
 protected:
 	bool _HasRoundCornerInWin11() noexcept override {
 		return true;
@@ -1,14 +1,12 @@
 #include "pch.h"
 #include "DeviceResources.h"
-#include "ScalingOptions.h"
 #include "Logger.h"
 #include "StrUtils.h"
 #include "DirectXHelper.h"
-#include "ScalingWindow.h"
 
 namespace Magpie::Core {
 
-bool DeviceResources::Initialize() noexcept {
+bool DeviceResources::Initialize(int graphicsCard, bool isWarp) noexcept {
 #ifdef _DEBUG
 	UINT flag = DXGI_CREATE_FACTORY_DEBUG;
 #else
@@ -31,7 +29,12 @@ bool DeviceResources::Initialize() noexcept {
 	_isSupportTearing = supportTearing;
 	Logger::Get().Info(fmt::format("可变刷新率支持: {}", supportTearing ? "是" : "否"));
 
-	if (!_ObtainAdapterAndDevice(ScalingWindow::Get().Options().graphicsCard)) {
+	if (isWarp) {
+		if (!_TryCreateWarpDevice()) {
+			Logger::Get().Error("_TryCreateWarpDevice 失败");
+			return false;
+		}
+	} else if (!_ObtainAdapterAndDevice(graphicsCard)) {
 		Logger::Get().Error("找不到可用的图形适配器");
 		return false;
 	}
@@ -110,7 +113,12 @@ bool DeviceResources::_ObtainAdapterAndDevice(int adapterIdx) noexcept {
 	}
 
 	// 作为最后手段，回落到 Basic Render Driver Adapter（WARP）
-	// https://docs.microsoft.com/en-us/windows/win32/direct3darticles/directx-warp
+	return _TryCreateWarpDevice();
+}
+
+// https://docs.microsoft.com/en-us/windows/win32/direct3darticles/directx-warp
+bool DeviceResources::_TryCreateWarpDevice() noexcept {
+	winrt::com_ptr<IDXGIAdapter1> adapter;
 	HRESULT hr = _dxgiFactory->EnumWarpAdapter(IID_PPV_ARGS(&adapter));
 	if (FAILED(hr)) {
 		Logger::Get().ComError("EnumWarpAdapter 失败", hr);
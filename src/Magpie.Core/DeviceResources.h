@@ -9,7 +9,8 @@ public:
 	DeviceResources(const DeviceResources&) = delete;
 	DeviceResources(DeviceResources&&) = default;
 
-	bool Initialize() noexcept;
+	// graphicsCard 为用户指定的显示卡。isWarp 为 true 时直接使用 WARP，用于离线渲染
+	bool Initialize(int graphicsCard, bool isWarp = false) noexcept;
 
 	IDXGIFactory7* GetDXGIFactory() const noexcept { return _dxgiFactory.get(); }
 	ID3D11Device5* GetD3DDevice() const noexcept { return _d3dDevice.get(); }
@@ -24,6 +25,7 @@ public:
 
 private:
 	bool _ObtainAdapterAndDevice(int adapterIdx) noexcept;
+	bool _TryCreateWarpDevice() noexcept;
 	bool _TryCreateD3DDevice(const winrt::com_ptr<IDXGIAdapter1>& adapter) noexcept;
 
 	winrt::com_ptr<IDXGIFactory7> _dxgiFactory;
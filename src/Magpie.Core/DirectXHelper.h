@@ -13,6 +13,15 @@ struct DirectXHelper {
 		bool warningsAreErrors = false
 	);
 
+	// 展开 #include 和宏，结果不含注释
+	static bool PreprocessShader(
+		std::string_view hlsl,
+		ID3DBlob** result,
+		const char* sourceName = nullptr,
+		ID3DInclude* include = nullptr,
+		const std::vector<std::pair<std::string, std::string>>& macros = {}
+	);
+
 	static bool IsDebugLayersAvailable() noexcept;
 
 	static winrt::com_ptr<ID3D11Texture2D> CreateTexture2D(
@@ -2,7 +2,6 @@
 #include "DwmSharedSurfaceFrameSource.h"
 #include "Logger.h"
 #include "ScalingWindow.h"
-#include "DirectXHelper.h"
 #include "DeviceResources.h"
 
 namespace Magpie::Core {
@@ -73,7 +72,7 @@ bool DwmSharedSurfaceFrameSource::_Initialize() noexcept {
 		return false;
 	}
 
-	_frameInWnd = {
+	_frameBox = {
 		(UINT)frameRect.left,
 		(UINT)frameRect.top,
 		0,
@@ -82,16 +81,15 @@ bool DwmSharedSurfaceFrameSource::_Initialize() noexcept {
 		1
 	};
 
-	_output = DirectXHelper::CreateTexture2D(
-		_deviceResources->GetD3DDevice(),
-		DXGI_FORMAT_B8G8R8A8_UNORM,
-		frameRect.right - frameRect.left,
-		frameRect.bottom - frameRect.top,
-		D3D11_BIND_SHADER_RESOURCE
-	);
-	if (!_output) {
-		Logger::Get().Error("CreateTexture2D 失败");
-		return false;
+	// 共享表面的格式和输出相同时第一个效果可以直接读取其中的 _frameBox 区域
+	if (winrt::com_ptr<ID3D11Texture2D> sharedTexture = _OpenSharedSurface()) {
+		D3D11_TEXTURE2D_DESC td;
+		sharedTexture->GetDesc(&td);
+
+		if (td.Format == DXGI_FORMAT_B8G8R8A8_UNORM && td.Width >= _frameBox.right && td.Height >= _frameBox.bottom) {
+			_frameTextureSize = { (LONG)td.Width, (LONG)td.Height };
+			_isOutputCropped = true;
+		}
 	}
 
 	Logger::Get().Info("DwmSharedSurfaceFrameSource 初始化完成");
@@ -99,13 +97,27 @@ bool DwmSharedSurfaceFrameSource::_Initialize() noexcept {
 }
 
 FrameSourceBase::UpdateState DwmSharedSurfaceFrameSource::_Update() noexcept {
+	winrt::com_ptr<ID3D11Texture2D> sharedTexture = _OpenSharedSurface();
+	if (!sharedTexture) {
+		return UpdateState::Error;
+	}
+
+	if (!_UpdateOutput(sharedTexture.get())) {
+		Logger::Get().Error("_UpdateOutput 失败");
+		return UpdateState::Error;
+	}
+
+	return UpdateState::NewFrame;
+}
+
+winrt::com_ptr<ID3D11Texture2D> DwmSharedSurfaceFrameSource::_OpenSharedSurface() noexcept {
 	HANDLE sharedTextureHandle = NULL;
 	if (!dwmGetDxSharedSurface(ScalingWindow::Get().HwndSrc(),
 		&sharedTextureHandle, nullptr, nullptr, nullptr, nullptr)
 		|| !sharedTextureHandle
 	) {
 		Logger::Get().Win32Error("DwmGetDxSharedSurface 失败");
-		return UpdateState::Error;
+		return nullptr;
 	}
 
 	winrt::com_ptr<ID3D11Texture2D> sharedTexture;
@@ -113,13 +125,10 @@ FrameSourceBase::UpdateState DwmSharedSurfaceFrameSource::_Update() noexcept {
 		->OpenSharedResource(sharedTextureHandle, IID_PPV_ARGS(&sharedTexture));
 	if (FAILED(hr)) {
 		Logger::Get().ComError("OpenSharedResource 失败", hr);
-		return UpdateState::Error;
+		return nullptr;
 	}
 
-	_deviceResources->GetD3DDC()->CopySubresourceRegion(
-		_output.get(), 0, 0, 0, 0, sharedTexture.get(), 0, &_frameInWnd);
-
-	return UpdateState::NewFrame;
+	return sharedTexture;
 }
 
 }
@@ -33,7 +33,7 @@ protected:
 	}
 
 private:
-	D3D11_BOX _frameInWnd{};
+	winrt::com_ptr<ID3D11Texture2D> _OpenSharedSurface() noexcept;
 };
 
 }
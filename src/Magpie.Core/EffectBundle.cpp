@@ -0,0 +1,231 @@
+// 不使用预编译头，以便在其他平台构建
+#include "EffectBundle.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <numeric>
+#include "EffectDesc.h"
+
+namespace Magpie::Core {
+
+static_assert(std::endian::native == std::endian::little, "效果包格式要求小端序");
+static_assert(sizeof(EffectBundle::Header) == 24);
+static_assert(sizeof(EffectBundle::Entry) == 40);
+static_assert(sizeof(EffectBundle::Dependency) == 16);
+
+static bool IsInBounds(EffectBundle::Section section, size_t size) noexcept {
+	return section.offset <= size && section.size <= size - section.offset;
+}
+
+static bool IsLess(std::string_view lName, uint32_t lFlags, std::string_view rName, uint32_t rFlags) noexcept {
+	const int result = lName.compare(rName);
+	return result < 0 || (result == 0 && lFlags < rFlags);
+}
+
+uint64_t EffectBundle::HashText(std::string_view text) noexcept {
+	uint64_t hash = 0xcbf29ce484222325;
+	for (char c : text) {
+		if (c == '\r') {
+			continue;
+		}
+		hash ^= (uint8_t)c;
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+bool EffectBundle::Write(std::span<const Item> items, std::vector<uint8_t>& result, uint32_t flags) noexcept {
+	result.clear();
+
+	std::vector<uint32_t> order(items.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) {
+		return IsLess(items[l].name, items[l].effectFlags, items[r].name, items[r].effectFlags);
+	});
+
+	uint32_t dependencyCount = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		const Item& item = items[order[i]];
+		if (!item.desc) {
+			return false;
+		}
+		// 不允许重复的条目
+		if (i > 0) {
+			const Item& prev = items[order[i - 1]];
+			if (prev.name == item.name && prev.effectFlags == item.effectFlags) {
+				return false;
+			}
+		}
+		dependencyCount += (uint32_t)item.dependencies.size();
+	}
+
+	const size_t entriesOffset = sizeof(Header);
+	const size_t dependenciesOffset = entriesOffset + sizeof(Entry) * items.size();
+	const size_t stringsOffset = dependenciesOffset + sizeof(Dependency) * dependencyCount;
+
+	std::vector<Entry> entries;
+	entries.reserve(items.size());
+	std::vector<Dependency> dependencies;
+	dependencies.reserve(dependencyCount);
+
+	// 先写入字符串，表最后填充
+	result.resize(stringsOffset);
+	const auto writeString = [&](std::string_view str) {
+		const Section section{ (uint32_t)result.size(), (uint32_t)str.size() };
+		result.insert(result.end(), str.begin(), str.end());
+		return section;
+	};
+
+	for (uint32_t idx : order) {
+		const Item& item = items[idx];
+
+		Entry& entry = entries.emplace_back();
+		entry.name = writeString(item.name);
+		entry.effectFlags = item.effectFlags;
+		entry.firstDependency = (uint32_t)dependencies.size();
+		entry.dependencyCount = (uint32_t)item.dependencies.size();
+		entry.reserved = 0;
+		entry.sourceHash = item.sourceHash;
+
+		for (const auto& [path, hash] : item.dependencies) {
+			dependencies.push_back({ writeString(path), hash });
+		}
+	}
+
+	std::vector<uint8_t> blob;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if (!EffectCacheFormat::Write(*items[order[i]].desc, blob)) {
+			result.clear();
+			return false;
+		}
+
+		result.resize((result.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT);
+		entries[i].data = { (uint32_t)result.size(), (uint32_t)blob.size() };
+		result.insert(result.end(), blob.begin(), blob.end());
+
+		if (result.size() > UINT32_MAX) {
+			result.clear();
+			return false;
+		}
+	}
+
+	const Header header{
+		.magic = MAGIC,
+		.version = VERSION,
+		.fileSize = (uint32_t)result.size(),
+		.entryCount = (uint32_t)entries.size(),
+		.dependencyCount = dependencyCount,
+		.flags = flags
+	};
+	std::memcpy(result.data(), &header, sizeof(header));
+	if (!entries.empty()) {
+		std::memcpy(result.data() + entriesOffset, entries.data(), sizeof(Entry) * entries.size());
+	}
+	if (!dependencies.empty()) {
+		std::memcpy(result.data() + dependenciesOffset, dependencies.data(), sizeof(Dependency) * dependencies.size());
+	}
+
+	return true;
+}
+
+bool EffectBundle::Open(std::span<const uint8_t> data, std::shared_ptr<const void> owner, bool allowStub) noexcept {
+	_data = {};
+	_owner = nullptr;
+	_entries = {};
+	_dependencies = {};
+	_isStub = false;
+
+	// 表直接在 data 中访问，要求对齐
+	if (data.size() < sizeof(Header) || (uintptr_t)data.data() % alignof(Entry) != 0) {
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION || header.fileSize != data.size()) {
+		return false;
+	}
+
+	// 不认识的标志可能改变了格式的含义
+	if ((header.flags & ~HeaderFlags::Stub) != 0 || ((header.flags & HeaderFlags::Stub) && !allowStub)) {
+		return false;
+	}
+
+	const uint64_t entriesOffset = sizeof(Header);
+	const uint64_t dependenciesOffset = entriesOffset + (uint64_t)sizeof(Entry) * header.entryCount;
+	const uint64_t tablesEnd = dependenciesOffset + (uint64_t)sizeof(Dependency) * header.dependencyCount;
+	if (tablesEnd > data.size()) {
+		return false;
+	}
+
+	const std::span<const Entry> entries(
+		(const Entry*)(data.data() + entriesOffset), header.entryCount);
+	const std::span<const Dependency> dependencies(
+		(const Dependency*)(data.data() + dependenciesOffset), header.dependencyCount);
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const Entry& entry = entries[i];
+		if (!IsInBounds(entry.name, data.size()) || !IsInBounds(entry.data, data.size())
+			|| entry.data.offset % DATA_ALIGNMENT != 0
+			|| entry.firstDependency > header.dependencyCount
+			|| entry.dependencyCount > header.dependencyCount - entry.firstDependency) {
+			return false;
+		}
+
+		// 二分查找要求严格有序
+		if (i > 0) {
+			const Entry& prev = entries[i - 1];
+			const std::string_view prevName((const char*)data.data() + prev.name.offset, prev.name.size);
+			const std::string_view name((const char*)data.data() + entry.name.offset, entry.name.size);
+			if (!IsLess(prevName, prev.effectFlags, name, entry.effectFlags)) {
+				return false;
+			}
+		}
+	}
+
+	for (const Dependency& dependency : dependencies) {
+		if (!IsInBounds(dependency.path, data.size())) {
+			return false;
+		}
+	}
+
+	_data = data;
+	_owner = std::move(owner);
+	_entries = entries;
+	_dependencies = dependencies;
+	_isStub = header.flags & HeaderFlags::Stub;
+	return true;
+}
+
+const EffectBundle::Entry* EffectBundle::Find(std::string_view name, uint32_t effectFlags) const noexcept {
+	auto it = std::lower_bound(_entries.begin(), _entries.end(), name,
+		[this, effectFlags](const Entry& entry, std::string_view value) {
+		return IsLess(GetName(entry), entry.effectFlags, value, effectFlags);
+	});
+
+	if (it == _entries.end() || GetName(*it) != name || it->effectFlags != effectFlags) {
+		return nullptr;
+	}
+	return &*it;
+}
+
+bool EffectBundle::Load(const Entry& entry, EffectDesc& desc) const noexcept {
+	if (!EffectCacheFormat::Read(_data.subspan(entry.data.offset, entry.data.size), _owner, desc)) {
+		return false;
+	}
+
+	if (!_isStub) {
+		// 防止 CreateComputeShader 在缩放时才失败
+		static constexpr uint8_t DXBC_MAGIC[] = { 'D', 'X', 'B', 'C' };
+		for (const EffectPassDesc& pass : desc.passes) {
+			if (pass.cso.size() < std::size(DXBC_MAGIC)
+				|| !std::equal(std::begin(DXBC_MAGIC), std::end(DXBC_MAGIC), pass.cso.begin())) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
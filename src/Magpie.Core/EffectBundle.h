@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "EffectCacheFormat.h"
+
+namespace Magpie::Core {
+
+struct EffectDesc;
+
+// 预编译的效果包，由 magpiefx-pack 生成，包含内置效果在默认编译选项下的元数据和字节码。
+// 布局如下，所有整数均为小端序:
+//
+// Header
+// Entry[entryCount]	按 (name, effectFlags) 排序以便二分查找
+// Dependency[dependencyCount]	每个条目包含的文件
+// 字符串区	效果名和包含文件的路径
+// 数据区	每个条目一个 EffectCacheFormat 格式的缓存，起始位置按 DATA_ALIGNMENT 对齐
+//
+// 条目记录了源码和包含文件的哈希，源码被修改后不再使用该条目
+class EffectBundle {
+public:
+	static constexpr uint32_t MAGIC = 0x4258464D;	// "MFXB"
+	// 当格式有更改时更新它
+	static constexpr uint32_t VERSION = 4;
+	static constexpr uint32_t DATA_ALIGNMENT = EffectCacheFormat::CSO_ALIGNMENT;
+
+	using Section = EffectCacheFormat::Section;
+
+	struct HeaderFlags {
+		// magpiefx-pack --stub 生成，字节码是生成的源码，只用于验证打包，运行时不能使用
+		static constexpr uint32_t Stub = 1;
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileSize;
+		uint32_t entryCount;
+		uint32_t dependencyCount;
+		uint32_t flags;	// HeaderFlags
+	};
+
+	struct Entry {
+		Section name;
+		uint32_t effectFlags;
+		uint32_t firstDependency;
+		uint32_t dependencyCount;
+		uint32_t reserved;
+		// 删除注释后的源码的 HashText
+		uint64_t sourceHash;
+		Section data;
+	};
+
+	struct Dependency {
+		// 相对于 effects 文件夹，使用反斜杠分隔
+		Section path;
+		// 文件内容的 HashText
+		uint64_t hash;
+	};
+
+	struct Item {
+		std::string name;
+		// 编译时使用的输入标志，即 EffectFlags::InlineParams 和 EffectFlags::FP16
+		uint32_t effectFlags = 0;
+		uint64_t sourceHash = 0;
+		std::vector<std::pair<std::string, uint64_t>> dependencies;
+		const EffectDesc* desc = nullptr;
+	};
+
+	// 文本的哈希，忽略 '\r' 使以文本模式和二进制模式读取的结果相同。
+	// 格式规定了哈希算法 (FNV-1a)，生成和读取可以在不同平台进行
+	static uint64_t HashText(std::string_view text) noexcept;
+
+	// flags 为 HeaderFlags
+	static bool Write(std::span<const Item> items, std::vector<uint8_t>& result, uint32_t flags = 0) noexcept;
+
+	// 检查文件结构，条目中的缓存在 Load 时检查。owner 持有 data。
+	// 除非 allowStub 为 true，否则拒绝 HeaderFlags::Stub 的效果包
+	bool Open(std::span<const uint8_t> data, std::shared_ptr<const void> owner, bool allowStub = false) noexcept;
+
+	const Entry* Find(std::string_view name, uint32_t effectFlags) const noexcept;
+
+	std::span<const Entry> Entries() const noexcept {
+		return _entries;
+	}
+
+	std::string_view GetName(const Entry& entry) const noexcept {
+		return _GetString(entry.name);
+	}
+
+	std::span<const Dependency> GetDependencies(const Entry& entry) const noexcept {
+		return _dependencies.subspan(entry.firstDependency, entry.dependencyCount);
+	}
+
+	std::string_view GetPath(const Dependency& dependency) const noexcept {
+		return _GetString(dependency.path);
+	}
+
+	// 字节码不会被复制，desc.passes 中的 csoOwner 为 Open 时传入的 owner
+	bool Load(const Entry& entry, EffectDesc& desc) const noexcept;
+
+private:
+	std::string_view _GetString(Section section) const noexcept {
+		return std::string_view((const char*)_data.data() + section.offset, section.size);
+	}
+
+	std::span<const uint8_t> _data;
+	std::shared_ptr<const void> _owner;
+	std::span<const Entry> _entries;
+	std::span<const Dependency> _dependencies;
+	bool _isStub = false;
+};
+
+}
@@ -0,0 +1,324 @@
+// 不使用预编译头，以便在其他平台构建
+#include "EffectCacheFormat.h"
+#include <bit>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "EffectDesc.h"
+
+namespace Magpie::Core {
+
+static_assert(std::endian::native == std::endian::little, "缓存格式要求小端序");
+static_assert(sizeof(EffectCacheFormat::Header) == 28);
+static_assert(sizeof(EffectCacheFormat::Section) == 8);
+
+namespace {
+
+class Writer {
+public:
+	Writer(std::vector<uint8_t>& buf) : _buf(buf) {}
+
+	template<typename T>
+	void Write(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		const uint8_t* p = (const uint8_t*)&value;
+		_buf.insert(_buf.end(), p, p + sizeof(T));
+	}
+
+	void WriteString(std::string_view str) {
+		Write((uint32_t)str.size());
+		_buf.insert(_buf.end(), str.begin(), str.end());
+	}
+
+	void WriteVector(const SmallVectorImpl<uint32_t>& vec) {
+		Write((uint32_t)vec.size());
+		for (uint32_t v : vec) {
+			Write(v);
+		}
+	}
+
+	void Align(uint32_t alignment) {
+		_buf.resize((_buf.size() + alignment - 1) / alignment * alignment);
+	}
+
+private:
+	std::vector<uint8_t>& _buf;
+};
+
+class Reader {
+public:
+	Reader(std::span<const uint8_t> data) : _data(data) {}
+
+	template<typename T>
+	bool Read(T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		if (_data.size() < sizeof(T)) {
+			return false;
+		}
+		std::memcpy(&value, _data.data(), sizeof(T));
+		_data = _data.subspan(sizeof(T));
+		return true;
+	}
+
+	bool ReadString(std::string& str) {
+		uint32_t size;
+		if (!Read(size) || _data.size() < size) {
+			return false;
+		}
+		str.assign((const char*)_data.data(), size);
+		_data = _data.subspan(size);
+		return true;
+	}
+
+	bool ReadVector(SmallVectorImpl<uint32_t>& vec) {
+		uint32_t size;
+		if (!Read(size) || _data.size() / sizeof(uint32_t) < size) {
+			return false;
+		}
+		vec.resize(size);
+		for (uint32_t& v : vec) {
+			Read(v);
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool ReadEnum(T& value, uint32_t count) {
+		uint32_t v;
+		if (!Read(v) || v >= count) {
+			return false;
+		}
+		value = (T)v;
+		return true;
+	}
+
+	bool IsEnd() const noexcept {
+		return _data.empty();
+	}
+
+private:
+	std::span<const uint8_t> _data;
+};
+
+}
+
+template<typename T>
+static void WriteConstant(Writer& writer, const EffectConstant<T>& constant) {
+	writer.Write(constant.defaultValue);
+	writer.Write(constant.minValue);
+	writer.Write(constant.maxValue);
+	writer.Write(constant.step);
+}
+
+template<typename T>
+static bool ReadConstant(Reader& reader, EffectConstant<T>& constant) {
+	return reader.Read(constant.defaultValue) && reader.Read(constant.minValue)
+		&& reader.Read(constant.maxValue) && reader.Read(constant.step);
+}
+
+static void WriteMetadata(Writer& writer, const EffectDesc& desc) {
+	writer.WriteString(desc.name);
+
+	writer.Write((uint32_t)desc.params.size());
+	for (const EffectParameterDesc& param : desc.params) {
+		writer.WriteString(param.name);
+		writer.WriteString(param.label);
+		writer.Write((uint32_t)param.constant.index());
+		if (param.constant.index() == 0) {
+			WriteConstant(writer, std::get<0>(param.constant));
+		} else {
+			WriteConstant(writer, std::get<1>(param.constant));
+		}
+	}
+
+	writer.Write((uint32_t)desc.textures.size());
+	for (const EffectIntermediateTextureDesc& texture : desc.textures) {
+		writer.WriteString(texture.sizeExpr.first);
+		writer.WriteString(texture.sizeExpr.second);
+		writer.Write((uint32_t)texture.format);
+		writer.WriteString(texture.name);
+		writer.WriteString(texture.source);
+	}
+
+	writer.Write((uint32_t)desc.samplers.size());
+	for (const EffectSamplerDesc& sampler : desc.samplers) {
+		writer.Write((uint32_t)sampler.filterType);
+		writer.Write((uint32_t)sampler.addressType);
+		writer.WriteString(sampler.name);
+	}
+
+	for (const EffectPassDesc& pass : desc.passes) {
+		writer.WriteVector(pass.inputs);
+		writer.WriteVector(pass.outputs);
+		writer.Write(pass.numThreads);
+		writer.Write(pass.blockSize.first);
+		writer.Write(pass.blockSize.second);
+		writer.WriteString(pass.desc);
+		writer.Write((uint8_t)pass.isPSStyle);
+		writer.Write((uint8_t)pass.hasFootprint);
+		writer.Write(pass.footprint.first);
+		writer.Write(pass.footprint.second);
+	}
+}
+
+static bool ReadMetadata(Reader& reader, EffectDesc& desc) {
+	if (!reader.ReadString(desc.name)) {
+		return false;
+	}
+
+	uint32_t count;
+	if (!reader.Read(count)) {
+		return false;
+	}
+	desc.params.resize(count);
+	for (EffectParameterDesc& param : desc.params) {
+		uint32_t type;
+		if (!reader.ReadString(param.name) || !reader.ReadString(param.label) || !reader.Read(type)) {
+			return false;
+		}
+
+		bool success;
+		if (type == 0) {
+			success = ReadConstant(reader, param.constant.emplace<0>());
+		} else if (type == 1) {
+			success = ReadConstant(reader, param.constant.emplace<1>());
+		} else {
+			success = false;
+		}
+		if (!success) {
+			return false;
+		}
+	}
+
+	if (!reader.Read(count)) {
+		return false;
+	}
+	desc.textures.resize(count);
+	for (EffectIntermediateTextureDesc& texture : desc.textures) {
+		if (!reader.ReadString(texture.sizeExpr.first) || !reader.ReadString(texture.sizeExpr.second)
+			|| !reader.ReadEnum(texture.format, (uint32_t)EffectIntermediateTextureFormat::UNKNOWN + 1)
+			|| !reader.ReadString(texture.name) || !reader.ReadString(texture.source)) {
+			return false;
+		}
+	}
+
+	if (!reader.Read(count)) {
+		return false;
+	}
+	desc.samplers.resize(count);
+	for (EffectSamplerDesc& sampler : desc.samplers) {
+		if (!reader.ReadEnum(sampler.filterType, 2) || !reader.ReadEnum(sampler.addressType, 2)
+			|| !reader.ReadString(sampler.name)) {
+			return false;
+		}
+	}
+
+	for (EffectPassDesc& pass : desc.passes) {
+		uint8_t isPSStyle;
+		uint8_t hasFootprint;
+		if (!reader.ReadVector(pass.inputs) || !reader.ReadVector(pass.outputs) || !reader.Read(pass.numThreads)
+			|| !reader.Read(pass.blockSize.first) || !reader.Read(pass.blockSize.second)
+			|| !reader.ReadString(pass.desc) || !reader.Read(isPSStyle) || isPSStyle > 1
+			|| !reader.Read(hasFootprint) || hasFootprint > 1
+			|| !reader.Read(pass.footprint.first) || !reader.Read(pass.footprint.second)) {
+			return false;
+		}
+		pass.isPSStyle = isPSStyle;
+		pass.hasFootprint = hasFootprint;
+	}
+
+	return reader.IsEnd();
+}
+
+bool EffectCacheFormat::Write(const EffectDesc& desc, std::vector<uint8_t>& result) noexcept {
+	result.clear();
+
+	const uint32_t passCount = (uint32_t)desc.passes.size();
+	const size_t tableSize = sizeof(Header) + sizeof(Section) * passCount;
+
+	{
+		// 估算需要的空间
+		size_t reservedSize = tableSize + 4096;
+		for (const EffectPassDesc& pass : desc.passes) {
+			reservedSize += pass.cso.size() + CSO_ALIGNMENT;
+		}
+		result.reserve(reservedSize);
+	}
+
+	Writer writer(result);
+
+	// 先写入元数据，头和区段表最后填充
+	result.resize(tableSize);
+	WriteMetadata(writer, desc);
+	const size_t metadataSize = result.size() - tableSize;
+
+	SmallVector<Section> csoSections;
+	csoSections.reserve(passCount);
+	for (const EffectPassDesc& pass : desc.passes) {
+		writer.Align(CSO_ALIGNMENT);
+		csoSections.push_back({ (uint32_t)result.size(), (uint32_t)pass.cso.size() });
+		result.insert(result.end(), pass.cso.begin(), pass.cso.end());
+	}
+
+	if (result.size() > UINT32_MAX) {
+		result.clear();
+		return false;
+	}
+
+	Header header{
+		.magic = MAGIC,
+		.version = VERSION,
+		.fileSize = (uint32_t)result.size(),
+		.effectFlags = desc.flags,
+		.passCount = passCount,
+		.metadata = { (uint32_t)tableSize, (uint32_t)metadataSize }
+	};
+	std::memcpy(result.data(), &header, sizeof(header));
+	if (passCount > 0) {
+		std::memcpy(result.data() + sizeof(Header), csoSections.data(), sizeof(Section) * passCount);
+	}
+
+	return true;
+}
+
+bool EffectCacheFormat::Read(
+	std::span<const uint8_t> data,
+	const std::shared_ptr<const void>& owner,
+	EffectDesc& desc
+) noexcept {
+	Reader reader(data);
+
+	Header header;
+	if (!reader.Read(header) || header.magic != MAGIC || header.version != VERSION || header.fileSize != data.size()) {
+		return false;
+	}
+
+	// 区段表
+	if ((data.size() - sizeof(Header)) / sizeof(Section) < header.passCount) {
+		return false;
+	}
+	desc.passes.resize(header.passCount);
+	for (EffectPassDesc& pass : desc.passes) {
+		Section section;
+		if (!reader.Read(section) || section.offset % CSO_ALIGNMENT != 0 || section.offset > data.size()
+			|| section.size > data.size() - section.offset) {
+			return false;
+		}
+		pass.cso = data.subspan(section.offset, section.size);
+		pass.csoOwner = owner;
+	}
+
+	if (header.metadata.offset > data.size() || header.metadata.size > data.size() - header.metadata.offset) {
+		return false;
+	}
+	Reader metadataReader(data.subspan(header.metadata.offset, header.metadata.size));
+	if (!ReadMetadata(metadataReader, desc)) {
+		return false;
+	}
+
+	desc.flags = header.effectFlags;
+	return true;
+}
+
+}
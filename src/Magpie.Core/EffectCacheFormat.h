@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Magpie::Core {
+
+struct EffectDesc;
+
+// 效果缓存的文件格式，可以映射到内存后就地读取。布局如下，所有整数均为小端序:
+//
+// EffectCacheHeader
+// EffectCacheSection[passCount]	每个通道的字节码所在的区段
+// 元数据区段	EffectDesc 中除字节码外的部分
+// 字节码区段	每个通道一个，起始位置按 CSO_ALIGNMENT 对齐
+struct EffectCacheFormat {
+	static constexpr uint32_t MAGIC = 0x4358464D;	// "MFXC"
+	// 当格式有更改时更新它
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint32_t CSO_ALIGNMENT = 16;
+
+	struct Section {
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileSize;
+		uint32_t effectFlags;
+		uint32_t passCount;
+		Section metadata;
+	};
+
+	static bool Write(const EffectDesc& desc, std::vector<uint8_t>& result) noexcept;
+
+	// 字节码不会被复制，desc.passes 中的 cso 指向 data，csoOwner 为 owner。
+	// 任何越界或不一致都会导致返回 false
+	static bool Read(std::span<const uint8_t> data, const std::shared_ptr<const void>& owner, EffectDesc& desc) noexcept;
+};
+
+}
@@ -1,238 +1,583 @@
 #include "pch.h"
 #include "EffectCacheManager.h"
-#include <regex>
 #include "StrUtils.h"
 #include "Logger.h"
 #include "CommonSharedConstants.h"
-#include <d3dcompiler.h>
 #include "Utils.h"
-#include "YasHelper.h"
+#include "EffectCacheFormat.h"
 
-namespace yas::detail {
+namespace Magpie::Core {
 
-// winrt::com_ptr<ID3DBlob>
-template<std::size_t F>
-struct serializer<
-	type_prop::not_a_fundamental,
-	ser_case::use_internal_serializer,
-	F,
-	winrt::com_ptr<ID3DBlob>
-> {
-	template<typename Archive>
-	static Archive& save(Archive& ar, const winrt::com_ptr<ID3DBlob>& blob) {
-		uint32_t size = (uint32_t)blob->GetBufferSize();
-		ar& size;
+// 缓存版本
+// 当缓存文件结构有更改时更新它，使旧缓存失效
+static constexpr uint32_t EFFECT_CACHE_VERSION = 17;
 
-		ar.write(blob->GetBufferPointer(), size);
+// 由 magpiefx-pack 生成，位于 effects 文件夹
+static constexpr const wchar_t* EFFECT_BUNDLE_FILE_NAME = L"effects.mfxb";
 
-		return ar;
-	}
 
-	template<typename Archive>
-	static Archive& load(Archive& ar, winrt::com_ptr<ID3DBlob>& blob) {
-		uint32_t size = 0;
-		ar& size;
-		HRESULT hr = D3DCreateBlob(size, blob.put());
-		if (FAILED(hr)) {
-			Logger::Get().ComError("D3DCreateBlob 失败", hr);
-			throw new std::exception();
+static std::wstring GetLinearEffectName(std::wstring_view effectName) {
+	std::wstring result(effectName);
+	for (wchar_t& c : result) {
+		if (c == L'\\') {
+			c = L'#';
 		}
-
-		ar.read(blob->GetBufferPointer(), size);
-
-		return ar;
 	}
-};
+	return result;
+}
 
+static std::wstring GetCacheFileName(std::wstring_view linearEffectName, std::wstring_view hash, UINT flags) {
+	// 缓存文件的命名: {效果名}_{标志位（16进制）}{哈希}
+	return fmt::format(L"{}{}_{:01x}{}", CommonSharedConstants::CACHE_DIR, linearEffectName, flags & 0xf, hash);
 }
 
-namespace Magpie::Core {
+// 将文件映射到内存，返回的指针持有视图。允许其他进程删除，本进程回收磁盘缓存时跳过已映射的文件。
+// updateAccessTime 为 false 时只需读取权限，用于不参与淘汰的效果包
+static std::shared_ptr<const void> MapFile(
+	const wchar_t* fileName,
+	std::span<const uint8_t>& data,
+	bool updateAccessTime = true
+) noexcept {
+	CREATEFILE2_EXTENDED_PARAMETERS extendedParams{
+		.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS),
+		.dwFileAttributes = FILE_ATTRIBUTE_NORMAL,
+		.dwFileFlags = FILE_FLAG_RANDOM_ACCESS,
+		.dwSecurityQosFlags = SECURITY_ANONYMOUS
+	};
+	wil::unique_hfile hFile(CreateFile2(fileName, updateAccessTime ? GENERIC_READ | FILE_WRITE_ATTRIBUTES : GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, &extendedParams));
+	if (!hFile) {
+		Logger::Get().Win32Error("打开缓存文件失败");
+		return nullptr;
+	}
 
-template<typename Archive>
-void serialize(Archive& ar, EffectParameterDesc& o) {
-	ar& o.name& o.label& o.constant;
-}
+	if (updateAccessTime) {
+		// 系统通常不更新访问时间，因此手动更新，磁盘缓存据此淘汰
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(hFile.get(), nullptr, &now, nullptr);
+	}
 
-template<typename Archive>
-void serialize(Archive& ar, EffectIntermediateTextureDesc& o) {
-	ar& o.format& o.name& o.source& o.sizeExpr;
-}
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(hFile.get(), &fileSize) || fileSize.QuadPart == 0 || fileSize.QuadPart > UINT32_MAX) {
+		return nullptr;
+	}
 
-template<typename Archive>
-void serialize(Archive& ar, EffectSamplerDesc& o) {
-	ar& o.filterType& o.addressType& o.name;
-}
+	wil::unique_handle hMapping(CreateFileMapping(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!hMapping) {
+		Logger::Get().Win32Error("CreateFileMapping 失败");
+		return nullptr;
+	}
 
-template<typename Archive>
-void serialize(Archive& ar, EffectPassDesc& o) {
-	ar& o.cso& o.inputs& o.outputs& o.numThreads[0] & o.numThreads[1] & o.numThreads[2] & o.blockSize& o.desc& o.isPSStyle;
-}
+	const void* view = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		Logger::Get().Win32Error("MapViewOfFile 失败");
+		return nullptr;
+	}
 
-template<typename Archive>
-void serialize(Archive& ar, EffectDesc& o) {
-	ar& o.name& o.params& o.textures& o.samplers& o.passes& o.flags;
+	data = { (const uint8_t*)view, (size_t)fileSize.QuadPart };
+	// 视图可能由多个 csoOwner 共享，句柄可以立即关闭
+	return std::shared_ptr<const void>(view, [](const void* p) { UnmapViewOfFile(p); });
 }
 
-static constexpr uint32_t MAX_CACHE_COUNT = 127;
+static std::wstring GetPassCacheFileName(uint64_t passHash) {
+	// 通道字节码按内容寻址: passes\{哈希}
+	return fmt::format(L"{}passes\\{:016x}", CommonSharedConstants::CACHE_DIR, passHash);
+}
 
-// 缓存版本
-// 当缓存文件结构有更改时更新它，使旧缓存失效
-static constexpr uint32_t EFFECT_CACHE_VERSION = 13;
+// 通道缓存文件的头，之后是字节码。读取时检查，文件被截断或损坏时重新编译
+struct PassCacheHeader {
+	uint32_t version;
+	uint32_t csoSize;
+	uint64_t csoHash;
+};
 
+// 先写入临时文件再替换目标，其他线程或进程不会读到写了一半的文件
+static bool WriteFileAtomically(const std::wstring& fileName, std::span<const uint8_t> data) noexcept {
+	// 临时文件名包含进程和线程 ID，同时保存相同的文件时互不干扰
+	const std::wstring tempFileName = fmt::format(L"{}.{:x}.{:x}.tmp",
+		fileName, GetCurrentProcessId(), GetCurrentThreadId());
+
+	{
+		wil::unique_hfile hFile(CreateFile2(tempFileName.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr));
+		if (!hFile) {
+			Logger::Get().Win32Error("创建临时文件失败");
+			return false;
+		}
 
-static std::wstring GetLinearEffectName(std::wstring_view effectName) {
-	std::wstring result(effectName);
-	for (wchar_t& c : result) {
-		if (c == L'\\') {
-			c = L'#';
+		DWORD written = 0;
+		if (!::WriteFile(hFile.get(), data.data(), (DWORD)data.size(), &written, nullptr) || written != data.size()) {
+			Logger::Get().Win32Error("写入临时文件失败");
+			hFile.reset();
+			DeleteFile(tempFileName.c_str());
+			return false;
 		}
 	}
-	return result;
-}
 
-static std::wstring GetCacheFileName(std::wstring_view linearEffectName, std::wstring_view hash, UINT flags) {
-	// 缓存文件的命名: {效果名}_{标志位（16进制）}{哈希}
-	return fmt::format(L"{}{}_{:01x}{}", CommonSharedConstants::CACHE_DIR, linearEffectName, flags & 0xf, hash);
+	if (!MoveFileEx(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		Logger::Get().Win32Error("替换缓存文件失败");
+		DeleteFile(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
 }
 
-void EffectCacheManager::_AddToMemCache(const std::wstring& cacheFileName, const EffectDesc& desc) {
-	auto lock = _lock.lock_exclusive();
+std::shared_ptr<const EffectDesc> EffectCacheManager::Load(
+	std::wstring_view effectName,
+	std::wstring_view hash,
+	uint32_t effectFlags
+) {
+	assert(!effectName.empty() && !hash.empty());
 
-	_memCache[cacheFileName] = { desc, ++_lastAccess };
+	std::wstring cacheFileName = GetCacheFileName(GetLinearEffectName(effectName), hash, effectFlags);
 
-	if (_memCache.size() > MAX_CACHE_COUNT) {
-		assert(_memCache.size() == MAX_CACHE_COUNT + 1);
+	if (std::shared_ptr<const EffectDesc> desc = _memCache.Get(cacheFileName)) {
+		Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+		return desc;
+	}
 
-		// 清理一半较旧的内存缓存
-		std::array<uint32_t, MAX_CACHE_COUNT + 1> access{};
-		std::transform(_memCache.begin(), _memCache.end(), access.begin(),
-			[](const auto& pair) {return pair.second.second; });
+	if (!Win32Utils::FileExists(cacheFileName.c_str())) {
+		return nullptr;
+	}
 
-		auto midIt = access.begin() + access.size() / 2;
-		std::nth_element(access.begin(), midIt, access.end());
-		const uint32_t mid = *midIt;
+	std::span<const uint8_t> data;
+	std::shared_ptr<const void> mapping = _MapCacheFile(cacheFileName, data);
+	if (!mapping) {
+		return nullptr;
+	}
 
-		for (auto it = _memCache.begin(); it != _memCache.end();) {
-			if (it->second.second < mid) {
-				it = _memCache.erase(it);
-			} else {
-				++it;
-			}
-		}
+	std::shared_ptr<EffectDesc> desc = std::make_shared<EffectDesc>();
+	if (!EffectCacheFormat::Read(data, mapping, *desc)) {
+		Logger::Get().Error("缓存文件不合法");
+		return nullptr;
+	}
 
-		Logger::Get().Info("已清理内存缓存");
+	if (_memCache.Put(cacheFileName, desc)) {
+		_ScheduleMemTrim();
 	}
+
+	Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+	return desc;
 }
 
-bool EffectCacheManager::_LoadFromMemCache(const std::wstring& cacheFileName, EffectDesc& desc) {
-	auto lock = _lock.lock_exclusive();
+void EffectCacheManager::Save(
+	std::wstring_view effectName,
+	std::wstring_view hash,
+	uint32_t effectFlags,
+	std::shared_ptr<const EffectDesc> desc
+) {
+	std::wstring linearEffectName = GetLinearEffectName(effectName);
 
-	auto it = _memCache.find(cacheFileName);
-	if (it != _memCache.end()) {
-		desc = it->second.first;
-		it->second.second = ++_lastAccess;
-		Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
-		return true;
+	std::vector<uint8_t> buf;
+	if (!EffectCacheFormat::Write(*desc, buf)) {
+		Logger::Get().Error("序列化 EffectDesc 失败");
+		return;
+	}
+
+	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+		Logger::Get().Win32Error("创建 cache 文件夹失败");
+		return;
+	}
+
+	std::wstring cacheFileName = GetCacheFileName(linearEffectName, hash, effectFlags);
+	if (!WriteFileAtomically(cacheFileName, buf)) {
+		Logger::Get().Error("保存缓存失败");
 	}
-	return false;
+
+	if (_memCache.Put(cacheFileName, std::move(desc))) {
+		_ScheduleMemTrim();
+	}
+
+	// 该效果的旧缓存在后台删除
+	_ScheduleDiskGC();
+
+	Logger::Get().Info(StrUtils::Concat("已保存缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
 }
 
-bool EffectCacheManager::Load(std::wstring_view effectName, std::wstring_view hash, EffectDesc& desc) {
+std::shared_ptr<const EffectDesc> EffectCacheManager::LoadPrebuilt(
+	std::wstring_view effectName,
+	std::wstring_view hash,
+	uint32_t effectFlags,
+	std::string_view source
+) {
 	assert(!effectName.empty() && !hash.empty());
 
-	std::wstring cacheFileName = GetCacheFileName(GetLinearEffectName(effectName), hash, desc.flags);
+	const EffectBundle* bundle = _GetBundle();
+	if (!bundle) {
+		return nullptr;
+	}
 
-	if (_LoadFromMemCache(cacheFileName, desc)) {
-		return true;
+	const EffectBundle::Entry* entry = bundle->Find(StrUtils::UTF16ToUTF8(effectName), effectFlags);
+	if (!entry || entry->sourceHash != EffectBundle::HashText(source)) {
+		return nullptr;
+	}
+
+	// 包含的文件也可能被修改
+	for (const EffectBundle::Dependency& dependency : bundle->GetDependencies(*entry)) {
+		std::wstring fileName = StrUtils::Concat(
+			CommonSharedConstants::EFFECTS_DIR, StrUtils::UTF8ToUTF16(bundle->GetPath(dependency)));
+
+		std::string text;
+		if (!Win32Utils::ReadTextFile(fileName.c_str(), text) || EffectBundle::HashText(text) != dependency.hash) {
+			return nullptr;
+		}
 	}
 
+	std::shared_ptr<EffectDesc> desc = std::make_shared<EffectDesc>();
+	if (!bundle->Load(*entry, *desc)) {
+		Logger::Get().Error("效果包中的条目不合法");
+		return nullptr;
+	}
+
+	std::wstring cacheFileName = GetCacheFileName(GetLinearEffectName(effectName), hash, effectFlags);
+	if (_memCache.Put(cacheFileName, desc)) {
+		_ScheduleMemTrim();
+	}
+
+	Logger::Get().Info(StrUtils::Concat("已从效果包读取 ", StrUtils::UTF16ToUTF8(effectName)));
+	return desc;
+}
+
+bool EffectCacheManager::LoadPass(uint64_t passHash, EffectPassDesc& passDesc) {
+	std::wstring cacheFileName = GetPassCacheFileName(passHash);
 	if (!Win32Utils::FileExists(cacheFileName.c_str())) {
 		return false;
 	}
 
-	std::vector<BYTE> buf;
-	if (!Win32Utils::ReadFile(cacheFileName.c_str(), buf) || buf.empty()) {
+	std::span<const uint8_t> data;
+	std::shared_ptr<const void> mapping = _MapCacheFile(cacheFileName, data);
+	if (!mapping) {
 		return false;
 	}
 
-	try {
-		yas::mem_istream mi(buf.data(), buf.size());
-		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+	PassCacheHeader header{};
+	if (data.size() >= sizeof(header)) {
+		std::memcpy(&header, data.data(), sizeof(header));
+	}
 
-		ia& desc;
-	} catch (...) {
-		Logger::Get().Error("反序列化失败");
-		desc = {};
+	const std::span<const uint8_t> cso = data.subspan(std::min(data.size(), sizeof(header)));
+	if (header.version != EFFECT_CACHE_VERSION || header.csoSize != cso.size()
+		|| Utils::HashData(cso) != header.csoHash) {
+		Logger::Get().Error(StrUtils::Concat("通道缓存 ", StrUtils::UTF16ToUTF8(cacheFileName), " 不合法"));
+		// 删除后由调用者重新编译并保存
+		mapping.reset();
+		_TryDeleteCacheFile(cacheFileName);
 		return false;
 	}
 
-	_AddToMemCache(cacheFileName, desc);
-
-	Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+	passDesc.cso = cso;
+	passDesc.csoOwner = std::move(mapping);
 	return true;
 }
 
-void EffectCacheManager::Save(std::wstring_view effectName, std::wstring_view hash, const EffectDesc& desc) {
-	std::wstring linearEffectName = GetLinearEffectName(effectName);
+void EffectCacheManager::SavePass(uint64_t passHash, std::span<const uint8_t> cso) {
+	std::wstring cacheFileName = GetPassCacheFileName(passHash);
+	if (Win32Utils::FileExists(cacheFileName.c_str())) {
+		// 其他效果或线程已保存相同的通道
+		return;
+	}
 
-	std::vector<BYTE> buf;
-	buf.reserve(4096);
-	
-	try {
-		yas::vector_ostream os(buf);
-		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+	const std::wstring passesDir = StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"passes");
+	if (!Win32Utils::DirExists(passesDir.c_str())) {
+		HRESULT hr = wil::CreateDirectoryDeepNoThrow(passesDir.c_str());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("创建 passes 文件夹失败", hr);
+			return;
+		}
+	}
 
-		oa& desc;
-	} catch (...) {
-		Logger::Get().Error("序列化 EffectDesc 失败");
+	std::vector<uint8_t> buf(sizeof(PassCacheHeader) + cso.size());
+	const PassCacheHeader header{
+		.version = EFFECT_CACHE_VERSION,
+		.csoSize = (uint32_t)cso.size(),
+		.csoHash = Utils::HashData(cso)
+	};
+	std::memcpy(buf.data(), &header, sizeof(header));
+	std::memcpy(buf.data() + sizeof(header), cso.data(), cso.size());
+
+	if (!WriteFileAtomically(cacheFileName, buf)) {
+		Logger::Get().Error("保存通道缓存失败");
 		return;
 	}
 
-	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr)) {
-		if (GetLastError() != ERROR_ALREADY_EXISTS) {
-			Logger::Get().Win32Error("创建 cache 文件夹失败");
+	_ScheduleDiskGC();
+}
+
+std::shared_ptr<const void> EffectCacheManager::_MapCacheFile(
+	const std::wstring& fileName,
+	std::span<const uint8_t>& data
+) noexcept {
+	// 先登记再映射，回收磁盘缓存时要么在映射前删除文件，要么跳过它
+	{
+		std::scoped_lock lock(_mappedFilesMutex);
+		++_mappedFiles[fileName];
+	}
+
+	std::shared_ptr<const void> mapping = MapFile(fileName.c_str(), data);
+	if (!mapping) {
+		_UnregisterMappedFile(fileName);
+		return nullptr;
+	}
+
+	// 所有 csoOwner 都释放后取消映射并注销
+	const void* view = mapping.get();
+	return std::shared_ptr<const void>(view, [this, fileName, mapping(std::move(mapping))](const void*) mutable {
+		mapping.reset();
+		_UnregisterMappedFile(fileName);
+	});
+}
+
+void EffectCacheManager::_UnregisterMappedFile(const std::wstring& fileName) noexcept {
+	std::scoped_lock lock(_mappedFilesMutex);
+	auto it = _mappedFiles.find(fileName);
+	assert(it != _mappedFiles.end());
+	if (--it->second == 0) {
+		_mappedFiles.erase(it);
+	}
+}
+
+bool EffectCacheManager::_TryDeleteCacheFile(const std::wstring& fileName) noexcept {
+	// 持有锁直到删除完成，删除期间不会开始映射
+	std::scoped_lock lock(_mappedFilesMutex);
+	if (_mappedFiles.contains(fileName)) {
+		return false;
+	}
+
+	if (!DeleteFile(fileName.c_str())) {
+		Logger::Get().Win32Error(StrUtils::Concat("删除缓存文件 ", StrUtils::UTF16ToUTF8(fileName), " 失败"));
+		return false;
+	}
+
+	return true;
+}
+
+const EffectBundle* EffectCacheManager::_GetBundle() noexcept {
+	std::call_once(_bundleOnceFlag, [&]() {
+		std::wstring fileName = StrUtils::Concat(CommonSharedConstants::EFFECTS_DIR, EFFECT_BUNDLE_FILE_NAME);
+		if (!Win32Utils::FileExists(fileName.c_str())) {
+			return;
+		}
+
+		std::span<const uint8_t> data;
+		std::shared_ptr<const void> mapping = MapFile(fileName.c_str(), data, false);
+		if (!mapping) {
 			return;
 		}
 
-		// 删除所有该效果（flags 相同）的缓存
-		std::wregex regex(fmt::format(L"^{}_{:01x}[0-9,a-f]{{16}}$", linearEffectName, desc.flags & 0xf),
-			std::wregex::optimize | std::wregex::nosubs);
+		std::unique_ptr<EffectBundle> bundle = std::make_unique<EffectBundle>();
+		if (!bundle->Open(data, std::move(mapping))) {
+			Logger::Get().Error("效果包不合法");
+			return;
+		}
+
+		Logger::Get().Info(fmt::format("已加载效果包，包含 {} 个条目", bundle->Entries().size()));
+		_bundle = std::move(bundle);
+	});
+
+	return _bundle.get();
+}
+
+void EffectCacheManager::_ScheduleMemTrim() noexcept {
+	// 合并多次请求
+	if (_memTrimScheduled.exchange(true, std::memory_order_acq_rel)) {
+		return;
+	}
+
+	if (!TrySubmitThreadpoolCallback(_MemTrimCallback, this, nullptr)) {
+		Logger::Get().Win32Error("TrySubmitThreadpoolCallback 失败");
+		_memTrimScheduled.store(false, std::memory_order_release);
+	}
+}
+
+void EffectCacheManager::_ScheduleDiskGC() noexcept {
+	if (_diskGCScheduled.exchange(true, std::memory_order_acq_rel)) {
+		return;
+	}
+
+	if (!TrySubmitThreadpoolCallback(_DiskGCCallback, this, nullptr)) {
+		Logger::Get().Win32Error("TrySubmitThreadpoolCallback 失败");
+		_diskGCScheduled.store(false, std::memory_order_release);
+	}
+}
+
+void CALLBACK EffectCacheManager::_MemTrimCallback(PTP_CALLBACK_INSTANCE, void* context) noexcept {
+	EffectCacheManager& that = *(EffectCacheManager*)context;
+	// 先清除标志，执行期间的新请求会再次调度
+	that._memTrimScheduled.store(false, std::memory_order_release);
 
+	const size_t oldCount = that._memCache.Count();
+	that._memCache.Trim();
+	Logger::Get().Info(fmt::format("已清理内存缓存: {} -> {} 项", oldCount, that._memCache.Count()));
+}
+
+void CALLBACK EffectCacheManager::_DiskGCCallback(PTP_CALLBACK_INSTANCE, void* context) noexcept {
+	EffectCacheManager& that = *(EffectCacheManager*)context;
+	that._diskGCScheduled.store(false, std::memory_order_release);
+	that._CollectDiskGarbage();
+}
+
+static bool IsHexString(std::wstring_view str) noexcept {
+	return std::all_of(str.begin(), str.end(), [](wchar_t c) {
+		return (c >= L'0' && c <= L'9') || (c >= L'a' && c <= L'f');
+	});
+}
+
+static uint64_t FileTimeToUInt64(const FILETIME& ft) noexcept {
+	return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+void EffectCacheManager::_CollectDiskGarbage() noexcept {
+	struct CacheFile {
+		std::wstring path;
+		uint64_t size;
+		uint64_t lastWriteTime;
+		uint64_t lastAccessTime;
+	};
+
+	std::vector<CacheFile> files;
+	auto listFiles = [&](std::wstring_view dir, auto&& filter) {
 		WIN32_FIND_DATA findData{};
-		wil::unique_hfind hFind(FindFirstFileEx(
-			StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"*").c_str(),
+		wil::unique_hfind hFind(FindFirstFileEx(StrUtils::Concat(dir, L"*").c_str(),
 			FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
-		if (hFind) {
-			do {
-				// 缓存文件名至少有 19 个字符
-				// {Name}_{1}{16}
-				if (StrUtils::StrLen(findData.cFileName) < 19) {
-					continue;
-				}
-
-				// 正则匹配文件名
-				if (!std::regex_match(findData.cFileName, regex)) {
-					continue;
-				}
-
-				if (!DeleteFile(StrUtils::Concat(CommonSharedConstants::CACHE_DIR, findData.cFileName).c_str())) {
-					Logger::Get().Win32Error(StrUtils::Concat("删除缓存文件 ",
-						StrUtils::UTF16ToUTF8(findData.cFileName), " 失败"));
-				}
-			} while (FindNextFile(hFind.get(), &findData));
-		} else {
-			Logger::Get().Win32Error("查找缓存文件失败");
+		if (!hFind) {
+			return;
+		}
+
+		do {
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				continue;
+			}
+
+			std::wstring_view fileName(findData.cFileName);
+			if (!filter(fileName)) {
+				continue;
+			}
+
+			uint64_t lastWriteTime = FileTimeToUInt64(findData.ftLastWriteTime);
+			files.push_back({
+				StrUtils::Concat(dir, fileName),
+				((uint64_t)findData.nFileSizeHigh << 32) | findData.nFileSizeLow,
+				lastWriteTime,
+				std::max(FileTimeToUInt64(findData.ftLastAccessTime), lastWriteTime)
+			});
+		} while (FindNextFile(hFind.get(), &findData));
+	};
+
+	// 效果缓存的命名: {效果名}_{标志位（1 位）}{哈希（16 位）}
+	listFiles(CommonSharedConstants::CACHE_DIR, [](std::wstring_view fileName) {
+		return fileName.size() >= 19 && fileName[fileName.size() - 18] == L'_'
+			&& IsHexString(fileName.substr(fileName.size() - 17));
+	});
+	const size_t effectCacheCount = files.size();
+	const std::wstring passesDir = StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"passes\\");
+	listFiles(passesDir, [](std::wstring_view fileName) {
+		return fileName.size() == 16 && IsHexString(fileName);
+	});
+	const size_t cacheFileCount = files.size();
+
+	// 保存缓存时崩溃会遗留临时文件，见 WriteFileAtomically
+	auto isTempFile = [](std::wstring_view fileName) {
+		return fileName.ends_with(L".tmp");
+	};
+	listFiles(CommonSharedConstants::CACHE_DIR, isTempFile);
+	listFiles(passesDir, isTempFile);
+
+	std::vector<bool> removed(files.size());
+	uint32_t removedCount = 0;
+	// 正在使用的文件不会被删除
+	auto removeFile = [&](size_t idx) {
+		if (!_TryDeleteCacheFile(files[idx].path)) {
+			return false;
+		}
+
+		removed[idx] = true;
+		++removedCount;
+		return true;
+	};
+
+	{
+		// 只删除一小时前的临时文件，其他进程可能正在写入
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		// FILETIME 的单位为 100ns
+		constexpr uint64_t ONE_HOUR = 3600ull * 10000000;
+		for (size_t i = cacheFileCount; i < files.size(); ++i) {
+			if (files[i].lastWriteTime + ONE_HOUR < FileTimeToUInt64(now)) {
+				removeFile(i);
+			}
 		}
 	}
 
-	std::wstring cacheFileName = GetCacheFileName(linearEffectName, hash, desc.flags);
-	if (!Win32Utils::WriteFile(cacheFileName.c_str(), buf.data(), buf.size())) {
-		Logger::Get().Error("保存缓存失败");
+	{
+		// 同一效果（标志位相同）只保留最新的缓存
+		phmap::flat_hash_map<std::wstring_view, size_t> newest;
+		for (size_t i = 0; i < effectCacheCount; ++i) {
+			std::wstring_view path = files[i].path;
+			auto [it, inserted] = newest.try_emplace(path.substr(0, path.size() - 16), i);
+			if (inserted) {
+				continue;
+			}
+
+			if (files[i].lastWriteTime > files[it->second].lastWriteTime) {
+				removeFile(it->second);
+				it->second = i;
+			} else {
+				removeFile(i);
+			}
+		}
 	}
 
-	_AddToMemCache(cacheFileName, desc);
+	uint64_t totalSize = 0;
+	for (size_t i = 0; i < cacheFileCount; ++i) {
+		if (!removed[i]) {
+			totalSize += files[i].size;
+		}
+	}
 
-	Logger::Get().Info(StrUtils::Concat("已保存缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+	if (totalSize > MAX_DISK_CACHE_BYTES) {
+		// 按最近访问时间淘汰，直到不超过容量的 3/4
+		std::vector<size_t> order;
+		order.reserve(cacheFileCount);
+		for (size_t i = 0; i < cacheFileCount; ++i) {
+			if (!removed[i]) {
+				order.push_back(i);
+			}
+		}
+		std::sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+			return files[l].lastAccessTime < files[r].lastAccessTime;
+		});
+
+		for (size_t idx : order) {
+			if (totalSize <= MAX_DISK_CACHE_BYTES / 4 * 3) {
+				break;
+			}
+
+			if (removeFile(idx)) {
+				totalSize -= files[idx].size;
+			}
+		}
+	}
+
+	if (removedCount > 0) {
+		Logger::Get().Info(fmt::format("已清理 {} 个磁盘缓存，剩余 {} KiB", removedCount, totalSize / 1024));
+	}
+}
+
+uint64_t EffectCacheManager::GetPassHash(std::string_view preprocessedSource, bool warningsAreErrors) {
+	std::string str;
+	str.reserve(preprocessedSource.size() + 64);
+	str = preprocessedSource;
+
+#ifdef _DEBUG
+	constexpr bool isDebug = true;
+#else
+	constexpr bool isDebug = false;
+#endif
+	// 编译选项也会影响字节码
+	str.append(fmt::format("VERSION:{}\nDEBUG:{}\nWAE:{}\n", EFFECT_CACHE_VERSION, isDebug, warningsAreErrors));
+
+	return Utils::HashData(std::span((const BYTE*)str.data(), str.size()));
 }
 
 static std::wstring HexHash(std::span<const BYTE> data) {
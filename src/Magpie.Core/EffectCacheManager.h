@@ -1,6 +1,9 @@
 #pragma once
 #include "Win32Utils.h"
 #include "EffectDesc.h"
+#include "EffectMemCache.h"
+#include "EffectBundle.h"
+#include <mutex>
 #include <parallel_hashmap/phmap.h>
 
 namespace Magpie::Core {
@@ -15,9 +18,27 @@ public:
 	EffectCacheManager(const EffectCacheManager&) = delete;
 	EffectCacheManager(EffectCacheManager&&) = delete;
 
-	bool Load(std::wstring_view effectName, std::wstring_view hash, EffectDesc& desc);
+	// 返回的快照可能由内存缓存和其他调用者共享，未找到时返回空
+	std::shared_ptr<const EffectDesc> Load(std::wstring_view effectName, std::wstring_view hash, uint32_t effectFlags);
 
-	void Save(std::wstring_view effectName, std::wstring_view hash, const EffectDesc& desc);
+	// effectFlags 和 Load 的相同。解析时可能清除 desc 中的一些标志，见 EffectFlags::CroppedInput
+	void Save(std::wstring_view effectName, std::wstring_view hash, uint32_t effectFlags, std::shared_ptr<const EffectDesc> desc);
+
+	// 从预编译的效果包读取，source 为删除注释后的源码。效果包只包含不内联参数的变体。
+	// 源码和包含的文件都未修改时才使用，命中后存入内存缓存，之后由 Load 读取
+	std::shared_ptr<const EffectDesc> LoadPrebuilt(
+		std::wstring_view effectName,
+		std::wstring_view hash,
+		uint32_t effectFlags,
+		std::string_view source
+	);
+
+	// 通道字节码的缓存以预处理后的源码寻址，因此可以在不同效果和参数间共享
+	bool LoadPass(uint64_t passHash, EffectPassDesc& passDesc);
+
+	void SavePass(uint64_t passHash, std::span<const uint8_t> cso);
+
+	static uint64_t GetPassHash(std::string_view preprocessedSource, bool warningsAreErrors);
 
 	// inlineParams 为内联变量，可以为空
 	// 接受 std::string& 的重载速度更快，且保证不修改 source
@@ -33,14 +54,44 @@ public:
 private:
 	EffectCacheManager() = default;
 
-	void _AddToMemCache(const std::wstring& cacheFileName, const EffectDesc& desc);
-	bool _LoadFromMemCache(const std::wstring& cacheFileName, EffectDesc& desc);
+	// 首次调用时映射效果包，不存在或不合法时返回空
+	const EffectBundle* _GetBundle() noexcept;
+
+	// 映射缓存文件并登记，返回的指针释放前回收磁盘缓存时不会删除该文件
+	std::shared_ptr<const void> _MapCacheFile(const std::wstring& fileName, std::span<const uint8_t>& data) noexcept;
+	void _UnregisterMappedFile(const std::wstring& fileName) noexcept;
+
+	// 文件已映射或删除失败时返回 false
+	bool _TryDeleteCacheFile(const std::wstring& fileName) noexcept;
+
+	// 淘汰都在线程池中执行，不会阻塞缩放的初始化
+	void _ScheduleMemTrim() noexcept;
+	void _ScheduleDiskGC() noexcept;
+
+	static void CALLBACK _MemTrimCallback(PTP_CALLBACK_INSTANCE, void* context) noexcept;
+	static void CALLBACK _DiskGCCallback(PTP_CALLBACK_INSTANCE, void* context) noexcept;
+
+	// 删除同一效果的旧缓存，然后按最近访问时间淘汰，直到总大小不超过限制
+	void _CollectDiskGarbage() noexcept;
+
+	// 内存缓存的容量，字节码通常占绝大部分
+	static constexpr size_t MAX_MEM_CACHE_BYTES = 64 * 1024 * 1024;
+	// 磁盘缓存的容量，包括效果缓存和通道缓存
+	static constexpr uint64_t MAX_DISK_CACHE_BYTES = 256 * 1024 * 1024;
+
+	// 已映射的缓存文件 -> 映射次数。必须在 _memCache 之前声明，后者析构时会注销映射
+	std::mutex _mappedFilesMutex;
+	phmap::flat_hash_map<std::wstring, uint32_t> _mappedFiles;
+
+	// cacheFileName -> EffectDesc
+	EffectMemCache _memCache{ MAX_MEM_CACHE_BYTES };
+
+	std::once_flag _bundleOnceFlag;
+	// 映射到内存，直到程序退出
+	std::unique_ptr<EffectBundle> _bundle;
 
-	// 用于同步对 _memCache 的访问
-	wil::srwlock _lock;
-	// cacheFileName -> (EffectDesc, lastAccess)
-	phmap::flat_hash_map<std::wstring, std::pair<EffectDesc, UINT>> _memCache;
-	UINT _lastAccess = 0;
+	std::atomic<bool> _memTrimScheduled = false;
+	std::atomic<bool> _diskGCScheduled = false;
 };
 
 }
@@ -3,6 +3,9 @@
 
 namespace Magpie::Core {
 
+class TaskScheduler;
+struct EffectCompileJob;
+
 struct EffectCompilerFlags {
 	static constexpr uint32_t NoCache = 1;
 	static constexpr uint32_t SaveSources = 1 << 1;
@@ -11,6 +14,9 @@ struct EffectCompilerFlags {
 	static constexpr uint32_t NoCompile = 1 << 3;
 };
 
+// 每个通道通过 #include 打开的文件，路径以 effects\ 开头，可能重复
+using EffectIncludes = std::vector<std::vector<std::wstring>>;
+
 struct EffectCompiler {
 	// 调用者需填入 desc 中的 name 和 flags
 	static uint32_t Compile(
@@ -18,6 +24,39 @@ struct EffectCompiler {
 		uint32_t flags,	// EffectCompilerFlags
 		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr
 	) noexcept;
+
+	// 和 Compile 相同，但返回不可变的快照。命中缓存时和缓存共享，无需复制。失败时返回空。
+	// includes 不为空时记录每个通道包含的文件，此时不会读取效果缓存，但仍使用通道缓存
+	static std::shared_ptr<const struct EffectDesc> CompileShared(
+		struct EffectDesc desc,
+		uint32_t flags,	// EffectCompilerFlags
+		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr,
+		EffectIncludes* includes = nullptr
+	) noexcept;
+
+	// 把编译拆分为解析任务和每个通道的编译任务提交到 scheduler，以便多个效果的通道一起调度。
+	// scheduler 执行完毕后调用 GetResult 获取结果
+	static std::shared_ptr<EffectCompileJob> Submit(
+		TaskScheduler& scheduler,
+		struct EffectDesc desc,
+		uint32_t flags,	// EffectCompilerFlags
+		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr,
+		EffectIncludes* includes = nullptr
+	) noexcept;
+
+	// 把 effectNames 中的效果融合为一个效果后提交编译，见 EffectFusion。
+	// 调用者需填入 desc 中的 name 和 flags。包含的文件相对于 name 所在的文件夹查找，
+	// 因此 name 应以第一个效果所在的文件夹开头
+	static std::shared_ptr<EffectCompileJob> SubmitFused(
+		TaskScheduler& scheduler,
+		struct EffectDesc desc,
+		std::vector<std::wstring> effectNames,
+		uint32_t flags,	// EffectCompilerFlags
+		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr
+	) noexcept;
+
+	// 只能调用一次，失败时返回空
+	static std::shared_ptr<const struct EffectDesc> GetResult(const std::shared_ptr<EffectCompileJob>& job) noexcept;
 };
 
 }
@@ -1,10 +1,14 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
 #include <variant>
+#include <vector>
 #include "SmallVector.h"
 
-struct ID3D10Blob;
-typedef ID3D10Blob ID3DBlob;
-
 namespace Magpie::Core {
 
 enum class EffectIntermediateTextureFormat {
@@ -69,22 +73,33 @@ struct EffectParameterDesc {
 };
 
 struct EffectPassDesc {
-	winrt::com_ptr<ID3DBlob> cso;
+	// 编译后的字节码，内存由 csoOwner 持有（ID3DBlob 或缓存文件的映射视图）
+	std::span<const uint8_t> cso;
+	std::shared_ptr<const void> csoOwner;
 	SmallVector<uint32_t> inputs;
 	SmallVector<uint32_t> outputs;
 	std::array<uint32_t, 3> numThreads{};
 	std::pair<uint32_t, uint32_t> blockSize{};
+	// 以输出像素中心对应的输入像素为中心，每个输出像素读取的输入像素在水平和竖直方向上最多相距
+	// 多少个像素，以各个输入的像素为单位。由 FOOTPRINT 指定，用于只重新渲染变化的区域
+	std::pair<uint32_t, uint32_t> footprint{};
 	std::string desc;
 	bool isPSStyle = false;
+	bool hasFootprint = false;
 };
 
 struct EffectFlags {
 	// 输入
 	static constexpr uint32_t InlineParams = 1;
 	static constexpr uint32_t FP16 = 1 << 1;
+	// INPUT 为捕获的纹理中从 __inputOffset 开始的区域，见 FrameSourceBase::IsOutputCropped。
+	// 效果使用 Wrap 采样器时无法支持，解析时被清除
+	static constexpr uint32_t CroppedInput = 1 << 2;
 	// 输出
 	// 此效果需要帧数和鼠标位置
 	static constexpr uint32_t UseDynamic = 1 << 4;
+	// 逐像素的效果，可以和前一个效果融合，见 EffectFusion
+	static constexpr uint32_t Pixelwise = 1 << 5;
 };
 
 struct EffectDesc {
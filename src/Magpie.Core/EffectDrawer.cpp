@@ -8,7 +8,6 @@
 #include "TextureLoader.h"
 #include "EffectHelper.h"
 #include "DirectXHelper.h"
-#include "ScalingWindow.h"
 #include "BackendDescriptorStore.h"
 #include "EffectsProfiler.h"
 
@@ -87,32 +86,12 @@ bool EffectDrawer::Initialize(
 	const EffectDesc& desc,
 	const EffectOption& option,
 	DeviceResources& deviceResources,
-	BackendDescriptorStore& descriptorStore,
-	ID3D11Texture2D** inOutTexture
+	SIZE scalingWndSize,
+	SIZE& inOutSize,
+	const EffectInputCrop* inputCrop
 ) noexcept {
 	_d3dDC = deviceResources.GetD3DDC();
 
-	SIZE inputSize{};
-	{
-		D3D11_TEXTURE2D_DESC inputDesc;
-		(*inOutTexture)->GetDesc(&inputDesc);
-		inputSize = { (LONG)inputDesc.Width, (LONG)inputDesc.Height };
-	}
-
-	static mu::Parser exprParser;
-	exprParser.DefineConst("INPUT_WIDTH", inputSize.cx);
-	exprParser.DefineConst("INPUT_HEIGHT", inputSize.cy);
-
-	const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
-	const SIZE outputSize = CalcOutputSize(desc.GetOutputSizeExpr(), option, scalingWndSize, inputSize, exprParser);
-	if (outputSize.cx <= 0 || outputSize.cy <= 0) {
-		Logger::Get().Error("非法的输出尺寸");
-		return false;
-	}
-
-	exprParser.DefineConst("OUTPUT_WIDTH", outputSize.cx);
-	exprParser.DefineConst("OUTPUT_HEIGHT", outputSize.cy);
-
 	_samplers.resize(desc.samplers.size());
 	for (UINT i = 0; i < _samplers.size(); ++i) {
 		const EffectSamplerDesc& samDesc = desc.samplers[i];
@@ -127,25 +106,9 @@ bool EffectDrawer::Initialize(
 		}
 	}
 
-	// 创建中间纹理
-	// 第一个为 INPUT，第二个为 OUTPUT
+	// 第一个为 INPUT，第二个为 OUTPUT，其他纹理的尺寸在 Resize 中计算
 	_textures.resize(desc.textures.size());
-	_textures[0].copy_from(*inOutTexture);
-
-	// 创建输出纹理，格式始终是 DXGI_FORMAT_R8G8B8A8_UNORM
-	_textures[1] = DirectXHelper::CreateTexture2D(
-		deviceResources.GetD3DDevice(),
-		EffectHelper::FORMAT_DESCS[(uint32_t)desc.textures[1].format].dxgiFormat,
-		outputSize.cx,
-		outputSize.cy,
-		D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
-	);
-
-	*inOutTexture = _textures[1].get();
-	if (!*inOutTexture) {
-		Logger::Get().Error("创建输出纹理失败");
-		return false;
-	}
+	_textureSizes.resize(desc.textures.size());
 
 	for (size_t i = 2; i < desc.textures.size(); ++i) {
 		const EffectIntermediateTextureDesc& texDesc = desc.textures[i];
@@ -163,62 +126,140 @@ bool EffectDrawer::Initialize(
 				return false;
 			}
 
+			D3D11_TEXTURE2D_DESC srcDesc{};
+			_textures[i]->GetDesc(&srcDesc);
+			_textureSizes[i] = { (LONG)srcDesc.Width, (LONG)srcDesc.Height };
+
 			if (texDesc.format != EffectIntermediateTextureFormat::UNKNOWN) {
 				// 检查纹理格式是否匹配
-				D3D11_TEXTURE2D_DESC srcDesc{};
-				_textures[i]->GetDesc(&srcDesc);
 				if (srcDesc.Format != EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].dxgiFormat) {
 					Logger::Get().Error("SOURCE 纹理格式不匹配");
 					return false;
 				}
 			}
-
-		} else {
-			SIZE texSize{};
-			try {
-				exprParser.SetExpr(texDesc.sizeExpr.first);
-				texSize.cx = std::lround(exprParser.Eval());
-				exprParser.SetExpr(texDesc.sizeExpr.second);
-				texSize.cy = std::lround(exprParser.Eval());
-			} catch (const mu::ParserError& e) {
-				Logger::Get().Error(fmt::format("计算中间纹理尺寸 {} 失败: {}", e.GetExpr(), e.GetMsg()));
-				return false;
-			}
-
-			if (texSize.cx <= 0 || texSize.cy <= 0) {
-				Logger::Get().Error("非法的中间纹理尺寸");
-				return false;
-			}
-
-			_textures[i] = DirectXHelper::CreateTexture2D(
-				deviceResources.GetD3DDevice(),
-				EffectHelper::FORMAT_DESCS[(UINT)texDesc.format].dxgiFormat,
-				texSize.cx,
-				texSize.cy,
-				D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
-			);
-			if (!_textures[i]) {
-				Logger::Get().Error("创建纹理失败");
-				return false;
-			}
 		}
 	}
 
 	_shaders.resize(desc.passes.size());
-	_srvs.resize(desc.passes.size());
-	_uavs.resize(desc.passes.size());
 	for (UINT i = 0; i < _shaders.size(); ++i) {
 		const EffectPassDesc& passDesc = desc.passes[i];
 
 		HRESULT hr = deviceResources.GetD3DDevice()->CreateComputeShader(
-			passDesc.cso->GetBufferPointer(), passDesc.cso->GetBufferSize(), nullptr, _shaders[i].put());
+			passDesc.cso.data(), passDesc.cso.size(), nullptr, _shaders[i].put());
 		if (FAILED(hr)) {
 			Logger::Get().ComError("创建计算着色器失败", hr);
 			return false;
 		}
 
+		_hasFootprints.push_back(passDesc.hasFootprint);
+	}
+
+	return Resize(desc, option, deviceResources, scalingWndSize, inOutSize, inputCrop);
+}
+
+bool EffectDrawer::Resize(
+	const EffectDesc& desc,
+	const EffectOption& option,
+	DeviceResources& deviceResources,
+	SIZE scalingWndSize,
+	SIZE& inOutSize,
+	const EffectInputCrop* inputCrop
+) noexcept {
+	assert(!(desc.flags & EffectFlags::CroppedInput) || inputCrop);
+
+	const SIZE inputSize = inOutSize;
+
+	static mu::Parser exprParser;
+	exprParser.DefineConst("INPUT_WIDTH", inputSize.cx);
+	exprParser.DefineConst("INPUT_HEIGHT", inputSize.cy);
+
+	const SIZE outputSize = CalcOutputSize(desc.GetOutputSizeExpr(), option, scalingWndSize, inputSize, exprParser);
+	if (outputSize.cx <= 0 || outputSize.cy <= 0) {
+		Logger::Get().Error("非法的输出尺寸");
+		return false;
+	}
+
+	exprParser.DefineConst("OUTPUT_WIDTH", outputSize.cx);
+	exprParser.DefineConst("OUTPUT_HEIGHT", outputSize.cy);
+
+	// 计算中间纹理的尺寸，SOURCE 纹理的尺寸已在 Initialize 中确定
+	_textureSizes[0] = inputSize;
+	_textureSizes[1] = outputSize;
+
+	for (size_t i = 2; i < desc.textures.size(); ++i) {
+		const EffectIntermediateTextureDesc& texDesc = desc.textures[i];
+		if (!texDesc.source.empty()) {
+			continue;
+		}
+
+		SIZE texSize{};
+		try {
+			exprParser.SetExpr(texDesc.sizeExpr.first);
+			texSize.cx = std::lround(exprParser.Eval());
+			exprParser.SetExpr(texDesc.sizeExpr.second);
+			texSize.cy = std::lround(exprParser.Eval());
+		} catch (const mu::ParserError& e) {
+			Logger::Get().Error(fmt::format("计算中间纹理尺寸 {} 失败: {}", e.GetExpr(), e.GetMsg()));
+			return false;
+		}
+
+		if (texSize.cx <= 0 || texSize.cy <= 0) {
+			Logger::Get().Error("非法的中间纹理尺寸");
+			return false;
+		}
+
+		_textureSizes[i] = texSize;
+	}
+
+	_dispatches.clear();
+	for (const EffectPassDesc& passDesc : desc.passes) {
+		const SIZE passOutputSize = _textureSizes[passDesc.outputs[0]];
+		_dispatches.emplace_back(
+			(passOutputSize.cx + passDesc.blockSize.first - 1) / passDesc.blockSize.first,
+			(passOutputSize.cy + passDesc.blockSize.second - 1) / passDesc.blockSize.second
+		);
+	}
+
+	if (!_InitializeConstants(desc, option, deviceResources, inputSize, outputSize, inputCrop)) {
+		Logger::Get().Error("_InitializeConstants 失败");
+		return false;
+	}
+
+	inOutSize = outputSize;
+	return true;
+}
+
+bool EffectDrawer::BindTextures(
+	const EffectDesc& desc,
+	std::span<ID3D11Texture2D* const> textures,
+	BackendDescriptorStore& descriptorStore
+) noexcept {
+	assert(textures.size() == desc.textures.size());
+
+	for (size_t i = 0; i < desc.textures.size(); ++i) {
+		if (i < 2 || desc.textures[i].source.empty()) {
+			_textures[i].copy_from(textures[i]);
+		}
+	}
+
+	_srvs.resize(desc.passes.size());
+	_uavs.resize(desc.passes.size());
+	_inputSrvSlots.clear();
+	for (UINT i = 0; i < desc.passes.size(); ++i) {
+		const EffectPassDesc& passDesc = desc.passes[i];
+
 		_srvs[i].resize(passDesc.inputs.size());
 		for (UINT j = 0; j < passDesc.inputs.size(); ++j) {
+			if (passDesc.inputs[j] == 0) {
+				_inputSrvSlots.emplace_back(i, j);
+
+				if (!_textures[0]) {
+					// 由 SetInput 设置
+					_srvs[i][j] = nullptr;
+					continue;
+				}
+			}
+
 			auto srv = _srvs[i][j] = descriptorStore.GetShaderResourceView(_textures[passDesc.inputs[j]].get());
 			if (!srv) {
 				Logger::Get().Error("GetShaderResourceView 失败");
@@ -234,24 +275,24 @@ bool EffectDrawer::Initialize(
 				return false;
 			}
 		}
-
-		D3D11_TEXTURE2D_DESC outputDesc;
-		_textures[passDesc.outputs[0]]->GetDesc(&outputDesc);
-		_dispatches.emplace_back(
-			(outputDesc.Width + passDesc.blockSize.first - 1) / passDesc.blockSize.first,
-			(outputDesc.Height + passDesc.blockSize.second - 1) / passDesc.blockSize.second
-		);
-	}
-
-	if (!_InitializeConstants(desc, option, deviceResources, inputSize, outputSize)) {
-		Logger::Get().Error("_InitializeConstants 失败");
-		return false;
 	}
 
 	return true;
 }
 
-void EffectDrawer::Draw(EffectsProfiler& profiler) const noexcept {
+void EffectDrawer::SetInput(ID3D11ShaderResourceView* srv) noexcept {
+	for (const auto [passIdx, slot] : _inputSrvSlots) {
+		_srvs[passIdx][slot] = srv;
+	}
+}
+
+void EffectDrawer::Draw(
+	EffectsProfiler& profiler,
+	std::span<const SmallVector<RegionPropagator::Rect>> passTiles,
+	ID3D11Buffer* tileOffsetCB
+) const noexcept {
+	assert(passTiles.empty() || passTiles.size() == _dispatches.size());
+
 	{
 		ID3D11Buffer* t = _constantBuffer.get();
 		_d3dDC->CSSetConstantBuffers(0, 1, &t);
@@ -259,19 +300,75 @@ void EffectDrawer::Draw(EffectsProfiler& profiler) const noexcept {
 	_d3dDC->CSSetSamplers(0, (UINT)_samplers.size(), _samplers.data());
 
 	for (uint32_t i = 0; i < _dispatches.size(); ++i) {
-		_DrawPass(i);
+		_DrawPass(i, passTiles.empty() ? nullptr : &passTiles[i], tileOffsetCB);
 		profiler.OnEndPass(_d3dDC);
 	}
 }
 
-void EffectDrawer::_DrawPass(uint32_t i) const noexcept {
+bool EffectDrawer::HasFootprintPass() const noexcept {
+	return std::find(_hasFootprints.begin(), _hasFootprints.end(), true) != _hasFootprints.end();
+}
+
+bool EffectDrawer::ReplaceShader(uint32_t passIdx, std::span<const uint8_t> cso, ID3D11Device* d3dDevice) noexcept {
+	assert(passIdx < _shaders.size());
+
+	winrt::com_ptr<ID3D11ComputeShader> shader;
+	HRESULT hr = d3dDevice->CreateComputeShader(cso.data(), cso.size(), nullptr, shader.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("创建计算着色器失败", hr);
+		return false;
+	}
+
+	_shaders[passIdx] = std::move(shader);
+	return true;
+}
+
+void EffectDrawer::_DrawPass(
+	uint32_t i,
+	const SmallVector<RegionPropagator::Rect>* tiles,
+	ID3D11Buffer* tileOffsetCB
+) const noexcept {
+	if (tiles && tiles->empty()) {
+		// 输入没有变化，保留上一帧的结果
+		return;
+	}
+
 	_d3dDC->CSSetShader(_shaders[i].get(), nullptr, 0);
 
 	_d3dDC->CSSetShaderResources(0, (UINT)_srvs[i].size(), _srvs[i].data());
 	UINT uavCount = (UINT)_uavs[i].size() / 2;
 	_d3dDC->CSSetUnorderedAccessViews(0, uavCount, _uavs[i].data(), nullptr);
 
-	_d3dDC->Dispatch(_dispatches[i].first, _dispatches[i].second, 1);
+	if (_hasFootprints[i]) {
+		assert(tileOffsetCB);
+
+		const auto dispatchTiles = [&](const RegionPropagator::Rect& rect) {
+			// cbuffer __CB3 : register(b2) { uint2 __tileOffset; };
+			D3D11_MAPPED_SUBRESOURCE ms;
+			HRESULT hr = _d3dDC->Map(tileOffsetCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms);
+			if (FAILED(hr)) {
+				Logger::Get().ComError("Map 失败", hr);
+				return;
+			}
+
+			const uint32_t offset[2] = { (uint32_t)rect.left, (uint32_t)rect.top };
+			std::memcpy(ms.pData, offset, sizeof(offset));
+			_d3dDC->Unmap(tileOffsetCB, 0);
+
+			_d3dDC->Dispatch(UINT(rect.right - rect.left), UINT(rect.bottom - rect.top), 1);
+		};
+
+		if (tiles) {
+			for (const RegionPropagator::Rect& rect : *tiles) {
+				dispatchTiles(rect);
+			}
+		} else {
+			dispatchTiles({ 0, 0, (int32_t)_dispatches[i].first, (int32_t)_dispatches[i].second });
+		}
+	} else {
+		// 没有 FOOTPRINT 的通道总是完整渲染
+		_d3dDC->Dispatch(_dispatches[i].first, _dispatches[i].second, 1);
+	}
 
 	_d3dDC->CSSetUnorderedAccessViews(0, uavCount, _uavs[i].data() + uavCount, nullptr);
 }
@@ -281,12 +378,14 @@ bool EffectDrawer::_InitializeConstants(
 	const EffectOption& option,
 	DeviceResources& deviceResources,
 	SIZE inputSize,
-	SIZE outputSize
+	SIZE outputSize,
+	const EffectInputCrop* inputCrop
 ) noexcept {
 	const bool isInlineParams = desc.flags & EffectFlags::InlineParams;
+	const bool isInputCropped = desc.flags & EffectFlags::CroppedInput;
 
 	// 大小必须为 4 的倍数
-	const size_t builtinConstantCount = 10;
+	const size_t builtinConstantCount = isInputCropped ? 14 : 10;
 	size_t psStylePassParams = 0;
 	for (UINT i = 0, end = (UINT)desc.passes.size() - 1; i < end; ++i) {
 		if (desc.passes[i].isPSStyle) {
@@ -300,6 +399,8 @@ bool EffectDrawer::_InitializeConstants(
 	//     float2 __inputPt;
 	//     float2 __outputPt;
 	//     float2 __scale;
+	//     [uint2 __inputOffset;]
+	//     [float2 __inputTexturePt;]
 	//     [PARAMETERS...]
 	// );
 	_constants[0].uintVal = inputSize.cx;
@@ -313,20 +414,26 @@ bool EffectDrawer::_InitializeConstants(
 	_constants[8].floatVal = outputSize.cx / (FLOAT)inputSize.cx;
 	_constants[9].floatVal = outputSize.cy / (FLOAT)inputSize.cy;
 
+	if (isInputCropped) {
+		_constants[10].uintVal = inputCrop->offset.x;
+		_constants[11].uintVal = inputCrop->offset.y;
+		_constants[12].floatVal = 1.0f / inputCrop->textureSize.cx;
+		_constants[13].floatVal = 1.0f / inputCrop->textureSize.cy;
+	}
+
 	// PS 样式的通道需要的参数
 	EffectHelper::Constant32* pCurParam = _constants.data() + builtinConstantCount;
 	if (psStylePassParams > 0) {
 		for (UINT i = 0, end = (UINT)desc.passes.size() - 1; i < end; ++i) {
 			if (desc.passes[i].isPSStyle) {
-				D3D11_TEXTURE2D_DESC outputDesc;
-				_textures[desc.passes[i].outputs[0]]->GetDesc(&outputDesc);
-				pCurParam->uintVal = outputDesc.Width;
+				const SIZE passOutputSize = _textureSizes[desc.passes[i].outputs[0]];
+				pCurParam->uintVal = passOutputSize.cx;
 				++pCurParam;
-				pCurParam->uintVal = outputDesc.Height;
+				pCurParam->uintVal = passOutputSize.cy;
 				++pCurParam;
-				pCurParam->floatVal = 1.0f / outputDesc.Width;
+				pCurParam->floatVal = 1.0f / passOutputSize.cx;
 				++pCurParam;
-				pCurParam->floatVal = 1.0f / outputDesc.Height;
+				pCurParam->floatVal = 1.0f / passOutputSize.cy;
 				++pCurParam;
 			}
 		}
@@ -379,6 +486,8 @@ bool EffectDrawer::_InitializeConstants(
 
 	D3D11_SUBRESOURCE_DATA initData{ .pSysMem = _constants.data() };
 
+	// Resize 时替换原来的常量缓冲区
+	_constantBuffer = nullptr;
 	HRESULT hr = deviceResources.GetD3DDevice()->CreateBuffer(&bd, &initData, _constantBuffer.put());
 	if (FAILED(hr)) {
 		Logger::Get().ComError("CreateBuffer 失败", hr);
@@ -2,6 +2,7 @@
 #include "EffectDesc.h"
 #include "SmallVector.h"
 #include "EffectHelper.h"
+#include "RegionPropagator.h"
 
 namespace Magpie::Core {
 
@@ -10,21 +11,74 @@ class DeviceResources;
 class BackendDescriptorStore;
 class EffectsProfiler;
 
+// 效果的 INPUT 为更大的纹理中的区域，见 EffectFlags::CroppedInput
+struct EffectInputCrop {
+	POINT offset;
+	SIZE textureSize;
+};
+
 class EffectDrawer {
 public:
 	EffectDrawer() = default;
 	EffectDrawer(const EffectDrawer&) = delete;
 	EffectDrawer(EffectDrawer&&) = default;
 
+	// 计算纹理尺寸，加载 SOURCE 纹理，创建着色器和常量缓冲区。inOutSize 传入输入尺寸，返回输出尺寸。
+	// scalingWndSize 用于 Fit 和 Fill 缩放，离线渲染时为目标尺寸。
+	// 中间纹理由调用者对整个效果链统一规划，之后通过 BindTextures 传入。
+	// desc 包含 EffectFlags::CroppedInput 时 inputCrop 不能为空
 	bool Initialize(
 		const EffectDesc& desc,
 		const EffectOption& option,
 		DeviceResources& deviceResources,
-		BackendDescriptorStore& descriptorStore,
-		ID3D11Texture2D** inOutTexture
+		SIZE scalingWndSize,
+		SIZE& inOutSize,
+		const EffectInputCrop* inputCrop = nullptr
+	) noexcept;
+
+	// 输入尺寸变化时重新计算纹理尺寸和常量，着色器、采样器和 SOURCE 纹理保持不变，之后需重新调用
+	// BindTextures。参数和 Initialize 相同
+	bool Resize(
+		const EffectDesc& desc,
+		const EffectOption& option,
+		DeviceResources& deviceResources,
+		SIZE scalingWndSize,
+		SIZE& inOutSize,
+		const EffectInputCrop* inputCrop = nullptr
 	) noexcept;
 
-	void Draw(EffectsProfiler& profiler) const noexcept;
+	// 和 EffectDesc::textures 一一对应，包括 INPUT 和 OUTPUT
+	const SmallVector<SIZE>& TextureSizes() const noexcept {
+		return _textureSizes;
+	}
+
+	// textures 和 EffectDesc::textures 一一对应，第一个为 INPUT。从文件加载的纹理被忽略，
+	// 未被任何通道使用的纹理可以为空。INPUT 为空时需在渲染前调用 SetInput
+	bool BindTextures(
+		const EffectDesc& desc,
+		std::span<ID3D11Texture2D* const> textures,
+		BackendDescriptorStore& descriptorStore
+	) noexcept;
+
+	// 替换读取 INPUT 的通道使用的 SRV，用于 INPUT 每帧不同的情况
+	void SetInput(ID3D11ShaderResourceView* srv) noexcept;
+
+	uint32_t PassCount() const noexcept {
+		return (uint32_t)_dispatches.size();
+	}
+
+	// passTiles 为每个通道需要调度的块，见 RegionPropagator，为空时完整渲染。
+	// 有 FOOTPRINT 的通道通过 tileOffsetCB 获取每次调度的起始块，因此此时它不能为空
+	void Draw(
+		EffectsProfiler& profiler,
+		std::span<const SmallVector<RegionPropagator::Rect>> passTiles = {},
+		ID3D11Buffer* tileOffsetCB = nullptr
+	) const noexcept;
+
+	bool HasFootprintPass() const noexcept;
+
+	// 热重载时替换通道的着色器，纹理等资源保持不变，因此新的字节码必须和原来的布局相同
+	bool ReplaceShader(uint32_t passIdx, std::span<const uint8_t> cso, ID3D11Device* d3dDevice) noexcept;
 
 private:
 	bool _InitializeConstants(
@@ -32,18 +86,22 @@ private:
 		const EffectOption& option,
 		DeviceResources& deviceResources,
 		SIZE inputSize,
-		SIZE outputSize
+		SIZE outputSize,
+		const EffectInputCrop* inputCrop
 	) noexcept;
 
-	void _DrawPass(uint32_t i) const noexcept;
+	void _DrawPass(uint32_t i, const SmallVector<RegionPropagator::Rect>* tiles, ID3D11Buffer* tileOffsetCB) const noexcept;
 
 	ID3D11DeviceContext* _d3dDC = nullptr;
 
 	SmallVector<ID3D11SamplerState*> _samplers;
 	SmallVector<winrt::com_ptr<ID3D11Texture2D>> _textures;
+	SmallVector<SIZE> _textureSizes;
 	std::vector<SmallVector<ID3D11ShaderResourceView*>> _srvs;
 	// 后半部分为空，用于解绑
 	std::vector<SmallVector<ID3D11UnorderedAccessView*>> _uavs;
+	// INPUT 在 _srvs 中的位置 (通道, 序号)
+	SmallVector<std::pair<uint32_t, uint32_t>> _inputSrvSlots;
 
 	SmallVector<EffectHelper::Constant32, 32> _constants;
 	winrt::com_ptr<ID3D11Buffer> _constantBuffer;
@@ -51,6 +109,8 @@ private:
 	SmallVector<winrt::com_ptr<ID3D11ComputeShader>> _shaders;
 
 	SmallVector<std::pair<uint32_t, uint32_t>> _dispatches;
+	// 通道的着色器是否使用 __tileOffset
+	SmallVector<bool> _hasFootprints;
 };
 
 }
@@ -0,0 +1,584 @@
+// 不使用预编译头，以便在其他平台构建
+#include "EffectFusion.h"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <fmt/format.h>
+#include "EffectDesc.h"
+#include "EffectParser.h"
+#include "StrUtils.h"
+
+namespace Magpie::Core {
+
+// 融合后第一个效果之后的效果对 INPUT 的采样被替换为此变量，它保存前一个效果的计算结果
+static constexpr std::string_view FUSED_COLOR = "__fused";
+
+static bool IsIdentifierStart(char c) noexcept {
+	return StrUtils::isalpha(c) || c == '_';
+}
+
+static bool IsIdentifierChar(char c) noexcept {
+	return StrUtils::isalnum(c) || c == '_';
+}
+
+static size_t SkipSpaces(std::string_view code, size_t pos) noexcept {
+	while (pos < code.size() && StrUtils::isspace(code[pos])) {
+		++pos;
+	}
+	return pos;
+}
+
+// 跳过空白后读取标识符，不是标识符时返回空且不移动 pos
+static std::string_view NextIdentifier(std::string_view code, size_t& pos) noexcept {
+	size_t start = SkipSpaces(code, pos);
+	if (start >= code.size() || !IsIdentifierStart(code[start])) {
+		return {};
+	}
+
+	size_t end = start + 1;
+	while (end < code.size() && IsIdentifierChar(code[end])) {
+		++end;
+	}
+
+	pos = end;
+	return code.substr(start, end - start);
+}
+
+// 跳过空白后检查 token，成功时 pos 指向 token 之后
+static bool CheckToken(std::string_view code, size_t& pos, std::string_view token) noexcept {
+	size_t start = SkipSpaces(code, pos);
+	if (code.substr(start, token.size()) != token) {
+		return false;
+	}
+
+	pos = start + token.size();
+	return true;
+}
+
+// 跳过数字，包括浮点数的小数部分、指数和后缀
+static size_t SkipNumber(std::string_view code, size_t pos) noexcept {
+	while (pos < code.size()) {
+		const char c = code[pos];
+		if (IsIdentifierChar(c) || c == '.') {
+			++pos;
+		} else if ((c == '+' || c == '-') && (code[pos - 1] == 'e' || code[pos - 1] == 'E')) {
+			++pos;
+		} else {
+			break;
+		}
+	}
+	return pos;
+}
+
+static size_t SkipString(std::string_view code, size_t pos) noexcept {
+	for (++pos; pos < code.size(); ++pos) {
+		if (code[pos] == '\\') {
+			++pos;
+		} else if (code[pos] == '"') {
+			return pos + 1;
+		}
+	}
+	return code.size();
+}
+
+static bool IsNumberStart(std::string_view code, size_t pos) noexcept {
+	return StrUtils::isdigit(code[pos])
+		|| (code[pos] == '.' && pos + 1 < code.size() && StrUtils::isdigit(code[pos + 1]));
+}
+
+// 遍历代码中的标识符，跳过数字、字符串和成员名。visitor 返回 false 时停止遍历并返回 false
+template <typename Fn>
+static bool ForEachIdentifier(std::string_view code, Fn&& visitor) noexcept {
+	// 上一个非空白字符
+	char prev = '\0';
+
+	for (size_t i = 0; i < code.size();) {
+		const char c = code[i];
+		if (c == '"') {
+			i = SkipString(code, i);
+			prev = '"';
+		} else if (IsNumberStart(code, i)) {
+			i = SkipNumber(code, i);
+			prev = '0';
+		} else if (IsIdentifierStart(c)) {
+			const size_t start = i;
+			std::string_view id = NextIdentifier(code, i);
+			if (prev != '.' && !visitor(id, start)) {
+				return false;
+			}
+			prev = 'a';
+		} else {
+			if (!StrUtils::isspace(c)) {
+				prev = c;
+			}
+			++i;
+		}
+	}
+
+	return true;
+}
+
+static bool HasInclude(std::string_view code) noexcept {
+	for (size_t pos = code.find('#'); pos != std::string_view::npos; pos = code.find('#', pos)) {
+		++pos;
+		if (NextIdentifier(code, pos) == "include") {
+			return true;
+		}
+	}
+	return false;
+}
+
+// 检查 [start, end) 处的标识符是否被赋值、自增或自减
+static bool IsModified(std::string_view code, size_t start, size_t end) noexcept {
+	size_t pos = start;
+	while (pos > 0 && StrUtils::isspace(code[pos - 1])) {
+		--pos;
+	}
+	if (pos >= 2) {
+		std::string_view prev = code.substr(pos - 2, 2);
+		if (prev == "++" || prev == "--") {
+			return true;
+		}
+	}
+
+	pos = end;
+	// 分量也可能被修改，如 pos.x += 1
+	if (CheckToken(code, pos, ".")) {
+		NextIdentifier(code, pos);
+	}
+
+	pos = SkipSpaces(code, pos);
+	std::string_view next = code.substr(pos, 2);
+	if (next.starts_with('=')) {
+		return next != "==";
+	}
+	// 保守起见把下标也视为修改
+	return next.starts_with('[') || next == "+=" || next == "-=" || next == "*=" || next == "/="
+		|| next == "%=" || next == "++" || next == "--";
+}
+
+struct InputSample {
+	size_t offset;
+	size_t length;
+};
+
+// 检查 INPUT 是否只用于在当前像素采样，即 INPUT.SampleLevel(sam, pos, 0) 或 INPUT.Sample(sam, pos)，
+// 其中 pos 是 Pass1 的参数且没有被修改。无法识别 pos 作为 out 或 inout 实参传递的情况，
+// PS 样式的通道中几乎不会这么做
+static bool FindInputSamples(std::string_view passCode, std::vector<InputSample>& samples) noexcept {
+	// 获取 Pass1 的参数名
+	std::string_view posName;
+	ForEachIdentifier(passCode, [&](std::string_view id, size_t offset) {
+		if (id != "Pass1") {
+			return true;
+		}
+
+		size_t pos = offset + id.size();
+		if (!CheckToken(passCode, pos, "(") || NextIdentifier(passCode, pos).empty()) {
+			return true;
+		}
+
+		std::string_view name = NextIdentifier(passCode, pos);
+		if (!name.empty() && CheckToken(passCode, pos, ")")) {
+			posName = name;
+			return false;
+		}
+		return true;
+	});
+
+	if (posName.empty()) {
+		return false;
+	}
+
+	return ForEachIdentifier(passCode, [&](std::string_view id, size_t offset) {
+		size_t pos = offset + id.size();
+
+		if (id == posName) {
+			return !IsModified(passCode, offset, pos);
+		}
+
+		if (id != "INPUT") {
+			return true;
+		}
+
+		if (!CheckToken(passCode, pos, ".")) {
+			return false;
+		}
+
+		std::string_view method = NextIdentifier(passCode, pos);
+		if (method != "SampleLevel" && method != "Sample") {
+			return false;
+		}
+
+		if (!CheckToken(passCode, pos, "(") || NextIdentifier(passCode, pos).empty()
+			|| !CheckToken(passCode, pos, ",") || NextIdentifier(passCode, pos) != posName) {
+			return false;
+		}
+
+		if (method == "SampleLevel" && (!CheckToken(passCode, pos, ",") || !CheckToken(passCode, pos, "0"))) {
+			return false;
+		}
+
+		if (!CheckToken(passCode, pos, ")")) {
+			return false;
+		}
+
+		samples.push_back({ offset, pos - offset });
+		return true;
+	});
+}
+
+static bool IsLineStart(std::string_view code, size_t pos) noexcept {
+	while (pos > 0) {
+		const char c = code[--pos];
+		if (c == '\n') {
+			return true;
+		}
+		if (!StrUtils::isspace(c)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// 跳到下一行，支持续行
+static size_t SkipLine(std::string_view code, size_t pos) noexcept {
+	while (true) {
+		pos = code.find('\n', pos);
+		if (pos == std::string_view::npos) {
+			return code.size();
+		}
+
+		size_t prev = pos;
+		if (prev > 0 && code[prev - 1] == '\r') {
+			--prev;
+		}
+		++pos;
+		if (prev == 0 || code[prev - 1] != '\\') {
+			return pos;
+		}
+	}
+}
+
+// 收集在全局作用域定义的名字（函数、全局变量和结构体）以及定义的宏
+static void CollectGlobalNames(
+	std::string_view code,
+	std::vector<std::string_view>& names,
+	std::vector<std::string_view>& macros
+) noexcept {
+	// 圆括号、方括号和花括号的嵌套深度
+	uint32_t depth = 0;
+	// 全局作用域中的尖括号只出现在模板类型中，如 vector<float, 4>
+	uint32_t angleDepth = 0;
+	// 位于全局变量的初始化表达式中
+	bool inInitializer = false;
+
+	for (size_t i = 0; i < code.size();) {
+		const char c = code[i];
+
+		if (c == '#' && IsLineStart(code, i)) {
+			size_t pos = i + 1;
+			if (NextIdentifier(code, pos) == "define") {
+				std::string_view name = NextIdentifier(code, pos);
+				if (!name.empty()) {
+					macros.push_back(name);
+				}
+			}
+
+			i = SkipLine(code, i);
+			continue;
+		}
+
+		if (c == '"') {
+			i = SkipString(code, i);
+			continue;
+		}
+
+		if (IsNumberStart(code, i)) {
+			i = SkipNumber(code, i);
+			continue;
+		}
+
+		if (IsIdentifierStart(c)) {
+			std::string_view id = NextIdentifier(code, i);
+			if (depth != 0 || angleDepth != 0 || inInitializer) {
+				continue;
+			}
+
+			if (id == "struct") {
+				std::string_view name = NextIdentifier(code, i);
+				if (!name.empty()) {
+					names.push_back(name);
+				}
+				continue;
+			}
+
+			const size_t pos = SkipSpaces(code, i);
+			if (pos < code.size() && std::string_view("(=;[,:").find(code[pos]) != std::string_view::npos) {
+				names.push_back(id);
+			}
+			continue;
+		}
+
+		switch (c) {
+		case '(':
+		case '[':
+		case '{':
+			++depth;
+			break;
+		case ')':
+		case ']':
+		case '}':
+			if (depth > 0) {
+				--depth;
+			}
+			break;
+		case '<':
+			if (depth == 0 && !inInitializer) {
+				++angleDepth;
+			}
+			break;
+		case '>':
+			if (depth == 0 && !inInitializer && angleDepth > 0) {
+				--angleDepth;
+			}
+			break;
+		case '=':
+			if (depth == 0) {
+				inInitializer = true;
+			}
+			break;
+		case ',':
+		case ';':
+			if (depth == 0) {
+				inInitializer = false;
+			}
+			break;
+		}
+
+		++i;
+	}
+}
+
+bool EffectFusion::CanBeFirst(const EffectDesc& desc) noexcept {
+	// 不能有 INPUT 和 OUTPUT 以外的纹理
+	return desc.passes.size() == 1 && desc.passes[0].isPSStyle && desc.textures.size() == 2;
+}
+
+bool EffectFusion::IsPixelwise(const EffectDesc& desc, const EffectBlocks& blocks) noexcept {
+	if (!CanBeFirst(desc) || blocks.passes.size() != 1) {
+		return false;
+	}
+
+	const auto& outputSizeExpr = desc.GetOutputSizeExpr();
+	if (outputSizeExpr.first != "INPUT_WIDTH" || outputSizeExpr.second != "INPUT_HEIGHT") {
+		return false;
+	}
+
+	// 包含的文件无法检查，而且融合后相对路径可能改变
+	for (std::string_view commonBlock : blocks.commons) {
+		if (HasInclude(commonBlock)) {
+			return false;
+		}
+
+		if (!ForEachIdentifier(commonBlock, [](std::string_view id, size_t) { return id != "INPUT"; })) {
+			return false;
+		}
+	}
+
+	if (HasInclude(blocks.passes[0])) {
+		return false;
+	}
+
+	std::vector<InputSample> samples;
+	return FindInputSamples(blocks.passes[0], samples);
+}
+
+std::string EffectFusion::GetParamPrefix(uint32_t effectIdx) noexcept {
+	return fmt::format("__F{}_", effectIdx + 1);
+}
+
+static const char* GetFilterName(EffectSamplerFilterType filterType) noexcept {
+	return filterType == EffectSamplerFilterType::Point ? "POINT" : "LINEAR";
+}
+
+static const char* GetAddressName(EffectSamplerAddressType addressType) noexcept {
+	return addressType == EffectSamplerAddressType::Wrap ? "WRAP" : "CLAMP";
+}
+
+uint32_t EffectFusion::GenerateSource(
+	std::span<const std::string_view> sources,
+	std::string& result,
+	std::string& errorMsg
+) noexcept {
+	if (sources.size() < 2) {
+		errorMsg = "至少需要两个效果";
+		return 1;
+	}
+
+	struct Member {
+		// blocks 中的 string_view 指向 source
+		std::string source;
+		EffectBlocks blocks;
+		EffectDesc desc;
+	};
+	std::vector<Member> members(sources.size());
+
+	bool useDynamic = false;
+	for (size_t i = 0; i < sources.size(); ++i) {
+		Member& member = members[i];
+		member.source = sources[i];
+
+		if (EffectParser::RemoveComments(member.source, member.blocks)
+			|| EffectParser::SplitBlocks(member.source, member.blocks)) {
+			errorMsg = fmt::format("解析效果#{} 失败", i);
+			return 1;
+		}
+
+		if (EffectParser::ResolveBlocks(member.blocks, member.desc, false, errorMsg)) {
+			errorMsg = fmt::format("解析效果#{} 失败: {}", i, errorMsg);
+			return 1;
+		}
+
+		if (i == 0 ? !CanBeFirst(member.desc) : !(member.desc.flags & EffectFlags::Pixelwise)) {
+			errorMsg = fmt::format("效果#{} 不能融合", i);
+			return 1;
+		}
+
+		if (member.desc.flags & EffectFlags::UseDynamic) {
+			useDynamic = true;
+		}
+	}
+
+	result.clear();
+	result.append(fmt::format("//!MAGPIE EFFECT\n//!VERSION {}\n", EffectParser::MAGPIE_FX_VERSION));
+	if (useDynamic) {
+		result.append("//!USE_DYNAMIC\n");
+	}
+	result.push_back('\n');
+
+	// 参数和采样器加上前缀以免重名
+	for (uint32_t i = 0; i < (uint32_t)members.size(); ++i) {
+		const std::string prefix = GetParamPrefix(i);
+
+		for (const EffectParameterDesc& paramDesc : members[i].desc.params) {
+			result.append("//!PARAMETER\n");
+			if (!paramDesc.label.empty()) {
+				result.append(fmt::format("//!LABEL {}\n", paramDesc.label));
+			}
+
+			std::visit([&](const auto& constant) {
+				using T = std::decay_t<decltype(constant.defaultValue)>;
+				result.append(fmt::format("//!DEFAULT {}\n//!MIN {}\n//!MAX {}\n//!STEP {}\n{} {}{};\n\n",
+					constant.defaultValue, constant.minValue, constant.maxValue, constant.step,
+					std::is_same_v<T, float> ? "float" : "int", prefix, paramDesc.name));
+			}, paramDesc.constant);
+		}
+	}
+
+	// 输出尺寸和第一个效果相同
+	result.append("//!TEXTURE\nTexture2D INPUT;\n\n//!TEXTURE\n");
+	{
+		const auto& outputSizeExpr = members[0].desc.GetOutputSizeExpr();
+		if (!outputSizeExpr.first.empty()) {
+			result.append(fmt::format("//!WIDTH {}\n", outputSizeExpr.first));
+		}
+		if (!outputSizeExpr.second.empty()) {
+			result.append(fmt::format("//!HEIGHT {}\n", outputSizeExpr.second));
+		}
+	}
+	result.append("Texture2D OUTPUT;\n\n");
+
+	for (uint32_t i = 0; i < (uint32_t)members.size(); ++i) {
+		const std::string prefix = GetParamPrefix(i);
+
+		for (const EffectSamplerDesc& samDesc : members[i].desc.samplers) {
+			result.append(fmt::format("//!SAMPLER\n//!FILTER {}\n//!ADDRESS {}\nSamplerState {}{};\n\n",
+				GetFilterName(samDesc.filterType), GetAddressName(samDesc.addressType), prefix, samDesc.name));
+		}
+	}
+
+	// 每个效果的代码放在宏定义之间，全局作用域中的名字都被加上前缀
+	result.append(fmt::format("//!COMMON\nstatic float4 {};\n\n", FUSED_COLOR));
+
+	for (uint32_t i = 0; i < (uint32_t)members.size(); ++i) {
+		const Member& member = members[i];
+		const std::string prefix = GetParamPrefix(i);
+
+		std::string_view passCode = member.blocks.passes[0];
+		std::vector<InputSample> samples;
+		if (i > 0 && !FindInputSamples(passCode, samples)) {
+			errorMsg = fmt::format("效果#{} 不能融合", i);
+			return 1;
+		}
+
+		std::vector<std::string_view> names;
+		std::vector<std::string_view> macros;
+		for (const EffectParameterDesc& paramDesc : member.desc.params) {
+			names.push_back(paramDesc.name);
+		}
+		for (const EffectSamplerDesc& samDesc : member.desc.samplers) {
+			names.push_back(samDesc.name);
+		}
+		names.push_back("Pass1");
+		for (std::string_view commonBlock : member.blocks.commons) {
+			CollectGlobalNames(commonBlock, names, macros);
+		}
+		CollectGlobalNames(passCode, names, macros);
+
+		// 排序使生成的源码是确定的，以便命中缓存
+		std::sort(names.begin(), names.end());
+		names.erase(std::unique(names.begin(), names.end()), names.end());
+
+		for (std::string_view name : names) {
+			result.append(fmt::format("#define {0} {1}{0}\n", name, prefix));
+		}
+
+		if (i > 0) {
+			// 输入尺寸和输出尺寸相同
+			result.append("#define GetInputSize GetOutputSize\n#define GetInputPt GetOutputPt\n#define GetScale() float2(1, 1)\n");
+		}
+		result.push_back('\n');
+
+		for (std::string_view commonBlock : member.blocks.commons) {
+			result.append(commonBlock);
+			result.push_back('\n');
+		}
+
+		size_t copied = 0;
+		for (const InputSample& sample : samples) {
+			result.append(passCode.substr(copied, sample.offset - copied));
+			result.append(FUSED_COLOR);
+			copied = sample.offset + sample.length;
+		}
+		result.append(passCode.substr(copied));
+		result.append("\n\n");
+
+		for (std::string_view name : names) {
+			result.append(fmt::format("#undef {}\n", name));
+		}
+		for (std::string_view name : macros) {
+			result.append(fmt::format("#undef {}\n", name));
+		}
+		if (i > 0) {
+			result.append("#undef GetInputSize\n#undef GetInputPt\n#undef GetScale\n");
+		}
+		result.push_back('\n');
+	}
+
+	// 效果的输出原本写入 R8G8B8A8_UNORM 格式的纹理，因此传给下一个效果前需要截断到 [0, 1]
+	result.append("//!PASS 1\n//!STYLE PS\n//!IN INPUT\n//!OUT OUTPUT\n");
+	// 之后的效果都是逐像素的，读取范围和第一个效果相同
+	if (const EffectPassDesc& firstPass = members[0].desc.passes[0]; firstPass.hasFootprint) {
+		result.append(fmt::format("//!FOOTPRINT {}, {}\n", firstPass.footprint.first, firstPass.footprint.second));
+	}
+	result.append("\nfloat4 Pass1(float2 pos) {\n");
+	for (uint32_t i = 0; i + 1 < (uint32_t)members.size(); ++i) {
+		result.append(fmt::format("\t{} = saturate({}Pass1(pos));\n", FUSED_COLOR, GetParamPrefix(i)));
+	}
+	result.append(fmt::format("\treturn {}Pass1(pos);\n}}\n", GetParamPrefix((uint32_t)members.size() - 1)));
+
+	return 0;
+}
+
+}
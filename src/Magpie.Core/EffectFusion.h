@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Magpie::Core {
+
+struct EffectDesc;
+struct EffectBlocks;
+
+// 把效果链中相邻的逐像素效果融合为一个通道，生成的 MagpieFX 源码和普通效果一样编译和缓存
+struct EffectFusion {
+	// 是否可以作为融合的第一个效果
+	static bool CanBeFirst(const EffectDesc& desc) noexcept;
+
+	// 由 EffectParser::ResolveBlocks 调用，结果保存在 EffectFlags::Pixelwise 中。
+	// blocks 中的 commons 和 passes 应只包含代码部分
+	static bool IsPixelwise(const EffectDesc& desc, const EffectBlocks& blocks) noexcept;
+
+	// 融合后第 effectIdx 个效果的参数名为前缀加原来的参数名
+	static std::string GetParamPrefix(uint32_t effectIdx) noexcept;
+
+	// sources 为各个效果的源码，按在效果链中的顺序排列。失败时 errorMsg 为错误信息
+	static uint32_t GenerateSource(
+		std::span<const std::string_view> sources,
+		std::string& result,
+		std::string& errorMsg
+	) noexcept;
+};
+
+}
@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "EffectHotReloader.h"
+#include "CommonSharedConstants.h"
+#include "Logger.h"
+#include "StrUtils.h"
+
+namespace Magpie::Core {
+
+// 编辑器保存文件时往往触发多次通知，收到通知后等待这段时间没有新的通知再处理
+static constexpr DWORD DEBOUNCE_MS = 100;
+
+// 规范化相对路径: 统一分隔符，处理 . 和 ..，并转为小写
+static std::wstring NormalizePath(std::wstring_view path) noexcept {
+	SmallVector<std::wstring_view> components;
+
+	while (!path.empty()) {
+		size_t delimPos = path.find_first_of(L"\\/");
+		std::wstring_view component = path.substr(0, delimPos);
+		path.remove_prefix(delimPos == std::wstring_view::npos ? path.size() : delimPos + 1);
+
+		if (component.empty() || component == L".") {
+			continue;
+		}
+
+		if (component == L"..") {
+			if (!components.empty()) {
+				components.pop_back();
+			}
+		} else {
+			components.push_back(component);
+		}
+	}
+
+	std::wstring result;
+	for (std::wstring_view component : components) {
+		if (!result.empty()) {
+			result.push_back(L'\\');
+		}
+		result += component;
+	}
+	StrUtils::ToLowerCase(result);
+	return result;
+}
+
+EffectHotReloader::~EffectHotReloader() {
+	if (_watcherThread.joinable()) {
+		_stopEvent.SetEvent();
+		_watcherThread.join();
+	}
+}
+
+void EffectHotReloader::SetDependencies(
+	uint32_t effectIdx,
+	std::string_view effectName,
+	const EffectIncludes& includes
+) noexcept {
+	static constexpr std::wstring_view EFFECTS_DIR = CommonSharedConstants::EFFECTS_DIR;
+
+	// 在锁外准备新的依赖
+	std::wstring source = NormalizePath(StrUtils::Concat(StrUtils::UTF8ToUTF16(effectName), L".hlsl"));
+
+	// 不同通道可能包含相同的文件
+	phmap::flat_hash_set<std::wstring> newDependencies;
+	for (const std::vector<std::wstring>& passIncludes : includes) {
+		for (std::wstring_view path : passIncludes) {
+			// PassInclude 记录的路径以 effects\ 开头
+			if (path.starts_with(EFFECTS_DIR)) {
+				path.remove_prefix(EFFECTS_DIR.size());
+			}
+			newDependencies.insert(NormalizePath(path));
+		}
+	}
+
+	auto lock = _lock.lock_exclusive();
+
+	if (_effectSources.size() <= effectIdx) {
+		_effectSources.resize(effectIdx + 1);
+	}
+	_effectSources[effectIdx] = std::move(source);
+
+	// 删除旧的依赖
+	for (auto it = _includeDependents.begin(); it != _includeDependents.end();) {
+		SmallVector<uint32_t>& dependents = it->second;
+		dependents.erase(std::remove(dependents.begin(), dependents.end(), effectIdx), dependents.end());
+
+		if (dependents.empty()) {
+			_includeDependents.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	for (const std::wstring& path : newDependencies) {
+		_includeDependents[path].push_back(effectIdx);
+	}
+}
+
+bool EffectHotReloader::Start(std::function<void(const SmallVector<ChangedEffect>&)> onChanged) noexcept {
+	assert(!_watcherThread.joinable());
+
+	_onChanged = std::move(onChanged);
+
+	_hEffectsDir.reset(CreateFile(
+		CommonSharedConstants::EFFECTS_DIR,
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		NULL
+	));
+	if (!_hEffectsDir) {
+		Logger::Get().Win32Error("打开 effects 文件夹失败");
+		return false;
+	}
+
+	if (!_changeEvent.try_create(wil::EventOptions::ManualReset, nullptr)
+		|| !_stopEvent.try_create(wil::EventOptions::ManualReset, nullptr)) {
+		Logger::Get().Win32Error("创建事件失败");
+		return false;
+	}
+
+	_watcherThread = std::thread(std::bind(&EffectHotReloader::_WatcherThreadProc, this));
+
+	Logger::Get().Info("已开始监视 effects 文件夹");
+	return true;
+}
+
+void EffectHotReloader::_WatcherThreadProc() noexcept {
+#ifdef _DEBUG
+	SetThreadDescription(GetCurrentThread(), L"Magpie 效果热重载线程");
+#endif
+
+	alignas(DWORD) uint8_t buffer[16 * 1024];
+	OVERLAPPED overlapped{ .hEvent = _changeEvent.get() };
+	bool isReading = false;
+
+	phmap::flat_hash_set<std::wstring> changedFiles;
+	// 缓冲区溢出时无法得知哪些文件更改，视为所有效果都已更改
+	bool isAllChanged = false;
+
+	while (true) {
+		if (!isReading) {
+			_changeEvent.ResetEvent();
+			if (!ReadDirectoryChangesW(_hEffectsDir.get(), buffer, sizeof(buffer), TRUE,
+				FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+				nullptr, &overlapped, nullptr)) {
+				Logger::Get().Win32Error("ReadDirectoryChangesW 失败");
+				return;
+			}
+			isReading = true;
+		}
+
+		const HANDLE events[] = { _stopEvent.get(), _changeEvent.get() };
+		const bool hasPendingChanges = isAllChanged || !changedFiles.empty();
+		const DWORD waitResult = WaitForMultipleObjects(
+			(DWORD)std::size(events), events, FALSE, hasPendingChanges ? DEBOUNCE_MS : INFINITE);
+
+		if (waitResult == WAIT_OBJECT_0 + 1) {
+			isReading = false;
+
+			DWORD bytesTransferred = 0;
+			if (!GetOverlappedResult(_hEffectsDir.get(), &overlapped, &bytesTransferred, FALSE)) {
+				Logger::Get().Win32Error("GetOverlappedResult 失败");
+				return;
+			}
+
+			if (bytesTransferred == 0) {
+				isAllChanged = true;
+				continue;
+			}
+
+			const uint8_t* cur = buffer;
+			while (true) {
+				const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)cur;
+				changedFiles.insert(NormalizePath(
+					std::wstring_view(info->FileName, info->FileNameLength / sizeof(wchar_t))));
+
+				if (info->NextEntryOffset == 0) {
+					break;
+				}
+				cur += info->NextEntryOffset;
+			}
+		} else if (waitResult == WAIT_TIMEOUT) {
+			_OnFilesChanged(changedFiles, isAllChanged);
+			changedFiles.clear();
+			isAllChanged = false;
+		} else {
+			// 退出或出错
+			if (waitResult != WAIT_OBJECT_0) {
+				Logger::Get().Win32Error("WaitForMultipleObjects 失败");
+			}
+
+			if (isReading) {
+				CancelIoEx(_hEffectsDir.get(), &overlapped);
+				DWORD bytesTransferred;
+				GetOverlappedResult(_hEffectsDir.get(), &overlapped, &bytesTransferred, TRUE);
+			}
+			return;
+		}
+	}
+}
+
+void EffectHotReloader::_OnFilesChanged(
+	const phmap::flat_hash_set<std::wstring>& changedFiles,
+	bool isAllChanged
+) const noexcept {
+	SmallVector<ChangedEffect> changedEffects;
+
+	{
+		auto lock = _lock.lock_shared();
+
+		const auto getChangedEffect = [&](uint32_t effectIdx) -> ChangedEffect& {
+			auto it = std::find_if(changedEffects.begin(), changedEffects.end(),
+				[effectIdx](const ChangedEffect& effect) { return effect.effectIdx == effectIdx; });
+			if (it != changedEffects.end()) {
+				return *it;
+			}
+			changedEffects.push_back({ .effectIdx = effectIdx, .isSourceChanged = false });
+			return changedEffects.back();
+		};
+
+		for (uint32_t i = 0; i < (uint32_t)_effectSources.size(); ++i) {
+			if (isAllChanged || changedFiles.contains(_effectSources[i])) {
+				getChangedEffect(i).isSourceChanged = true;
+			}
+		}
+
+		for (const std::wstring& file : changedFiles) {
+			auto it = _includeDependents.find(file);
+			if (it == _includeDependents.end()) {
+				continue;
+			}
+
+			for (uint32_t effectIdx : it->second) {
+				getChangedEffect(effectIdx);
+			}
+		}
+	}
+
+	if (changedEffects.empty()) {
+		return;
+	}
+
+	std::sort(changedEffects.begin(), changedEffects.end(),
+		[](const ChangedEffect& l, const ChangedEffect& r) { return l.effectIdx < r.effectIdx; });
+	_onChanged(changedEffects);
+}
+
+}
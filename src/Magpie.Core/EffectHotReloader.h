@@ -0,0 +1,50 @@
+#pragma once
+#include "EffectCompiler.h"
+#include "SmallVector.h"
+#include <parallel_hashmap/phmap.h>
+
+namespace Magpie::Core {
+
+// 开发者模式下监视 effects 文件夹，效果的源文件或它包含的文件更改后通知调用者。
+// 依赖关系来自编译时 PassInclude 记录的 EffectIncludes
+class EffectHotReloader {
+public:
+	struct ChangedEffect {
+		uint32_t effectIdx;
+		// 为真表示效果的源文件更改，否则为包含的文件更改
+		bool isSourceChanged;
+	};
+
+	EffectHotReloader() = default;
+	EffectHotReloader(const EffectHotReloader&) = delete;
+	EffectHotReloader(EffectHotReloader&&) = delete;
+
+	~EffectHotReloader();
+
+	// 设置或更新效果的依赖，可以在任何线程调用
+	void SetDependencies(uint32_t effectIdx, std::string_view effectName, const EffectIncludes& includes) noexcept;
+
+	// onChanged 在监视线程中调用
+	bool Start(std::function<void(const SmallVector<ChangedEffect>&)> onChanged) noexcept;
+
+private:
+	void _WatcherThreadProc() noexcept;
+
+	void _OnFilesChanged(const phmap::flat_hash_set<std::wstring>& changedFiles, bool isAllChanged) const noexcept;
+
+	std::function<void(const SmallVector<ChangedEffect>&)> _onChanged;
+
+	wil::unique_hfile _hEffectsDir;
+	wil::unique_event_nothrow _changeEvent;
+	wil::unique_event_nothrow _stopEvent;
+	std::thread _watcherThread;
+
+	mutable wil::srwlock _lock;
+	// 以下成员由 _lock 保护，路径均相对于 effects 文件夹，已规范化并转为小写
+	// 每个效果的源文件
+	std::vector<std::wstring> _effectSources;
+	// 被包含的文件 -> 包含它的效果
+	phmap::flat_hash_map<std::wstring, SmallVector<uint32_t>> _includeDependents;
+};
+
+}
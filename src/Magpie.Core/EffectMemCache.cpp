@@ -0,0 +1,97 @@
+// 不使用预编译头，以便在其他平台构建
+#include "EffectMemCache.h"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace Magpie::Core {
+
+std::shared_ptr<const EffectDesc> EffectMemCache::Get(const std::wstring& key) const noexcept {
+	std::shared_lock lock(_mutex);
+
+	auto it = _entries.find(key);
+	if (it == _entries.end()) {
+		return nullptr;
+	}
+
+	// 共享锁下只更新原子的访问时间
+	it->second->lastAccess.store(++_clock, std::memory_order_relaxed);
+	return it->second->desc;
+}
+
+bool EffectMemCache::Put(const std::wstring& key, std::shared_ptr<const EffectDesc> desc) noexcept {
+	std::unique_ptr<_Entry> entry = std::make_unique<_Entry>();
+	entry->size = EstimateSize(*desc) + key.size() * sizeof(wchar_t);
+	entry->desc = std::move(desc);
+	entry->lastAccess.store(++_clock, std::memory_order_relaxed);
+
+	std::unique_lock lock(_mutex);
+
+	std::unique_ptr<_Entry>& slot = _entries[key];
+	if (slot) {
+		_size -= slot->size;
+	}
+	_size += entry->size;
+	slot = std::move(entry);
+
+	return _size > _capacity;
+}
+
+void EffectMemCache::Trim() noexcept {
+	std::unique_lock lock(_mutex);
+
+	if (_size <= _capacity) {
+		return;
+	}
+
+	std::vector<std::pair<uint64_t, const std::wstring*>> order;
+	order.reserve(_entries.size());
+	for (const auto& [key, entry] : _entries) {
+		order.emplace_back(entry->lastAccess.load(std::memory_order_relaxed), &key);
+	}
+	std::sort(order.begin(), order.end());
+
+	const size_t target = _capacity / 4 * 3;
+	for (const auto& [lastAccess, key] : order) {
+		if (_size <= target) {
+			break;
+		}
+
+		auto it = _entries.find(*key);
+		_size -= it->second->size;
+		_entries.erase(it);
+	}
+}
+
+size_t EffectMemCache::Size() const noexcept {
+	std::shared_lock lock(_mutex);
+	return _size;
+}
+
+size_t EffectMemCache::Count() const noexcept {
+	std::shared_lock lock(_mutex);
+	return _entries.size();
+}
+
+size_t EffectMemCache::EstimateSize(const EffectDesc& desc) noexcept {
+	size_t result = sizeof(EffectDesc) + desc.name.size() + desc.sortName.size();
+
+	for (const EffectParameterDesc& param : desc.params) {
+		result += sizeof(param) + param.name.size() + param.label.size();
+	}
+	for (const EffectIntermediateTextureDesc& texture : desc.textures) {
+		result += sizeof(texture) + texture.sizeExpr.first.size() + texture.sizeExpr.second.size()
+			+ texture.name.size() + texture.source.size();
+	}
+	for (const EffectSamplerDesc& sampler : desc.samplers) {
+		result += sizeof(sampler) + sampler.name.size();
+	}
+	for (const EffectPassDesc& pass : desc.passes) {
+		result += sizeof(pass) + pass.cso.size() + pass.desc.size()
+			+ (pass.inputs.size() + pass.outputs.size()) * sizeof(uint32_t);
+	}
+
+	return result;
+}
+
+}
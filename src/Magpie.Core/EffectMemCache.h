@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "EffectDesc.h"
+
+namespace Magpie::Core {
+
+// 效果的内存缓存，超出容量时按最近访问时间淘汰。条目为不可变的快照，查找时无需复制
+class EffectMemCache {
+public:
+	EffectMemCache(size_t capacity) noexcept : _capacity(capacity) {}
+
+	EffectMemCache(const EffectMemCache&) = delete;
+	EffectMemCache(EffectMemCache&&) = delete;
+
+	// 未找到时返回空
+	std::shared_ptr<const EffectDesc> Get(const std::wstring& key) const noexcept;
+
+	// 返回 true 表示超出容量，应调用 Trim
+	bool Put(const std::wstring& key, std::shared_ptr<const EffectDesc> desc) noexcept;
+
+	// 淘汰最久未访问的条目，直到不超过容量的 3/4，以免频繁淘汰
+	void Trim() noexcept;
+
+	size_t Size() const noexcept;
+
+	size_t Count() const noexcept;
+
+	// 估算 desc 占用的内存，包含字节码
+	static size_t EstimateSize(const EffectDesc& desc) noexcept;
+
+private:
+	struct _Entry {
+		std::shared_ptr<const EffectDesc> desc;
+		size_t size = 0;
+		mutable std::atomic<uint64_t> lastAccess = 0;
+	};
+
+	const size_t _capacity;
+
+	mutable std::shared_mutex _mutex;
+	std::unordered_map<std::wstring, std::unique_ptr<_Entry>> _entries;
+	size_t _size = 0;
+	// 逻辑时钟，每次访问加一
+	mutable std::atomic<uint64_t> _clock = 0;
+};
+
+}
@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "EffectMetadataIndex.h"
+#include "YasHelper.h"
+#include "Logger.h"
+#include "Win32Utils.h"
+#include "CommonSharedConstants.h"
+#include "StrUtils.h"
+#include "Utils.h"
+#include "EffectParser.h"
+
+namespace Magpie::Core {
+
+template<typename Archive>
+void serialize(Archive& ar, EffectParameterDesc& o) {
+	ar& o.name& o.label& o.constant;
+}
+
+template<typename Archive>
+void serialize(Archive& ar, EffectMetadata& o) {
+	ar& o.fileSize& o.lastWriteTime& o.contentHash& o.sortName& o.params& o.canScale;
+}
+
+// 索引版本
+// 当索引结构有更改时更新它，使旧索引失效
+static constexpr uint32_t EFFECT_METADATA_INDEX_VERSION = 1;
+
+static std::wstring GetIndexFileName() noexcept {
+	return StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"effects_metadata");
+}
+
+bool EffectMetadataIndex::Load(phmap::flat_hash_map<std::wstring, EffectMetadata>& index) noexcept {
+	index.clear();
+
+	std::wstring fileName = GetIndexFileName();
+	if (!Win32Utils::FileExists(fileName.c_str())) {
+		return false;
+	}
+
+	std::vector<BYTE> buf;
+	if (!Win32Utils::ReadFile(fileName.c_str(), buf) || buf.empty()) {
+		return false;
+	}
+
+	try {
+		yas::mem_istream mi(buf.data(), buf.size());
+		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+
+		// 解析器更新后元数据可能不同
+		uint32_t version = 0;
+		uint32_t fxVersion = 0;
+		ia& version& fxVersion;
+		if (version != EFFECT_METADATA_INDEX_VERSION || fxVersion != EffectParser::MAGPIE_FX_VERSION) {
+			Logger::Get().Info("效果元数据索引版本不匹配");
+			return false;
+		}
+
+		uint32_t count = 0;
+		ia& count;
+		index.reserve(count);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			std::string name;
+			EffectMetadata metadata;
+			ia& name& metadata;
+			index.emplace(StrUtils::UTF8ToUTF16(name), std::move(metadata));
+		}
+	} catch (...) {
+		Logger::Get().Error("反序列化效果元数据索引失败");
+		index.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void EffectMetadataIndex::Save(const phmap::flat_hash_map<std::wstring, EffectMetadata>& index) noexcept {
+	std::vector<BYTE> buf;
+	buf.reserve(16384);
+
+	try {
+		yas::vector_ostream os(buf);
+		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+
+		oa& EFFECT_METADATA_INDEX_VERSION& EffectParser::MAGPIE_FX_VERSION;
+		oa& (uint32_t)index.size();
+
+		for (const auto& [name, metadata] : index) {
+			oa& StrUtils::UTF16ToUTF8(name)& metadata;
+		}
+	} catch (...) {
+		Logger::Get().Error("序列化效果元数据索引失败");
+		return;
+	}
+
+	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+		Logger::Get().Win32Error("创建 cache 文件夹失败");
+		return;
+	}
+
+	if (!Win32Utils::WriteFile(GetIndexFileName().c_str(), buf.data(), buf.size())) {
+		Logger::Get().Error("保存效果元数据索引失败");
+		return;
+	}
+
+	Logger::Get().Info("已保存效果元数据索引");
+}
+
+uint64_t EffectMetadataIndex::HashContent(std::string_view source) noexcept {
+	return Utils::HashData(std::span((const BYTE*)source.data(), source.size()));
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "EffectDesc.h"
+#include <parallel_hashmap/phmap.h>
+
+namespace Magpie::Core {
+
+// 供用户界面使用的效果元数据
+struct EffectMetadata {
+	// 用于判断源文件是否被修改
+	uint64_t fileSize = 0;
+	uint64_t lastWriteTime = 0;
+	uint64_t contentHash = 0;
+
+	std::string sortName;
+	std::vector<EffectParameterDesc> params;
+	bool canScale = false;
+};
+
+// 效果元数据的持久化索引，键为效果名。启动时一次读取，只需重新解析修改过的效果
+struct EffectMetadataIndex {
+	static bool Load(phmap::flat_hash_map<std::wstring, EffectMetadata>& index) noexcept;
+
+	static void Save(const phmap::flat_hash_map<std::wstring, EffectMetadata>& index) noexcept;
+
+	static uint64_t HashContent(std::string_view source) noexcept;
+};
+
+}
@@ -0,0 +1,1692 @@
+// 不使用预编译头，以便在其他平台构建
+#include "EffectParser.h"
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+#include <fmt/format.h>
+#include "EffectDesc.h"
+#include "EffectFusion.h"
+#include "EffectHelper.h"
+#include "StrUtils.h"
+
+namespace Magpie::Core {
+
+static const char* META_INDICATOR = "//!";
+
+// 判断 pos 之前是否只有空白字符，即 pos 是否位于行首
+static bool IsLineStart(const char* begin, const char* pos) noexcept {
+	while (pos != begin) {
+		char c = *--pos;
+		if (c == '\n') {
+			return true;
+		}
+		if (!StrUtils::isspace(c)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t EffectParser::RemoveComments(std::string& source, EffectBlocks& blocks) noexcept {
+	// 确保以换行符结尾，这样扫描时无需检查越界
+	if (source.empty() || source.back() != '\n') {
+		source.push_back('\n');
+	}
+
+	blocks.metaLines.clear();
+
+	// 原地处理，dest 总是不超过 src
+	char* const begin = source.data();
+	const char* const end = begin + source.size();
+	const char* src = begin;
+	char* dest = begin;
+
+	while (true) {
+		// 使用 memchr 跳过不含 / 的部分
+		const char* slash = (const char*)std::memchr(src, '/', end - src);
+		if (!slash) {
+			slash = end;
+		}
+
+		size_t len = slash - src;
+		if (dest != src) {
+			std::memmove(dest, src, len);
+		}
+		dest += len;
+		src = slash;
+
+		if (src == end) {
+			break;
+		}
+
+		// 最后一个字符为换行符，因此 src[1] 和 src[2] 必定有效
+		if (src[1] == '/') {
+			if (src[2] == '!') {
+				// 保留 //!，如果位于行首则记录位置供划分块使用
+				if (IsLineStart(begin, dest)) {
+					blocks.metaLines.push_back(uint32_t(dest - begin));
+				}
+
+				std::memmove(dest, src, 3);
+				dest += 3;
+				src += 3;
+			} else {
+				// 行注释，保留换行符
+				src = (const char*)std::memchr(src + 2, '\n', end - src - 2);
+			}
+			continue;
+		}
+
+		if (src[1] == '*') {
+			// 块注释
+			const char* p = src + 2;
+			while (true) {
+				p = (const char*)std::memchr(p, '*', end - p);
+				if (!p || p + 1 == end) {
+					// 未闭合
+					return 1;
+				}
+
+				if (p[1] == '/') {
+					break;
+				}
+				++p;
+			}
+
+			src = p + 2;
+			continue;
+		}
+
+		*dest++ = *src++;
+	}
+
+	// 无需保留最后的换行符
+	source.resize(dest - begin - 1);
+	return 0;
+}
+
+template<bool IncludeNewLine>
+static void RemoveLeadingBlanks(std::string_view& source) {
+	size_t i = 0;
+	for (; i < source.size(); ++i) {
+		if constexpr (IncludeNewLine) {
+			if (!StrUtils::isspace(source[i])) {
+				break;
+			}
+		} else {
+			char c = source[i];
+			if (c != ' ' && c != '\t') {
+				break;
+			}
+		}
+	}
+
+	source.remove_prefix(i);
+}
+
+template<bool AllowNewLine>
+static bool CheckNextToken(std::string_view& source, std::string_view token) {
+	RemoveLeadingBlanks<AllowNewLine>(source);
+
+	if (!source.starts_with(token)) {
+		return false;
+	}
+
+	source.remove_prefix(token.size());
+	return true;
+}
+
+template<bool AllowNewLine>
+static uint32_t GetNextToken(std::string_view& source, std::string_view& value) {
+	RemoveLeadingBlanks<AllowNewLine>(source);
+
+	if (source.empty()) {
+		return 2;
+	}
+
+	char cur = source[0];
+
+	if (StrUtils::isalpha(cur) || cur == '_') {
+		size_t j = 1;
+		for (; j < source.size(); ++j) {
+			cur = source[j];
+
+			if (!StrUtils::isalnum(cur) && cur != '_') {
+				break;
+			}
+		}
+
+		value = source.substr(0, j);
+		source.remove_prefix(j);
+		return 0;
+	}
+
+	if constexpr (AllowNewLine) {
+		return 1;
+	} else {
+		return cur == '\n' ? 2 : 1;
+	}
+}
+
+static bool CheckMagic(std::string_view& source) {
+	std::string_view token;
+	if (!CheckNextToken<true>(source, META_INDICATOR)) {
+		return false;
+	}
+
+	if (!CheckNextToken<false>(source, "MAGPIE")) {
+		return false;
+	}
+	if (!CheckNextToken<false>(source, "EFFECT")) {
+		return false;
+	}
+
+	if (GetNextToken<false>(source, token) != 2) {
+		return false;
+	}
+
+	if (source.empty()) {
+		return false;
+	}
+
+	return true;
+}
+
+static uint32_t GetNextString(std::string_view& source, std::string_view& value) {
+	RemoveLeadingBlanks<false>(source);
+	size_t pos = source.find('\n');
+
+	value = source.substr(0, pos);
+	StrUtils::Trim(value);
+	if (value.empty()) {
+		return 1;
+	}
+
+	source.remove_prefix(std::min(pos + 1, source.size()));
+	return 0;
+}
+
+template<typename T>
+static uint32_t GetNextNumber(std::string_view& source, T& value) {
+	RemoveLeadingBlanks<false>(source);
+
+	if (source.empty()) {
+		return 1;
+	}
+
+	const auto& result = std::from_chars(source.data(), source.data() + source.size(), value);
+	if ((int)result.ec) {
+		return 1;
+	}
+
+	// 解析成功
+	source.remove_prefix(result.ptr - source.data());
+	return 0;
+}
+
+static uint32_t GetNextExpr(std::string_view& source, std::string& expr) {
+	RemoveLeadingBlanks<false>(source);
+	size_t size = std::min(source.find('\n') + 1, source.size());
+
+	// 移除空白字符
+	expr.resize(size);
+
+	size_t j = 0;
+	for (size_t i = 0; i < size; ++i) {
+		char c = source[i];
+		if (!StrUtils::isspace(c)) {
+			expr[j++] = c;
+		}
+	}
+	expr.resize(j);
+
+	if (expr.empty()) {
+		return 1;
+	}
+
+	source.remove_prefix(size);
+	return 0;
+}
+
+static uint32_t ResolveHeader(std::string_view block, EffectDesc& desc, bool noCompile) {
+	// 必需的选项: VERSION
+	// 可选的选项: USE_DYNAMIC, SORT_NAME
+
+	std::bitset<3> processed;
+
+	std::string_view token;
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+		std::string t = StrUtils::ToUpperCase(token);
+
+		if (t == "VERSION") {
+			if (processed[0]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			uint32_t version;
+			if (GetNextNumber(block, version)) {
+				return 1;
+			}
+
+			if (version != EffectParser::MAGPIE_FX_VERSION) {
+				return 1;
+			}
+
+			if (GetNextToken<false>(block, token) != 2) {
+				return 1;
+			}
+		} else if (t == "USE_DYNAMIC") {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			if (GetNextToken<false>(block, token) != 2) {
+				return 1;
+			}
+
+			desc.flags |= EffectFlags::UseDynamic;
+		} else if (t == "SORT_NAME") {
+			if (processed[2]) {
+				return 1;
+			}
+			processed[2] = true;
+
+			std::string_view sortName;
+			if (GetNextString(block, sortName)) {
+				return 1;
+			}
+
+			if (noCompile) {
+				desc.sortName = sortName;
+			}
+		} else {
+			return 1;
+		}
+	}
+
+	// HEADER 块不含代码部分
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	if (!processed[0]) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t ResolveParameter(std::string_view block, EffectDesc& desc) {
+	// 必需的选项: DEFAULT, MIN, MAX, STEP
+	// 可选的选项: LABEL
+
+	std::bitset<5> processed;
+
+	std::string_view token;
+
+	if (!CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	if (!CheckNextToken<false>(block, "PARAMETER")) {
+		return 1;
+	}
+	if (GetNextToken<false>(block, token) != 2) {
+		return 1;
+	}
+
+	EffectParameterDesc& paramDesc = desc.params.emplace_back();
+
+	std::string_view defaultValue;
+	std::string_view minValue;
+	std::string_view maxValue;
+	std::string_view stepValue;
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+
+		std::string t = StrUtils::ToUpperCase(token);
+
+		if (t == "DEFAULT") {
+			if (processed[0]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			if (GetNextString(block, defaultValue)) {
+				return 1;
+			}
+		} else if (t == "LABEL") {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			std::string_view label;
+			if (GetNextString(block, label)) {
+				return 1;
+			}
+			paramDesc.label = label;
+		} else if (t == "MIN") {
+			if (processed[2]) {
+				return 1;
+			}
+			processed[2] = true;
+
+			if (GetNextString(block, minValue)) {
+				return 1;
+			}
+		} else if (t == "MAX") {
+			if (processed[3]) {
+				return 1;
+			}
+			processed[3] = true;
+
+			if (GetNextString(block, maxValue)) {
+				return 1;
+			}
+		} else if (t == "STEP") {
+			if (processed[4]) {
+				return 1;
+			}
+			processed[4] = true;
+
+			if (GetNextString(block, stepValue)) {
+				return 1;
+			}
+		} else {
+			return 1;
+		}
+	}
+
+	// 检查必选项
+	if (!processed[0] || !processed[2] || !processed[3] || !processed[4]) {
+		return 1;
+	}
+
+	// 代码部分
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+
+	if (token == "float") {
+		EffectConstant<float>& constant = paramDesc.constant.emplace<0>();
+
+		if (GetNextNumber(defaultValue, constant.defaultValue)) {
+			return 1;
+		}
+		if (GetNextNumber(minValue, constant.minValue)) {
+			return 1;
+		}
+		if (GetNextNumber(maxValue, constant.maxValue)) {
+			return 1;
+		}
+		if (GetNextNumber(stepValue, constant.step)) {
+			return 1;
+		}
+
+		if (constant.defaultValue < constant.minValue || constant.maxValue < constant.defaultValue) {
+			return 1;
+		}
+	} else if (token == "int") {
+		EffectConstant<int>& constant = paramDesc.constant.emplace<1>();
+
+		if (GetNextNumber(defaultValue, constant.defaultValue)) {
+			return 1;
+		}
+		if (GetNextNumber(minValue, constant.minValue)) {
+			return 1;
+		}
+		if (GetNextNumber(maxValue, constant.maxValue)) {
+			return 1;
+		}
+		if (GetNextNumber(stepValue, constant.step)) {
+			return 1;
+		}
+
+		if (constant.defaultValue < constant.minValue || constant.maxValue < constant.defaultValue) {
+			return 1;
+		}
+	} else {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+	paramDesc.name = token;
+
+	if (!CheckNextToken<true>(block, ";")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static uint32_t ResolveTexture(std::string_view block, EffectDesc& desc) {
+	// 如果名称为 INPUT 不能有任何选项，含 SOURCE 时不能有任何其他选项
+	// 如果名称为 OUTPUT 只能有 WIDTH 或 HEIGHT
+	// 否则必需的选项: FORMAT
+	// 可选的选项: WIDTH, HEIGHT
+
+	EffectIntermediateTextureDesc& texDesc = desc.textures.emplace_back();
+
+	std::bitset<4> processed;
+
+	std::string_view token;
+
+	if (!CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	if (!CheckNextToken<false>(block, "TEXTURE")) {
+		return 1;
+	}
+	if (GetNextToken<false>(block, token) != 2) {
+		return 1;
+	}
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+
+		std::string t = StrUtils::ToUpperCase(token);
+
+		if (t == "SOURCE") {
+			if (processed[0] || processed[2] || processed[3]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			if (GetNextString(block, token)) {
+				return 1;
+			}
+
+			texDesc.source = token;
+		} else if (t == "FORMAT") {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			if (GetNextString(block, token)) {
+				return 1;
+			}
+
+			using enum EffectIntermediateTextureFormat;
+
+			static auto formatMap = []() {
+				std::unordered_map<std::string, EffectIntermediateTextureFormat> result;
+
+				// UNKNOWN 不可用
+				constexpr size_t descCount = std::size(EffectHelper::FORMAT_DESCS) - 1;
+				result.reserve(descCount);
+				for (size_t i = 0; i < descCount; ++i) {
+					result.emplace(EffectHelper::FORMAT_DESCS[i].name, (EffectIntermediateTextureFormat)i);
+				}
+				return result;
+			}();
+
+			auto it = formatMap.find(std::string(token));
+			if (it == formatMap.end()) {
+				return 1;
+			}
+
+			texDesc.format = it->second;
+		} else if (t == "WIDTH") {
+			if (processed[0] || processed[2]) {
+				return 1;
+			}
+			processed[2] = true;
+
+			if (GetNextExpr(block, texDesc.sizeExpr.first)) {
+				return 1;
+			}
+		} else if (t == "HEIGHT") {
+			if (processed[0] || processed[3]) {
+				return 1;
+			}
+			processed[3] = true;
+
+			if (GetNextExpr(block, texDesc.sizeExpr.second)) {
+				return 1;
+			}
+		} else {
+			return 1;
+		}
+	}
+
+	// WIDTH 和 HEIGHT 必须成对出现
+	if (processed[2] != processed[3]) {
+		return 1;
+	}
+
+	// 代码部分
+	if (!CheckNextToken<true>(block, "Texture2D")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+
+	if (token == desc.textures[0].name) {
+		if (processed.any()) {
+			return 1;
+		}
+
+		// INPUT 已为第一个元素
+		desc.textures.pop_back();
+	} else if (token == desc.textures[1].name) {
+		if (processed[0] || processed[1]) {
+			return 1;
+		}
+
+		// OUTPUT 已为第二个元素
+		desc.textures[1].sizeExpr = std::move(texDesc.sizeExpr);
+		desc.textures.pop_back();
+	} else {
+		texDesc.name = token;
+	}
+
+	if (!CheckNextToken<true>(block, ";")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t ResolveSampler(std::string_view block, EffectDesc& desc) {
+	// 必选项: FILTER
+	// 可选项: ADDRESS
+
+	EffectSamplerDesc& samDesc = desc.samplers.emplace_back();
+
+	std::bitset<2> processed;
+
+	std::string_view token;
+
+	if (!CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	if (!CheckNextToken<false>(block, "SAMPLER")) {
+		return 1;
+	}
+	if (GetNextToken<false>(block, token) != 2) {
+		return 1;
+	}
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+
+		std::string t = StrUtils::ToUpperCase(token);
+
+		if (t == "FILTER") {
+			if (processed[0]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			if (GetNextString(block, token)) {
+				return 1;
+			}
+
+			std::string filter = StrUtils::ToUpperCase(token);
+
+			if (filter == "LINEAR") {
+				samDesc.filterType = EffectSamplerFilterType::Linear;
+			} else if (filter == "POINT") {
+				samDesc.filterType = EffectSamplerFilterType::Point;
+			} else {
+				return 1;
+			}
+		} else if (t == "ADDRESS") {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			if (GetNextString(block, token)) {
+				return 1;
+			}
+
+			std::string filter = StrUtils::ToUpperCase(token);
+
+			if (filter == "CLAMP") {
+				samDesc.addressType = EffectSamplerAddressType::Clamp;
+			} else if (filter == "WRAP") {
+				samDesc.addressType = EffectSamplerAddressType::Wrap;
+			} else {
+				return 1;
+			}
+		} else {
+			return 1;
+		}
+	}
+
+	if (!processed[0]) {
+		return 1;
+	}
+
+	// 代码部分
+	if (!CheckNextToken<true>(block, "SamplerState")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+
+	samDesc.name = token;
+
+	if (!CheckNextToken<true>(block, ";")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t ResolveCommon(std::string_view& block) {
+	// 无选项
+
+	if (!CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	if (!CheckNextToken<false>(block, "COMMON")) {
+		return 1;
+	}
+
+	if (CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t ResolvePasses(
+	SmallVector<std::string_view>& blocks,
+	EffectDesc& desc
+) {
+	// 必选项: IN, OUT
+	// 可选项: BLOCK_SIZE, NUM_THREADS, STYLE, DESC, FOOTPRINT
+	// STYLE 为 PS 时不能有 BLOCK_SIZE 或 NUM_THREADS
+
+	std::string_view token;
+
+	// 首先解析通道序号
+
+	// first 为 Pass 序号，second 为在 blocks 中的位置
+	SmallVector<std::pair<uint32_t, uint32_t>> passNumbers;
+	passNumbers.reserve(blocks.size());
+
+	for (uint32_t i = 0; i < blocks.size(); ++i) {
+		std::string_view& block = blocks[i];
+
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			return 1;
+		}
+
+		if (!CheckNextToken<false>(block, "PASS")) {
+			return 1;
+		}
+
+		uint32_t index;
+		if (GetNextNumber(block, index)) {
+			return 1;
+		}
+		if (GetNextToken<false>(block, token) != 2) {
+			return 1;
+		}
+
+		passNumbers.emplace_back(index, i);
+	}
+
+	// 以通道序号排序
+	std::sort(
+		passNumbers.begin(),
+		passNumbers.end(),
+		[](const auto& l, const auto& r) { return l.first < r.first; }
+	);
+
+	{
+		SmallVector<std::string_view> temp = blocks;
+		for (uint32_t i = 0; i < blocks.size(); ++i) {
+			if (passNumbers[i].first != i + 1) {
+				// PASS 序号不连续
+				return 1;
+			}
+
+			blocks[i] = temp[passNumbers[i].second];
+		}
+	}
+
+	desc.passes.resize(blocks.size());
+
+	for (uint32_t i = 0; i < blocks.size(); ++i) {
+		std::string_view& block = blocks[i];
+		auto& passDesc = desc.passes[i];
+
+		// 用于检查输入和输出中重复的纹理
+		std::unordered_map<std::string_view, uint32_t> texNames;
+		texNames.reserve(desc.textures.size());
+		for (uint32_t j = 0; j < desc.textures.size(); ++j) {
+			texNames.emplace(desc.textures[j].name, j);
+		}
+
+		std::bitset<7> processed;
+
+		while (true) {
+			if (!CheckNextToken<true>(block, META_INDICATOR)) {
+				break;
+			}
+
+			if (GetNextToken<false>(block, token)) {
+				return 1;
+			}
+
+			std::string t = StrUtils::ToUpperCase(token);
+
+			if (t == "IN") {
+				if (processed[0]) {
+					return 1;
+				}
+				processed[0] = true;
+
+				std::string_view inputsStr;
+				if (GetNextString(block, inputsStr)) {
+					return 1;
+				}
+
+				for (std::string_view& input : StrUtils::Split(inputsStr, ',')) {
+					StrUtils::Trim(input);
+
+					auto it = texNames.find(input);
+					if (it == texNames.end() || it->second == 1) {
+						// 不支持 OUTPUT 作为输入
+						return 1;
+					}
+
+					passDesc.inputs.push_back(it->second);
+					texNames.erase(it);
+				}
+			} else if (t == "OUT") {
+				if (processed[1]) {
+					return 1;
+				}
+				processed[1] = true;
+
+				std::string_view outputsStr;
+				if (GetNextString(block, outputsStr)) {
+					return 1;
+				}
+
+				if (i == blocks.size() - 1) {
+					// 最后一个通道的输出只能是 OUTPUT
+					if (outputsStr != desc.textures[1].name) {
+						return 1;
+					}
+
+					passDesc.outputs.push_back(1);
+				} else {
+					SmallVector<std::string_view> outputs = StrUtils::Split(outputsStr, ',');
+					if (outputs.size() > 8) {
+						// 最多 8 个输出
+						return 1;
+					}
+
+					for (std::string_view& output : outputs) {
+						StrUtils::Trim(output);
+
+						auto it = texNames.find(output);
+						if (it == texNames.end()) {
+							// 未找到纹理名称
+							return 1;
+						}
+
+						if (it->second == 0 || !desc.textures[it->second].source.empty()) {
+							// INPUT 和从文件读取的纹理不能作为输出
+							return 1;
+						}
+
+						passDesc.outputs.push_back(it->second);
+						texNames.erase(it);
+					}
+				}
+			} else if (t == "BLOCK_SIZE") {
+				if (processed[2]) {
+					return 1;
+				}
+				processed[2] = true;
+
+				std::string_view val;
+				if (GetNextString(block, val)) {
+					return 1;
+				}
+
+				SmallVector<std::string_view> split = StrUtils::Split(val, ',');
+				if (split.size() > 2) {
+					return 1;
+				}
+
+				uint32_t num;
+				if (GetNextNumber(split[0], num) || num == 0) {
+					return 1;
+				}
+
+				if (GetNextToken<false>(split[0], token) != 2) {
+					return false;
+				}
+
+				passDesc.blockSize.first = num;
+
+				// 如果只有一个数字，则它同时指定长和高
+				if (split.size() == 2) {
+					if (GetNextNumber(split[1], num) || num == 0) {
+						return 1;
+					}
+
+					if (GetNextToken<false>(split[1], token) != 2) {
+						return false;
+					}
+				}
+
+				passDesc.blockSize.second = num;
+			} else if (t == "NUM_THREADS") {
+				if (processed[3]) {
+					return 1;
+				}
+				processed[3] = true;
+
+				std::string_view val;
+				if (GetNextString(block, val)) {
+					return 1;
+				}
+
+				SmallVector<std::string_view> split = StrUtils::Split(val, ',');
+				if (split.size() > 3) {
+					return 1;
+				}
+
+				for (uint32_t j = 0; j < 3; ++j) {
+					uint32_t num = 1;
+					if (split.size() > j) {
+						if (GetNextNumber(split[j], num)) {
+							return 1;
+						}
+
+						if (GetNextToken<false>(split[j], token) != 2) {
+							return false;
+						}
+					}
+
+					passDesc.numThreads[j] = num;
+				}
+			} else if (t == "STYLE") {
+				if (processed[4]) {
+					return 1;
+				}
+				processed[4] = true;
+
+				std::string_view val;
+				if (GetNextString(block, val)) {
+					return 1;
+				}
+
+				if (val == "PS") {
+					passDesc.isPSStyle = true;
+					passDesc.blockSize.first = 16;
+					passDesc.blockSize.second = 16;
+					passDesc.numThreads = { 64,1,1 };
+				} else if (val != "CS") {
+					return 1;
+				}
+			} else if (t == "DESC") {
+				if (processed[5]) {
+					return 1;
+				}
+				processed[5] = true;
+
+				std::string_view val;
+				if (GetNextString(block, val)) {
+					return 1;
+				}
+
+				StrUtils::Trim(val);
+				passDesc.desc = val;
+			} else if (t == "FOOTPRINT") {
+				if (processed[6]) {
+					return 1;
+				}
+				processed[6] = true;
+
+				std::string_view val;
+				if (GetNextString(block, val)) {
+					return 1;
+				}
+
+				SmallVector<std::string_view> split = StrUtils::Split(val, ',');
+				if (split.size() > 2) {
+					return 1;
+				}
+
+				uint32_t nums[2]{};
+				for (uint32_t j = 0; j < split.size(); ++j) {
+					if (GetNextNumber(split[j], nums[j])) {
+						return 1;
+					}
+
+					if (GetNextToken<false>(split[j], token) != 2) {
+						return 1;
+					}
+				}
+
+				// 和 BLOCK_SIZE 相同，只有一个数字时同时指定水平和竖直方向
+				passDesc.footprint.first = nums[0];
+				passDesc.footprint.second = split.size() == 2 ? nums[1] : nums[0];
+
+				passDesc.hasFootprint = true;
+			} else {
+				return 1;
+			}
+		}
+
+		// 必须指定 IN 和 OUT
+		if (!processed[0] || !processed[1]) {
+			return 1;
+		}
+
+		if (passDesc.isPSStyle) {
+			if (processed[2] || processed[3]) {
+				return 1;
+			}
+		} else {
+			if (!processed[2] || !processed[3]) {
+				return 1;
+			}
+		}
+
+		if (passDesc.desc.empty()) {
+			passDesc.desc = fmt::format("Pass {}", i + 1);
+		}
+	}
+
+	return 0;
+}
+
+uint32_t EffectParser::SplitBlocks(std::string_view source, EffectBlocks& blocks) noexcept {
+	const char* const begin = source.data();
+
+	// 检查头
+	if (!CheckMagic(source)) {
+		return 2;
+	}
+
+	enum class BlockType {
+		Header,
+		Parameter,
+		Texture,
+		Sampler,
+		Common,
+		Pass
+	};
+
+	BlockType curBlockType = BlockType::Header;
+	size_t curBlockOff = 0;
+
+	auto completeCurrentBlock = [&](size_t len, BlockType newBlockType) {
+		switch (curBlockType) {
+		case BlockType::Header:
+			blocks.header = source.substr(curBlockOff, len);
+			break;
+		case BlockType::Parameter:
+			blocks.params.push_back(source.substr(curBlockOff, len));
+			break;
+		case BlockType::Texture:
+			blocks.textures.push_back(source.substr(curBlockOff, len));
+			break;
+		case BlockType::Sampler:
+			blocks.samplers.push_back(source.substr(curBlockOff, len));
+			break;
+		case BlockType::Common:
+			blocks.commons.push_back(source.substr(curBlockOff, len));
+			break;
+		case BlockType::Pass:
+			blocks.passes.push_back(source.substr(curBlockOff, len));
+			break;
+		default:
+			assert(false);
+			break;
+		}
+
+		curBlockType = newBlockType;
+		curBlockOff += len;
+	};
+
+	// 只需检查 RemoveComments 记录的 //! 行，无需再次扫描整个源码
+	const size_t magicLen = source.data() - begin;
+	for (uint32_t metaLine : blocks.metaLines) {
+		if (metaLine < magicLen) {
+			// MagpieFX 头
+			continue;
+		}
+
+		const size_t offset = metaLine - magicLen;
+		std::string_view t = source.substr(offset + 3);
+		std::string_view token;
+		if (GetNextToken<false>(t, token)) {
+			return 1;
+		}
+
+		BlockType blockType;
+		std::string blockTypeName = StrUtils::ToUpperCase(token);
+		if (blockTypeName == "PARAMETER") {
+			blockType = BlockType::Parameter;
+		} else if (blockTypeName == "TEXTURE") {
+			blockType = BlockType::Texture;
+		} else if (blockTypeName == "SAMPLER") {
+			blockType = BlockType::Sampler;
+		} else if (blockTypeName == "COMMON") {
+			blockType = BlockType::Common;
+		} else if (blockTypeName == "PASS") {
+			blockType = BlockType::Pass;
+		} else {
+			continue;
+		}
+
+		// 新块从上一个非空行之后开始
+		size_t blockOff = offset;
+		while (blockOff > curBlockOff && StrUtils::isspace(source[blockOff - 1])) {
+			--blockOff;
+		}
+		blockOff = source.find('\n', blockOff) + 1;
+
+		completeCurrentBlock(blockOff - curBlockOff, blockType);
+	}
+
+	completeCurrentBlock(source.size() - curBlockOff, BlockType::Header);
+	return 0;
+}
+
+uint32_t EffectParser::ResolveBlocks(
+	EffectBlocks& blocks,
+	EffectDesc& desc,
+	bool noCompile,
+	std::string& errorMsg
+) noexcept {
+	// 必须有 PASS 块
+	if (!noCompile && blocks.passes.empty()) {
+		errorMsg = "无 PASS 块";
+		return 1;
+	}
+
+	if (ResolveHeader(blocks.header, desc, noCompile)) {
+		errorMsg = "解析 Header 块失败";
+		return 1;
+	}
+
+	desc.params.clear();
+	for (size_t i = 0; i < blocks.params.size(); ++i) {
+		if (ResolveParameter(blocks.params[i], desc)) {
+			errorMsg = fmt::format("解析 Parameter#{} 块失败", i + 1);
+			return 1;
+		}
+	}
+
+	desc.textures.clear();
+	// 第一个元素为 INPUT
+	{
+		auto& inputDesc = desc.textures.emplace_back();
+		inputDesc.name = "INPUT";
+		inputDesc.format = EffectIntermediateTextureFormat::R8G8B8A8_UNORM;
+		inputDesc.sizeExpr.first = "INPUT_WIDTH";
+		inputDesc.sizeExpr.second = "INPUT_HEIGHT";
+	}
+	// 第二个元素为 OUTPUT
+	{
+		auto& outputDesc = desc.textures.emplace_back();
+		outputDesc.name = "OUTPUT";
+		outputDesc.format = EffectIntermediateTextureFormat::R8G8B8A8_UNORM;
+	}
+
+	for (size_t i = 0; i < blocks.textures.size(); ++i) {
+		if (ResolveTexture(blocks.textures[i], desc)) {
+			errorMsg = fmt::format("解析 Texture#{} 块失败", i + 1);
+			return 1;
+		}
+	}
+
+	if (!noCompile) {
+		desc.samplers.clear();
+		for (size_t i = 0; i < blocks.samplers.size(); ++i) {
+			if (ResolveSampler(blocks.samplers[i], desc)) {
+				errorMsg = fmt::format("解析 Sampler#{} 块失败", i + 1);
+				return 1;
+			}
+		}
+
+		// Wrap 采样器无法限制在 INPUT 的区域内，只能复制捕获的纹理
+		if ((desc.flags & EffectFlags::CroppedInput) && std::any_of(desc.samplers.begin(), desc.samplers.end(),
+			[](const EffectSamplerDesc& d) { return d.addressType == EffectSamplerAddressType::Wrap; })) {
+			desc.flags &= ~EffectFlags::CroppedInput;
+		}
+	}
+
+	{
+		// 确保没有重复的名字
+		std::unordered_set<std::string_view> names;
+		for (const auto& d : desc.params) {
+			if (!names.insert(d.name).second) {
+				errorMsg = "标识符重复";
+				return 1;
+			}
+		}
+		for (const auto& d : desc.textures) {
+			if (!names.insert(d.name).second) {
+				errorMsg = "标识符重复";
+				return 1;
+			}
+		}
+		for (const auto& d : desc.samplers) {
+			if (!names.insert(d.name).second) {
+				errorMsg = "标识符重复";
+				return 1;
+			}
+		}
+	}
+
+	if (!noCompile) {
+		for (size_t i = 0; i < blocks.commons.size(); ++i) {
+			if (ResolveCommon(blocks.commons[i])) {
+				errorMsg = fmt::format("解析 Common#{} 块失败", i + 1);
+				return 1;
+			}
+		}
+
+		desc.passes.clear();
+		if (ResolvePasses(blocks.passes, desc)) {
+			errorMsg = "解析 Pass 块失败";
+			return 1;
+		}
+
+		if (EffectFusion::IsPixelwise(desc, blocks)) {
+			desc.flags |= EffectFlags::Pixelwise;
+		}
+	}
+
+	return 0;
+}
+
+// INPUT 为 __INPUT 中从 __inputOffset 开始、尺寸为 __inputSize 的区域，见 EffectFlags::CroppedInput。
+// 以结构体模拟效果中用到的 Texture2D 的方法，读取限制在区域内，结果和单独的纹理相同
+static const char* CROPPED_INPUT_HLSL = R"(float2 __CroppedInputPos(float2 pos) {
+	// 限制在边缘像素的中心之间，此时线性采样的结果和 Clamp 寻址相同
+	return (clamp(pos * float2(__inputSize), 0.5f, float2(__inputSize) - 0.5f) + float2(__inputOffset)) * __inputTexturePt;
+}
+
+float4 __CroppedInputLoad(int2 pos, int mip) {
+	// 越界时返回 0
+	if (any(uint2(pos) >= __inputSize)) {
+		return 0;
+	}
+	return __INPUT.Load(int3(pos + int2(__inputOffset), mip));
+}
+
+float4 __CroppedInputGather(SamplerState s, float2 pos, uint component) {
+	const int2 base = int2(floor(pos * float2(__inputSize) - 0.5f));
+	const int2 maxPos = int2(__inputSize) - 1;
+
+	// 四个像素都在区域内时直接使用 Gather
+	if (all(base >= 0) && all(base < maxPos)) {
+		const float2 texturePos = (pos * float2(__inputSize) + float2(__inputOffset)) * __inputTexturePt;
+		if (component == 0) {
+			return __INPUT.GatherRed(s, texturePos);
+		} else if (component == 1) {
+			return __INPUT.GatherGreen(s, texturePos);
+		} else if (component == 2) {
+			return __INPUT.GatherBlue(s, texturePos);
+		} else {
+			return __INPUT.GatherAlpha(s, texturePos);
+		}
+	}
+
+	// 在边缘逐个读取，和 Clamp 寻址相同
+	const int2 p0 = clamp(base, 0, maxPos) + int2(__inputOffset);
+	const int2 p1 = clamp(base + 1, 0, maxPos) + int2(__inputOffset);
+	const float4 x = __INPUT.Load(int3(p0.x, p1.y, 0));
+	const float4 y = __INPUT.Load(int3(p1.x, p1.y, 0));
+	const float4 z = __INPUT.Load(int3(p1.x, p0.y, 0));
+	const float4 w = __INPUT.Load(int3(p0.x, p0.y, 0));
+	return float4(x[component], y[component], z[component], w[component]);
+}
+
+struct __CroppedInput {
+	uint __unused;
+
+	float4 SampleLevel(SamplerState s, float2 pos, float lod) {
+		return __INPUT.SampleLevel(s, __CroppedInputPos(pos), lod);
+	}
+	float4 SampleLevel(SamplerState s, float2 pos, float lod, int2 offset) {
+		return __INPUT.SampleLevel(s, __CroppedInputPos(pos + offset * __inputPt), lod);
+	}
+
+	float4 Load(int3 location) {
+		return __CroppedInputLoad(location.xy, location.z);
+	}
+	float4 Load(int3 location, int2 offset) {
+		return __CroppedInputLoad(location.xy + offset, location.z);
+	}
+
+	float4 Gather(SamplerState s, float2 pos) { return __CroppedInputGather(s, pos, 0); }
+	float4 GatherRed(SamplerState s, float2 pos) { return __CroppedInputGather(s, pos, 0); }
+	float4 GatherGreen(SamplerState s, float2 pos) { return __CroppedInputGather(s, pos, 1); }
+	float4 GatherBlue(SamplerState s, float2 pos) { return __CroppedInputGather(s, pos, 2); }
+	float4 GatherAlpha(SamplerState s, float2 pos) { return __CroppedInputGather(s, pos, 3); }
+	float4 Gather(SamplerState s, float2 pos, int2 offset) { return __CroppedInputGather(s, pos + offset * __inputPt, 0); }
+	float4 GatherRed(SamplerState s, float2 pos, int2 offset) { return __CroppedInputGather(s, pos + offset * __inputPt, 0); }
+	float4 GatherGreen(SamplerState s, float2 pos, int2 offset) { return __CroppedInputGather(s, pos + offset * __inputPt, 1); }
+	float4 GatherBlue(SamplerState s, float2 pos, int2 offset) { return __CroppedInputGather(s, pos + offset * __inputPt, 2); }
+	float4 GatherAlpha(SamplerState s, float2 pos, int2 offset) { return __CroppedInputGather(s, pos + offset * __inputPt, 3); }
+
+	void GetDimensions(out uint width, out uint height) {
+		width = __inputSize.x;
+		height = __inputSize.y;
+	}
+};
+
+static __CroppedInput INPUT = (__CroppedInput)0;
+
+)";
+
+std::string EffectParser::GenerateConstantBuffer(const EffectDesc& desc) noexcept {
+	std::string cbHlsl = R"(cbuffer __CB1 : register(b0) {
+	uint2 __inputSize;
+	uint2 __outputSize;
+	float2 __inputPt;
+	float2 __outputPt;
+	float2 __scale;
+)";
+
+	// INPUT 在捕获的纹理中的起点和捕获的纹理的像素尺寸
+	if (desc.flags & EffectFlags::CroppedInput) {
+		cbHlsl.append("\tuint2 __inputOffset;\n\tfloat2 __inputTexturePt;\n");
+	}
+
+	// PS 样式需要获知输出纹理的尺寸
+	// 最后一个通道不需要
+	for (uint32_t i = 0, end = (uint32_t)desc.passes.size() - 1; i < end; ++i) {
+		if (desc.passes[i].isPSStyle) {
+			cbHlsl.append(fmt::format("\tuint2 __pass{0}OutputSize;\n\tfloat2 __pass{0}OutputPt;\n", i + 1));
+		}
+	}
+
+	if (!(desc.flags & EffectFlags::InlineParams)) {
+		for (const auto& d : desc.params) {
+			cbHlsl.append("\t")
+				.append(d.constant.index() == 0 ? "float " : "int ")
+				.append(d.name)
+				.append(";\n");
+		}
+	}
+
+	cbHlsl.append("};\n");
+
+	if (desc.flags & EffectFlags::UseDynamic) {
+		cbHlsl.append("cbuffer __CB2 : register(b1) { uint __frameCount; };\n\n");
+	}
+
+	return cbHlsl;
+}
+
+uint32_t EffectParser::GeneratePassSource(
+	const EffectDesc& desc,
+	uint32_t passIdx,
+	std::string_view cbHlsl,
+	const SmallVector<std::string_view>& commonBlocks,
+	std::string_view passBlock,
+	const std::unordered_map<std::string, float>* inlineParams,
+	std::string& result,
+	std::vector<std::pair<std::string, std::string>>& macros
+) noexcept {
+	bool isInlineParams = desc.flags & EffectFlags::InlineParams;
+
+	const EffectPassDesc& passDesc = desc.passes[(size_t)passIdx - 1];
+
+	{
+		// 估算需要的空间
+		size_t reservedSize = 2048 + cbHlsl.size() + passBlock.size();
+		for (std::string_view commonBlock : commonBlocks) {
+			reservedSize += commonBlock.size();
+		}
+
+		result.reserve(reservedSize);
+	}
+
+	// 常量缓冲区
+	result.append(cbHlsl);
+
+	// 只渲染变化的区域时每次调度一个矩形，__tileOffset 为它左上角的块
+	const std::string_view groupId = passDesc.hasFootprint ? "(gid.xy + __tileOffset)" : "gid.xy";
+	if (passDesc.hasFootprint) {
+		result.append("cbuffer __CB3 : register(b2) { uint2 __tileOffset; };\n\n");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//
+	// SRV、UAV 和采样器
+	// 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// SRV
+	bool isInputCropped = false;
+	for (int i = 0; i < passDesc.inputs.size(); ++i) {
+		auto& texDesc = desc.textures[passDesc.inputs[i]];
+		// 裁剪的 INPUT 通过下面的 __CroppedInput 访问
+		const bool isCropped = passDesc.inputs[i] == 0 && (desc.flags & EffectFlags::CroppedInput);
+		isInputCropped |= isCropped;
+		result.append(fmt::format("Texture2D<{}> {}{} : register(t{});\n", EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].srvTexelType, isCropped ? "__" : "", texDesc.name, i));
+	}
+
+	// UAV
+	for (int i = 0; i < passDesc.outputs.size(); ++i) {
+		auto& texDesc = desc.textures[passDesc.outputs[i]];
+		result.append(fmt::format("RWTexture2D<{}> {} : register(u{});\n", EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].uavTexelType, texDesc.name, i));
+	}
+
+
+	if (!desc.samplers.empty()) {
+		// 采样器
+		for (int i = 0; i < desc.samplers.size(); ++i) {
+			result.append(fmt::format("SamplerState {} : register(s{});\n", desc.samplers[i].name, i));
+		}
+	}
+
+	result.push_back('\n');
+
+	if (isInputCropped) {
+		result.append(CROPPED_INPUT_HLSL);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//
+	// 内置宏
+	// 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	macros.reserve(64);
+	macros.emplace_back("MP_BLOCK_WIDTH", std::to_string(passDesc.blockSize.first));
+	macros.emplace_back("MP_BLOCK_HEIGHT", std::to_string(passDesc.blockSize.second));
+	macros.emplace_back("MP_NUM_THREADS_X", std::to_string(passDesc.numThreads[0]));
+	macros.emplace_back("MP_NUM_THREADS_Y", std::to_string(passDesc.numThreads[1]));
+	macros.emplace_back("MP_NUM_THREADS_Z", std::to_string(passDesc.numThreads[2]));
+
+	if (passDesc.isPSStyle) {
+		macros.emplace_back("MP_PS_STYLE", "");
+	}
+
+	if (isInlineParams) {
+		macros.emplace_back("MP_INLINE_PARAMS", "");
+	}
+
+#ifdef _DEBUG
+	macros.emplace_back("MP_DEBUG", "");
+#endif
+
+	// 用于在 FP32 和 FP16 间切换的宏
+	static const char* numbers[] = { "1","2","3","4" };
+	if (desc.flags & EffectFlags::FP16) {
+		macros.emplace_back("MP_FP16", "");
+		macros.emplace_back("MF", "min16float");
+
+		for (uint32_t i = 0; i < 4; ++i) {
+			macros.emplace_back(StrUtils::Concat("MF", numbers[i]), StrUtils::Concat("min16float", numbers[i]));
+
+			for (uint32_t j = 0; j < 4; ++j) {
+				macros.emplace_back(StrUtils::Concat("MF", numbers[i], "x", numbers[j]), StrUtils::Concat("min16float", numbers[i], "x", numbers[j]));
+			}
+		}
+	} else {
+		macros.emplace_back("MF", "float");
+
+		for (uint32_t i = 0; i < 4; ++i) {
+			macros.emplace_back(StrUtils::Concat("MF", numbers[i]), StrUtils::Concat("float", numbers[i]));
+
+			for (uint32_t j = 0; j < 4; ++j) {
+				macros.emplace_back(StrUtils::Concat("MF", numbers[i], "x", numbers[j]), StrUtils::Concat("float", numbers[i], "x", numbers[j]));
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//
+	// 内联常量
+	// 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	if (isInlineParams && inlineParams) {
+		for (const auto& d : desc.params) {
+			auto it = inlineParams->find(d.name);
+			if (it == inlineParams->end()) {
+				if (d.constant.index() == 0) {
+					macros.emplace_back(d.name, std::to_string(std::get<0>(d.constant).defaultValue));
+				} else {
+					macros.emplace_back(d.name, std::to_string(std::get<1>(d.constant).defaultValue));
+				}
+			} else {
+				if (d.constant.index() == 0) {
+					macros.emplace_back(d.name, std::to_string(it->second));
+				} else {
+					macros.emplace_back(d.name, std::to_string((int)std::lround(it->second)));
+				}
+			}
+		}
+
+		for (const auto& pair : *inlineParams) {
+			auto it = std::find_if(desc.params.begin(), desc.params.end(),
+				[&](const EffectParameterDesc& d) { return d.name == pair.first; });
+			if (it == desc.params.end()) {
+				return 1;
+			}
+		}
+
+		result.push_back('\n');
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//
+	// 内置函数
+	// 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	result.append(R"(uint __Bfe(uint src, uint off, uint bits) { uint mask = (1u << bits) - 1; return (src >> off) & mask; }
+uint __BfiM(uint src, uint ins, uint bits) { uint mask = (1u << bits) - 1; return (ins & mask) | (src & (~mask)); }
+uint2 Rmp8x8(uint a) { return uint2(__Bfe(a, 1u, 3u), __BfiM(__Bfe(a, 3u, 3u), a, 1u)); }
+uint2 GetInputSize() { return __inputSize; }
+float2 GetInputPt() { return __inputPt; }
+uint2 GetOutputSize() { return __outputSize; }
+float2 GetOutputPt() { return __outputPt; }
+float2 GetScale() { return __scale; }
+)");
+
+	if (desc.flags & EffectFlags::UseDynamic) {
+		result.append(R"(uint GetFrameCount() { return __frameCount; }
+
+)");
+	} else {
+		result.push_back('\n');
+	}
+
+
+	for (std::string_view commonBlock : commonBlocks) {
+		result.append(commonBlock);
+		result.push_back('\n');
+	}
+
+	result.append(passBlock);
+	if (result.back() == '\n') {
+		result.push_back('\n');
+	} else {
+		result.append("\n\n");
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//
+	// 着色器入口
+	// 
+	////////////////////////////////////////////////////////////////////////////////////////////////////////
+	if (passDesc.isPSStyle) {
+		if (passDesc.outputs.size() <= 1) {
+			std::string outputSize;
+			std::string outputPt;
+			if (passIdx == desc.passes.size()) {
+				// 最后一个通道
+				outputSize = "__outputSize";
+				outputPt = "__outputPt";
+			} else {
+				outputSize = fmt::format("__pass{}OutputSize", passIdx);
+				outputPt = fmt::format("__pass{}OutputPt", passIdx);
+			}
+
+			result.append(fmt::format(R"([numthreads(64, 1, 1)]
+void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
+	uint2 gxy = ({4} << 4u) + Rmp8x8(tid.x);
+	if (gxy.x >= {1}.x || gxy.y >= {1}.y) {{
+		return;
+	}}
+	float2 pos = (gxy + 0.5f) * {2};
+	float2 step = 8 * {2};
+
+	{3}[gxy] = Pass{0}(pos);
+
+	gxy.x += 8u;
+	pos.x += step.x;
+	if (gxy.x < {1}.x && gxy.y < {1}.y) {{
+		{3}[gxy] = Pass{0}(pos);
+	}}
+	
+	gxy.y += 8u;
+	pos.y += step.y;
+	if (gxy.x < {1}.x && gxy.y < {1}.y) {{
+		{3}[gxy] = Pass{0}(pos);
+	}}
+	
+	gxy.x -= 8u;
+	pos.x -= step.x;
+	if (gxy.x < {1}.x && gxy.y < {1}.y) {{
+		{3}[gxy] = Pass{0}(pos);
+	}}
+}}
+)", passIdx, outputSize, outputPt, desc.textures[passDesc.outputs[0]].name, groupId));
+		} else {
+			// 多渲染目标
+			result.append(fmt::format(R"([numthreads(64, 1, 1)]
+void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
+	uint2 gxy = ({1} << 4u) + Rmp8x8(tid.x);
+	if (gxy.x >= __pass{0}OutputSize.x || gxy.y >= __pass{0}OutputSize.y) {{
+		return;
+	}}
+	float2 pos = (gxy + 0.5f) * __pass{0}OutputPt;
+	float2 step = 8 * __pass{0}OutputPt;
+)", passIdx, groupId));
+			for (int i = 0; i < passDesc.outputs.size(); ++i) {
+				auto& texDesc = desc.textures[passDesc.outputs[i]];
+				result.append(fmt::format("\t{} c{};\n",
+					EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].srvTexelType, i));
+			}
+
+			std::string callPass = fmt::format("\tPass{}(pos, ", passIdx);
+
+			for (int i = 0; i < passDesc.outputs.size() - 1; ++i) {
+				callPass.append(fmt::format("c{}, ", i));
+			}
+			callPass.append(fmt::format("c{});\n", passDesc.outputs.size() - 1));
+			for (int i = 0; i < passDesc.outputs.size(); ++i) {
+				callPass.append(fmt::format("\t\t\t{}[gxy] = c{};\n", desc.textures[passDesc.outputs[i]].name, i));
+			}
+
+			result.append(fmt::format(R"({0}
+	gxy.x += 8u;
+	pos.x += step.x;
+	if (gxy.x < __pass{1}OutputSize.x && gxy.y < __pass{1}OutputSize.y) {{
+		{0}
+	}}
+	
+	gxy.y += 8u;
+	pos.y += step.y;
+	if (gxy.x < __pass{1}OutputSize.x && gxy.y < __pass{1}OutputSize.y) {{
+		{0}
+	}}
+	
+	gxy.x -= 8u;
+	pos.x -= step.x;
+	if (gxy.x < __pass{1}OutputSize.x && gxy.y < __pass{1}OutputSize.y) {{
+		{0}
+	}}
+}}
+)", callPass, passIdx));
+		}
+	} else {
+		// 大部分情况下 BLOCK_SIZE 都是 2 的整数次幂，这时将乘法转换为位移
+		std::string blockStartExpr;
+		if (passDesc.blockSize.first == passDesc.blockSize.second && std::has_single_bit(passDesc.blockSize.first)) {
+			const int nShift = std::countr_zero(passDesc.blockSize.first);
+			blockStartExpr = fmt::format("({} << {})", groupId, nShift);
+		} else {
+			blockStartExpr = fmt::format("{} * uint2({}, {})", groupId, passDesc.blockSize.first, passDesc.blockSize.second);
+		}
+
+		result.append(fmt::format(R"([numthreads({}, {}, {})]
+void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
+	Pass{}({}, tid);
+}}
+)", passDesc.numThreads[0], passDesc.numThreads[1], passDesc.numThreads[2], passIdx, blockStartExpr));
+	}
+
+	return 0;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+struct EffectDesc;
+
+// 源码中的各个块，均指向删除注释后的源码
+struct EffectBlocks {
+	std::string_view header;
+	SmallVector<std::string_view> params;
+	SmallVector<std::string_view> textures;
+	SmallVector<std::string_view> samplers;
+	SmallVector<std::string_view> commons;
+	SmallVector<std::string_view> passes;
+
+	// RemoveComments 记录的位于行首的 //! 的位置，SplitBlocks 据此划分块
+	SmallVector<uint32_t> metaLines;
+};
+
+// MagpieFX 前端: 解析效果源码并生成每个通道的 HLSL
+struct EffectParser {
+	// 当前 MagpieFX 版本
+	static constexpr uint32_t MAGPIE_FX_VERSION = 4;
+
+	// 删除注释，保留 //! 开头的行，同时记录 //! 行的位置。只扫描源码一次
+	static uint32_t RemoveComments(std::string& source, EffectBlocks& blocks) noexcept;
+
+	// 检查 MagpieFX 头并根据 RemoveComments 记录的位置将源码划分为块。
+	// 返回 2 表示 MagpieFX 头不合法
+	static uint32_t SplitBlocks(std::string_view source, EffectBlocks& blocks) noexcept;
+
+	// 解析所有块并填充 desc，调用者需填入 desc 中的 name 和 flags。
+	// 解析后 blocks.commons 和 blocks.passes 只包含代码部分，passes 按通道序号排序。
+	// 失败时 errorMsg 为错误信息
+	static uint32_t ResolveBlocks(
+		EffectBlocks& blocks,
+		EffectDesc& desc,
+		bool noCompile,
+		std::string& errorMsg
+	) noexcept;
+
+	// 所有通道共用的常量缓冲区
+	static std::string GenerateConstantBuffer(const EffectDesc& desc) noexcept;
+
+	// passIdx 从 1 开始。inlineParams 的键为 UTF-8 编码的参数名
+	static uint32_t GeneratePassSource(
+		const EffectDesc& desc,
+		uint32_t passIdx,
+		std::string_view cbHlsl,
+		const SmallVector<std::string_view>& commonBlocks,
+		std::string_view passBlock,
+		const std::unordered_map<std::string, float>* inlineParams,
+		std::string& result,
+		std::vector<std::pair<std::string, std::string>>& macros
+	) noexcept;
+};
+
+}
@@ -5,86 +5,113 @@
 
 namespace Magpie::Core {
 
+// GPU 落后时最多等待取回的帧数
+static constexpr uint32_t QUERY_RING_DEPTH = 3;
+
 void EffectsProfiler::Start(ID3D11Device* d3dDevice, uint32_t passCount) {
-	assert(_passQueries.empty());
-	_passQueries.resize(passCount);
+	assert(_querySets.empty());
+	_querySets.resize(QUERY_RING_DEPTH);
+	_queryRing.Initialize(QUERY_RING_DEPTH);
+
+	for (_QuerySet& querySet : _querySets) {
+		D3D11_QUERY_DESC desc{ .Query = D3D11_QUERY_TIMESTAMP_DISJOINT };
+		d3dDevice->CreateQuery(&desc, querySet.disjointQuery.put());
 
-	D3D11_QUERY_DESC desc{ .Query = D3D11_QUERY_TIMESTAMP_DISJOINT };
-	d3dDevice->CreateQuery(&desc, _disjointQuery.put());
+		desc.Query = D3D11_QUERY_TIMESTAMP;
+		d3dDevice->CreateQuery(&desc, querySet.startQuery.put());
 
-	desc.Query = D3D11_QUERY_TIMESTAMP;
-	d3dDevice->CreateQuery(&desc, _startQuery.put());
-	for (winrt::com_ptr<ID3D11Query>& query : _passQueries) {
-		d3dDevice->CreateQuery(&desc, query.put());
+		querySet.passQueries.resize(passCount);
+		for (winrt::com_ptr<ID3D11Query>& query : querySet.passQueries) {
+			d3dDevice->CreateQuery(&desc, query.put());
+		}
 	}
 }
 
 void EffectsProfiler::Stop() {
-	_disjointQuery = nullptr;
-	_startQuery = nullptr;
-	_passQueries.clear();
+	_querySets.clear();
+	_queryRing.Reset();
+	_curQuerySet = nullptr;
 }
 
 void EffectsProfiler::OnBeginEffects(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+	if (_querySets.empty()) {
+		return;
+	}
+
+	const std::optional<uint32_t> slot = _queryRing.Submit(_frameIndex++);
+	_curQuerySet = slot ? &_querySets[*slot] : nullptr;
+	if (!_curQuerySet) {
 		return;
 	}
 
-	d3dDC->Begin(_disjointQuery.get());
-	d3dDC->End(_startQuery.get());
+	d3dDC->Begin(_curQuerySet->disjointQuery.get());
+	d3dDC->End(_curQuerySet->startQuery.get());
 
 	_curPass = 0;
 }
 
 void EffectsProfiler::OnEndPass(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+	if (!_curQuerySet) {
 		return;
 	}
 
-	d3dDC->End(_passQueries[_curPass++].get());
+	d3dDC->End(_curQuerySet->passQueries[_curPass++].get());
 }
 
 void EffectsProfiler::OnEndEffects(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+	if (!_curQuerySet) {
 		return;
 	}
 
-	d3dDC->End(_disjointQuery.get());
+	d3dDC->End(_curQuerySet->disjointQuery.get());
+	_curQuerySet = nullptr;
 }
 
 template<typename T>
-static T GetQueryData(ID3D11DeviceContext* d3dDC, ID3D11Query* query) noexcept {
-	T data{};
-	while (d3dDC->GetData(query, &data, sizeof(data), 0) != S_OK) {
-		Sleep(0);
-	}
-	return data;
+static bool TryGetQueryData(ID3D11DeviceContext* d3dDC, ID3D11Query* query, T& data) noexcept {
+	// 由渲染流程负责 Flush
+	return d3dDC->GetData(query, &data, sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
 }
 
 void EffectsProfiler::QueryTimings(ID3D11DeviceContext* d3dDC) noexcept {
-	if (_passQueries.empty()) {
+	if (_querySets.empty()) {
 		return;
 	}
 
-	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData =
-		GetQueryData<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>(d3dDC, _disjointQuery.get());
-
-	if (disjointData.Disjoint) {
-		return;
-	}
-
-	const float toMS = 1000.0f / disjointData.Frequency;
-
-	uint64_t prevTimestamp = GetQueryData<uint64_t>(d3dDC, _startQuery.get());
-
-	auto lock = _timingsLock.lock_exclusive();
-	_timings.resize(_passQueries.size());
-	for (size_t i = 0; i < _passQueries.size(); ++i) {
-		uint64_t timestamp = GetQueryData<uint64_t>(d3dDC, _passQueries[i].get());
-		_timings[i] = (timestamp - prevTimestamp) * toMS;
-
-		prevTimestamp = timestamp;
-	}
+	_queryRing.Poll([&](uint32_t slot, uint64_t) {
+		const _QuerySet& querySet = _querySets[slot];
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+		if (!TryGetQueryData(d3dDC, querySet.disjointQuery.get(), disjointData)) {
+			return false;
+		}
+
+		uint64_t prevTimestamp;
+		if (!TryGetQueryData(d3dDC, querySet.startQuery.get(), prevTimestamp)) {
+			return false;
+		}
+
+		SmallVector<uint64_t> timestamps(querySet.passQueries.size());
+		for (size_t i = 0; i < timestamps.size(); ++i) {
+			if (!TryGetQueryData(d3dDC, querySet.passQueries[i].get(), timestamps[i])) {
+				return false;
+			}
+		}
+
+		if (disjointData.Disjoint) {
+			return true;
+		}
+
+		const float toMS = 1000.0f / disjointData.Frequency;
+
+		auto lock = _timingsLock.lock_exclusive();
+		_timings.resize(timestamps.size());
+		for (size_t i = 0; i < timestamps.size(); ++i) {
+			_timings[i] = (timestamps[i] - prevTimestamp) * toMS;
+			prevTimestamp = timestamps[i];
+		}
+		return true;
+	});
 }
 
 SmallVector<float> EffectsProfiler::GetTimings() noexcept {
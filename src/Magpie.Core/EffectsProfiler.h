@@ -1,6 +1,7 @@
 #pragma once
 #include "SmallVector.h"
 #include "Win32Utils.h"
+#include "ReadbackRing.h"
 
 namespace Magpie::Core {
 
@@ -23,6 +24,7 @@ public:
 
 	void OnEndEffects(ID3D11DeviceContext* d3dDC);
 
+	// 取回已完成的帧的耗时，不等待 GPU，因此结果会延迟几帧
 	void QueryTimings(ID3D11DeviceContext* d3dDC) noexcept;
 
 	// 从前端线程调用
@@ -32,10 +34,18 @@ private:
 	SmallVector<float> _timings;
 	wil::srwlock _timingsLock;
 
-	winrt::com_ptr<ID3D11Query> _disjointQuery;
-	winrt::com_ptr<ID3D11Query> _startQuery;
-	std::vector<winrt::com_ptr<ID3D11Query>> _passQueries;
-
+	struct _QuerySet {
+		winrt::com_ptr<ID3D11Query> disjointQuery;
+		winrt::com_ptr<ID3D11Query> startQuery;
+		std::vector<winrt::com_ptr<ID3D11Query>> passQueries;
+	};
+	// 每帧使用一组查询
+	std::vector<_QuerySet> _querySets;
+	ReadbackRing _queryRing;
+	uint64_t _frameIndex = 0;
+
+	// 环已满时为空，这一帧不统计
+	_QuerySet* _curQuerySet = nullptr;
 	uint32_t _curPass = 0;
 };
 
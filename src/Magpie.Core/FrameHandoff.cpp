@@ -0,0 +1,32 @@
+// 不使用预编译头，以便在其他平台构建
+#include "FrameHandoff.h"
+
+namespace Magpie::Core {
+
+void FrameHandoff::Reset() noexcept {
+	_pending.store(1, std::memory_order_relaxed);
+	_backIdx = 0;
+	_frontIdx = 2;
+	_hasFrontBuffer = false;
+}
+
+bool FrameHandoff::Publish() noexcept {
+	// release 使写入对前端可见，acquire 确保前端已不再读取换回的缓冲区
+	const uint32_t old = _pending.exchange(_backIdx | NEW_FRAME_FLAG, std::memory_order_acq_rel);
+	_backIdx = old & INDEX_MASK;
+	return old & NEW_FRAME_FLAG;
+}
+
+bool FrameHandoff::Acquire() noexcept {
+	if (!HasNewFrame()) {
+		return false;
+	}
+
+	// 只有后端会设置 NEW_FRAME_FLAG，检查后它不会被清除
+	const uint32_t old = _pending.exchange(_frontIdx, std::memory_order_acq_rel);
+	_frontIdx = old & INDEX_MASK;
+	_hasFrontBuffer = true;
+	return true;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace Magpie::Core {
+
+// 后端和前端之间通过三个缓冲区交换共享纹理的索引，双方都不会等待对方
+class FrameHandoff {
+public:
+	static constexpr uint32_t BUFFER_COUNT = 3;
+
+	// 不能和其他方法同时调用
+	void Reset() noexcept;
+
+	// 后端: 可以写入的缓冲区，前端不会访问
+	uint32_t BackBufferIndex() const noexcept {
+		return _backIdx;
+	}
+
+	// 后端: 写入完成，发布为最新的帧并换得下一个可以写入的缓冲区。
+	// 返回 true 表示替换了前端尚未取走的帧
+	bool Publish() noexcept;
+
+	// 前端: 是否有尚未取走的新帧
+	bool HasNewFrame() const noexcept {
+		return _pending.load(std::memory_order_relaxed) & NEW_FRAME_FLAG;
+	}
+
+	// 前端: 取走最新完成的帧，返回 false 表示没有新帧，仍应使用上一次取得的帧
+	bool Acquire() noexcept;
+
+	// 前端: 上一次取得的帧
+	uint32_t FrontBufferIndex() const noexcept {
+		return _frontIdx;
+	}
+
+	// 前端: 是否已取得过帧，在此之前 FrontBufferIndex 中没有内容
+	bool HasFrontBuffer() const noexcept {
+		return _hasFrontBuffer;
+	}
+
+private:
+	static constexpr uint32_t INDEX_MASK = 0x3;
+	static constexpr uint32_t NEW_FRAME_FLAG = 0x4;
+
+	// 低两位为等待前端取走的缓冲区，NEW_FRAME_FLAG 表示其中是尚未取走的新帧
+	std::atomic<uint32_t> _pending = 1;
+	// 只由后端访问
+	uint32_t _backIdx = 0;
+	// 只由前端访问
+	uint32_t _frontIdx = 2;
+	bool _hasFrontBuffer = false;
+};
+
+}
@@ -0,0 +1,132 @@
+// 不使用预编译头，以便在其他平台构建
+#include "FramePacer.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace Magpie::Core {
+
+static void PushHistory(std::vector<int64_t>& history, uint64_t index, int64_t value) noexcept {
+	if (history.size() < FramePacer::HISTORY_SIZE) {
+		history.push_back(value);
+	} else {
+		history[index % FramePacer::HISTORY_SIZE] = value;
+	}
+}
+
+static int64_t Percentile(std::vector<int64_t> values, double p) noexcept {
+	if (values.empty()) {
+		return 0;
+	}
+
+	const size_t idx = std::min(values.size() - 1, (size_t)(p * values.size()));
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+void FramePacer::Initialize(Policy policy) noexcept {
+	_policy = policy;
+	_vblankTime = 0;
+	_refreshPeriod = 0;
+	_lastDisplayTime = INT64_MIN;
+	_lastLatency = 0;
+	_renderDurations.clear();
+	_latencies.clear();
+	_jitters.clear();
+	_frameCount = 0;
+	_missedCount = 0;
+	_supersededCount = 0;
+}
+
+void FramePacer::OnVBlank(int64_t vblankTime, int64_t refreshPeriod) noexcept {
+	_vblankTime = vblankTime;
+	_refreshPeriod = std::max(refreshPeriod, (int64_t)0);
+}
+
+int64_t FramePacer::VBlankAtOrAfter(int64_t time) const noexcept {
+	if (_refreshPeriod == 0) {
+		return time;
+	}
+
+	const int64_t delta = time - _vblankTime;
+	// 向上取整，delta 可能为负
+	int64_t count = delta / _refreshPeriod;
+	if (delta > count * _refreshPeriod) {
+		++count;
+	}
+	return _vblankTime + count * _refreshPeriod;
+}
+
+int64_t FramePacer::NextWakeTime(int64_t now) const noexcept {
+	if (_refreshPeriod == 0) {
+		return now;
+	}
+
+	const int64_t budget = _RenderBudget();
+	int64_t target = VBlankAtOrAfter(now + budget);
+	// 追求最低延迟时新帧可以替换尚未显示的帧，否则跳过上一帧已占用的垂直同步以免丢帧。
+	// 加半个周期以容忍垂直同步时间的微小漂移
+	if (_policy == Policy::Smoothest && _lastDisplayTime != INT64_MIN && target <= _lastDisplayTime) {
+		target = VBlankAtOrAfter(_lastDisplayTime + _refreshPeriod / 2);
+	}
+
+	return target - budget;
+}
+
+int64_t FramePacer::OnFrameRendered(int64_t captureTime, int64_t renderStart, int64_t renderEnd) noexcept {
+	int64_t displayTime = renderEnd + PRESENT_MARGIN;
+	if (_refreshPeriod > 0) {
+		// 按开始渲染时的预计用时应赶上的垂直同步
+		const int64_t plannedTime = VBlankAtOrAfter(renderStart + _RenderBudget());
+
+		displayTime = VBlankAtOrAfter(displayTime);
+		if (displayTime > plannedTime) {
+			++_missedCount;
+		}
+		if (displayTime <= _lastDisplayTime) {
+			// SyncInterval 为 0，同一个垂直同步只显示最新的帧
+			++_supersededCount;
+		}
+	}
+
+	const int64_t latency = displayTime - captureTime;
+	if (_frameCount > 0) {
+		PushHistory(_jitters, _frameCount - 1, std::abs(latency - _lastLatency));
+	}
+	PushHistory(_renderDurations, _frameCount, renderEnd - renderStart);
+	PushHistory(_latencies, _frameCount, latency);
+	++_frameCount;
+
+	_lastDisplayTime = displayTime;
+	_lastLatency = latency;
+	return displayTime;
+}
+
+FramePacer::Statistics FramePacer::GetStatistics() const noexcept {
+	return {
+		.latencyP50 = Percentile(_latencies, 0.5),
+		.latencyP95 = Percentile(_latencies, 0.95),
+		.latencyP99 = Percentile(_latencies, 0.99),
+		.jitterP50 = Percentile(_jitters, 0.5),
+		.jitterP99 = Percentile(_jitters, 0.99),
+		.frameCount = _frameCount,
+		.missedCount = _missedCount,
+		.supersededCount = _supersededCount
+	};
+}
+
+int64_t FramePacer::_RenderBudget() const noexcept {
+	if (_renderDurations.empty()) {
+		// 尚无统计时尽早开始
+		return _refreshPeriod;
+	}
+
+	if (_policy == Policy::LowestLatency) {
+		// 留出半毫秒应对定时器的唤醒延迟
+		return Percentile(_renderDurations, 0.9) + PRESENT_MARGIN + 500'000;
+	} else {
+		// 留出八分之一个周期应对系统调度的延迟
+		return Percentile(_renderDurations, 0.99) + PRESENT_MARGIN + _refreshPeriod / 8;
+	}
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 安排后端渲染使每帧恰好在下一个垂直同步前完成，并统计从捕获到显示的延迟
+class FramePacer {
+public:
+	enum class Policy {
+		// 按渲染用时的 p90 安排，延迟最低，但偶尔会错过垂直同步
+		LowestLatency,
+		// 按渲染用时的较高分位数并留出余量，较少错过垂直同步，延迟更稳定
+		Smoothest
+	};
+
+	// 前端把新帧复制到后缓冲并呈现的用时，显示时间据此估计
+	static constexpr int64_t PRESENT_MARGIN = 1'000'000;
+	// 统计最近多少帧
+	static constexpr uint32_t HISTORY_SIZE = 128;
+
+	void Initialize(Policy policy) noexcept;
+
+	// 更新最近一次垂直同步的时间和刷新间隔，调用者应定期更新以跟踪时钟漂移
+	void OnVBlank(int64_t vblankTime, int64_t refreshPeriod) noexcept;
+
+	bool HasVBlank() const noexcept {
+		return _refreshPeriod > 0;
+	}
+
+	// 不早于 time 的第一个垂直同步
+	int64_t VBlankAtOrAfter(int64_t time) const noexcept;
+
+	// 下一帧应在何时开始，不晚于 now 表示立即开始。每个垂直同步最多安排一帧
+	int64_t NextWakeTime(int64_t now) const noexcept;
+
+	// 完成一帧。captureTime 为捕获这一帧的时间，renderStart 和 renderEnd 为后端开始和完成渲染的时间。
+	// 返回估计的显示时间
+	int64_t OnFrameRendered(int64_t captureTime, int64_t renderStart, int64_t renderEnd) noexcept;
+
+	struct Statistics {
+		// 从捕获到显示的延迟
+		int64_t latencyP50 = 0;
+		int64_t latencyP95 = 0;
+		int64_t latencyP99 = 0;
+		// 相邻两帧延迟之差的绝对值
+		int64_t jitterP50 = 0;
+		int64_t jitterP99 = 0;
+		// 以下为开始以来的总数
+		uint64_t frameCount = 0;
+		// 未能在预定的垂直同步前完成的帧
+		uint64_t missedCount = 0;
+		// 估计尚未显示就被下一帧替换的帧
+		uint64_t supersededCount = 0;
+	};
+
+	// 延迟和抖动只统计最近 HISTORY_SIZE 帧
+	Statistics GetStatistics() const noexcept;
+
+private:
+	// 预计从开始渲染到呈现完成的用时
+	int64_t _RenderBudget() const noexcept;
+
+	Policy _policy = Policy::LowestLatency;
+
+	int64_t _vblankTime = 0;
+	int64_t _refreshPeriod = 0;
+
+	// 上一帧估计的显示时间，下一帧不会安排在同一个垂直同步
+	int64_t _lastDisplayTime = INT64_MIN;
+	int64_t _lastLatency = 0;
+
+	// 以下均为环形缓冲区
+	std::vector<int64_t> _renderDurations;
+	std::vector<int64_t> _latencies;
+	std::vector<int64_t> _jitters;
+
+	uint64_t _frameCount = 0;
+	uint64_t _missedCount = 0;
+	uint64_t _supersededCount = 0;
+};
+
+}
@@ -6,6 +6,7 @@
 #include "Utils.h"
 #include "SmallVector.h"
 #include "DirectXHelper.h"
+#include "ChangeMask.h"
 #include "DeviceResources.h"
 #include "shaders/DuplicateFrameCS.h"
 #include "ScalingWindow.h"
@@ -16,6 +17,10 @@ namespace Magpie::Core {
 static constexpr uint16_t INITIAL_CHECK_COUNT = 16;
 static constexpr uint16_t INITIAL_SKIP_COUNT = 1;
 static constexpr uint16_t MAX_SKIP_COUNT = 16;
+// 变化的块组成的矩形超过此数量时复制整个输出
+static constexpr uint32_t MAX_PARTIAL_COPY_COUNT = 32;
+// 同时等待取回的比较结果数
+static constexpr uint32_t COMPARISON_RING_DEPTH = 3;
 
 FrameSourceBase::FrameSourceBase() noexcept :
 	_nextSkipCount(INITIAL_SKIP_COUNT), _framesLeft(INITIAL_CHECK_COUNT) {}
@@ -55,9 +60,14 @@ FrameSourceBase::~FrameSourceBase() noexcept {
 	}
 }
 
-bool FrameSourceBase::Initialize(DeviceResources& deviceResources, BackendDescriptorStore& descriptorStore) noexcept {
+bool FrameSourceBase::Initialize(
+	DeviceResources& deviceResources,
+	BackendDescriptorStore& descriptorStore,
+	FrameTimingRecorder& frameTimings
+) noexcept {
 	_deviceResources = &deviceResources;
 	_descriptorStore = &descriptorStore;
+	_frameTimings = &frameTimings;
 
 	const HWND hwndSrc = ScalingWindow::Get().HwndSrc();
 
@@ -100,31 +110,163 @@ bool FrameSourceBase::Initialize(DeviceResources& deviceResources, BackendDescri
 		return false;
 	}
 
-	assert(_output);
-	_outputSrv = descriptorStore.GetShaderResourceView(_output.get());
+	if (_isOutputCropped) {
+		_outputSize = {
+			LONG(_frameBox.right - _frameBox.left),
+			LONG(_frameBox.bottom - _frameBox.top)
+		};
+	} else if (!_InitOutput()) {
+		Logger::Get().Error("_InitOutput 失败");
+		return false;
+	}
+
+	return true;
+}
+
+bool FrameSourceBase::DisableCroppedOutput() noexcept {
+	assert(_isOutputCropped && !_output);
+
+	_isOutputCropped = false;
+	if (!_InitOutput()) {
+		Logger::Get().Error("_InitOutput 失败");
+		return false;
+	}
+
+	return true;
+}
+
+FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
+	// 上一次返回 NewFrame 后变化区域已被使用，重新开始累积
+	if (std::exchange(_isNewFrameReturned, false)) {
+		_dirtyRects.clear();
+		_isOutputDirty = false;
+	}
+
+	UpdateState state;
+	if (_isComparisonPending) {
+		// 比较结果取回前不更新 _output
+		state = _EndComparison();
+	} else {
+		// 取回之前只用于统计的比较结果
+		if (_comparisonRing.PendingCount() > 0) {
+			_PollComparisons();
+		}
+
+		_hasNewDirtyRects = false;
+		state = _Update();
+		if (state != UpdateState::NewFrame) {
+			return state;
+		}
+
+		++_frameIndex;
+
+		if (!_hasNewDirtyRects) {
+			_isOutputDirty = true;
+		}
+
+		// 重复帧的变化区域保留到下一个新帧
+		state = _CheckForDuplicateFrame();
+	}
+
+	_isNewFrameReturned = state == UpdateState::NewFrame;
+	return state;
+}
+
+bool FrameSourceBase::CanReportDirtyRects() const noexcept {
+	const ScalingOptions& options = ScalingWindow::Get().Options();
+	return !options.Is3DGameMode() && options.duplicateFrameDetectionMode != DuplicateFrameDetectionMode::Never;
+}
+
+bool FrameSourceBase::_InitOutput() noexcept {
+	if (!_output) {
+		_output = DirectXHelper::CreateTexture2D(
+			_deviceResources->GetD3DDevice(),
+			DXGI_FORMAT_B8G8R8A8_UNORM,
+			_frameBox.right - _frameBox.left,
+			_frameBox.bottom - _frameBox.top,
+			D3D11_BIND_SHADER_RESOURCE
+		);
+		if (!_output) {
+			Logger::Get().Error("创建纹理失败");
+			return false;
+		}
+	}
+
+	_outputSrv = _descriptorStore->GetShaderResourceView(_output.get());
 	if (!_outputSrv) {
 		Logger::Get().Error("GetShaderResourceView 失败");
 		return false;
 	}
 
+	D3D11_TEXTURE2D_DESC td;
+	_output->GetDesc(&td);
+	_outputSize = { (LONG)td.Width, (LONG)td.Height };
+
 	return true;
 }
 
-FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
-	const UpdateState state = _Update();
+bool FrameSourceBase::_UpdateOutput(ID3D11Texture2D* frameTexture) noexcept {
+	if (!_isOutputCropped) {
+		_deviceResources->GetD3DDC()->CopySubresourceRegion(
+			_output.get(), 0, 0, 0, 0, frameTexture, 0, &_frameBox);
+		return true;
+	}
+
+	if (frameTexture == _output.get()) {
+		return true;
+	}
+
+	auto it = std::find_if(_frameSrvs.begin(), _frameSrvs.end(),
+		[&](const auto& pair) { return pair.first.get() == frameTexture; });
+	if (it == _frameSrvs.end()) {
+		// 效果的常量缓冲区中包含捕获的纹理的尺寸
+		D3D11_TEXTURE2D_DESC td;
+		frameTexture->GetDesc(&td);
+		if ((LONG)td.Width != _frameTextureSize.cx || (LONG)td.Height != _frameTextureSize.cy) {
+			Logger::Get().Error("捕获的纹理尺寸已改变");
+			return false;
+		}
+
+		winrt::com_ptr<ID3D11ShaderResourceView> srv;
+		HRESULT hr = _deviceResources->GetD3DDevice()->CreateShaderResourceView(frameTexture, nullptr, srv.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateShaderResourceView 失败", hr);
+			return false;
+		}
+
+		if (_frameSrvs.size() == 4) {
+			_frameSrvs.erase(_frameSrvs.begin());
+		}
 
+		winrt::com_ptr<ID3D11Texture2D> texture;
+		texture.copy_from(frameTexture);
+		_frameSrvs.emplace_back(std::move(texture), std::move(srv));
+		it = _frameSrvs.end() - 1;
+	}
+
+	_output = it->first;
+	_outputSrv = it->second.get();
+	return true;
+}
+
+void FrameSourceBase::_AddDirtyRect(const RECT& rect) noexcept {
+	_hasNewDirtyRects = true;
+
+	if (rect.left < rect.right && rect.top < rect.bottom) {
+		_dirtyRects.push_back(rect);
+	}
+}
+
+FrameSourceBase::UpdateState FrameSourceBase::_CheckForDuplicateFrame() noexcept {
 	const ScalingOptions& options = ScalingWindow::Get().Options();
 	const auto duplicateFrameDetectionMode = options.duplicateFrameDetectionMode;
-	if (state != UpdateState::NewFrame || options.Is3DGameMode() ||
-		duplicateFrameDetectionMode == DuplicateFrameDetectionMode::Never) {
-		return state;
+	if (options.Is3DGameMode() || duplicateFrameDetectionMode == DuplicateFrameDetectionMode::Never) {
+		return UpdateState::NewFrame;
 	}
 
-	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
-
 	if (!_prevFrame) {
 		if (_InitCheckingForDuplicateFrame()) {
-			d3dDC->CopyResource(_prevFrame.get(), _output.get());
+			_UpdatePrevFrame(false);
 		} else {
 			Logger::Get().Error("_InitCheckingForDuplicateFrame 失败");
 			_prevFrame = nullptr;
@@ -136,12 +278,7 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 
 	if (duplicateFrameDetectionMode == DuplicateFrameDetectionMode::Always) {
 		// 总是检查重复帧
-		if (_IsDuplicateFrame()) {
-			return UpdateState::Waiting;
-		} else {
-			d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			return UpdateState::NewFrame;
-		}
+		return _BeginComparison(_ComparisonKind::Always);
 	}
 
 	///////////////////////////////////////////////
@@ -150,8 +287,6 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 	//
 	///////////////////////////////////////////////
 
-	const bool isStatisticsEnabled = options.IsStatisticsForDynamicDetectionEnabled();
-
 	if (_isCheckingForDuplicateFrame) {
 		if (--_framesLeft == 0) {
 			_isCheckingForDuplicateFrame = false;
@@ -162,18 +297,10 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 			}
 		}
 
-		if (_IsDuplicateFrame()) {
-			_isCheckingForDuplicateFrame = true;
-			_framesLeft = INITIAL_CHECK_COUNT;
-			_nextSkipCount = INITIAL_SKIP_COUNT;
-			return UpdateState::Waiting;
-		} else {
-			if (_isCheckingForDuplicateFrame || isStatisticsEnabled) {
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			}
-			return UpdateState::NewFrame;
-		}
+		return _BeginComparison(_ComparisonKind::Checking);
 	} else {
+		const bool isStatisticsEnabled = options.IsStatisticsForDynamicDetectionEnabled();
+
 		if (--_framesLeft == 0) {
 			_isCheckingForDuplicateFrame = true;
 			// 第 2 次连续检查 10 帧，之后逐渐减少，从第 16 次开始只连续检查 2 帧
@@ -181,28 +308,208 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 			
 			if (!isStatisticsEnabled) {
 				// 下一帧将检查重复帧，需要复制此帧
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
+				_UpdatePrevFrame(false);
+				return UpdateState::NewFrame;
 			}
 		}
 
 		if (isStatisticsEnabled) {
-			const bool isDuplicate = _IsDuplicateFrame();
-			if (!isDuplicate) {
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			}
+			return _BeginComparison(_ComparisonKind::Statistics);
+		}
 
-			std::pair<uint32_t, uint32_t> statistics = _statistics.load(std::memory_order_relaxed);
-			if (isDuplicate) {
-				// 预测错误
-				++statistics.first;
-			}
-			// 总帧数
-			++statistics.second;
-			_statistics.store(statistics, std::memory_order_relaxed);
+		_isPrevFrameCurrent = false;
+		return UpdateState::NewFrame;
+	}
+}
+
+FrameSourceBase::UpdateState FrameSourceBase::_BeginComparison(_ComparisonKind kind) noexcept {
+	const std::optional<uint32_t> slot = _comparisonRing.Submit(_frameIndex);
+	if (!slot) {
+		// GPU 落后太多，跳过这次比较
+		_isChangeMaskValid = false;
+		_changedRects.clear();
+
+		if (kind == _ComparisonKind::Statistics) {
+			_UpdatePrevFrame(false);
+			return UpdateState::NewFrame;
 		}
 
+		return _ApplyComparison(kind, false);
+	}
+
+	_comparisonKinds[*slot] = kind;
+
+	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
+
+	ID3D11ShaderResourceView* srvs[]{ _outputSrv, _prevFrameSrv.get() };
+	d3dDC->CSSetShaderResources(0, 2, srvs);
+
+	ID3D11SamplerState* sam = _deviceResources->GetSampler(
+		D3D11_FILTER_MIN_MAG_MIP_POINT, D3D11_TEXTURE_ADDRESS_CLAMP);
+	d3dDC->CSSetSamplers(0, 1, &sam);
+
+	{
+		ID3D11Buffer* t = _dupFrameCB.get();
+		d3dDC->CSSetConstantBuffers(0, 1, &t);
+	}
+
+	// 将缓冲区置零
+	static constexpr UINT ZERO[4]{};
+	d3dDC->ClearUnorderedAccessViewUint(_resultBufferUav, ZERO);
+	d3dDC->CSSetUnorderedAccessViews(0, 1, &_resultBufferUav, nullptr);
+
+	d3dDC->CSSetShader(_dupFrameCS.get(), nullptr, 0);
+
+	d3dDC->Dispatch(_dispatchCount.first, _dispatchCount.second, 1);
+
+	d3dDC->CopyResource(_readBackBuffers[*slot].get(), _resultBuffer.get());
+
+	if (kind == _ComparisonKind::Statistics) {
+		// 结果在之后的帧中取回。无论是否重复都复制，重复帧和 _prevFrame 相同
+		_UpdatePrevFrame(false);
 		return UpdateState::NewFrame;
 	}
+
+	// 不在 Map 中等待 GPU，完成后通过 _comparisonEvent 通知后端线程
+	_comparisonEvent.ResetEvent();
+	HRESULT hr = d3dDC->Signal(_comparisonFence.get(), ++_comparisonFenceValue);
+	if (SUCCEEDED(hr)) {
+		hr = _comparisonFence->SetEventOnCompletion(_comparisonFenceValue, _comparisonEvent.get());
+	}
+	if (FAILED(hr)) {
+		Logger::Get().ComError("等待比较结果失败", hr);
+		// 后端线程不再等待事件，而是不断尝试取回结果
+		_comparisonEvent.SetEvent();
+	}
+
+	d3dDC->Flush();
+
+	_pendingComparison = kind;
+	_isComparisonPending = true;
+	_isComparedWithCurrent = _isPrevFrameCurrent;
+	return _EndComparison();
+}
+
+void FrameSourceBase::_PollComparisons() noexcept {
+	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
+
+	_comparisonRing.Poll([&](uint32_t slot, uint64_t) {
+		ID3D11Buffer* readBackBuffer = _readBackBuffers[slot].get();
+
+		D3D11_MAPPED_SUBRESOURCE ms;
+		HRESULT hr = d3dDC->Map(readBackBuffer, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &ms);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+			return false;
+		}
+
+		if (FAILED(hr)) {
+			Logger::Get().ComError("Map 失败", hr);
+		}
+
+		if (_comparisonKinds[slot] == _ComparisonKind::Statistics) {
+			if (SUCCEEDED(hr)) {
+				std::pair<uint32_t, uint32_t> statistics = _statistics.load(std::memory_order_relaxed);
+				if (*(const uint32_t*)ms.pData == 0) {
+					// 预测错误
+					++statistics.first;
+				}
+				// 总帧数
+				++statistics.second;
+				_statistics.store(statistics, std::memory_order_relaxed);
+			}
+		} else {
+			// 失败时视为有变化
+			_isChangeMaskValid = SUCCEEDED(hr);
+			if (_isChangeMaskValid) {
+				std::memcpy(_changeMask.data(), ms.pData, _changeMask.size() * sizeof(uint32_t));
+			}
+			_isComparisonPending = false;
+		}
+
+		if (SUCCEEDED(hr)) {
+			d3dDC->Unmap(readBackBuffer, 0);
+		}
+		return true;
+	});
+}
+
+FrameSourceBase::UpdateState FrameSourceBase::_EndComparison() noexcept {
+	_PollComparisons();
+	if (_isComparisonPending) {
+		return UpdateState::Waiting;
+	}
+
+	_changedRects.clear();
+	if (_isChangeMaskValid) {
+		SmallVector<RegionPropagator::Rect> rects;
+		ChangeMask::ToRects(_changeMask, _outputSize.cx, _outputSize.cy, rects);
+		for (const RegionPropagator::Rect& rect : rects) {
+			_changedRects.push_back({ rect.left, rect.top, rect.right, rect.bottom });
+		}
+	}
+
+	return _ApplyComparison(_pendingComparison, _isChangeMaskValid && _changeMask[0] == 0);
+}
+
+FrameSourceBase::UpdateState FrameSourceBase::_ApplyComparison(_ComparisonKind kind, bool isDuplicate) noexcept {
+	if (kind == _ComparisonKind::Always) {
+		if (isDuplicate) {
+			return UpdateState::Waiting;
+		}
+
+		_UpdatePrevFrame(true);
+	} else {
+		assert(kind == _ComparisonKind::Checking);
+
+		if (isDuplicate) {
+			_isCheckingForDuplicateFrame = true;
+			_framesLeft = INITIAL_CHECK_COUNT;
+			_nextSkipCount = INITIAL_SKIP_COUNT;
+			return UpdateState::Waiting;
+		}
+
+		if (_isCheckingForDuplicateFrame ||
+			ScalingWindow::Get().Options().IsStatisticsForDynamicDetectionEnabled()) {
+			_UpdatePrevFrame(true);
+		} else {
+			_isPrevFrameCurrent = false;
+		}
+	}
+
+	// 比较结果比帧源报告的更精确
+	if (_isChangeMaskValid && _isComparedWithCurrent) {
+		_dirtyRects = _changedRects;
+		_isOutputDirty = false;
+	}
+
+	return UpdateState::NewFrame;
+}
+
+void FrameSourceBase::_UpdatePrevFrame(bool useChangeMask) noexcept {
+	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
+
+	// 启用裁剪时从捕获的纹理中复制
+	const POINT origin = _isOutputCropped ? OutputOffset() : POINT{};
+
+	if (useChangeMask && _isChangeMaskValid && _changedRects.size() <= MAX_PARTIAL_COPY_COUNT) {
+		for (const RECT& rect : _changedRects) {
+			const D3D11_BOX box{
+				.left = UINT(origin.x + rect.left),
+				.top = UINT(origin.y + rect.top),
+				.front = 0,
+				.right = UINT(origin.x + rect.right),
+				.bottom = UINT(origin.y + rect.bottom),
+				.back = 1
+			};
+			d3dDC->CopySubresourceRegion(_prevFrame.get(), 0, rect.left, rect.top, 0, _output.get(), 0, &box);
+		}
+	} else if (_isOutputCropped) {
+		d3dDC->CopySubresourceRegion(_prevFrame.get(), 0, 0, 0, 0, _output.get(), 0, &_frameBox);
+	} else {
+		d3dDC->CopyResource(_prevFrame.get(), _output.get());
+	}
+
+	_isPrevFrameCurrent = true;
 }
 
 std::pair<uint32_t, uint32_t> FrameSourceBase::GetStatisticsForDynamicDetection() const noexcept {
@@ -507,8 +814,11 @@ bool FrameSourceBase::_CenterWindowIfNecessary(HWND hWnd, const RECT& rcWork) no
 bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 	ID3D11Device5* d3dDevice = _deviceResources->GetD3DDevice();
 
+	// 启用裁剪时 _output 为捕获的纹理，_prevFrame 只保存输出的区域
 	D3D11_TEXTURE2D_DESC td;
 	_output->GetDesc(&td);
+	td.Width = (UINT)_outputSize.cx;
+	td.Height = (UINT)_outputSize.cy;
 
 	_prevFrame = DirectXHelper::CreateTexture2D(
 		d3dDevice, td.Format, td.Width, td.Height, D3D11_BIND_SHADER_RESOURCE);
@@ -522,8 +832,11 @@ bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 		return false;
 	}
 
+	const uint32_t wordCount = ChangeMask::WordCount(td.Width, td.Height);
+	_changeMask.resize(wordCount);
+
 	D3D11_BUFFER_DESC bd{
-		.ByteWidth = 4,
+		.ByteWidth = wordCount * 4,
 		.Usage = D3D11_USAGE_DEFAULT,
 		.BindFlags = D3D11_BIND_UNORDERED_ACCESS,
 		.StructureByteStride = 4
@@ -535,7 +848,7 @@ bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 	}
 
 	_resultBufferUav = _descriptorStore->GetUnorderedAccessView(
-		_resultBuffer.get(), 1, DXGI_FORMAT_R32_UINT);
+		_resultBuffer.get(), wordCount, DXGI_FORMAT_R32_UINT);
 	if (!_resultBufferUav) {
 		Logger::Get().ComError("GetUnorderedAccessView 失败", hr);
 		return false;
@@ -544,12 +857,18 @@ bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 	bd.Usage = D3D11_USAGE_STAGING;
 	bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 	bd.BindFlags = 0;
-	hr = d3dDevice->CreateBuffer(&bd, nullptr, _readBackBuffer.put());
-	if (FAILED(hr)) {
-		Logger::Get().ComError("CreateBuffer 失败", hr);
-		return false;
+	_readBackBuffers.resize(COMPARISON_RING_DEPTH);
+	for (winrt::com_ptr<ID3D11Buffer>& readBackBuffer : _readBackBuffers) {
+		hr = d3dDevice->CreateBuffer(&bd, nullptr, readBackBuffer.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
 	}
 
+	_comparisonRing.Initialize(COMPARISON_RING_DEPTH);
+	_comparisonKinds.resize(COMPARISON_RING_DEPTH);
+
 	hr = d3dDevice->CreateComputeShader(
 		DuplicateFrameCS, sizeof(DuplicateFrameCS), nullptr, _dupFrameCS.put());
 	if (FAILED(hr)) {
@@ -557,44 +876,42 @@ bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 		return false;
 	}
 
-	static constexpr std::pair<uint32_t, uint32_t> BLOCK_SIZE{ 16, 16 };
-	_dispatchCount.first = (td.Width + BLOCK_SIZE.first - 1) / BLOCK_SIZE.first;
-	_dispatchCount.second = (td.Height + BLOCK_SIZE.second - 1) / BLOCK_SIZE.second;
-	
-	return true;
-}
+	{
+		// cbuffer __CB1 : register(b0) { uint2 offset; };
+		const POINT origin = _isOutputCropped ? OutputOffset() : POINT{};
+		const uint32_t offset[4] = { (uint32_t)origin.x, (uint32_t)origin.y };
 
-bool FrameSourceBase::_IsDuplicateFrame() {
-	// 检查是否和前一帧相同
-	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
-
-	ID3D11ShaderResourceView* srvs[]{ _outputSrv, _prevFrameSrv.get() };
-	d3dDC->CSSetShaderResources(0, 2, srvs);
-
-	ID3D11SamplerState* sam = _deviceResources->GetSampler(
-		D3D11_FILTER_MIN_MAG_MIP_POINT, D3D11_TEXTURE_ADDRESS_CLAMP);
-	d3dDC->CSSetSamplers(0, 1, &sam);
-
-	// 将缓冲区置零
-	static constexpr UINT ZERO[4]{};
-	d3dDC->ClearUnorderedAccessViewUint(_resultBufferUav, ZERO);
-	d3dDC->CSSetUnorderedAccessViews(0, 1, &_resultBufferUav, nullptr);
-
-	d3dDC->CSSetShader(_dupFrameCS.get(), nullptr, 0);
-
-	d3dDC->Dispatch(_dispatchCount.first, _dispatchCount.second, 1);
+		const D3D11_BUFFER_DESC cbDesc{
+			.ByteWidth = sizeof(offset),
+			.Usage = D3D11_USAGE_IMMUTABLE,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER
+		};
+		const D3D11_SUBRESOURCE_DATA initData{ .pSysMem = offset };
+		hr = d3dDevice->CreateBuffer(&cbDesc, &initData, _dupFrameCB.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
 
-	// 取回结果
-	d3dDC->CopyResource(_readBackBuffer.get(), _resultBuffer.get());
+	hr = d3dDevice->CreateFence(
+		_comparisonFenceValue, D3D11_FENCE_FLAG_NONE, IID_PPV_ARGS(&_comparisonFence));
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateFence 失败", hr);
+		return false;
+	}
 
-	uint32_t result = 1;
-	D3D11_MAPPED_SUBRESOURCE ms;
-	HRESULT hr = d3dDC->Map(_readBackBuffer.get(), 0, D3D11_MAP_READ, 0, &ms);
-	if (SUCCEEDED(hr)) {
-		result = *(uint32_t*)ms.pData;
-		d3dDC->Unmap(_readBackBuffer.get(), 0);
+	// 手动重置，以便后端线程在结果可以取回前不断检查
+	if (!_comparisonEvent.try_create(wil::EventOptions::ManualReset, nullptr)) {
+		Logger::Get().Win32Error("CreateEvent 失败");
+		return false;
 	}
-	return result == 0;
+
+	// 每个线程组比较一个块
+	_dispatchCount.first = (td.Width + ChangeMask::TILE_SIZE - 1) / ChangeMask::TILE_SIZE;
+	_dispatchCount.second = (td.Height + ChangeMask::TILE_SIZE - 1) / ChangeMask::TILE_SIZE;
+	
+	return true;
 }
 
 }
@@ -1,9 +1,12 @@
 #pragma once
+#include "SmallVector.h"
+#include "ReadbackRing.h"
 
 namespace Magpie::Core {
 
 class DeviceResources;
 class BackendDescriptorStore;
+class FrameTimingRecorder;
 
 class FrameSourceBase {
 public:
@@ -15,7 +18,11 @@ public:
 	FrameSourceBase(const FrameSourceBase&) = delete;
 	FrameSourceBase(FrameSourceBase&&) = delete;
 
-	bool Initialize(DeviceResources& deviceResources, BackendDescriptorStore& descriptorStore) noexcept;
+	bool Initialize(
+		DeviceResources& deviceResources,
+		BackendDescriptorStore& descriptorStore,
+		FrameTimingRecorder& frameTimings
+	) noexcept;
 
 	enum class UpdateState {
 		NewFrame,
@@ -25,16 +32,59 @@ public:
 
 	UpdateState Update() noexcept;
 
+	// 启用裁剪时为整个捕获的纹理，输出为其中从 OutputOffset 开始的区域，每帧可能不同，
+	// 在第一帧之前为空
 	ID3D11Texture2D* GetOutput() noexcept {
 		return _output.get();
 	}
 
+	ID3D11ShaderResourceView* GetOutputSrv() noexcept {
+		return _outputSrv;
+	}
+
+	SIZE OutputSize() const noexcept {
+		return _outputSize;
+	}
+
+	// 是否直接输出捕获的纹理，省去每帧一次复制。此时第一个效果需使用 EffectFlags::CroppedInput
+	// 编译，在渲染前通过 GetOutputSrv 获取 INPUT
+	bool IsOutputCropped() const noexcept {
+		return _isOutputCropped;
+	}
+
+	// 以下两个只在 IsOutputCropped 时有效
+	POINT OutputOffset() const noexcept {
+		return { (LONG)_frameBox.left, (LONG)_frameBox.top };
+	}
+
+	SIZE FrameTextureSize() const noexcept {
+		return _frameTextureSize;
+	}
+
+	// 第一个效果不支持 EffectFlags::CroppedInput 时回落到复制捕获的纹理，只能在第一帧之前调用
+	bool DisableCroppedOutput() noexcept;
+
 	// 注意: 返回源窗口作为输入部分的位置，但可能和 GetOutput 获取到的纹理尺寸不同，
 	// 因为源窗口可能存在 DPI 缩放，而某些捕获方法无视 DPI 缩放
 	const RECT& SrcRect() const noexcept { return _srcRect; }
 
 	std::pair<uint32_t, uint32_t> GetStatisticsForDynamicDetection() const noexcept;
 
+	// 自上一次 Update 返回 NewFrame 以来 GetOutput 中变化的区域，在 Update 返回 NewFrame 后有效。
+	// 返回空表示整个输出都可能变化
+	const SmallVector<RECT>* DirtyRects() const noexcept {
+		return _isOutputDirty ? nullptr : &_dirtyRects;
+	}
+
+	// 是否能报告变化的区域，见 DirtyRects。检查重复帧时可以从比较结果得到变化的区域
+	virtual bool CanReportDirtyRects() const noexcept;
+
+	// 重复帧检查的结果尚未取回时返回它完成后触发的事件，此时 Update 返回 Waiting，
+	// 应在事件触发后再次调用 Update
+	HANDLE PendingComparisonEvent() const noexcept {
+		return _isComparisonPending ? _comparisonEvent.get() : NULL;
+	}
+
 	virtual const char* Name() const noexcept = 0;
 
 	virtual bool IsScreenCapture() const noexcept = 0;
@@ -42,10 +92,22 @@ public:
 	enum FrameSourceWaitType {
 		NoWait,
 		WaitForMessage,
-		WaitForFrame
+		WaitForFrame,
+		// 有新帧时触发 NewFrameEvent
+		WaitForEvent
 	};
 
 	virtual FrameSourceWaitType WaitType() const noexcept = 0;
+
+	// WaitForEvent 的帧源有新帧时触发的事件
+	virtual HANDLE NewFrameEvent() const noexcept {
+		return NULL;
+	}
+
+	// WaitForFrame 的帧源在 Update 中最多等待新帧多久，单位为毫秒
+	void SetFrameWaitTimeout(uint32_t timeout) noexcept {
+		_frameWaitTimeout = timeout;
+	}
 	
 	virtual void OnCursorVisibilityChanged(bool /*isVisible*/, bool /*onDestory*/) noexcept {};
 
@@ -60,6 +122,13 @@ protected:
 
 	bool _CalcSrcRect() noexcept;
 
+	// 由 _Update 在返回 NewFrame 前调用，rect 相对于输出。一次也不调用时视为整个输出都已变化
+	void _AddDirtyRect(const RECT& rect) noexcept;
+
+	// 由设置了 _frameBox 的帧源在 _Update 中调用，frameTexture 为捕获的纹理。
+	// 启用裁剪时直接将它作为输出，否则复制 _frameBox 区域到 _output
+	bool _UpdateOutput(ID3D11Texture2D* frameTexture) noexcept;
+
 	// 获取坐标系 1 到坐标系 2 的映射关系
 	// 坐标系 1: 屏幕坐标系，即虚拟化后的坐标系。原点为屏幕左上角
 	// 坐标系 2: 虚拟化前的坐标系，即源窗口所见的坐标系，原点为窗口左上角
@@ -75,12 +144,22 @@ protected:
 
 	DeviceResources* _deviceResources = nullptr;
 	BackendDescriptorStore* _descriptorStore = nullptr;
+	FrameTimingRecorder* _frameTimings = nullptr;
 	winrt::com_ptr<ID3D11Texture2D> _output;
-	ID3D11ShaderResourceView* _outputSrv;
+	ID3D11ShaderResourceView* _outputSrv = nullptr;
+
+	// 捕获的纹理中作为输出的区域和捕获的纹理的尺寸，由使用 _UpdateOutput 的帧源在 _Initialize 中设置。
+	// 这些帧源无需创建 _output，_isOutputCropped 为 true 表示支持直接输出捕获的纹理
+	D3D11_BOX _frameBox{};
+	SIZE _frameTextureSize{};
+	bool _isOutputCropped = false;
+
+	uint32_t _frameWaitTimeout = 1;
 
 	winrt::com_ptr<ID3D11Buffer> _resultBuffer;
 	ID3D11UnorderedAccessView* _resultBufferUav = nullptr;
-	winrt::com_ptr<ID3D11Buffer> _readBackBuffer;
+	// 见 _comparisonRing
+	std::vector<winrt::com_ptr<ID3D11Buffer>> _readBackBuffers;
 	winrt::com_ptr<ID3D11ComputeShader> _dupFrameCS;
 	std::pair<uint32_t, uint32_t> _dispatchCount;
 
@@ -88,18 +167,73 @@ protected:
 	bool _windowResizingDisabled = false;
 
 private:
+	UpdateState _CheckForDuplicateFrame() noexcept;
+
 	bool _InitCheckingForDuplicateFrame();
 
-	bool _IsDuplicateFrame();
+	enum class _ComparisonKind {
+		Always,
+		// 动态检查重复帧时处于检查阶段
+		Checking,
+		// 动态检查重复帧时处于跳过阶段，只用于统计
+		Statistics
+	};
+
+	// 在 GPU 上比较 _output 和 _prevFrame，结果异步取回。只用于统计时不等待结果
+	UpdateState _BeginComparison(_ComparisonKind kind) noexcept;
+
+	// 取回所有已完成的比较结果，不会等待 GPU
+	void _PollComparisons() noexcept;
+
+	// 取回需要等待的比较结果，尚未完成时返回 Waiting
+	UpdateState _EndComparison() noexcept;
+
+	UpdateState _ApplyComparison(_ComparisonKind kind, bool isDuplicate) noexcept;
+
+	// 只复制变化的块，useChangeMask 为 false 或块过多时复制整个输出
+	void _UpdatePrevFrame(bool useChangeMask) noexcept;
+
+	// 创建 _output 的 SRV，帧源没有创建 _output 时先创建它
+	bool _InitOutput() noexcept;
+
+	SIZE _outputSize{};
+	// 启用裁剪时捕获的纹理通常在几个缓冲区间轮换，因此缓存它们的 SRV
+	SmallVector<std::pair<winrt::com_ptr<ID3D11Texture2D>, winrt::com_ptr<ID3D11ShaderResourceView>>, 4> _frameSrvs;
 
 	// 用于检查重复帧
 	winrt::com_ptr<ID3D11Texture2D> _prevFrame;
 	winrt::com_ptr<ID3D11ShaderResourceView> _prevFrameSrv;
+	// 输出在捕获的纹理中的起点
+	winrt::com_ptr<ID3D11Buffer> _dupFrameCB;
 	uint16_t _nextSkipCount;
 	uint16_t _framesLeft;
 	// (预测错误帧数, 总计跳过帧数)
 	std::atomic<std::pair<uint32_t, uint32_t>> _statistics;
 	bool _isCheckingForDuplicateFrame = true;
+
+	winrt::com_ptr<ID3D11Fence> _comparisonFence;
+	uint64_t _comparisonFenceValue = 0;
+	wil::unique_event_nothrow _comparisonEvent;
+	// 每次比较使用一个暂存缓冲区，GPU 落后时放弃比较而不是等待
+	ReadbackRing _comparisonRing;
+	SmallVector<_ComparisonKind> _comparisonKinds;
+	// 最近一次取回的需要等待的比较结果，见 ChangeMask
+	std::vector<uint32_t> _changeMask;
+	SmallVector<RECT> _changedRects;
+	uint64_t _frameIndex = 0;
+	_ComparisonKind _pendingComparison = _ComparisonKind::Always;
+	bool _isComparisonPending = false;
+	bool _isChangeMaskValid = false;
+	// _prevFrame 和上一次返回 NewFrame 时的输出相同，此时比较结果就是变化的区域
+	bool _isPrevFrameCurrent = false;
+	bool _isComparedWithCurrent = false;
+
+	SmallVector<RECT> _dirtyRects;
+	// 自上一次返回 NewFrame 以来有一帧没有报告变化的区域
+	bool _isOutputDirty = true;
+	// 本次 _Update 调用了 _AddDirtyRect
+	bool _hasNewDirtyRects = false;
+	bool _isNewFrameReturned = false;
 };
 
 }
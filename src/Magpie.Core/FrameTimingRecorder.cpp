@@ -0,0 +1,174 @@
+// 不使用预编译头，以便在其他平台构建
+#include "FrameTimingRecorder.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <fmt/format.h>
+
+namespace Magpie::Core {
+
+const char* FrameTimingRecorder::StageName(Stage stage) noexcept {
+	switch (stage) {
+	case Stage::SourceCapture:
+		return "sourceCapture";
+	case Stage::SourceQueue:
+		return "sourceQueue";
+	case Stage::CaptureWait:
+		return "captureWait";
+	case Stage::DuplicateCheck:
+		return "duplicateCheck";
+	case Stage::Effects:
+		return "effects";
+	case Stage::Handoff:
+		return "handoff";
+	case Stage::Present:
+		return "present";
+	default:
+		return "";
+	}
+}
+
+uint32_t FrameTimingRecorder::BucketIndex(float ms) noexcept {
+	// 也处理 NaN
+	if (!(ms > MIN_BUCKET_MS)) {
+		return 0;
+	}
+
+	// 先限制范围再转换，无穷大转换为整数是未定义行为
+	const float idx = std::log2(ms / MIN_BUCKET_MS) * BUCKETS_PER_OCTAVE;
+	return (uint32_t)std::min(idx, float(BUCKET_COUNT - 1));
+}
+
+float FrameTimingRecorder::BucketValue(uint32_t bucket) noexcept {
+	return MIN_BUCKET_MS * std::exp2((bucket + 0.5f) / BUCKETS_PER_OCTAVE);
+}
+
+void FrameTimingRecorder::Record(Stage stage, float ms) noexcept {
+	_StageHistory& history = _stages[(uint32_t)stage];
+
+	// 只有一个写入者，无需读-改-写
+	const uint64_t count = history.count.load(std::memory_order_relaxed);
+	std::atomic<float>& slot = history.samples[count % WINDOW_SIZE];
+	if (count >= WINDOW_SIZE) {
+		// 移出窗口的样本
+		history.buckets[BucketIndex(slot.load(std::memory_order_relaxed))].fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	slot.store(ms, std::memory_order_relaxed);
+	history.buckets[BucketIndex(ms)].fetch_add(1, std::memory_order_relaxed);
+	history.count.store(count + 1, std::memory_order_release);
+}
+
+void FrameTimingRecorder::Reset() noexcept {
+	for (_StageHistory& history : _stages) {
+		for (std::atomic<uint32_t>& bucket : history.buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		history.count.store(0, std::memory_order_release);
+	}
+}
+
+FrameTimingRecorder::Percentiles FrameTimingRecorder::GetPercentiles(Stage stage) const noexcept {
+	const _StageHistory& history = _stages[(uint32_t)stage];
+
+	std::array<uint32_t, BUCKET_COUNT> buckets;
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+		buckets[i] = history.buckets[i].load(std::memory_order_relaxed);
+		total += buckets[i];
+	}
+
+	Percentiles result;
+	result.count = total;
+	if (total == 0) {
+		return result;
+	}
+
+	// 第 ceil(p * total) 个样本所在的桶
+	const auto percentile = [&](float p) {
+		const uint32_t rank = std::max((uint32_t)std::ceil(p * total), 1u);
+		uint32_t accumulated = 0;
+		for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+			accumulated += buckets[i];
+			if (accumulated >= rank) {
+				return BucketValue(i);
+			}
+		}
+		return BucketValue(BUCKET_COUNT - 1);
+	};
+
+	result.p50 = percentile(0.50f);
+	result.p95 = percentile(0.95f);
+	result.p99 = percentile(0.99f);
+	return result;
+}
+
+void FrameTimingRecorder::GetSamples(Stage stage, std::vector<float>& result) const {
+	const _StageHistory& history = _stages[(uint32_t)stage];
+
+	const uint64_t count = history.count.load(std::memory_order_acquire);
+	const uint64_t sampleCount = std::min(count, (uint64_t)WINDOW_SIZE);
+	result.resize((size_t)sampleCount);
+	for (uint64_t i = 0; i < sampleCount; ++i) {
+		result[(size_t)i] = history.samples[(count - sampleCount + i) % WINDOW_SIZE].load(std::memory_order_relaxed);
+	}
+}
+
+std::string FrameTimingRecorder::ExportCsv() const {
+	std::string result = "stage,sample,ms\n";
+
+	std::vector<float> samples;
+	for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+		GetSamples((Stage)i, samples);
+		for (size_t j = 0; j < samples.size(); ++j) {
+			fmt::format_to(std::back_inserter(result), "{},{},{:.4f}\n", StageName((Stage)i), j, samples[j]);
+		}
+	}
+
+	return result;
+}
+
+// JSON 不能表示 NaN 和无穷大，用 null 代替
+static void AppendJsonNumber(std::string& result, float value) {
+	if (std::isfinite(value)) {
+		fmt::format_to(std::back_inserter(result), "{:.4f}", value);
+	} else {
+		result += "null";
+	}
+}
+
+std::string FrameTimingRecorder::ExportJson() const {
+	std::string result = "{\n  \"stages\": [";
+
+	std::vector<float> samples;
+	for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+		const Percentiles percentiles = GetPercentiles((Stage)i);
+		fmt::format_to(std::back_inserter(result), "{}\n    {{\n      \"name\": \"{}\",\n      \"count\": {},",
+			i == 0 ? "" : ",", StageName((Stage)i), percentiles.count);
+
+		// 没有样本时分位数无意义
+		const float noValue = std::numeric_limits<float>::quiet_NaN();
+		result += "\n      \"p50\": ";
+		AppendJsonNumber(result, percentiles.count > 0 ? percentiles.p50 : noValue);
+		result += ",\n      \"p95\": ";
+		AppendJsonNumber(result, percentiles.count > 0 ? percentiles.p95 : noValue);
+		result += ",\n      \"p99\": ";
+		AppendJsonNumber(result, percentiles.count > 0 ? percentiles.p99 : noValue);
+		result += ",\n      \"samples\": [";
+
+		GetSamples((Stage)i, samples);
+		for (size_t j = 0; j < samples.size(); ++j) {
+			if (j > 0) {
+				result += ", ";
+			}
+			AppendJsonNumber(result, samples[j]);
+		}
+
+		result += "]\n    }";
+	}
+
+	result += "\n  ]\n}\n";
+	return result;
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 记录每帧各阶段的用时并统计最近 WINDOW_SIZE 个样本的分位数。每个阶段只能由一个线程写入
+class FrameTimingRecorder {
+public:
+	enum class Stage : uint32_t {
+		// 帧源在自己的捕获线程中捕获一帧，只有 GDI 帧源写入
+		SourceCapture,
+		// 捕获线程完成捕获到后端取走这一帧。回放帧源中为从预定的时间到后端取走这一帧
+		SourceQueue,
+		// 从允许渲染下一帧到帧源返回新帧，不包括检查重复帧
+		CaptureWait,
+		// 等待重复帧检查的结果
+		DuplicateCheck,
+		// 提交效果直到 GPU 完成
+		Effects,
+		// 把输出复制到共享纹理并通知前端
+		Handoff,
+		// 前端复制到后缓冲、绘制叠加层和光标并呈现
+		Present,
+		COUNT
+	};
+
+	static constexpr uint32_t STAGE_COUNT = (uint32_t)Stage::COUNT;
+	static constexpr uint32_t WINDOW_SIZE = 256;
+
+	// 直方图以 1 微秒为起点，每倍频程 8 个桶，覆盖到约 1 秒，相对误差不超过 5%
+	static constexpr float MIN_BUCKET_MS = 0.001f;
+	static constexpr uint32_t BUCKETS_PER_OCTAVE = 8;
+	static constexpr uint32_t BUCKET_COUNT = BUCKETS_PER_OCTAVE * 20;
+
+	static const char* StageName(Stage stage) noexcept;
+
+	static uint32_t BucketIndex(float ms) noexcept;
+
+	// 桶的几何中点
+	static float BucketValue(uint32_t bucket) noexcept;
+
+	void Record(Stage stage, float ms) noexcept;
+
+	// 清空所有阶段，不能和 Record 同时调用
+	void Reset() noexcept;
+
+	struct Percentiles {
+		float p50 = 0;
+		float p95 = 0;
+		float p99 = 0;
+		// 窗口中的样本数
+		uint32_t count = 0;
+	};
+
+	Percentiles GetPercentiles(Stage stage) const noexcept;
+
+	// 窗口中的样本，从旧到新
+	void GetSamples(Stage stage, std::vector<float>& result) const;
+
+	// 每行一个样本：阶段,序号,毫秒
+	std::string ExportCsv() const;
+
+	// 每个阶段的分位数和样本
+	std::string ExportJson() const;
+
+private:
+	struct _StageHistory {
+		std::array<std::atomic<float>, WINDOW_SIZE> samples{};
+		std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets{};
+		// 已记录的样本总数
+		std::atomic<uint64_t> count = 0;
+	};
+
+	std::array<_StageHistory, STAGE_COUNT> _stages;
+};
+
+}
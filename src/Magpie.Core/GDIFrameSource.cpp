@@ -5,6 +5,8 @@
 #include "DirectXHelper.h"
 #include "DeviceResources.h"
 #include "ScalingWindow.h"
+#include "Win32Utils.h"
+#include "FrameTimingRecorder.h"
 
 namespace Magpie::Core {
 
@@ -51,57 +53,173 @@ bool GDIFrameSource::_Initialize() noexcept {
 		return false;
 	}
 
+	const int width = _frameRect.right - _frameRect.left;
+	const int height = _frameRect.bottom - _frameRect.top;
+
 	_output = DirectXHelper::CreateTexture2D(
 		_deviceResources->GetD3DDevice(),
 		DXGI_FORMAT_B8G8R8A8_UNORM,
-		_frameRect.right - _frameRect.left,
-		_frameRect.bottom - _frameRect.top,
-		D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET,
-		D3D11_USAGE_DEFAULT,
-		D3D11_RESOURCE_MISC_GDI_COMPATIBLE
+		width,
+		height,
+		D3D11_BIND_SHADER_RESOURCE
 	);
 	if (!_output) {
 		Logger::Get().Error("创建纹理失败");
 		return false;
 	}
 
-	_dxgiSurface = _output.try_as<IDXGISurface1>();
-	if (!_dxgiSurface) {
-		Logger::Get().Error("从 Texture2D 获取 IDXGISurface1 失败");
+	// 自上而下的 32 位 DIB，内存布局和 DXGI_FORMAT_B8G8R8A8_UNORM 相同
+	const BITMAPINFO bi{
+		.bmiHeader = {
+			.biSize = sizeof(BITMAPINFOHEADER),
+			.biWidth = width,
+			.biHeight = -height,
+			.biPlanes = 1,
+			.biBitCount = 32,
+			.biCompression = BI_RGB
+		}
+	};
+	for (_CaptureBuffer& buffer : _captureBuffers) {
+		void* bits = nullptr;
+		buffer.hBitmap.reset(CreateDIBSection(NULL, &bi, DIB_RGB_COLORS, &bits, NULL, 0));
+		if (!buffer.hBitmap) {
+			Logger::Get().Win32Error("CreateDIBSection 失败");
+			return false;
+		}
+		buffer.bits = (const uint8_t*)bits;
+
+		buffer.hdc.reset(CreateCompatibleDC(NULL));
+		if (!buffer.hdc) {
+			Logger::Get().Win32Error("CreateCompatibleDC 失败");
+			return false;
+		}
+		SelectObject(buffer.hdc.get(), buffer.hBitmap.get());
+	}
+
+	// 按屏幕刷新率捕获，设置了最大帧率时不超过它
+	float captureRate = (float)Win32Utils::GetMonitorRefreshRate(hwndSrc);
+	if (captureRate <= 0) {
+		captureRate = 60;
+	}
+	if (const std::optional<float>& maxFrameRate = ScalingWindow::Get().Options().maxFrameRate) {
+		captureRate = std::min(captureRate, *maxFrameRate);
+	}
+	_captureInterval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::duration<float>(1 / captureRate));
+
+	if (!_newFrameEvent.try_create(wil::EventOptions::None, nullptr)
+		|| !_stopEvent.try_create(wil::EventOptions::ManualReset, nullptr)) {
+		Logger::Get().Win32Error("创建事件失败");
 		return false;
 	}
 
-	Logger::Get().Info("GDIFrameSource 初始化完成");
+	_captureThread = std::thread(std::bind(&GDIFrameSource::_CaptureThreadProc, this));
+
+	Logger::Get().Info(fmt::format("GDIFrameSource 初始化完成，捕获帧率: {}", captureRate));
 	return true;
 }
 
-FrameSourceBase::UpdateState GDIFrameSource::_Update() noexcept {
-	HDC hdcDest;
-	HRESULT hr = _dxgiSurface->GetDC(TRUE, &hdcDest);
-	if (FAILED(hr)) {
-		Logger::Get().ComError("从 Texture2D 获取 IDXGISurface1 失败", hr);
-		return UpdateState::Error;
-	}
+GDIFrameSource::~GDIFrameSource() {
+	if (_captureThread.joinable()) {
+		_stopEvent.SetEvent();
+		_captureThread.join();
 
-	auto se = wil::scope_exit([&]() {
-		_dxgiSurface->ReleaseDC(nullptr);
-	});
+		Logger::Get().Info(fmt::format("GDI 捕获线程共捕获 {} 帧，其中 {} 帧未被后端取走就被替换",
+			_capturedCount.load(std::memory_order_relaxed), _replacedCount.load(std::memory_order_relaxed)));
+	}
+}
 
-	const HWND hwndSrc = ScalingWindow::Get().HwndSrc();
-	wil::unique_hdc_window hdcSrc(
-		wil::window_dc(GetDCEx(hwndSrc, NULL, DCX_LOCKWINDOWUPDATE | DCX_WINDOW), hwndSrc));
-	if (!hdcSrc) {
-		Logger::Get().Win32Error("GetDC 失败");
+FrameSourceBase::UpdateState GDIFrameSource::_Update() noexcept {
+	if (_hasCaptureError.load(std::memory_order_relaxed)) {
 		return UpdateState::Error;
 	}
 
-	if (!BitBlt(hdcDest, 0, 0, _frameRect.right - _frameRect.left, _frameRect.bottom - _frameRect.top,
-		hdcSrc.get(), _frameRect.left, _frameRect.top, SRCCOPY)
-	) {
-		Logger::Get().Win32Error("BitBlt 失败");
+	if (!_handoff.Acquire()) {
+		return UpdateState::Waiting;
 	}
 
+	const _CaptureBuffer& buffer = _captureBuffers[_handoff.FrontBufferIndex()];
+	_frameTimings->Record(FrameTimingRecorder::Stage::SourceQueue, std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - buffer.captureTime).count());
+
+	_deviceResources->GetD3DDC()->UpdateSubresource(
+		_output.get(), 0, nullptr, buffer.bits, (_frameRect.right - _frameRect.left) * 4, 0);
+
 	return UpdateState::NewFrame;
 }
 
+void GDIFrameSource::_CaptureThreadProc() noexcept {
+#ifdef _DEBUG
+	SetThreadDescription(GetCurrentThread(), L"Magpie GDI 捕获线程");
+#endif
+
+	const auto reportError = [this]() {
+		_hasCaptureError.store(true, std::memory_order_relaxed);
+		_newFrameEvent.SetEvent();
+	};
+
+	// 高精度定时器需要 Win10 v1803，不支持时回落到普通定时器
+	wil::unique_handle hTimer(CreateWaitableTimerEx(nullptr, nullptr,
+		CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	if (!hTimer) {
+		hTimer.reset(CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+		if (!hTimer) {
+			Logger::Get().Win32Error("CreateWaitableTimerEx 失败");
+			reportError();
+			return;
+		}
+	}
+
+	const HWND hwndSrc = ScalingWindow::Get().HwndSrc();
+	auto nextCaptureTime = std::chrono::steady_clock::now();
+
+	while (true) {
+		const auto captureStart = std::chrono::steady_clock::now();
+		_CaptureBuffer& buffer = _captureBuffers[_handoff.BackBufferIndex()];
+
+		{
+			wil::unique_hdc_window hdcSrc(
+				wil::window_dc(GetDCEx(hwndSrc, NULL, DCX_LOCKWINDOWUPDATE | DCX_WINDOW), hwndSrc));
+			if (!hdcSrc) {
+				Logger::Get().Win32Error("GetDC 失败");
+				reportError();
+				return;
+			}
+
+			if (!BitBlt(buffer.hdc.get(), 0, 0, _frameRect.right - _frameRect.left, _frameRect.bottom - _frameRect.top,
+				hdcSrc.get(), _frameRect.left, _frameRect.top, SRCCOPY)
+			) {
+				Logger::Get().Win32Error("BitBlt 失败");
+			}
+		}
+
+		// GDI 可能批处理绘制，后端线程读取 DIB 前必须完成
+		GdiFlush();
+
+		buffer.captureTime = std::chrono::steady_clock::now();
+		_frameTimings->Record(FrameTimingRecorder::Stage::SourceCapture,
+			std::chrono::duration<float, std::milli>(buffer.captureTime - captureStart).count());
+
+		if (_handoff.Publish()) {
+			_replacedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		_capturedCount.fetch_add(1, std::memory_order_relaxed);
+		_newFrameEvent.SetEvent();
+
+		// 按固定间隔捕获，落后时不追赶
+		nextCaptureTime = std::max(nextCaptureTime + _captureInterval, std::chrono::steady_clock::now());
+		// 负值表示相对时间，单位为 100ns
+		LARGE_INTEGER liDueTime{
+			.QuadPart = -std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				nextCaptureTime - std::chrono::steady_clock::now()).count() / 100, 1)
+		};
+		SetWaitableTimerEx(hTimer.get(), &liDueTime, 0, NULL, NULL, NULL, 0);
+
+		const HANDLE events[] = { _stopEvent.get(), hTimer.get() };
+		if (WaitForMultipleObjects((DWORD)std::size(events), events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+			return;
+		}
+	}
+}
+
 }
@@ -1,18 +1,25 @@
 #pragma once
 #include "FrameSourceBase.h"
+#include "FrameHandoff.h"
 
 namespace Magpie::Core {
 
+// GDI 捕获可能很慢，因此在专门的线程中按屏幕刷新率用 BitBlt 捕获到 DIB，后端线程只需上传最新完成的帧，
+// 捕获下一帧和渲染当前帧同时进行。捕获线程和后端线程通过 FrameHandoff 交换三个 DIB，双方都不会等待对方
 class GDIFrameSource final : public FrameSourceBase {
 public:
-	virtual ~GDIFrameSource() {}
+	virtual ~GDIFrameSource();
 
 	bool IsScreenCapture() const noexcept override {
 		return false;
 	}
 
 	FrameSourceWaitType WaitType() const noexcept override {
-		return NoWait;
+		return WaitForEvent;
+	}
+
+	HANDLE NewFrameEvent() const noexcept override {
+		return _newFrameEvent.get();
 	}
 
 	const char* Name() const noexcept override {
@@ -33,8 +40,33 @@ protected:
 	}
 
 private:
+	void _CaptureThreadProc() noexcept;
+
 	RECT _frameRect{};
-	winrt::com_ptr<IDXGISurface1> _dxgiSurface;
+
+	struct _CaptureBuffer {
+		wil::unique_hbitmap hBitmap;
+		// 选入了 hBitmap，先于它销毁
+		wil::unique_hdc hdc;
+		const uint8_t* bits = nullptr;
+		// 捕获完成的时间
+		std::chrono::steady_clock::time_point captureTime;
+	};
+	// 捕获线程写入 _handoff.BackBufferIndex()，后端线程读取 _handoff.FrontBufferIndex()
+	std::array<_CaptureBuffer, FrameHandoff::BUFFER_COUNT> _captureBuffers;
+	FrameHandoff _handoff;
+	std::chrono::nanoseconds _captureInterval{};
+
+	// 捕获线程发布新帧或出错时触发
+	wil::unique_event_nothrow _newFrameEvent;
+	wil::unique_event_nothrow _stopEvent;
+	std::thread _captureThread;
+
+	// 以下由捕获线程写入
+	std::atomic<bool> _hasCaptureError = false;
+	std::atomic<uint32_t> _capturedCount = 0;
+	// 后端取走前就被下一帧替换的帧
+	std::atomic<uint32_t> _replacedCount = 0;
 };
 
 }
@@ -6,7 +6,6 @@
 #include "Logger.h"
 #include <Windows.Graphics.DirectX.Direct3D11.interop.h>
 #include "Win32Utils.h"
-#include "DirectXHelper.h"
 #include "ScalingOptions.h"
 #include "ScalingWindow.h"
 
@@ -70,17 +69,9 @@ bool GraphicsCaptureFrameSource::_Initialize() noexcept {
 		}
 	}
 
-	_output = DirectXHelper::CreateTexture2D(
-		d3dDevice,
-		DXGI_FORMAT_B8G8R8A8_UNORM,
-		_frameBox.right - _frameBox.left,
-		_frameBox.bottom - _frameBox.top,
-		D3D11_BIND_SHADER_RESOURCE
-	);
-	if (!_output) {
-		Logger::Get().Error("创建纹理失败");
-		return false;
-	}
+	// 帧的尺寸为包含源窗口的最小尺寸，第一个效果可以直接读取其中的 _frameBox 区域
+	_frameTextureSize = { (LONG)_frameBox.right, (LONG)_frameBox.bottom };
+	_isOutputCropped = true;
 
 	if (!_StartCapture()) {
 		Logger::Get().Error("_StartCapture 失败");
@@ -116,7 +107,15 @@ FrameSourceBase::UpdateState GraphicsCaptureFrameSource::_Update() noexcept {
 		return UpdateState::Error;
 	}
 
-	_deviceResources->GetD3DDC()->CopySubresourceRegion(_output.get(), 0, 0, 0, 0, withFrame.get(), 0, &_frameBox);
+	if (!_UpdateOutput(withFrame.get())) {
+		Logger::Get().Error("_UpdateOutput 失败");
+		return UpdateState::Error;
+	}
+
+	if (_isOutputCropped) {
+		// 替换上一帧，使其回到缓冲池
+		_frame = std::move(frame);
+	}
 
 	return UpdateState::NewFrame;
 }
@@ -409,7 +408,8 @@ bool GraphicsCaptureFrameSource::_StartCapture() noexcept {
 		_captureFramePool = winrt::Direct3D11CaptureFramePool::Create(
 			_wrappedD3DDevice,
 			winrt::DirectXPixelFormat::B8G8R8A8UIntNormalized,
-			1,	// 帧的缓存数量
+			// 帧的缓存数量。直接输出捕获的纹理时持有一帧，需要另一个缓冲区接收新帧
+			_isOutputCropped ? 2 : 1,
 			{ (int)_frameBox.right, (int)_frameBox.bottom } // 帧的尺寸为包含源窗口的最小尺寸
 		);
 
@@ -448,6 +448,7 @@ bool GraphicsCaptureFrameSource::_StartCapture() noexcept {
 }
 
 void GraphicsCaptureFrameSource::_StopCapture() noexcept {
+	_frame = nullptr;
 	if (_captureSession) {
 		_captureSession.Close();
 		_captureSession = nullptr;
@@ -55,13 +55,13 @@ private:
 	LONG_PTR _originalOwnerExStyle = 0;
 	winrt::com_ptr<ITaskbarList> _taskbarList;
 
-	D3D11_BOX _frameBox{};
-
 	bool _isScreenCapture = false;
 
 	winrt::Windows::Graphics::Capture::GraphicsCaptureItem _captureItem{ nullptr };
 	winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool _captureFramePool{ nullptr };
 	winrt::Windows::Graphics::Capture::GraphicsCaptureSession _captureSession{ nullptr };
+	// 直接输出捕获的纹理时持有当前帧，使它在下一帧到达前不会回到缓冲池
+	winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame _frame{ nullptr };
 	winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice _wrappedD3DDevice{ nullptr };
 };
 
@@ -0,0 +1,124 @@
+// 不使用预编译头，以便在其他平台构建
+#include "LetterboxDetector.h"
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+namespace Magpie::Core {
+
+// 第一个和最后一个不是黑色的单元，全黑时返回空
+static std::optional<std::pair<uint32_t, uint32_t>> FindContent(std::span<const uint32_t> cells) noexcept {
+	const auto isContent = [](uint32_t value) {
+		return value > LetterboxDetector::BLACK_THRESHOLD;
+	};
+
+	const auto first = std::find_if(cells.begin(), cells.end(), isContent);
+	if (first == cells.end()) {
+		return std::nullopt;
+	}
+
+	const auto last = std::find_if(cells.rbegin(), cells.rend(), isContent);
+	return std::make_pair(uint32_t(first - cells.begin()), uint32_t(cells.rend() - last - 1));
+}
+
+static LetterboxDetector::Rect Union(const LetterboxDetector::Rect& l, const LetterboxDetector::Rect& r) noexcept {
+	return {
+		std::min(l.left, r.left),
+		std::min(l.top, r.top),
+		std::max(l.right, r.right),
+		std::max(l.bottom, r.bottom)
+	};
+}
+
+static LetterboxDetector::Rect Intersect(const LetterboxDetector::Rect& l, const LetterboxDetector::Rect& r) noexcept {
+	return {
+		std::max(l.left, r.left),
+		std::max(l.top, r.top),
+		std::min(l.right, r.right),
+		std::min(l.bottom, r.bottom)
+	};
+}
+
+static bool Contains(const LetterboxDetector::Rect& outer, const LetterboxDetector::Rect& inner) noexcept {
+	return inner.left >= outer.left && inner.top >= outer.top
+		&& inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+static uint64_t Area(const LetterboxDetector::Rect& rect) noexcept {
+	return (uint64_t)rect.Width() * rect.Height();
+}
+
+void LetterboxDetector::Initialize(uint32_t width, uint32_t height) noexcept {
+	_width = width;
+	_height = height;
+	_activeRect = _FullRect();
+	_pendingCount = 0;
+	_shrinkDelay = SHRINK_DELAY;
+	_statistics = {};
+}
+
+bool LetterboxDetector::Update(std::span<const uint32_t> rowMax, std::span<const uint32_t> columnMax) noexcept {
+	++_statistics.detectionCount;
+
+	assert(rowMax.size() == RowCount(_height) && columnMax.size() == ColumnCount(_width));
+
+	const auto rows = FindContent(rowMax);
+	const auto columns = FindContent(columnMax);
+	if (!rows || !columns) {
+		++_statistics.blackFrameCount;
+		return false;
+	}
+
+	// 向外取整到单元的边界，宁可保留一些黑色也不能裁掉画面
+	const Rect contentRect{
+		columns->first * CELL_SIZE,
+		rows->first * CELL_SIZE,
+		std::min((columns->second + 1) * CELL_SIZE, _width),
+		std::min((rows->second + 1) * CELL_SIZE, _height)
+	};
+
+	if (!Contains(_activeRect, contentRect)) {
+		// 画面超出了有效区域，立即扩大。其他方向的缩小仍需等待
+		_activeRect = _SnapToFull(Union(_activeRect, contentRect));
+		_pendingCount = 0;
+		_shrinkDelay = std::min(_shrinkDelay * 2, MAX_SHRINK_DELAY);
+		++_statistics.growCount;
+		return true;
+	}
+
+	_pendingRect = _pendingCount == 0 ? contentRect : Union(_pendingRect, contentRect);
+	if (++_pendingCount < _shrinkDelay) {
+		return false;
+	}
+	_pendingCount = 0;
+
+	// 黑边通常对称，两侧取较窄的一边，暗场景中偏向一侧的画面因此不会导致过度裁剪。
+	// 单侧有字幕等内容时已经通过扩大包含在内。缩小不会使有效区域在任何方向上扩大
+	const uint32_t horzBar = std::min(_pendingRect.left, _width - _pendingRect.right);
+	const uint32_t vertBar = std::min(_pendingRect.top, _height - _pendingRect.bottom);
+	const Rect shrunkRect = _SnapToFull(Intersect(_activeRect, {
+		horzBar,
+		vertBar,
+		_width - horzBar,
+		_height - vertBar
+	}));
+
+	if (shrunkRect == _activeRect || !_IsSavingEnough(_activeRect, shrunkRect)) {
+		return false;
+	}
+
+	_activeRect = shrunkRect;
+	++_statistics.shrinkCount;
+	return true;
+}
+
+LetterboxDetector::Rect LetterboxDetector::_SnapToFull(const Rect& rect) const noexcept {
+	const Rect fullRect = _FullRect();
+	return _IsSavingEnough(fullRect, rect) ? rect : fullRect;
+}
+
+bool LetterboxDetector::_IsSavingEnough(const Rect& from, const Rect& to) const noexcept {
+	return double(Area(from)) - double(Area(to)) >= MIN_SAVED_AREA * double(Area(_FullRect()));
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+namespace Magpie::Core {
+
+// 根据 LetterboxCS 的归约结果检测画面四周的黑边，有效区域扩大时立即生效，缩小需要多次确认
+class LetterboxDetector {
+public:
+	static constexpr uint32_t CELL_SIZE = 8;
+	// 不超过此值视为黑色。视频中的黑色常为 16 且有噪声
+	static constexpr uint32_t BLACK_THRESHOLD = 24;
+	// 有效区域连续这么多次检测都小于当前区域时才缩小
+	static constexpr uint32_t SHRINK_DELAY = 60;
+	static constexpr uint32_t MAX_SHRINK_DELAY = SHRINK_DELAY * 16;
+	// 裁剪或缩小节省的面积不足整个帧的这个比例时不值得重建资源
+	static constexpr float MIN_SAVED_AREA = 0.05f;
+
+	// 单位为像素，right 和 bottom 不包含在内
+	struct Rect {
+		uint32_t left = 0;
+		uint32_t top = 0;
+		uint32_t right = 0;
+		uint32_t bottom = 0;
+
+		uint32_t Width() const noexcept {
+			return right - left;
+		}
+
+		uint32_t Height() const noexcept {
+			return bottom - top;
+		}
+
+		bool operator==(const Rect&) const noexcept = default;
+	};
+
+	static uint32_t RowCount(uint32_t height) noexcept {
+		return (height + CELL_SIZE - 1) / CELL_SIZE;
+	}
+
+	static uint32_t ColumnCount(uint32_t width) noexcept {
+		return (width + CELL_SIZE - 1) / CELL_SIZE;
+	}
+
+	void Initialize(uint32_t width, uint32_t height) noexcept;
+
+	// 处理一次归约的结果，返回 true 表示 ActiveRect 变化。rowMax 和 columnMax 的长度分别为
+	// RowCount 和 ColumnCount
+	bool Update(std::span<const uint32_t> rowMax, std::span<const uint32_t> columnMax) noexcept;
+
+	const Rect& ActiveRect() const noexcept {
+		return _activeRect;
+	}
+
+	bool IsCropped() const noexcept {
+		return _activeRect != _FullRect();
+	}
+
+	struct Statistics {
+		uint32_t detectionCount = 0;
+		// 全黑的帧无法判断有效区域，被忽略
+		uint32_t blackFrameCount = 0;
+		uint32_t growCount = 0;
+		uint32_t shrinkCount = 0;
+	};
+
+	const Statistics& GetStatistics() const noexcept {
+		return _statistics;
+	}
+
+private:
+	Rect _FullRect() const noexcept {
+		return { 0, 0, _width, _height };
+	}
+
+	// 节省的面积太小时返回整个帧
+	Rect _SnapToFull(const Rect& rect) const noexcept;
+
+	bool _IsSavingEnough(const Rect& from, const Rect& to) const noexcept;
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+
+	Rect _activeRect;
+	// 自上次变化以来所有检测结果的并集
+	Rect _pendingRect;
+	uint32_t _pendingCount = 0;
+	uint32_t _shrinkDelay = SHRINK_DELAY;
+
+	Statistics _statistics;
+};
+
+}
@@ -0,0 +1,555 @@
+#include "pch.h"
+#include "OfflineRenderer.h"
+#include "DeviceResources.h"
+#include "BackendDescriptorStore.h"
+#include "EffectDrawer.h"
+#include "EffectsProfiler.h"
+#include "EffectCompiler.h"
+#include "EffectHelper.h"
+#include "TextureLoader.h"
+#include "DirectXHelper.h"
+#include "Logger.h"
+#include "StrUtils.h"
+#include <wincodec.h>
+
+namespace Magpie::Core {
+
+static EffectDesc CreateEffectDesc(const EffectOption& effectOption) noexcept {
+	EffectDesc desc;
+
+	desc.name = StrUtils::UTF16ToUTF8(effectOption.name);
+
+	if (effectOption.flags & EffectOptionFlags::InlineParams) {
+		desc.flags |= EffectFlags::InlineParams;
+	}
+	if (effectOption.flags & EffectOptionFlags::FP16) {
+		desc.flags |= EffectFlags::FP16;
+	}
+
+	return desc;
+}
+
+static bool IsSameInput(const D3D11_TEXTURE2D_DESC& l, const D3D11_TEXTURE2D_DESC& r) noexcept {
+	return l.Width == r.Width && l.Height == r.Height && l.Format == r.Format
+		&& l.MipLevels == r.MipLevels && l.ArraySize == r.ArraySize;
+}
+
+static const GUID* GetContainerFormat(std::wstring_view fileName) noexcept {
+	const std::wstring suffix = StrUtils::ToLowerCase(fileName.substr(fileName.find_last_of(L'.') + 1));
+
+	if (suffix == L"png") {
+		return &GUID_ContainerFormatPng;
+	} else if (suffix == L"bmp") {
+		return &GUID_ContainerFormatBmp;
+	} else if (suffix == L"jpg" || suffix == L"jpeg") {
+		return &GUID_ContainerFormatJpeg;
+	} else if (suffix == L"tif" || suffix == L"tiff") {
+		return &GUID_ContainerFormatTiff;
+	} else {
+		return nullptr;
+	}
+}
+
+// 效果链的输出为 R8G8B8A8_UNORM
+static bool SaveTexture(
+	ID3D11Device* d3dDevice,
+	ID3D11DeviceContext* d3dDC,
+	ID3D11Texture2D* texture,
+	const wchar_t* fileName
+) noexcept {
+	const GUID* containerFormat = GetContainerFormat(fileName);
+	if (!containerFormat) {
+		Logger::Get().Error("不支持的输出格式");
+		return false;
+	}
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+
+	winrt::com_ptr<ID3D11Texture2D> stagingTexture;
+	HRESULT hr = d3dDevice->CreateTexture2D(&desc, nullptr, stagingTexture.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateTexture2D 失败", hr);
+		return false;
+	}
+
+	d3dDC->CopyResource(stagingTexture.get(), texture);
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	hr = d3dDC->Map(stagingTexture.get(), 0, D3D11_MAP_READ, 0, &ms);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("Map 失败", hr);
+		return false;
+	}
+
+	auto se = wil::scope_exit([&]() {
+		d3dDC->Unmap(stagingTexture.get(), 0);
+	});
+
+	winrt::com_ptr<IWICImagingFactory2> wicImgFactory =
+		winrt::try_create_instance<IWICImagingFactory2>(CLSID_WICImagingFactory);
+	if (!wicImgFactory) {
+		Logger::Get().Error("创建 WICImagingFactory 失败");
+		return false;
+	}
+
+	winrt::com_ptr<IWICBitmap> bitmap;
+	hr = wicImgFactory->CreateBitmapFromMemory(desc.Width, desc.Height, GUID_WICPixelFormat32bppRGBA,
+		ms.RowPitch, ms.RowPitch * desc.Height, (BYTE*)ms.pData, bitmap.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateBitmapFromMemory 失败", hr);
+		return false;
+	}
+
+	winrt::com_ptr<IWICStream> stream;
+	hr = wicImgFactory->CreateStream(stream.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateStream 失败", hr);
+		return false;
+	}
+
+	hr = stream->InitializeFromFilename(fileName, GENERIC_WRITE);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("InitializeFromFilename 失败", hr);
+		return false;
+	}
+
+	winrt::com_ptr<IWICBitmapEncoder> encoder;
+	hr = wicImgFactory->CreateEncoder(*containerFormat, nullptr, encoder.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateEncoder 失败", hr);
+		return false;
+	}
+
+	hr = encoder->Initialize(stream.get(), WICBitmapEncoderNoCache);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("IWICBitmapEncoder::Initialize 失败", hr);
+		return false;
+	}
+
+	winrt::com_ptr<IWICBitmapFrameEncode> frame;
+	hr = encoder->CreateNewFrame(frame.put(), nullptr);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateNewFrame 失败", hr);
+		return false;
+	}
+
+	hr = frame->Initialize(nullptr);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("IWICBitmapFrameEncode::Initialize 失败", hr);
+		return false;
+	}
+
+	// 编码器不支持 RGBA 时 WriteSource 会转换格式，如 JPEG 丢弃 Alpha 通道
+	hr = frame->WriteSource(bitmap.get(), nullptr);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("WriteSource 失败", hr);
+		return false;
+	}
+
+	hr = frame->Commit();
+	if (FAILED(hr)) {
+		Logger::Get().ComError("IWICBitmapFrameEncode::Commit 失败", hr);
+		return false;
+	}
+
+	hr = encoder->Commit();
+	if (FAILED(hr)) {
+		Logger::Get().ComError("IWICBitmapEncoder::Commit 失败", hr);
+		return false;
+	}
+
+	return true;
+}
+
+// 第 ceil(p * n) 小的值
+static float Percentile(std::vector<float>& values, float p) noexcept {
+	if (values.empty()) {
+		return 0;
+	}
+
+	const size_t rank = std::max((size_t)std::ceil(p * values.size()), (size_t)1);
+	std::nth_element(values.begin(), values.begin() + (rank - 1), values.end());
+	return values[rank - 1];
+}
+
+// 离线渲染的设备和效果链。效果只编译一次，输入的尺寸或格式改变时重新创建纹理
+class OfflineEffectChain {
+public:
+	bool Initialize(const OfflineRenderOptions& options) noexcept;
+
+	// 渲染 repeatCount 次，保存最后一次的结果
+	bool Render(const wchar_t* inputPath, const wchar_t* outputPath) noexcept;
+
+	void AppendStatistics(std::string& report) noexcept;
+
+private:
+	bool _BuildEffects(const D3D11_TEXTURE2D_DESC& inputDesc) noexcept;
+
+	void _RenderOnce() noexcept;
+
+	const OfflineRenderOptions* _options = nullptr;
+
+	DeviceResources _deviceResources;
+	std::vector<std::shared_ptr<const EffectDesc>> _effectDescs;
+
+	// 以下由 _BuildEffects 创建
+	// 不能移动赋值，因此每次重建时原地构造
+	std::optional<BackendDescriptorStore> _descriptorStore;
+	std::vector<EffectDrawer> _effectDrawers;
+	std::vector<winrt::com_ptr<ID3D11Texture2D>> _textures;
+	winrt::com_ptr<ID3D11Texture2D> _inputTexture;
+	ID3D11Texture2D* _outputTexture = nullptr;
+
+	winrt::com_ptr<ID3D11Buffer> _dynamicCB;
+	winrt::com_ptr<ID3D11Buffer> _tileOffsetCB;
+	winrt::com_ptr<ID3D11Fence> _d3dFence;
+	uint64_t _fenceValue = 0;
+	wil::unique_event_nothrow _fenceEvent;
+	uint32_t _frameCount = 0;
+
+	EffectsProfiler _effectsProfiler;
+	// 每帧从提交到 GPU 完成的用时
+	std::vector<float> _frameTimes;
+	// 每个通道的总耗时和统计的帧数
+	std::vector<double> _passTotals;
+	uint32_t _profiledFrameCount = 0;
+};
+
+bool OfflineEffectChain::Initialize(const OfflineRenderOptions& options) noexcept {
+	_options = &options;
+
+	if (!_deviceResources.Initialize(options.graphicsCard, options.isWarp)) {
+		Logger::Get().Error("初始化 DeviceResources 失败");
+		return false;
+	}
+
+	_effectDescs.reserve(options.effects.size());
+	for (const EffectOption& effectOption : options.effects) {
+		std::shared_ptr<const EffectDesc> desc = EffectCompiler::CompileShared(
+			CreateEffectDesc(effectOption), options.compileFlags, &effectOption.parameters);
+		if (!desc) {
+			Logger::Get().Error(StrUtils::Concat("编译 ", StrUtils::UTF16ToUTF8(effectOption.name), ".hlsl 失败"));
+			return false;
+		}
+		_effectDescs.push_back(std::move(desc));
+	}
+
+	ID3D11Device5* d3dDevice = _deviceResources.GetD3DDevice();
+
+	if (std::any_of(_effectDescs.begin(), _effectDescs.end(),
+		[](const auto& desc) { return bool(desc->flags & EffectFlags::UseDynamic); })) {
+		D3D11_BUFFER_DESC bd = {
+			.ByteWidth = 16,	// 只用 4 个字节
+			.Usage = D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE
+		};
+		HRESULT hr = d3dDevice->CreateBuffer(&bd, nullptr, _dynamicCB.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
+	HRESULT hr = d3dDevice->CreateFence(
+		_fenceValue, D3D11_FENCE_FLAG_NONE, IID_PPV_ARGS(&_d3dFence));
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateFence 失败", hr);
+		return false;
+	}
+
+	if (!_fenceEvent.try_create(wil::EventOptions::None, nullptr)) {
+		Logger::Get().Win32Error("CreateEvent 失败");
+		return false;
+	}
+
+	return true;
+}
+
+bool OfflineEffectChain::_BuildEffects(const D3D11_TEXTURE2D_DESC& inputDesc) noexcept {
+	ID3D11Device5* d3dDevice = _deviceResources.GetD3DDevice();
+
+	// 纹理的地址可能被重用，视图的缓存必须一起重建
+	_effectDrawers.clear();
+	_textures.clear();
+	_descriptorStore.emplace();
+	_descriptorStore->Initialize(d3dDevice);
+	_effectsProfiler.Stop();
+	_outputTexture = nullptr;
+
+	D3D11_TEXTURE2D_DESC desc = inputDesc;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	_inputTexture = nullptr;
+	HRESULT hr = d3dDevice->CreateTexture2D(&desc, nullptr, _inputTexture.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateTexture2D 失败", hr);
+		return false;
+	}
+
+	const SIZE inputSize{ (LONG)inputDesc.Width, (LONG)inputDesc.Height };
+	const SIZE targetSize = _options->targetSize.cx > 0 && _options->targetSize.cy > 0 ?
+		_options->targetSize : SIZE{ inputSize.cx * 2, inputSize.cy * 2 };
+
+	const uint32_t effectCount = (uint32_t)_effectDescs.size();
+	_effectDrawers.resize(effectCount);
+
+	SIZE inOutSize = inputSize;
+	for (uint32_t i = 0; i < effectCount; ++i) {
+		if (!_effectDrawers[i].Initialize(
+			*_effectDescs[i],
+			_options->effects[i],
+			_deviceResources,
+			targetSize,
+			inOutSize
+		)) {
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, _effectDescs[i]->name));
+			return false;
+		}
+	}
+
+	// 每个中间纹理单独分配，离线渲染不在意显存
+	ID3D11Texture2D* inOutTexture = _inputTexture.get();
+	uint32_t passCount = 0;
+	SmallVector<ID3D11Texture2D*> effectTextures;
+	for (uint32_t i = 0; i < effectCount; ++i) {
+		const EffectDesc& effectDesc = *_effectDescs[i];
+		const SmallVector<SIZE>& sizes = _effectDrawers[i].TextureSizes();
+
+		effectTextures.assign(effectDesc.textures.size(), nullptr);
+		effectTextures[0] = inOutTexture;
+		for (size_t j = 1; j < effectDesc.textures.size(); ++j) {
+			const EffectIntermediateTextureDesc& texDesc = effectDesc.textures[j];
+			if (!texDesc.source.empty()) {
+				// 从文件加载的纹理由 EffectDrawer 负责
+				continue;
+			}
+
+			winrt::com_ptr<ID3D11Texture2D>& texture = _textures.emplace_back(DirectXHelper::CreateTexture2D(
+				d3dDevice,
+				EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].dxgiFormat,
+				sizes[j].cx,
+				sizes[j].cy,
+				D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+			));
+			if (!texture) {
+				Logger::Get().Error("创建纹理失败");
+				return false;
+			}
+			effectTextures[j] = texture.get();
+		}
+
+		if (!_effectDrawers[i].BindTextures(effectDesc, effectTextures, *_descriptorStore)) {
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 的纹理失败", i, effectDesc.name));
+			return false;
+		}
+
+		inOutTexture = effectTextures[1];
+		passCount += _effectDrawers[i].PassCount();
+	}
+	_outputTexture = inOutTexture;
+
+	// 有 FOOTPRINT 的通道即使完整渲染也需要起始块
+	if (!_tileOffsetCB && std::any_of(_effectDrawers.begin(), _effectDrawers.end(),
+		[](const EffectDrawer& drawer) { return drawer.HasFootprintPass(); })) {
+		D3D11_BUFFER_DESC bd = {
+			.ByteWidth = 16,	// 只用 8 个字节
+			.Usage = D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE
+		};
+		hr = d3dDevice->CreateBuffer(&bd, nullptr, _tileOffsetCB.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
+	_effectsProfiler.Start(d3dDevice, passCount);
+	_passTotals.assign(passCount, 0.0);
+	_profiledFrameCount = 0;
+
+	Logger::Get().Info(fmt::format("离线渲染: 输入尺寸 {}x{}，输出尺寸 {}x{}",
+		inputSize.cx, inputSize.cy, inOutSize.cx, inOutSize.cy));
+	return true;
+}
+
+void OfflineEffectChain::_RenderOnce() noexcept {
+	ID3D11DeviceContext4* d3dDC = _deviceResources.GetD3DDC();
+	d3dDC->ClearState();
+
+	if (ID3D11Buffer* t = _dynamicCB.get()) {
+		// cbuffer __CB2 : register(b1) { uint __frameCount; };
+		D3D11_MAPPED_SUBRESOURCE ms;
+		HRESULT hr = d3dDC->Map(t, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms);
+		if (SUCCEEDED(hr)) {
+			std::memcpy(ms.pData, &_frameCount, 4);
+			d3dDC->Unmap(t, 0);
+		} else {
+			Logger::Get().ComError("Map 失败", hr);
+		}
+		d3dDC->CSSetConstantBuffers(1, 1, &t);
+	}
+	++_frameCount;
+
+	ID3D11Buffer* tileOffsetCB = _tileOffsetCB.get();
+	if (tileOffsetCB) {
+		d3dDC->CSSetConstantBuffers(2, 1, &tileOffsetCB);
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	_effectsProfiler.OnBeginEffects(d3dDC);
+	for (const EffectDrawer& effectDrawer : _effectDrawers) {
+		effectDrawer.Draw(_effectsProfiler, {}, tileOffsetCB);
+	}
+	_effectsProfiler.OnEndEffects(d3dDC);
+
+	// 和 Renderer 相同地等待 GPU 完成，使每帧的用时互不重叠。不能轮询，否则会占用 WARP 的 CPU 时间
+	HRESULT hr = d3dDC->Signal(_d3dFence.get(), ++_fenceValue);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("Signal 失败", hr);
+		return;
+	}
+
+	hr = _d3dFence->SetEventOnCompletion(_fenceValue, _fenceEvent.get());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("SetEventOnCompletion 失败", hr);
+		return;
+	}
+
+	d3dDC->Flush();
+	_fenceEvent.wait();
+
+	_frameTimes.push_back(std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - startTime).count());
+
+	// GPU 已完成，查询结果一定可用
+	_effectsProfiler.QueryTimings(d3dDC);
+	const SmallVector<float> timings = _effectsProfiler.GetTimings();
+	if (timings.size() == _passTotals.size()) {
+		for (size_t i = 0; i < timings.size(); ++i) {
+			_passTotals[i] += timings[i];
+		}
+		++_profiledFrameCount;
+	}
+}
+
+bool OfflineEffectChain::Render(const wchar_t* inputPath, const wchar_t* outputPath) noexcept {
+	winrt::com_ptr<ID3D11Texture2D> image = TextureLoader::Load(inputPath, _deviceResources.GetD3DDevice());
+	if (!image) {
+		Logger::Get().Error("加载输入图像失败");
+		return false;
+	}
+
+	D3D11_TEXTURE2D_DESC imageDesc;
+	image->GetDesc(&imageDesc);
+
+	bool isSameInput = false;
+	if (_inputTexture && _outputTexture) {
+		D3D11_TEXTURE2D_DESC inputDesc;
+		_inputTexture->GetDesc(&inputDesc);
+		isSameInput = IsSameInput(inputDesc, imageDesc);
+	}
+
+	if (!isSameInput && !_BuildEffects(imageDesc)) {
+		Logger::Get().Error("_BuildEffects 失败");
+		return false;
+	}
+
+	ID3D11DeviceContext4* d3dDC = _deviceResources.GetD3DDC();
+	d3dDC->CopyResource(_inputTexture.get(), image.get());
+
+	for (uint32_t i = 0; i < _options->repeatCount; ++i) {
+		_RenderOnce();
+	}
+
+	return SaveTexture(_deviceResources.GetD3DDevice(), d3dDC, _outputTexture, outputPath);
+}
+
+void OfflineEffectChain::AppendStatistics(std::string& report) noexcept {
+	if (_frameTimes.empty()) {
+		return;
+	}
+
+	double totalMs = 0;
+	for (float ms : _frameTimes) {
+		totalMs += ms;
+	}
+
+	fmt::format_to(std::back_inserter(report),
+		"共渲染 {} 帧，每帧平均 {:.3f} 毫秒，p50 {:.3f} 毫秒，p95 {:.3f} 毫秒，p99 {:.3f} 毫秒\n",
+		_frameTimes.size(), totalMs / _frameTimes.size(), Percentile(_frameTimes, 0.50f),
+		Percentile(_frameTimes, 0.95f), Percentile(_frameTimes, 0.99f));
+
+	// 只统计最后一种输入尺寸的帧
+	if (_profiledFrameCount == 0) {
+		return;
+	}
+
+	fmt::format_to(std::back_inserter(report), "最后一种输入尺寸的 GPU 耗时 ({} 帧平均):\n", _profiledFrameCount);
+	size_t passIdx = 0;
+	for (const std::shared_ptr<const EffectDesc>& desc : _effectDescs) {
+		double effectMs = 0;
+		for (size_t i = 0; i < desc->passes.size(); ++i) {
+			effectMs += _passTotals[passIdx + i];
+		}
+		fmt::format_to(std::back_inserter(report), "  {}: {:.3f} 毫秒\n", desc->name, effectMs / _profiledFrameCount);
+
+		if (desc->passes.size() > 1) {
+			for (const EffectPassDesc& passDesc : desc->passes) {
+				fmt::format_to(std::back_inserter(report), "    {}: {:.3f} 毫秒\n",
+					passDesc.desc, _passTotals[passIdx++] / _profiledFrameCount);
+			}
+		} else {
+			passIdx += desc->passes.size();
+		}
+	}
+}
+
+bool OfflineRenderer::Run(const OfflineRenderOptions& options, std::string& report) noexcept {
+	assert(options.inputPaths.size() == options.outputPaths.size());
+	report.clear();
+
+	if (options.effects.empty() || options.repeatCount == 0) {
+		Logger::Get().Error("离线渲染的选项不合法");
+		return false;
+	}
+
+	OfflineEffectChain effectChain;
+	if (!effectChain.Initialize(options)) {
+		Logger::Get().Error("初始化离线渲染失败");
+		return false;
+	}
+
+	uint32_t failedCount = 0;
+	for (size_t i = 0; i < options.inputPaths.size(); ++i) {
+		const std::wstring& inputPath = options.inputPaths[i];
+		const std::wstring& outputPath = options.outputPaths[i];
+
+		const bool success = effectChain.Render(inputPath.c_str(), outputPath.c_str());
+		if (!success) {
+			++failedCount;
+		}
+
+		fmt::format_to(std::back_inserter(report), "{} -> {}: {}\n", StrUtils::UTF16ToUTF8(inputPath),
+			StrUtils::UTF16ToUTF8(outputPath), success ? "成功" : "失败");
+	}
+
+	effectChain.AppendStatistics(report);
+
+	Logger::Get().Info(fmt::format("离线渲染完成，{} 个图像，{} 个失败\n{}",
+		options.inputPaths.size(), failedCount, report));
+	return failedCount == 0;
+}
+
+}
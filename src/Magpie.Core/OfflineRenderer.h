@@ -0,0 +1,31 @@
+#pragma once
+#include "ScalingOptions.h"
+
+namespace Magpie::Core {
+
+struct OfflineRenderOptions {
+	// 同 ScalingOptions::effects
+	std::vector<EffectOption> effects;
+	// 输入和输出的图像文件，一一对应
+	std::vector<std::wstring> inputPaths;
+	std::vector<std::wstring> outputPaths;
+	// 相当于缩放窗口的尺寸，用于 Fit 和 Fill 缩放。为 0 时为输入尺寸的两倍
+	SIZE targetSize{};
+	// EffectCompilerFlags
+	uint32_t compileFlags = 0;
+	// 每个图像渲染的次数，只保存最后一次的结果。大于 1 时用于测量效果链的性能
+	uint32_t repeatCount = 1;
+	int graphicsCard = -1;
+	// 使用 WARP 而不是显卡，结果不依赖硬件
+	bool isWarp = false;
+};
+
+// 不创建窗口和交换链，对图像文件执行效果链并保存结果。用于批量放大图像，以及不依赖窗口捕获、
+// 可以重现的性能测试。不融合效果，因此可以统计每个效果每个通道的耗时
+struct OfflineRenderer {
+	// 逐个渲染并保存，某个图像失败时继续渲染其余图像。report 为每个图像的结果和耗时统计。
+	// 所有图像都成功时返回 true
+	static bool Run(const OfflineRenderOptions& options, std::string& report) noexcept;
+};
+
+}
@@ -22,6 +22,19 @@ namespace Magpie::Core {
 static const char* COLOR_INDICATOR = "■";
 static const wchar_t COLOR_INDICATOR_W = L'■';
 
+// 导出到 logs 文件夹，文件名包含当前时间
+static void ExportFrameTimings(const FrameTimingRecorder& frameTimings, bool isJson) noexcept {
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+	const std::wstring fileName = fmt::format(L"logs\\frame_timings_{:04}{:02}{:02}_{:02}{:02}{:02}.{}",
+		time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, isJson ? L"json" : L"csv");
+
+	const std::string text = isJson ? frameTimings.ExportJson() : frameTimings.ExportCsv();
+	if (Win32Utils::WriteTextFile(fileName.c_str(), text)) {
+		Logger::Get().Info(StrUtils::Concat("已导出帧时间: ", StrUtils::UTF16ToUTF8(fileName)));
+	}
+}
+
 OverlayDrawer::OverlayDrawer() :
 	_resourceLoader(winrt::ResourceLoader::GetForViewIndependentUse(CommonSharedConstants::APP_RESOURCE_MAP_ID))
 {}
@@ -853,6 +866,14 @@ bool OverlayDrawer::_DrawUI(const SmallVector<float>& effectTimings, uint32_t fp
 	}
 	const std::string& frameRateStr = _GetResourceString(L"Overlay_Profiler_FrameRate");
 	ImGui::TextUnformatted(fmt::format("{}: {} FPS", frameRateStr, fps).c_str());
+	if (renderer.IsFramePacingEnabled()) {
+		const std::pair<float, float> latency = renderer.FrameLatency();
+		ImGui::TextUnformatted(StrUtils::Concat(_GetResourceString(L"Overlay_Profiler_Latency"), ": ").c_str());
+		ImGui::SameLine(0, 0);
+		ImGui::PushFont(_fontMonoNumbers);
+		ImGui::TextUnformatted(fmt::format("{:.1f} ms (P99 {:.1f} ms)", latency.first, latency.second).c_str());
+		ImGui::PopFont();
+	}
 	ImGui::PopTextWrapPos();
 
 	ImGui::Spacing();
@@ -1102,6 +1123,59 @@ bool OverlayDrawer::_DrawUI(const SmallVector<float>& effectTimings, uint32_t fp
 				ImGui::EndTable();
 			}
 		}
+
+		// 最近几百帧各阶段用时的分布
+		ImGui::Spacing();
+		ImGui::TextUnformatted(_GetResourceString(L"Overlay_Profiler_FrameTimings").c_str());
+		const FrameTimingRecorder& frameTimings = renderer.FrameTimings();
+		if (ImGui::BeginTable("frameTimings", 4, ImGuiTableFlags_PadOuterX)) {
+			ImGui::TableSetupColumn(nullptr, ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoResize | ImGuiTableColumnFlags_NoReorder);
+			for (const char* name : { "P50", "P95", "P99" }) {
+				ImGui::TableSetupColumn(name, ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize | ImGuiTableColumnFlags_NoReorder);
+			}
+			ImGui::TableHeadersRow();
+
+			static constexpr const wchar_t* STAGE_KEYS[] = {
+				L"Overlay_Profiler_FrameTimings_SourceCapture",
+				L"Overlay_Profiler_FrameTimings_SourceQueue",
+				L"Overlay_Profiler_FrameTimings_CaptureWait",
+				L"Overlay_Profiler_FrameTimings_DuplicateCheck",
+				L"Overlay_Profiler_FrameTimings_Effects",
+				L"Overlay_Profiler_FrameTimings_Handoff",
+				L"Overlay_Profiler_FrameTimings_Present"
+			};
+			static_assert(std::size(STAGE_KEYS) == FrameTimingRecorder::STAGE_COUNT);
+
+			for (uint32_t i = 0; i < FrameTimingRecorder::STAGE_COUNT; ++i) {
+				const FrameTimingRecorder::Percentiles percentiles =
+					frameTimings.GetPercentiles((FrameTimingRecorder::Stage)i);
+				// 有些阶段只有部分帧源会记录
+				if (percentiles.count == 0) {
+					continue;
+				}
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(_GetResourceString(STAGE_KEYS[i]).c_str());
+
+				ImGui::PushFont(_fontMonoNumbers);
+				for (float value : { percentiles.p50, percentiles.p95, percentiles.p99 }) {
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(fmt::format("{:.2f}", value).c_str());
+				}
+				ImGui::PopFont();
+			}
+
+			ImGui::EndTable();
+		}
+
+		if (ImGui::Button(_GetResourceString(L"Overlay_Profiler_FrameTimings_ExportCsv").c_str())) {
+			ExportFrameTimings(frameTimings, false);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button(_GetResourceString(L"Overlay_Profiler_FrameTimings_ExportJson").c_str())) {
+			ExportFrameTimings(frameTimings, true);
+		}
 	}
 	
 	ImGui::End();
@@ -0,0 +1,38 @@
+// 不使用预编译头，以便在其他平台构建
+#include "ReadbackRing.h"
+#include <algorithm>
+
+namespace Magpie::Core {
+
+void ReadbackRing::Initialize(uint32_t depth) noexcept {
+	_slots.assign(std::max(depth, 1u), 0);
+	_oldest = 0;
+	_pendingCount = 0;
+	_droppedCount = 0;
+}
+
+std::optional<uint32_t> ReadbackRing::Submit(uint64_t frameIndex) noexcept {
+	if (_pendingCount == Depth()) {
+		++_droppedCount;
+		return std::nullopt;
+	}
+
+	const uint32_t slot = (_oldest + _pendingCount) % Depth();
+	_slots[slot] = frameIndex;
+	++_pendingCount;
+	return slot;
+}
+
+void ReadbackRing::Reset() noexcept {
+	_oldest = 0;
+	_pendingCount = 0;
+}
+
+std::optional<uint64_t> ReadbackRing::OldestPendingFrame() const noexcept {
+	if (_pendingCount == 0) {
+		return std::nullopt;
+	}
+	return _slots[_oldest];
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 管理回读槽位，GPU 完成后按提交顺序取回。环已满时放弃新的请求，调用者从不等待 GPU
+class ReadbackRing {
+public:
+	void Initialize(uint32_t depth) noexcept;
+
+	uint32_t Depth() const noexcept {
+		return (uint32_t)_slots.size();
+	}
+
+	// 为第 frameIndex 帧的请求分配槽位，环已满时返回空
+	std::optional<uint32_t> Submit(uint64_t frameIndex) noexcept;
+
+	// 按提交顺序取回已完成的请求，遇到第一个未完成的请求时停止。
+	// tryRead(slot, frameIndex) 不应阻塞，返回 false 表示 GPU 尚未完成。返回取回的请求数
+	template <typename TryRead>
+	uint32_t Poll(TryRead&& tryRead) noexcept {
+		uint32_t count = 0;
+		while (_pendingCount > 0) {
+			const uint32_t slot = _oldest;
+			if (!tryRead(slot, _slots[slot])) {
+				break;
+			}
+
+			_oldest = (_oldest + 1) % Depth();
+			--_pendingCount;
+			++count;
+		}
+		return count;
+	}
+
+	// 放弃所有未取回的请求，如资源被重新创建时
+	void Reset() noexcept;
+
+	uint32_t PendingCount() const noexcept {
+		return _pendingCount;
+	}
+
+	// 最早的未取回的请求的帧号
+	std::optional<uint64_t> OldestPendingFrame() const noexcept;
+
+	// 因为环已满而被放弃的请求数
+	uint64_t DroppedCount() const noexcept {
+		return _droppedCount;
+	}
+
+private:
+	// 每个槽位的帧号
+	std::vector<uint64_t> _slots;
+	uint32_t _oldest = 0;
+	uint32_t _pendingCount = 0;
+	uint64_t _droppedCount = 0;
+};
+
+}
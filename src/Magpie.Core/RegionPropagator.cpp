@@ -0,0 +1,285 @@
+// 不使用预编译头，以便在其他平台构建
+#include "RegionPropagator.h"
+#include <algorithm>
+#include <limits>
+
+namespace Magpie::Core {
+
+// 超过此数量的矩形直接合并为它们的外接矩形，避免合并的开销随矩形数快速增长
+static constexpr uint32_t MAX_RECTS_TO_MERGE = 64;
+
+static int64_t FloorDiv(int64_t a, int64_t b) noexcept {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t CeilDiv(int64_t a, int64_t b) noexcept {
+	return -FloorDiv(-a, b);
+}
+
+static RegionPropagator::Rect Union(const RegionPropagator::Rect& l, const RegionPropagator::Rect& r) noexcept {
+	return {
+		std::min(l.left, r.left),
+		std::min(l.top, r.top),
+		std::max(l.right, r.right),
+		std::max(l.bottom, r.bottom)
+	};
+}
+
+static RegionPropagator::Rect Intersect(const RegionPropagator::Rect& l, const RegionPropagator::Rect& r) noexcept {
+	return {
+		std::max(l.left, r.left),
+		std::max(l.top, r.top),
+		std::min(l.right, r.right),
+		std::min(l.bottom, r.bottom)
+	};
+}
+
+static RegionPropagator::Rect FullRect(uint32_t width, uint32_t height) noexcept {
+	return { 0, 0, (int32_t)width, (int32_t)height };
+}
+
+static RegionPropagator::Rect FullTiles(
+	const RegionPropagator::Texture& output,
+	std::pair<uint32_t, uint32_t> blockSize
+) noexcept {
+	return FullRect(
+		(output.width + blockSize.first - 1) / blockSize.first,
+		(output.height + blockSize.second - 1) / blockSize.second
+	);
+}
+
+bool RegionPropagator::Initialize(std::vector<Texture> textures, std::vector<Pass> passes, uint32_t inputIdx) noexcept {
+	_textures = std::move(textures);
+	_passes = std::move(passes);
+	_inputIdx = inputIdx;
+
+	const uint32_t textureCount = (uint32_t)_textures.size();
+	const uint32_t passCount = (uint32_t)_passes.size();
+
+	std::vector<uint32_t> writerCounts(textureCount);
+	for (const Pass& pass : _passes) {
+		for (uint32_t idx : pass.outputs) {
+			++writerCounts[idx];
+		}
+	}
+
+	// 纹理的变化区域能否小于整个纹理。在被写入前读取的纹理包含上一帧的内容，
+	// 本帧的变化区域未知
+	std::vector<bool> canBePartial(textureCount, false);
+	for (uint32_t i = 0; i < textureCount; ++i) {
+		canBePartial[i] = i == _inputIdx || _textures[i].isConstant;
+	}
+
+	bool hasRegionalPass = false;
+	_isPassRegional.assign(passCount, false);
+	for (uint32_t i = 0; i < passCount; ++i) {
+		const Pass& pass = _passes[i];
+
+		bool isRegional = pass.hasFootprint && !pass.isDynamic
+			&& pass.blockSize.first > 0 && pass.blockSize.second > 0 && !pass.outputs.empty();
+		for (uint32_t idx : pass.inputs) {
+			isRegional = isRegional && canBePartial[idx];
+		}
+		// 多个通道写入同一纹理时只更新一部分会留下其他通道的结果
+		for (uint32_t idx : pass.outputs) {
+			isRegional = isRegional && writerCounts[idx] == 1;
+		}
+
+		_isPassRegional[i] = isRegional;
+		hasRegionalPass |= isRegional;
+
+		for (uint32_t idx : pass.outputs) {
+			canBePartial[idx] = isRegional;
+		}
+	}
+
+	_textureRegions.assign(textureCount, {});
+	_passTiles.assign(passCount, {});
+	return hasRegionalPass;
+}
+
+void RegionPropagator::Propagate(const SmallVector<Rect>* dirtyRects) noexcept {
+	for (uint32_t i = 0; i < (uint32_t)_textures.size(); ++i) {
+		const Texture& texture = _textures[i];
+		SmallVector<Rect>& region = _textureRegions[i];
+		region.clear();
+
+		if (texture.isConstant) {
+			continue;
+		}
+
+		const Rect fullRect = FullRect(texture.width, texture.height);
+		if (i == _inputIdx && dirtyRects) {
+			for (const Rect& rect : *dirtyRects) {
+				const Rect clipped = Intersect(rect, fullRect);
+				if (!clipped.IsEmpty()) {
+					region.push_back(clipped);
+				}
+			}
+		} else {
+			// 在被写入前读取的纹理视为完全变化
+			region.push_back(fullRect);
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)_passes.size(); ++i) {
+		const Pass& pass = _passes[i];
+		SmallVector<Rect>& tiles = _passTiles[i];
+		tiles.clear();
+
+		if (pass.outputs.empty()) {
+			continue;
+		}
+
+		const Texture& output = _textures[pass.outputs[0]];
+
+		if (!dirtyRects || !_isPassRegional[i]) {
+			tiles.push_back(FullTiles(output, pass.blockSize));
+		} else {
+			const int32_t blockWidth = (int32_t)pass.blockSize.first;
+			const int32_t blockHeight = (int32_t)pass.blockSize.second;
+
+			for (uint32_t idx : pass.inputs) {
+				const Texture& input = _textures[idx];
+				for (const Rect& rect : _textureRegions[idx]) {
+					const Rect mapped = MapRect(rect, pass.footprint,
+						{ input.width, input.height }, { output.width, output.height });
+					if (mapped.IsEmpty()) {
+						continue;
+					}
+
+					// 对齐到块
+					tiles.push_back({
+						mapped.left / blockWidth,
+						mapped.top / blockHeight,
+						(mapped.right + blockWidth - 1) / blockWidth,
+						(mapped.bottom + blockHeight - 1) / blockHeight
+					});
+				}
+			}
+
+			MergeRects(tiles, MAX_RECTS_PER_PASS);
+		}
+
+		// 只有调度的块会被重写，整块重写时块内未变化的像素结果相同
+		for (uint32_t idx : pass.outputs) {
+			SmallVector<Rect>& region = _textureRegions[idx];
+			region.clear();
+
+			const Rect fullRect = FullRect(_textures[idx].width, _textures[idx].height);
+			for (const Rect& tile : tiles) {
+				region.push_back(Intersect(fullRect, {
+					tile.left * (int32_t)pass.blockSize.first,
+					tile.top * (int32_t)pass.blockSize.second,
+					tile.right * (int32_t)pass.blockSize.first,
+					tile.bottom * (int32_t)pass.blockSize.second
+				}));
+			}
+		}
+	}
+}
+
+float RegionPropagator::DispatchedRatio() const noexcept {
+	int64_t dispatched = 0;
+	int64_t total = 0;
+	for (uint32_t i = 0; i < (uint32_t)_passes.size(); ++i) {
+		const Pass& pass = _passes[i];
+		if (pass.outputs.empty()) {
+			continue;
+		}
+
+		for (const Rect& tile : _passTiles[i]) {
+			dispatched += tile.Area();
+		}
+		total += FullTiles(_textures[pass.outputs[0]], pass.blockSize).Area();
+	}
+
+	return total == 0 ? 1.0f : float(dispatched) / total;
+}
+
+RegionPropagator::Rect RegionPropagator::MapRect(
+	const Rect& rect,
+	std::pair<uint32_t, uint32_t> footprint,
+	std::pair<uint32_t, uint32_t> inputSize,
+	std::pair<uint32_t, uint32_t> outputSize
+) noexcept {
+	if (rect.IsEmpty() || inputSize.first == 0 || inputSize.second == 0) {
+		return {};
+	}
+
+	// 输出像素 x 的中心对应输入中的 u = (x + 0.5) * inputWidth / outputWidth，它读取 floor(u) 两侧
+	// footprint 范围内的像素，因此输入中 [left, right) 变化时 u 在 [left - footprint, right + footprint)
+	// 中的输出像素受影响。这里向外取整，额外的半个像素用于容纳着色器中的浮点误差
+	const auto mapRange = [](int32_t begin, int32_t end, uint32_t radius, uint32_t inSize, uint32_t outSize) {
+		const int64_t dilatedBegin = (int64_t)begin - radius;
+		const int64_t dilatedEnd = (int64_t)end + radius;
+		const int64_t mappedBegin = FloorDiv(dilatedBegin * outSize, inSize);
+		const int64_t mappedEnd = CeilDiv(dilatedEnd * outSize, inSize);
+		return std::pair<int32_t, int32_t>(
+			(int32_t)std::clamp<int64_t>(mappedBegin, 0, outSize),
+			(int32_t)std::clamp<int64_t>(mappedEnd, 0, outSize)
+		);
+	};
+
+	const auto [left, right] = mapRange(rect.left, rect.right, footprint.first, inputSize.first, outputSize.first);
+	const auto [top, bottom] = mapRange(rect.top, rect.bottom, footprint.second, inputSize.second, outputSize.second);
+	return { left, top, right, bottom };
+}
+
+void RegionPropagator::MergeRects(SmallVector<Rect>& rects, uint32_t maxCount) noexcept {
+	rects.erase(std::remove_if(rects.begin(), rects.end(),
+		[](const Rect& rect) { return rect.IsEmpty(); }), rects.end());
+
+	if (rects.size() > MAX_RECTS_TO_MERGE) {
+		Rect bounds = rects[0];
+		for (const Rect& rect : rects) {
+			bounds = Union(bounds, rect);
+		}
+		rects.assign(1, bounds);
+		return;
+	}
+
+	maxCount = std::max(maxCount, 1u);
+
+	while (rects.size() > 1) {
+		// 合并后增加的面积
+		int64_t minCost = std::numeric_limits<int64_t>::max();
+		uint32_t bestI = 0;
+		uint32_t bestJ = 0;
+		bool mergedFree = false;
+
+		for (uint32_t i = 0; i < rects.size() && !mergedFree; ++i) {
+			for (uint32_t j = i + 1; j < rects.size(); ++j) {
+				const Rect bounds = Union(rects[i], rects[j]);
+				const int64_t overlap = Intersect(rects[i], rects[j]).Area();
+				const int64_t cost = bounds.Area() - (rects[i].Area() + rects[j].Area() - overlap);
+
+				if (overlap > 0 || cost <= 0) {
+					rects[i] = bounds;
+					rects.erase(rects.begin() + j);
+					mergedFree = true;
+					break;
+				}
+
+				if (cost < minCost) {
+					minCost = cost;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+		}
+
+		if (mergedFree) {
+			continue;
+		}
+
+		if (rects.size() <= maxCount) {
+			break;
+		}
+
+		rects[bestI] = Union(rects[bestI], rects[bestJ]);
+		rects.erase(rects.begin() + bestJ);
+	}
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+// 根据帧源输出中变化的区域计算效果链中每个通道需要重新渲染的块
+class RegionPropagator {
+public:
+	// 左闭右开
+	struct Rect {
+		int32_t left = 0;
+		int32_t top = 0;
+		int32_t right = 0;
+		int32_t bottom = 0;
+
+		bool IsEmpty() const noexcept {
+			return left >= right || top >= bottom;
+		}
+
+		int64_t Area() const noexcept {
+			return IsEmpty() ? 0 : int64_t(right - left) * (bottom - top);
+		}
+
+		bool operator==(const Rect&) const noexcept = default;
+	};
+
+	struct Texture {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// 内容不随帧变化，如从文件加载的纹理
+		bool isConstant = false;
+	};
+
+	struct Pass {
+		SmallVector<uint32_t> inputs;
+		SmallVector<uint32_t> outputs;
+		// 一个线程组处理的块
+		std::pair<uint32_t, uint32_t> blockSize{ 1, 1 };
+		// 见 EffectPassDesc::footprint
+		std::pair<uint32_t, uint32_t> footprint{};
+		bool hasFootprint = false;
+		// 即使输入不变输出也可能变化，如使用帧数的通道
+		bool isDynamic = false;
+	};
+
+	// 每个通道最多调度的矩形数，超过时合并代价最小的两个
+	static constexpr uint32_t MAX_RECTS_PER_PASS = 8;
+
+	// inputIdx 为帧源输出对应的纹理，同一通道的输出应有相同的尺寸。
+	// 返回是否有通道可以只渲染一部分，否则没有必要使用区域渲染
+	bool Initialize(std::vector<Texture> textures, std::vector<Pass> passes, uint32_t inputIdx) noexcept;
+
+	// 计算新的一帧每个通道需要调度的块。dirtyRects 为帧源输出中变化的区域，为空时整帧重新渲染
+	void Propagate(const SmallVector<Rect>* dirtyRects) noexcept;
+
+	// 以块为单位，互不重叠。为空表示这一帧不需要调度该通道
+	std::span<const SmallVector<Rect>> PassTiles() const noexcept {
+		return _passTiles;
+	}
+
+	// 最近一次 Propagate 调度的块占完整渲染的比例
+	float DispatchedRatio() const noexcept;
+
+	// 输入纹理中 rect 变化时，读取范围为 footprint 的通道在输出中需要重新渲染的区域，已裁剪到输出尺寸
+	static Rect MapRect(
+		const Rect& rect,
+		std::pair<uint32_t, uint32_t> footprint,
+		std::pair<uint32_t, uint32_t> inputSize,
+		std::pair<uint32_t, uint32_t> outputSize
+	) noexcept;
+
+	// 删除空矩形，合并重叠的矩形以及合并后不增加面积的矩形，然后不断合并代价最小的两个矩形，
+	// 直到不超过 maxCount 个。结果互不重叠
+	static void MergeRects(SmallVector<Rect>& rects, uint32_t maxCount) noexcept;
+
+private:
+	std::vector<Texture> _textures;
+	std::vector<Pass> _passes;
+	uint32_t _inputIdx = 0;
+
+	// 通道可以只渲染一部分
+	std::vector<bool> _isPassRegional;
+	// 本帧纹理中变化的区域
+	std::vector<SmallVector<Rect>> _textureRegions;
+	std::vector<SmallVector<Rect>> _passTiles;
+};
+
+}
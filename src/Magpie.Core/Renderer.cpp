@@ -8,19 +8,29 @@
 #include "StrUtils.h"
 #include "Utils.h"
 #include "EffectCompiler.h"
+#include "EffectFusion.h"
 #include "GraphicsCaptureFrameSource.h"
 #include "DesktopDuplicationFrameSource.h"
 #include "GDIFrameSource.h"
 #include "DwmSharedSurfaceFrameSource.h"
+#include "ReplayFrameSource.h"
 #include "DirectXHelper.h"
 #include <dispatcherqueue.h>
 #include "ScalingWindow.h"
 #include "OverlayDrawer.h"
 #include "CursorManager.h"
 #include "EffectsProfiler.h"
+#include "TaskScheduler.h"
+#include "TextureAliasPlanner.h"
+#include "EffectHelper.h"
+#include "AutoCropper.h"
 
 namespace Magpie::Core {
 
+static int64_t ToNs(std::chrono::steady_clock::time_point time) noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
 Renderer::Renderer() noexcept {}
 
 Renderer::~Renderer() noexcept {
@@ -80,7 +90,7 @@ static void LogAdapter(IDXGIAdapter4* adapter) noexcept {
 bool Renderer::Initialize() noexcept {
 	_backendThread = std::thread(std::bind(&Renderer::_BackendThreadProc, this));
 
-	if (!_frontendResources.Initialize()) {
+	if (!_frontendResources.Initialize(ScalingWindow::Get().Options().graphicsCard)) {
 		Logger::Get().Error("初始化前端资源失败");
 		return false;
 	}
@@ -101,17 +111,20 @@ bool Renderer::Initialize() noexcept {
 	}
 
 	// 获取共享纹理
-	HRESULT hr = _frontendResources.GetD3DDevice()->OpenSharedResource(
-		sharedTextureHandle, IID_PPV_ARGS(_frontendSharedTexture.put()));
-	if (FAILED(hr)) {
-		Logger::Get().ComError("OpenSharedResource 失败", hr);
-		return false;
-	}
+	HRESULT hr = S_OK;
+	for (uint32_t i = 0; i < FrameHandoff::BUFFER_COUNT; ++i) {
+		hr = _frontendResources.GetD3DDevice()->OpenSharedResource(
+			_sharedTextureHandles[i], IID_PPV_ARGS(_frontendSharedTextures[i].put()));
+		if (FAILED(hr)) {
+			Logger::Get().ComError("OpenSharedResource 失败", hr);
+			return false;
+		}
 
-	_frontendSharedTextureMutex = _frontendSharedTexture.try_as<IDXGIKeyedMutex>();
+		_frontendSharedTextureMutexes[i] = _frontendSharedTextures[i].try_as<IDXGIKeyedMutex>();
+	}
 
 	D3D11_TEXTURE2D_DESC desc;
-	_frontendSharedTexture->GetDesc(&desc);
+	_frontendSharedTextures[0]->GetDesc(&desc);
 
 	const RECT& scalingWndRect = ScalingWindow::Get().WndRect();
 	_destRect.left = (scalingWndRect.left + scalingWndRect.right - (LONG)desc.Width) / 2;
@@ -260,6 +273,8 @@ bool Renderer::_CreateSwapChain() noexcept {
 void Renderer::_FrontendRender() noexcept {
 	_frameLatencyWaitableObject.wait(1000);
 
+	const auto startTime = std::chrono::steady_clock::now();
+
 	ID3D11DeviceContext4* d3dDC = _frontendResources.GetD3DDC();
 	d3dDC->ClearState();
 
@@ -276,15 +291,21 @@ void Renderer::_FrontendRender() noexcept {
 		d3dDC->ClearRenderTargetView(_backBufferRtv.get(), BLACK);
 	}
 
-	_lastAccessMutexKey = ++_sharedTextureMutexKey;
-	HRESULT hr = _frontendSharedTextureMutex->AcquireSync(_lastAccessMutexKey - 1, INFINITE);
+	// 取走最新完成的帧，没有新帧时 (如只有光标移动) 重新使用上一帧
+	_frameHandoff.Acquire();
+	const uint32_t bufferIdx = _frameHandoff.FrontBufferIndex();
+	ID3D11Texture2D* sharedTexture = _frontendSharedTextures[bufferIdx].get();
+	IDXGIKeyedMutex* sharedTextureMutex = _frontendSharedTextureMutexes[bufferIdx].get();
+
+	// 后端不会访问这个缓冲区，键值互斥只用于跨设备同步，不会等待
+	HRESULT hr = sharedTextureMutex->AcquireSync(0, INFINITE);
 	if (FAILED(hr)) {
 		Logger::Get().ComError("AcquireSync 失败", hr);
 		return;
 	}
 
 	if (isFill) {
-		d3dDC->CopyResource(_backBuffer.get(), _frontendSharedTexture.get());
+		d3dDC->CopyResource(_backBuffer.get(), sharedTexture);
 	} else {
 		d3dDC->CopySubresourceRegion(
 			_backBuffer.get(),
@@ -292,13 +313,13 @@ void Renderer::_FrontendRender() noexcept {
 			_destRect.left - scalingWndRect.left,
 			_destRect.top - scalingWndRect.top,
 			0,
-			_frontendSharedTexture.get(),
+			sharedTexture,
 			0,
 			nullptr
 		);
 	}
 
-	_frontendSharedTextureMutex->ReleaseSync(_lastAccessMutexKey);
+	sharedTextureMutex->ReleaseSync(0);
 
 	// 叠加层和光标都绘制到 back buffer
 	{
@@ -322,6 +343,9 @@ void Renderer::_FrontendRender() noexcept {
 	// 两个垂直同步之间允许渲染数帧，SyncInterval = 0 只呈现最新的一帧，旧帧被丢弃
 	_swapChain->Present(0, 0);
 
+	_frameTimings.Record(FrameTimingRecorder::Stage::Present,
+		std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+
 	// 丢弃渲染目标的内容
 	d3dDC->DiscardView(_backBufferRtv.get());
 }
@@ -333,8 +357,8 @@ bool Renderer::Render() noexcept {
 	const uint32_t fps = _stepTimer.FPS();
 
 	// 有新帧或光标改变则渲染新的帧
-	if (_lastAccessMutexKey == _sharedTextureMutexKey.load(std::memory_order_relaxed)) {
-		if (_lastAccessMutexKey == 0) {
+	if (!_frameHandoff.HasNewFrame()) {
+		if (!_frameHandoff.HasFrontBuffer()) {
 			// 第一帧尚未完成
 			return false;
 		}
@@ -418,6 +442,9 @@ bool Renderer::_InitFrameSource() noexcept {
 	case CaptureMethod::DwmSharedSurface:
 		_frameSource = std::make_unique<DwmSharedSurfaceFrameSource>();
 		break;
+	case CaptureMethod::Replay:
+		_frameSource = std::make_unique<ReplayFrameSource>();
+		break;
 	default:
 		Logger::Get().Error("未知的捕获模式");
 		return false;
@@ -425,7 +452,7 @@ bool Renderer::_InitFrameSource() noexcept {
 
 	Logger::Get().Info(StrUtils::Concat("当前捕获模式: ", _frameSource->Name()));
 
-	if (!_frameSource->Initialize(_backendResources, _backendDescriptorStore)) {
+	if (!_frameSource->Initialize(_backendResources, _backendDescriptorStore, _frameTimings)) {
 		Logger::Get().Error("初始化 FrameSource 失败");
 		return false;
 	}
@@ -435,25 +462,32 @@ bool Renderer::_InitFrameSource() noexcept {
 		srcRect.left, srcRect.top, srcRect.right, srcRect.bottom));
 
 	// 由于 DPI 缩放，捕获尺寸和边界矩形尺寸不一定相同
-	D3D11_TEXTURE2D_DESC desc;
-	_frameSource->GetOutput()->GetDesc(&desc);
-	Logger::Get().Info(fmt::format("捕获尺寸: {}x{}", desc.Width, desc.Height));
+	const SIZE outputSize = _frameSource->OutputSize();
+	Logger::Get().Info(fmt::format("捕获尺寸: {}x{}", outputSize.cx, outputSize.cy));
 
 	return true;
 }
 
-static std::optional<EffectDesc> CompileEffect(const EffectOption& effectOption) noexcept {
-	EffectDesc result;
+// isInputCropped 为 true 时 INPUT 为捕获的纹理中的区域，只用于第一个效果
+static EffectDesc CreateEffectDesc(const EffectOption& effectOption, bool isInputCropped = false) noexcept {
+	EffectDesc desc;
 
-	result.name = StrUtils::UTF16ToUTF8(effectOption.name);
+	desc.name = StrUtils::UTF16ToUTF8(effectOption.name);
 
 	if (effectOption.flags & EffectOptionFlags::InlineParams) {
-		result.flags |= EffectFlags::InlineParams;
+		desc.flags |= EffectFlags::InlineParams;
 	}
 	if (effectOption.flags & EffectOptionFlags::FP16) {
-		result.flags |= EffectFlags::FP16;
+		desc.flags |= EffectFlags::FP16;
+	}
+	if (isInputCropped) {
+		desc.flags |= EffectFlags::CroppedInput;
 	}
 
+	return desc;
+}
+
+static uint32_t GetCompileFlags() noexcept {
 	uint32_t compileFlag = 0;
 	const ScalingOptions& scalingOptions = ScalingWindow::Get().Options();
 	if (scalingOptions.IsEffectCacheDisabled()) {
@@ -465,21 +499,271 @@ static std::optional<EffectDesc> CompileEffect(const EffectOption& effectOption)
 	if (scalingOptions.IsWarningsAreErrors()) {
 		compileFlag |= EffectCompilerFlags::WarningsAreErrors;
 	}
+	return compileFlag;
+}
 
-	bool success = true;
+// 返回的 EffectDesc 可能和缓存共享，因此是只读的
+static std::shared_ptr<const EffectDesc> CompileEffect(
+	const EffectOption& effectOption,
+	EffectIncludes* includes = nullptr,
+	bool isInputCropped = false
+) noexcept {
+	std::shared_ptr<const EffectDesc> result;
 	int duration = Utils::Measure([&]() {
-		success = !EffectCompiler::Compile(result, compileFlag, &effectOption.parameters);
+		result = EffectCompiler::CompileShared(CreateEffectDesc(effectOption, isInputCropped),
+			GetCompileFlags(), &effectOption.parameters, includes);
 	});
 
-	if (success) {
+	if (result) {
 		Logger::Get().Info(fmt::format("编译 {}.hlsl 用时 {} 毫秒",
 			StrUtils::UTF16ToUTF8(effectOption.name), duration / 1000.0f));
 		return result;
 	} else {
 		Logger::Get().Error(StrUtils::Concat("编译 ",
 			StrUtils::UTF16ToUTF8(effectOption.name), ".hlsl 失败"));
-		return std::nullopt;
+		return nullptr;
+	}
+}
+
+// 把相邻的效果融合为一个通道，见 EffectFusion。effectDescs 和 effectOptions 被替换为融合后的结果，
+// fusedOptions 保存融合后的效果的选项。融合失败时保留原来的效果
+static void FuseEffects(
+	std::vector<std::shared_ptr<const EffectDesc>>& effectDescs,
+	std::vector<const EffectOption*>& effectOptions,
+	std::vector<EffectOption>& fusedOptions
+) noexcept {
+	// 内联参数和 FP16 作用于整个效果，因此融合的效果必须相同
+	constexpr uint32_t INPUT_FLAGS = EffectFlags::InlineParams | EffectFlags::FP16;
+
+	// 每组的第一个效果和效果数
+	SmallVector<std::pair<uint32_t, uint32_t>> groups;
+	const uint32_t effectCount = (uint32_t)effectDescs.size();
+	for (uint32_t i = 0; i < effectCount;) {
+		if (!EffectFusion::CanBeFirst(*effectDescs[i])) {
+			++i;
+			continue;
+		}
+
+		const uint32_t inputFlags = effectDescs[i]->flags & INPUT_FLAGS;
+		uint32_t end = i + 1;
+		while (end < effectCount && (effectDescs[end]->flags & EffectFlags::Pixelwise)
+			&& (effectDescs[end]->flags & INPUT_FLAGS) == inputFlags) {
+			++end;
+		}
+
+		if (end - i > 1) {
+			groups.emplace_back(i, end - i);
+		}
+		i = end;
+	}
+
+	if (groups.empty()) {
+		return;
+	}
+
+	// 编译任务持有参数的指针，因此不能重新分配
+	fusedOptions.reserve(groups.size());
+
+	TaskScheduler scheduler;
+	std::vector<std::shared_ptr<EffectCompileJob>> jobs;
+	jobs.reserve(groups.size());
+	const uint32_t compileFlags = GetCompileFlags();
+
+	for (const auto [first, count] : groups) {
+		const EffectOption& firstOption = *effectOptions[first];
+
+		// 输出尺寸和第一个效果相同
+		EffectOption& fusedOption = fusedOptions.emplace_back();
+		fusedOption.name = firstOption.name;
+		fusedOption.scalingType = firstOption.scalingType;
+		fusedOption.scale = firstOption.scale;
+		fusedOption.flags = firstOption.flags;
+
+		std::vector<std::wstring> effectNames;
+		effectNames.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const EffectOption& option = *effectOptions[first + i];
+			effectNames.push_back(option.name);
+
+			if (i > 0) {
+				// 包含的文件相对于第一个效果所在的文件夹查找，因此之后的效果只保留文件名
+				std::wstring_view name = option.name;
+				fusedOption.name += L'+';
+				fusedOption.name += name.substr(name.find_last_of(L'\\') + 1);
+			}
+
+			const std::wstring prefix = StrUtils::UTF8ToUTF16(EffectFusion::GetParamPrefix(i));
+			for (const auto& [paramName, value] : option.parameters) {
+				fusedOption.parameters.emplace(prefix + paramName, value);
+			}
+		}
+
+		// 融合后的效果的 INPUT 和第一个效果相同
+		const bool isInputCropped = first == 0 && (effectDescs[0]->flags & EffectFlags::CroppedInput);
+		jobs.push_back(EffectCompiler::SubmitFused(scheduler, CreateEffectDesc(fusedOption, isInputCropped),
+			std::move(effectNames), compileFlags, &fusedOption.parameters));
+	}
+
+#ifdef _DEBUG
+	scheduler.Run(1);
+#else
+	scheduler.Run();
+#endif
+
+	// 从后往前替换，使之前的序号保持不变
+	for (size_t i = groups.size(); i-- > 0;) {
+		const auto [first, count] = groups[i];
+
+		std::shared_ptr<const EffectDesc> fusedDesc = EffectCompiler::GetResult(jobs[i]);
+		if (!fusedDesc) {
+			Logger::Get().Warn(StrUtils::Concat("编译融合的效果 ",
+				StrUtils::UTF16ToUTF8(fusedOptions[i].name), " 失败，将分别执行"));
+			continue;
+		}
+
+		Logger::Get().Info(fmt::format("已融合 {} 个效果: {}", count, fusedDesc->name));
+
+		effectDescs[first] = std::move(fusedDesc);
+		effectDescs.erase(effectDescs.begin() + first + 1, effectDescs.begin() + first + count);
+		effectOptions[first] = &fusedOptions[i];
+		effectOptions.erase(effectOptions.begin() + first + 1, effectOptions.begin() + first + count);
+	}
+}
+
+ID3D11Texture2D* Renderer::_CreateEffectTextures(std::span<const EffectDesc* const> descs) noexcept {
+	// 把所有效果的纹理和通道展开到整个效果链，效果的 INPUT 是上一个效果的 OUTPUT
+	std::vector<TextureAliasPlanner::Texture> textures;
+	std::vector<TextureAliasPlanner::Pass> passes;
+	std::vector<SmallVector<uint32_t>> textureIndices(descs.size());
+	// 和 textures 及 passes 一一对应
+	std::vector<RegionPropagator::Texture> regionTextures;
+	std::vector<RegionPropagator::Pass> regionPasses;
+
+	// 帧源的输出
+	textures.push_back({ .isExternal = true });
+	{
+		const SIZE inputSize = _effectDrawers[0].TextureSizes()[0];
+		regionTextures.push_back({ .width = (uint32_t)inputSize.cx, .height = (uint32_t)inputSize.cy });
+	}
+	uint32_t inputIdx = 0;
+
+	for (size_t i = 0; i < descs.size(); ++i) {
+		const EffectDesc& desc = *descs[i];
+		const SmallVector<SIZE>& sizes = _effectDrawers[i].TextureSizes();
+
+		SmallVector<uint32_t>& indices = textureIndices[i];
+		indices.resize(desc.textures.size());
+		indices[0] = inputIdx;
+		for (size_t j = 1; j < desc.textures.size(); ++j) {
+			const EffectIntermediateTextureDesc& texDesc = desc.textures[j];
+			const auto& formatDesc = EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format];
+
+			indices[j] = (uint32_t)textures.size();
+			textures.push_back({
+				.width = (uint32_t)sizes[j].cx,
+				.height = (uint32_t)sizes[j].cy,
+				.format = (uint32_t)formatDesc.dxgiFormat,
+				.byteSize = (uint64_t)sizes[j].cx * sizes[j].cy * formatDesc.bytesPerPixel,
+				.isExternal = !texDesc.source.empty()
+			});
+			regionTextures.push_back({
+				.width = (uint32_t)sizes[j].cx,
+				.height = (uint32_t)sizes[j].cy,
+				.isConstant = !texDesc.source.empty()
+			});
+		}
+
+		// 重复寻址时变化的区域会影响纹理另一侧的像素，FOOTPRINT 无法描述
+		const bool hasWrapSampler = std::any_of(desc.samplers.begin(), desc.samplers.end(),
+			[](const EffectSamplerDesc& sampler) { return sampler.addressType == EffectSamplerAddressType::Wrap; });
+
+		for (const EffectPassDesc& passDesc : desc.passes) {
+			TextureAliasPlanner::Pass& pass = passes.emplace_back();
+			for (uint32_t idx : passDesc.inputs) {
+				pass.inputs.push_back(indices[idx]);
+			}
+			for (uint32_t idx : passDesc.outputs) {
+				pass.outputs.push_back(indices[idx]);
+			}
+
+			regionPasses.push_back({
+				.inputs = pass.inputs,
+				.outputs = pass.outputs,
+				.blockSize = passDesc.blockSize,
+				.footprint = passDesc.footprint,
+				.hasFootprint = passDesc.hasFootprint && !hasWrapSampler,
+				.isDynamic = bool(desc.flags & EffectFlags::UseDynamic)
+			});
+		}
+
+		inputIdx = indices[1];
+	}
+
+	// 效果链的输出在渲染后被复制到共享纹理
+	textures[inputIdx].isPersistent = true;
+
+	_isRegionRenderingEnabled = _frameSource->CanReportDirtyRects()
+		&& _regionPropagator.Initialize(std::move(regionTextures), std::move(regionPasses), 0);
+	if (_isRegionRenderingEnabled) {
+		// 未变化的块保留上一帧的结果
+		for (TextureAliasPlanner::Texture& texture : textures) {
+			texture.isPersistent = true;
+		}
+		Logger::Get().Info("只重新渲染变化的区域");
+	}
+
+	const TextureAliasPlanner::Result plan = TextureAliasPlanner::Plan(textures, passes);
+
+	// 重新创建时之前的纹理即将释放，它们的视图不能再被使用
+	for (const winrt::com_ptr<ID3D11Texture2D>& texture : _effectTextures) {
+		_backendDescriptorStore.ReleaseViews(texture.get());
+	}
+
+	std::vector<winrt::com_ptr<ID3D11Texture2D>>& allocations = _effectTextures;
+	allocations.assign(plan.allocationTextures.size(), nullptr);
+	for (size_t i = 0; i < allocations.size(); ++i) {
+		const TextureAliasPlanner::Texture& texture = textures[plan.allocationTextures[i]];
+		allocations[i] = DirectXHelper::CreateTexture2D(
+			_backendResources.GetD3DDevice(),
+			(DXGI_FORMAT)texture.format,
+			texture.width,
+			texture.height,
+			D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+		);
+		if (!allocations[i]) {
+			Logger::Get().Error("创建纹理失败");
+			return nullptr;
+		}
+	}
+
+	const uint32_t plannedCount = (uint32_t)std::count_if(plan.allocations.begin(), plan.allocations.end(),
+		[](uint32_t allocation) { return allocation != TextureAliasPlanner::NO_ALLOCATION; });
+	Logger::Get().Info(fmt::format("中间纹理 {} 个 ({:.1f} MiB)，共享后 {} 个 ({:.1f} MiB)",
+		plannedCount, plan.unaliasedBytes / 1048576.0, allocations.size(), plan.aliasedBytes / 1048576.0));
+
+	// 直接读取捕获的纹理时 INPUT 每帧不同，渲染前设置。裁剪黑边时可能为复制的有效区域
+	ID3D11Texture2D* inOutTexture = _autoCropInput ? _autoCropInput.get()
+		: _frameSource->IsOutputCropped() ? nullptr : _frameSource->GetOutput();
+	SmallVector<ID3D11Texture2D*> effectTextures;
+	for (size_t i = 0; i < descs.size(); ++i) {
+		const SmallVector<uint32_t>& indices = textureIndices[i];
+
+		effectTextures.resize(indices.size());
+		effectTextures[0] = inOutTexture;
+		for (size_t j = 1; j < indices.size(); ++j) {
+			const uint32_t allocation = plan.allocations[indices[j]];
+			effectTextures[j] = allocation == TextureAliasPlanner::NO_ALLOCATION ? nullptr : allocations[allocation].get();
+		}
+
+		if (!_effectDrawers[i].BindTextures(*descs[i], effectTextures, _backendDescriptorStore)) {
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 的纹理失败", i, descs[i]->name));
+			return nullptr;
+		}
+
+		inOutTexture = effectTextures[1];
 	}
+
+	return inOutTexture;
 }
 
 ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
@@ -488,41 +772,97 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 
 	const uint32_t effectCount = (uint32_t)effects.size();
 
-	// 并行编译所有效果
-	std::vector<EffectDesc> effectDescs(effects.size());
-	std::atomic<bool> anyFailure;
+	// 热重载需要每个通道包含的文件
+	const bool isHotReloadEnabled = ScalingWindow::Get().Options().IsEffectHotReloadEnabled();
+	std::vector<EffectIncludes> effectIncludes(isHotReloadEnabled ? effectCount : 0);
 
-	int duration = Utils::Measure([&]() {
-		Win32Utils::RunParallel([&](uint32_t id) {
-			std::optional<EffectDesc> desc = CompileEffect(effects[id]);
-			if (desc) {
-				effectDescs[id] = std::move(*desc);
-			} else {
-				anyFailure.store(true, std::memory_order_relaxed);
+	// 所有效果的解析和各个通道的编译放进同一个任务图，使所有核心一直忙碌到最后一个通道完成，
+	// 而不是让通道多的效果独自拖慢整体
+	std::vector<std::shared_ptr<const EffectDesc>> effectDescs(effects.size());
+	// 第一个效果尝试直接读取捕获的纹理，见 FrameSourceBase::IsOutputCropped
+	const bool isInputCropped = _frameSource->IsOutputCropped();
+	{
+		const uint32_t compileFlags = GetCompileFlags();
+
+		TaskScheduler scheduler;
+		std::vector<std::shared_ptr<EffectCompileJob>> jobs;
+		jobs.reserve(effectCount);
+		for (uint32_t i = 0; i < effectCount; ++i) {
+			jobs.push_back(EffectCompiler::Submit(scheduler, CreateEffectDesc(effects[i], i == 0 && isInputCropped), compileFlags,
+				&effects[i].parameters, isHotReloadEnabled ? &effectIncludes[i] : nullptr));
+		}
+
+#ifdef _DEBUG
+		// 为了便于调试，DEBUG 模式下只使用一个线程
+		scheduler.Run(1);
+#else
+		scheduler.Run();
+#endif
+
+		bool anyFailure = false;
+		for (uint32_t i = 0; i < effectCount; ++i) {
+			effectDescs[i] = EffectCompiler::GetResult(jobs[i]);
+			if (!effectDescs[i] && i == 0 && isInputCropped) {
+				// 效果可能以其他方式使用 INPUT，复制捕获的纹理后再试一次
+				Logger::Get().Warn("编译直接读取捕获的纹理的效果失败，将复制捕获的纹理");
+				effectDescs[0] = CompileEffect(effects[0], isHotReloadEnabled ? &effectIncludes[0] : nullptr);
 			}
-		}, effectCount);
-	});
+			if (!effectDescs[i]) {
+				Logger::Get().Error(StrUtils::Concat("编译 ", StrUtils::UTF16ToUTF8(effects[i].name), ".hlsl 失败"));
+				anyFailure = true;
+			}
+		}
 
-	if (anyFailure.load(std::memory_order_relaxed)) {
-		return nullptr;
+		if (anyFailure) {
+			return nullptr;
+		}
+
+		const TaskScheduler::Stats& stats = scheduler.GetStats();
+		Logger::Get().Info(fmt::format(
+			"编译着色器总计用时 {:.3f} 毫秒，关键路径 {:.3f} 毫秒，所有任务耗时 {:.3f} 毫秒 ({} 个任务，{} 个线程，窃取 {} 次)",
+			stats.wallMs, stats.criticalPathMs, stats.workMs, stats.taskCount, stats.threadCount, stats.stealCount));
 	}
 
-	if (effectCount > 1) {
-		Logger::Get().Info(fmt::format("编译着色器总计用时 {} 毫秒", duration / 1000.0f));
+	// 每个 EffectDrawer 对应的效果选项，融合后多个效果共用一个 EffectDrawer
+	std::vector<const EffectOption*> effectOptions(effectCount);
+	for (uint32_t i = 0; i < effectCount; ++i) {
+		effectOptions[i] = &effects[i];
+	}
+
+	// 热重载以效果为单位替换着色器，因此不融合
+	std::vector<EffectOption> fusedOptions;
+	if (!isHotReloadEnabled) {
+		FuseEffects(effectDescs, effectOptions, fusedOptions);
+	}
+	const uint32_t drawerCount = (uint32_t)effectDescs.size();
+
+	_effectDrawers.resize(drawerCount);
+
+	// 效果不支持时回落到复制捕获的纹理
+	EffectInputCrop inputCrop{};
+	if (isInputCropped) {
+		if (effectDescs[0]->flags & EffectFlags::CroppedInput) {
+			inputCrop = { _frameSource->OutputOffset(), _frameSource->FrameTextureSize() };
+			Logger::Get().Info("第一个效果直接读取捕获的纹理");
+		} else if (!_frameSource->DisableCroppedOutput()) {
+			Logger::Get().Error("DisableCroppedOutput 失败");
+			return nullptr;
+		}
 	}
 
-	_effectDrawers.resize(effects.size());
+	SIZE inOutSize = _frameSource->OutputSize();
 
-	ID3D11Texture2D* inOutTexture = _frameSource->GetOutput();
-	for (uint32_t i = 0; i < effectCount; ++i) {
+	const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
+	for (uint32_t i = 0; i < drawerCount; ++i) {
 		if (!_effectDrawers[i].Initialize(
-			effectDescs[i],
-			effects[i],
+			*effectDescs[i],
+			*effectOptions[i],
 			_backendResources,
-			_backendDescriptorStore,
-			&inOutTexture
+			scalingWndSize,
+			inOutSize,
+			i == 0 && _frameSource->IsOutputCropped() ? &inputCrop : nullptr
 		)) {
-			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, StrUtils::UTF16ToUTF8(effects[i].name)));
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, StrUtils::UTF16ToUTF8(effectOptions[i]->name)));
 			return nullptr;
 		}
 	}
@@ -531,21 +871,35 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 	_effectInfos.resize(effectDescs.size());
 	for (size_t i = 0; i < effectDescs.size(); ++i) {
 		EffectInfo& info = _effectInfos[i];
-		EffectDesc& desc = effectDescs[i];
-		info.name = std::move(desc.name);
+		const EffectDesc& desc = *effectDescs[i];
+		info.name = desc.name;
 
 		info.passNames.reserve(desc.passes.size());
-		for (EffectPassDesc& passDesc : desc.passes) {
-			info.passNames.emplace_back(std::move(passDesc.desc));
+		for (const EffectPassDesc& passDesc : desc.passes) {
+			info.passNames.emplace_back(passDesc.desc);
+		}
+	}
+
+	// 每个 EffectDrawer 使用的 EffectDesc，包括降采样效果
+	std::vector<const EffectDesc*> drawerDescs(drawerCount);
+	for (uint32_t i = 0; i < drawerCount; ++i) {
+		drawerDescs[i] = effectDescs[i].get();
+	}
+
+	// 裁剪黑边时需要重新计算尺寸，融合的效果的选项是局部变量，因此复制一份
+	const bool isAutoCroppingEnabled = ScalingWindow::Get().Options().IsAutoCroppingEnabled();
+	if (isAutoCroppingEnabled) {
+		_drawerDescs = effectDescs;
+		_drawerOptions.reserve(drawerCount + 1);
+		for (uint32_t i = 0; i < drawerCount; ++i) {
+			_drawerOptions.push_back(*effectOptions[i]);
 		}
 	}
 
 	// 输出尺寸大于缩放窗口尺寸则需要降采样
+	std::shared_ptr<const EffectDesc> bicubicDesc;
 	{
-		D3D11_TEXTURE2D_DESC desc;
-		inOutTexture->GetDesc(&desc);
-		const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
-		if ((LONG)desc.Width > scalingWndSize.cx || (LONG)desc.Height > scalingWndSize.cy) {
+		if (inOutSize.cx > scalingWndSize.cx || inOutSize.cy > scalingWndSize.cy) {
 			EffectOption bicubicOption{
 				.name = L"Bicubic",
 				.parameters{
@@ -557,7 +911,7 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 				.flags = EffectOptionFlags::InlineParams
 			};
 
-			std::optional<EffectDesc> bicubicDesc = CompileEffect(bicubicOption);
+			bicubicDesc = CompileEffect(bicubicOption);
 			if (!bicubicDesc) {
 				Logger::Get().Error("编译降采样效果失败");
 				return nullptr;
@@ -568,26 +922,38 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 				*bicubicDesc,
 				bicubicOption,
 				_backendResources,
-				_backendDescriptorStore,
-				&inOutTexture
+				scalingWndSize,
+				inOutSize
 			)) {
 				Logger::Get().Error("初始化降采样效果失败");
 				return nullptr;
 			}
+			drawerDescs.push_back(bicubicDesc.get());
+
+			if (isAutoCroppingEnabled) {
+				_drawerDescs.push_back(bicubicDesc);
+				_drawerOptions.push_back(std::move(bicubicOption));
+			}
 
 			// 为降采样算法生成 EffectInfo
 			EffectInfo& bicubicEffectInfo = _effectInfos.emplace_back();
-			bicubicEffectInfo.name = std::move(bicubicDesc->name);
+			bicubicEffectInfo.name = bicubicDesc->name;
 			bicubicEffectInfo.passNames.reserve(bicubicDesc->passes.size());
-			for (EffectPassDesc& passDesc : bicubicDesc->passes) {
-				bicubicEffectInfo.passNames.emplace_back(std::move(passDesc.desc));
+			for (const EffectPassDesc& passDesc : bicubicDesc->passes) {
+				bicubicEffectInfo.passNames.emplace_back(passDesc.desc);
 			}
 		}
 	}
 
+	ID3D11Texture2D* inOutTexture = _CreateEffectTextures(drawerDescs);
+	if (!inOutTexture) {
+		Logger::Get().Error("创建中间纹理失败");
+		return nullptr;
+	}
+
 	// 初始化所有效果共用的动态常量缓冲区
 	for (uint32_t i = 0; i < effectDescs.size(); ++i) {
-		if (effectDescs[i].flags & EffectFlags::UseDynamic) {
+		if (effectDescs[i]->flags & EffectFlags::UseDynamic) {
 			_firstDynamicEffectIdx = i;
 			break;
 		}
@@ -607,41 +973,295 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 		}
 	}
 
+	// 有 FOOTPRINT 的通道即使完整渲染也需要起始块
+	if (std::any_of(_effectDrawers.begin(), _effectDrawers.end(),
+		[](const EffectDrawer& drawer) { return drawer.HasFootprintPass(); })) {
+		D3D11_BUFFER_DESC bd = {
+			.ByteWidth = 16,	// 只用 8 个字节
+			.Usage = D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE
+		};
+		HRESULT hr = _backendResources.GetD3DDevice()->CreateBuffer(&bd, nullptr, _tileOffsetCB.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return nullptr;
+		}
+	}
+
+	if (isHotReloadEnabled) {
+		_effectHotReloader = std::make_unique<EffectHotReloader>();
+		for (uint32_t i = 0; i < effectCount; ++i) {
+			_effectHotReloader->SetDependencies(i, effectDescs[i]->name, effectIncludes[i]);
+		}
+
+		// 热重载线程不能访问帧源，在这里取得第一个效果的输入是否被裁剪
+		if (_effectHotReloader->Start(std::bind_front(&Renderer::_HotReloadEffects, this, isInputCropped))) {
+			_effectDescs = std::move(effectDescs);
+		} else {
+			// 热重载只是辅助功能，失败不影响缩放
+			Logger::Get().Error("启动效果热重载失败");
+			_effectHotReloader.reset();
+		}
+	}
+
 	return inOutTexture;
 }
 
-HANDLE Renderer::_CreateSharedTexture(ID3D11Texture2D* effectsOutput) noexcept {
+// 热替换着色器要求纹理、采样器、参数和通道的输入输出都不变
+static bool IsSameLayout(const EffectDesc& l, const EffectDesc& r) noexcept {
+	if (l.flags != r.flags || l.params.size() != r.params.size() || l.textures.size() != r.textures.size()
+		|| l.samplers.size() != r.samplers.size() || l.passes.size() != r.passes.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < l.params.size(); ++i) {
+		const EffectParameterDesc& lp = l.params[i];
+		const EffectParameterDesc& rp = r.params[i];
+		if (lp.name != rp.name || lp.constant.index() != rp.constant.index()) {
+			return false;
+		}
+
+		// 初始化时根据默认值和范围填充常量缓冲区
+		const bool isSameConstant = std::visit([&](const auto& lc) {
+			const auto& rc = std::get<std::decay_t<decltype(lc)>>(rp.constant);
+			return lc.defaultValue == rc.defaultValue && lc.minValue == rc.minValue && lc.maxValue == rc.maxValue;
+		}, lp.constant);
+		if (!isSameConstant) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.textures.size(); ++i) {
+		const EffectIntermediateTextureDesc& lt = l.textures[i];
+		const EffectIntermediateTextureDesc& rt = r.textures[i];
+		if (lt.sizeExpr != rt.sizeExpr || lt.format != rt.format || lt.source != rt.source) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.samplers.size(); ++i) {
+		if (l.samplers[i].filterType != r.samplers[i].filterType
+			|| l.samplers[i].addressType != r.samplers[i].addressType) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.passes.size(); ++i) {
+		const EffectPassDesc& lp = l.passes[i];
+		const EffectPassDesc& rp = r.passes[i];
+		if (lp.inputs != rp.inputs || lp.outputs != rp.outputs
+			|| lp.blockSize != rp.blockSize || lp.isPSStyle != rp.isPSStyle
+			|| lp.hasFootprint != rp.hasFootprint || lp.footprint != rp.footprint) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Renderer::_HotReloadEffects(
+	bool isInputCropped,
+	const SmallVector<EffectHotReloader::ChangedEffect>& changedEffects
+) noexcept {
+	const std::vector<EffectOption>& effects = ScalingWindow::Get().Options().effects;
+
+	for (const EffectHotReloader::ChangedEffect& changedEffect : changedEffects) {
+		const EffectOption& effectOption = effects[changedEffect.effectIdx];
+		const std::string effectName = StrUtils::UTF16ToUTF8(effectOption.name);
+
+		Logger::Get().Info(fmt::format("效果#{} ({}) {}已更改", changedEffect.effectIdx, effectName,
+			changedEffect.isSourceChanged ? "的源文件" : "包含的文件"));
+
+		// 重新编译整个效果，未更改的通道会命中通道缓存，因此只有受影响的通道被重新编译
+		EffectIncludes includes;
+		std::shared_ptr<const EffectDesc> desc = CompileEffect(effectOption, &includes,
+			changedEffect.effectIdx == 0 && isInputCropped);
+		if (!desc) {
+			// 保留原来的着色器，修复错误后再次保存即可
+			continue;
+		}
+
+		_effectHotReloader->SetDependencies(changedEffect.effectIdx, desc->name, includes);
+
+		_backendThreadDispatcher.TryEnqueue([this, effectIdx(changedEffect.effectIdx), desc(std::move(desc))]() mutable {
+			_ApplyReloadedEffect(effectIdx, std::move(desc));
+		});
+	}
+}
+
+void Renderer::_ApplyReloadedEffect(uint32_t effectIdx, std::shared_ptr<const EffectDesc> desc) noexcept {
+	const EffectDesc& oldDesc = *_effectDescs[effectIdx];
+	if (!IsSameLayout(oldDesc, *desc)) {
+		Logger::Get().Warn(fmt::format("效果#{} ({}) 的布局已更改，需要重新缩放", effectIdx, desc->name));
+		return;
+	}
+
+	uint32_t replacedCount = 0;
+	for (uint32_t i = 0; i < (uint32_t)desc->passes.size(); ++i) {
+		const std::span<const uint8_t> cso = desc->passes[i].cso;
+		if (std::ranges::equal(cso, oldDesc.passes[i].cso)) {
+			continue;
+		}
+
+		if (!_effectDrawers[effectIdx].ReplaceShader(i, cso, _backendResources.GetD3DDevice())) {
+			Logger::Get().Error(fmt::format("替换效果#{} ({}) 的 Pass{} 失败", effectIdx, desc->name, i + 1));
+			return;
+		}
+		++replacedCount;
+	}
+
+	Logger::Get().Info(fmt::format("已热重载效果#{} ({})，替换了 {} 个通道", effectIdx, desc->name, replacedCount));
+
+	// 替换后旧的字节码不再需要
+	_effectDescs[effectIdx] = std::move(desc);
+	if (replacedCount > 0) {
+		_isEffectsReloaded = true;
+		_isFullRenderNeeded = true;
+	}
+}
+
+bool Renderer::_ApplyAutoCrop(const LetterboxDetector::Rect& rect) noexcept {
+	const SIZE frameSize = _frameSource->OutputSize();
+	const SIZE cropSize{ (LONG)rect.Width(), (LONG)rect.Height() };
+	const bool isCropped = cropSize.cx != frameSize.cx || cropSize.cy != frameSize.cy;
+
+	D3D11_TEXTURE2D_DESC sharedDesc;
+	_backendSharedTextures[0]->GetDesc(&sharedDesc);
+	const SIZE outputSize{ (LONG)sharedDesc.Width, (LONG)sharedDesc.Height };
+
+	// 按比例缩小缩放窗口，Fit 和 Fill 缩放的倍率因此不变，效果链的输出即为原来的输出中对应的区域
+	const SIZE wndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
+	const SIZE scalingWndSize{
+		std::lround((double)wndSize.cx * cropSize.cx / frameSize.cx),
+		std::lround((double)wndSize.cy * cropSize.cy / frameSize.cy)
+	};
+
+	const bool isInputCropped = _frameSource->IsOutputCropped();
+	EffectInputCrop inputCrop{};
+	if (isInputCropped) {
+		const POINT offset = _frameSource->OutputOffset();
+		inputCrop = {
+			{ offset.x + (LONG)rect.left, offset.y + (LONG)rect.top },
+			_frameSource->FrameTextureSize()
+		};
+	}
+
+	SIZE inOutSize = cropSize;
+	std::vector<const EffectDesc*> drawerDescs(_drawerDescs.size());
+	for (uint32_t i = 0; i < (uint32_t)_drawerDescs.size(); ++i) {
+		drawerDescs[i] = _drawerDescs[i].get();
+
+		if (!_effectDrawers[i].Resize(
+			*_drawerDescs[i],
+			_drawerOptions[i],
+			_backendResources,
+			scalingWndSize,
+			inOutSize,
+			i == 0 && isInputCropped ? &inputCrop : nullptr
+		)) {
+			Logger::Get().Error(fmt::format("调整效果#{} ({}) 的尺寸失败", i, _drawerDescs[i]->name));
+			return false;
+		}
+	}
+
+	// 输出尺寸不按比例变化的效果（如使用 Absolute 缩放）无法放入共享纹理中对应的区域
+	const SIZE expectedSize{
+		std::lround((double)cropSize.cx * outputSize.cx / frameSize.cx),
+		std::lround((double)cropSize.cy * outputSize.cy / frameSize.cy)
+	};
+	if (std::abs(inOutSize.cx - expectedSize.cx) > 2 || std::abs(inOutSize.cy - expectedSize.cy) > 2
+		|| inOutSize.cx > outputSize.cx || inOutSize.cy > outputSize.cy) {
+		Logger::Get().Error(fmt::format("裁剪后效果链的输出尺寸为 {}x{}，预期为 {}x{}",
+			inOutSize.cx, inOutSize.cy, expectedSize.cx, expectedSize.cy));
+		return false;
+	}
+
+	if (_autoCropInput) {
+		_backendDescriptorStore.ReleaseViews(_autoCropInput.get());
+		_autoCropInput = nullptr;
+	}
+
+	if (isCropped && !isInputCropped) {
+		D3D11_TEXTURE2D_DESC inputDesc;
+		_frameSource->GetOutput()->GetDesc(&inputDesc);
+		_autoCropInput = DirectXHelper::CreateTexture2D(
+			_backendResources.GetD3DDevice(),
+			inputDesc.Format,
+			cropSize.cx,
+			cropSize.cy,
+			D3D11_BIND_SHADER_RESOURCE
+		);
+		if (!_autoCropInput) {
+			Logger::Get().Error("创建纹理失败");
+			return false;
+		}
+	}
+
+	_effectsOutput = _CreateEffectTextures(drawerDescs);
+	if (!_effectsOutput) {
+		Logger::Get().Error("创建中间纹理失败");
+		return false;
+	}
+
+	_autoCropRect = rect;
+	_autoCropDestOffset = {
+		std::min(std::lround((double)rect.left * outputSize.cx / frameSize.cx), outputSize.cx - inOutSize.cx),
+		std::min(std::lround((double)rect.top * outputSize.cy / frameSize.cy), outputSize.cy - inOutSize.cy)
+	};
+	_isFullRenderNeeded = true;
+	_sharedTexturesToClear = (1u << FrameHandoff::BUFFER_COUNT) - 1;
+
+	Logger::Get().Info(fmt::format("效果链的输入: ({},{})-({},{})，输出: {}x{}",
+		rect.left, rect.top, rect.right, rect.bottom, inOutSize.cx, inOutSize.cy));
+	return true;
+}
+
+bool Renderer::_CreateSharedTextures(ID3D11Texture2D* effectsOutput) noexcept {
 	D3D11_TEXTURE2D_DESC desc;
 	effectsOutput->GetDesc(&desc);
 	SIZE textureSize = { (LONG)desc.Width, (LONG)desc.Height };
 
-	// 创建共享纹理
-	_backendSharedTexture = DirectXHelper::CreateTexture2D(
-		_backendResources.GetD3DDevice(),
-		DXGI_FORMAT_R8G8B8A8_UNORM,
-		textureSize.cx,
-		textureSize.cy,
-		D3D11_BIND_SHADER_RESOURCE,
-		D3D11_USAGE_DEFAULT,
-		D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX
-	);
-	if (!_backendSharedTexture) {
-		Logger::Get().Error("创建 Texture2D 失败");
-		return NULL;
-	}
+	// 裁剪黑边时效果链的输出只覆盖共享纹理的一部分，其他区域需要清除
+	const bool isAutoCroppingEnabled = ScalingWindow::Get().Options().IsAutoCroppingEnabled();
+
+	// 创建共享纹理。FrameHandoff 保证每个纹理同时只被一方访问，键值互斥只用于跨设备同步
+	for (uint32_t i = 0; i < FrameHandoff::BUFFER_COUNT; ++i) {
+		_backendSharedTextures[i] = DirectXHelper::CreateTexture2D(
+			_backendResources.GetD3DDevice(),
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			textureSize.cx,
+			textureSize.cy,
+			isAutoCroppingEnabled ? D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET : D3D11_BIND_SHADER_RESOURCE,
+			D3D11_USAGE_DEFAULT,
+			D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX
+		);
+		if (!_backendSharedTextures[i]) {
+			Logger::Get().Error("创建 Texture2D 失败");
+			return false;
+		}
+
+		if (isAutoCroppingEnabled) {
+			HRESULT hr = _backendResources.GetD3DDevice()->CreateRenderTargetView(
+				_backendSharedTextures[i].get(), nullptr, _backendSharedTextureRtvs[i].put());
+			if (FAILED(hr)) {
+				Logger::Get().ComError("CreateRenderTargetView 失败", hr);
+				return false;
+			}
+		}
 
-	_backendSharedTextureMutex = _backendSharedTexture.try_as<IDXGIKeyedMutex>();
+		_backendSharedTextureMutexes[i] = _backendSharedTextures[i].try_as<IDXGIKeyedMutex>();
 
-	winrt::com_ptr<IDXGIResource> sharedDxgiRes = _backendSharedTexture.try_as<IDXGIResource>();
+		winrt::com_ptr<IDXGIResource> sharedDxgiRes = _backendSharedTextures[i].try_as<IDXGIResource>();
 
-	HANDLE sharedHandle = NULL;
-	HRESULT hr = sharedDxgiRes->GetSharedHandle(&sharedHandle);
-	if (FAILED(hr)) {
-		Logger::Get().ComError("GetSharedHandle 失败", hr);
-		return NULL;
+		HRESULT hr = sharedDxgiRes->GetSharedHandle(&_sharedTextureHandles[i]);
+		if (FAILED(hr)) {
+			Logger::Get().ComError("GetSharedHandle 失败", hr);
+			return false;
+		}
 	}
 
-	return sharedHandle;
+	return true;
 }
 
 void Renderer::_BackendThreadProc() noexcept {
@@ -651,8 +1271,9 @@ void Renderer::_BackendThreadProc() noexcept {
 
 	winrt::init_apartment(winrt::apartment_type::single_threaded);
 
-	ID3D11Texture2D* outputTexture = _InitBackend();
-	if (!outputTexture) {
+	_effectsOutput = _InitBackend();
+	if (!_effectsOutput) {
+		_effectHotReloader.reset();
 		_frameSource.reset();
 		// 通知前端初始化失败
 		_sharedTextureHandle.store(INVALID_HANDLE_VALUE, std::memory_order_release);
@@ -667,11 +1288,28 @@ void Renderer::_BackendThreadProc() noexcept {
 	}
 
 	bool waitingForStepTimer = true;
+	// 允许渲染下一帧的时间和之后等待重复帧检查的总用时
+	std::chrono::steady_clock::time_point frameWaitStart;
+	std::chrono::steady_clock::duration comparisonWait{};
+	// 尚无结果的捕获开始的时间，等待重复帧检查时不为空
+	std::optional<std::chrono::steady_clock::time_point> captureStart;
 
 	MSG msg;
 	while (true) {
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 			if (msg.message == WM_QUIT) {
+				const BackendScheduler::Statistics& stats = _backendScheduler.GetStatistics();
+				Logger::Get().Info(fmt::format("内容帧率: {:.1f}，捕获 {} 次，新帧 {} 个",
+					_backendScheduler.ContentFrameRate(), stats.captureCount, stats.newFrameCount));
+
+				if (_autoCropper) {
+					const LetterboxDetector::Statistics& cropStats = _autoCropper->GetStatistics();
+					Logger::Get().Info(fmt::format("裁剪黑边: 检测 {} 次 (全黑 {} 次)，扩大 {} 次，缩小 {} 次",
+						cropStats.detectionCount, cropStats.blackFrameCount, cropStats.growCount, cropStats.shrinkCount));
+				}
+
+				// 先停止热重载线程，它可能正在编译效果
+				_effectHotReloader.reset();
 				// 不能在前端线程释放
 				_frameSource.reset();
 				return;
@@ -681,29 +1319,71 @@ void Renderer::_BackendThreadProc() noexcept {
 		}
 
 		if (waitingForStepTimer) {
-			if (!_stepTimer.WaitForNextFrame()) {
+			std::chrono::steady_clock::time_point wakeTime;
+			if (!_stepTimer.IsNextFrameDue(wakeTime)) {
 				_stepTimer.UpdateFPS(false);
+				_WaitForBackendEvents(NULL, wakeTime);
 				continue;
 			}
 			waitingForStepTimer = false;
+			frameWaitStart = std::chrono::steady_clock::now();
+			comparisonWait = {};
+		}
+
+		const auto frameTime = std::chrono::steady_clock::now();
+		if (!captureStart) {
+			// 只能轮询的帧源在预计没有新帧时推迟捕获
+			const int64_t now = ToNs(frameTime);
+			const int64_t captureTime = _backendScheduler.NextCaptureTime(now);
+			if (captureTime > now) {
+				_stepTimer.UpdateFPS(false);
+				_WaitForBackendEvents(NULL, frameTime + std::chrono::nanoseconds(captureTime - now));
+				continue;
+			}
+
+			captureStart = frameTime;
 		}
 
 		const FrameSourceBase::UpdateState state = _frameSource->Update();
 		_stepTimer.UpdateFPS(state == FrameSourceBase::UpdateState::NewFrame);
 
+		const HANDLE hComparisonEvent = state == FrameSourceBase::UpdateState::Waiting ?
+			_frameSource->PendingComparisonEvent() : NULL;
+		if (!hComparisonEvent) {
+			_backendScheduler.OnCaptured(ToNs(*captureStart), state == FrameSourceBase::UpdateState::NewFrame);
+			captureStart.reset();
+		}
+
+		// 源窗口静止时也应立即显示热重载的结果
+		if (std::exchange(_isEffectsReloaded, false) && state != FrameSourceBase::UpdateState::NewFrame) {
+			_BackendRender();
+		}
+
 		switch (state) {
 		case FrameSourceBase::UpdateState::NewFrame:
 		{
-			_BackendRender(outputTexture);
+			using FloatMs = std::chrono::duration<float, std::milli>;
+			_frameTimings.Record(FrameTimingRecorder::Stage::CaptureWait,
+				FloatMs(std::chrono::steady_clock::now() - frameWaitStart - comparisonWait).count());
+			_frameTimings.Record(FrameTimingRecorder::Stage::DuplicateCheck, FloatMs(comparisonWait).count());
+
+			_BackendRender();
+			_stepTimer.OnFrameRendered(frameTime, std::chrono::steady_clock::now());
 			waitingForStepTimer = true;
 			break;
 		}
 		case FrameSourceBase::UpdateState::Waiting:
 		{
-			if (_frameSource->WaitType() == FrameSourceBase::WaitForMessage) {
-				// 等待新消息
-				WaitMessage();
+			if (hComparisonEvent) {
+				// 等待重复帧检查完成，同时处理消息
+				const auto waitStart = std::chrono::steady_clock::now();
+				_WaitForBackendEvents(hComparisonEvent, std::nullopt);
+				comparisonWait += std::chrono::steady_clock::now() - waitStart;
+			} else if (_backendScheduler.Kind() == BackendScheduler::SourceKind::Event) {
+				// 新帧到达时会有新消息或触发帧源的事件
+				_WaitForBackendEvents(_frameSource->NewFrameEvent(), std::nullopt);
 			}
+			// 轮询的帧源在下一次循环中等待到下一次捕获的时间，Desktop Duplication 在捕获时等待
 			break;
 		}
 		default:
@@ -715,6 +1395,38 @@ void Renderer::_BackendThreadProc() noexcept {
 	}
 }
 
+void Renderer::_WaitForBackendEvents(
+	HANDLE hEvent,
+	std::optional<std::chrono::steady_clock::time_point> deadline
+) noexcept {
+	HANDLE handles[2];
+	DWORD count = 0;
+	if (hEvent) {
+		handles[count++] = hEvent;
+	}
+
+	if (deadline) {
+		const auto rest = *deadline - std::chrono::steady_clock::now();
+		if (rest <= std::chrono::nanoseconds(0)) {
+			return;
+		}
+
+		// 负值表示相对时间，单位为 100ns
+		LARGE_INTEGER liDueTime{
+			.QuadPart = -std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(rest).count() / 100, 1)
+		};
+		SetWaitableTimerEx(_hBackendTimer.get(), &liDueTime, 0, NULL, NULL, NULL, 0);
+		handles[count++] = _hBackendTimer.get();
+	}
+
+	// MWMO_INPUTAVAILABLE 使得已在队列中但未处理的消息也能唤醒
+	MsgWaitForMultipleObjectsEx(count, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+	if (deadline) {
+		CancelWaitableTimer(_hBackendTimer.get());
+	}
+}
+
 ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 	// 创建 DispatcherQueue
 	{
@@ -734,7 +1446,7 @@ ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 		_backendThreadDispatcher = dqc.DispatcherQueue();
 	}
 
-	if (!_backendResources.Initialize()) {
+	if (!_backendResources.Initialize(ScalingWindow::Get().Options().graphicsCard)) {
 		return nullptr;
 	}
 	
@@ -746,32 +1458,49 @@ ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 	}
 
 	{
+		const ScalingOptions& options = ScalingWindow::Get().Options();
+
 		std::optional<float> frameRateLimit;
-		if (_frameSource->WaitType() == FrameSourceBase::NoWait) {
+		// 不限帧率的回放用于测量吞吐量，不受屏幕刷新率限制
+		if (_frameSource->WaitType() == FrameSourceBase::NoWait && options.captureMethod != CaptureMethod::Replay) {
 			// 某些捕获方式不会限制捕获帧率，因此将捕获帧率限制为屏幕刷新率
-			const HWND hwndSrc = ScalingWindow::Get().HwndSrc();
-			if (HMONITOR hMon = MonitorFromWindow(hwndSrc, MONITOR_DEFAULTTONEAREST)) {
-				MONITORINFOEX mi{ sizeof(MONITORINFOEX) };
-				GetMonitorInfo(hMon, &mi);
-
-				DEVMODE dm{ .dmSize = sizeof(DEVMODE) };
-				EnumDisplaySettings(mi.szDevice, ENUM_CURRENT_SETTINGS, &dm);
-
-				if (dm.dmDisplayFrequency > 0) {
-					Logger::Get().Info(fmt::format("屏幕刷新率: {}", dm.dmDisplayFrequency));
-					frameRateLimit = float(dm.dmDisplayFrequency);
-				}
+			const uint32_t refreshRate = Win32Utils::GetMonitorRefreshRate(ScalingWindow::Get().HwndSrc());
+			if (refreshRate > 0) {
+				Logger::Get().Info(fmt::format("屏幕刷新率: {}", refreshRate));
+				frameRateLimit = float(refreshRate);
 			}
 		}
 
-		const ScalingOptions& options = ScalingWindow::Get().Options();
 		if (options.maxFrameRate) {
 			if (!frameRateLimit || *options.maxFrameRate < *frameRateLimit) {
 				frameRateLimit = options.maxFrameRate;
 			}
 		}
 
-		_stepTimer.Initialize(frameRateLimit);
+		_stepTimer.Initialize(frameRateLimit, options.framePacingMode);
+
+		BackendScheduler::SourceKind sourceKind = BackendScheduler::SourceKind::Event;
+		if (_frameSource->WaitType() == FrameSourceBase::NoWait) {
+			sourceKind = BackendScheduler::SourceKind::Polled;
+		} else if (_frameSource->WaitType() == FrameSourceBase::WaitForFrame) {
+			sourceKind = BackendScheduler::SourceKind::Blocking;
+		}
+		// WaitForMessage 和 WaitForEvent 都有新帧时才唤醒后端
+		// 轮询间隔和帧率限制相同
+		_backendScheduler.Initialize(sourceKind,
+			frameRateLimit ? int64_t(1e9 / *frameRateLimit) : 0);
+		_frameSource->SetFrameWaitTimeout(_backendScheduler.BlockingTimeout());
+	}
+
+	// 高精度定时器需要 Win10 v1803，不支持时回落到普通定时器
+	_hBackendTimer.reset(CreateWaitableTimerEx(nullptr, nullptr,
+		CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	if (!_hBackendTimer) {
+		_hBackendTimer.reset(CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+		if (!_hBackendTimer) {
+			Logger::Get().Win32Error("CreateWaitableTimerEx 失败");
+			return nullptr;
+		}
 	}
 
 	ID3D11Texture2D* outputTexture = _BuildEffects();
@@ -791,32 +1520,130 @@ ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 		return nullptr;
 	}
 
-	HANDLE sharedHandle = _CreateSharedTexture(outputTexture);
-	if (!sharedHandle) {
-		Logger::Get().Win32Error("_CreateSharedTexture 失败");
+	if (!_CreateSharedTextures(outputTexture)) {
+		Logger::Get().Error("_CreateSharedTextures 失败");
 		return nullptr;
 	}
+
+	{
+		const SIZE frameSize = _frameSource->OutputSize();
+		_autoCropRect = { 0, 0, (uint32_t)frameSize.cx, (uint32_t)frameSize.cy };
+
+		if (ScalingWindow::Get().Options().IsAutoCroppingEnabled()) {
+			// 检测整个输出，启用裁剪时输出是捕获的纹理中的区域
+			const POINT offset = _frameSource->IsOutputCropped() ? _frameSource->OutputOffset() : POINT{};
+			_autoCropper = std::make_unique<AutoCropper>();
+			if (!_autoCropper->Initialize(_backendResources, _backendDescriptorStore, frameSize, offset)) {
+				// 只是优化，失败不影响缩放
+				Logger::Get().Error("初始化 AutoCropper 失败");
+				_autoCropper.reset();
+			}
+		}
+	}
 	
 	_srcRect = _frameSource->SrcRect();
-	_sharedTextureHandle.store(sharedHandle, std::memory_order_release);
+	_sharedTextureHandle.store(_sharedTextureHandles[0], std::memory_order_release);
 	_sharedTextureHandle.notify_one();
 
 	return outputTexture;
 }
 
-void Renderer::_BackendRender(ID3D11Texture2D* effectsOutput) noexcept {
+void Renderer::_BackendRender() noexcept {
+	using FloatMs = std::chrono::duration<float, std::milli>;
+	const auto startTime = std::chrono::steady_clock::now();
+
 	ID3D11DeviceContext4* d3dDC = _backendResources.GetD3DDC();
 	d3dDC->ClearState();
 
+	if (_autoCropper) {
+		if (_autoCropper->Poll() && !_ApplyAutoCrop(_autoCropper->ActiveRect())) {
+			Logger::Get().Error("裁剪黑边失败，将不再裁剪");
+			_autoCropper.reset();
+
+			const SIZE frameSize = _frameSource->OutputSize();
+			if (!_ApplyAutoCrop({ 0, 0, (uint32_t)frameSize.cx, (uint32_t)frameSize.cy })) {
+				Logger::Get().Error("恢复效果链的尺寸失败");
+				_effectsOutput = nullptr;
+			}
+		}
+
+		if (_autoCropper) {
+			// 结果在之后的帧中取回，检测因此滞后几帧。有效区域扩大时最多有这几帧的画面被裁掉
+			_autoCropper->Submit(_frameSource->GetOutputSrv());
+		}
+	}
+
+	if (!_effectsOutput) {
+		// 重新创建效果链的资源失败
+		return;
+	}
+
 	if (ID3D11Buffer* t = _dynamicCB.get()) {
 		_UpdateDynamicConstants();
 		d3dDC->CSSetConstantBuffers(1, 1, &t);
 	}
 
+	ID3D11Buffer* tileOffsetCB = _tileOffsetCB.get();
+	if (tileOffsetCB) {
+		d3dDC->CSSetConstantBuffers(2, 1, &tileOffsetCB);
+	}
+
+	std::span<const SmallVector<RegionPropagator::Rect>> passTiles;
+	if (_isRegionRenderingEnabled) {
+		const SmallVector<RECT>* dirtyRects = _frameSource->DirtyRects();
+		if (std::exchange(_isFullRenderNeeded, false) || !dirtyRects) {
+			_regionPropagator.Propagate(nullptr);
+		} else {
+			// 变换到效果链的输入中，裁剪黑边时有效区域之外的变化被忽略
+			const int32_t cropLeft = (int32_t)_autoCropRect.left;
+			const int32_t cropTop = (int32_t)_autoCropRect.top;
+			const int32_t cropWidth = (int32_t)_autoCropRect.Width();
+			const int32_t cropHeight = (int32_t)_autoCropRect.Height();
+
+			SmallVector<RegionPropagator::Rect> rects;
+			rects.reserve(dirtyRects->size());
+			for (const RECT& rect : *dirtyRects) {
+				const RegionPropagator::Rect clipped{
+					std::max((int32_t)rect.left - cropLeft, 0),
+					std::max((int32_t)rect.top - cropTop, 0),
+					std::min((int32_t)rect.right - cropLeft, cropWidth),
+					std::min((int32_t)rect.bottom - cropTop, cropHeight)
+				};
+				if (!clipped.IsEmpty()) {
+					rects.push_back(clipped);
+				}
+			}
+			_regionPropagator.Propagate(&rects);
+		}
+
+		passTiles = _regionPropagator.PassTiles();
+	}
+
+	if (_autoCropInput) {
+		const D3D11_BOX box{
+			_autoCropRect.left,
+			_autoCropRect.top,
+			0,
+			_autoCropRect.right,
+			_autoCropRect.bottom,
+			1
+		};
+		d3dDC->CopySubresourceRegion(_autoCropInput.get(), 0, 0, 0, 0, _frameSource->GetOutput(), 0, &box);
+	}
+
 	_effectsProfiler.OnBeginEffects(d3dDC);
 
+	if (_frameSource->IsOutputCropped()) {
+		// 捕获的纹理每帧可能不同
+		_effectDrawers[0].SetInput(_frameSource->GetOutputSrv());
+	}
+
 	for (const EffectDrawer& effectDrawer : _effectDrawers) {
-		effectDrawer.Draw(_effectsProfiler);
+		const uint32_t passCount = effectDrawer.PassCount();
+		effectDrawer.Draw(_effectsProfiler, passTiles.empty() ? passTiles : passTiles.first(passCount), tileOffsetCB);
+		if (!passTiles.empty()) {
+			passTiles = passTiles.subspan(passCount);
+		}
 	}
 
 	_effectsProfiler.OnEndEffects(d3dDC);
@@ -838,27 +1665,45 @@ void Renderer::_BackendRender(ID3D11Texture2D* effectsOutput) noexcept {
 	// 等待渲染完成
 	_fenceEvent.wait();
 
+	const auto effectsEndTime = std::chrono::steady_clock::now();
+	_frameTimings.Record(FrameTimingRecorder::Stage::Effects, FloatMs(effectsEndTime - startTime).count());
+
 	// 查询效果的渲染时间
 	_effectsProfiler.QueryTimings(d3dDC);
 
-	// 渲染完成后再更新 _sharedTextureMutexKey，否则前端必须等待，降低光标流畅度
-	const uint64_t key = ++_sharedTextureMutexKey;
-	hr = _backendSharedTextureMutex->AcquireSync(key - 1, INFINITE);
+	// 写入前端不会访问的缓冲区，渲染完成后才发布，前端始终可以呈现上一帧而不必等待
+	const uint32_t bufferIdx = _frameHandoff.BackBufferIndex();
+	IDXGIKeyedMutex* sharedTextureMutex = _backendSharedTextureMutexes[bufferIdx].get();
+	hr = sharedTextureMutex->AcquireSync(0, INFINITE);
 	if (FAILED(hr)) {
 		Logger::Get().ComError("AcquireSync 失败", hr);
 		return;
 	}
 
-	d3dDC->CopyResource(_backendSharedTexture.get(), effectsOutput);
+	if (_sharedTexturesToClear & (1u << bufferIdx)) {
+		// 裁剪变化后效果链的输出之外的区域可能残留之前的画面
+		_sharedTexturesToClear &= ~(1u << bufferIdx);
+		static constexpr FLOAT BLACK[4]{ 0.0f, 0.0f, 0.0f, 1.0f };
+		d3dDC->ClearRenderTargetView(_backendSharedTextureRtvs[bufferIdx].get(), BLACK);
+	}
+
+	// 裁剪黑边时效果链的输出只是共享纹理中的一部分
+	d3dDC->CopySubresourceRegion(_backendSharedTextures[bufferIdx].get(), 0,
+		(UINT)_autoCropDestOffset.x, (UINT)_autoCropDestOffset.y, 0, _effectsOutput, 0, nullptr);
 
-	_backendSharedTextureMutex->ReleaseSync(key);
+	sharedTextureMutex->ReleaseSync(0);
 
 	// 根据 https://learn.microsoft.com/en-us/windows/win32/api/d3d11/nf-d3d11-id3d11device-opensharedresource，
 	// 更新共享纹理后必须调用 Flush
 	d3dDC->Flush();
 
+	_frameHandoff.Publish();
+
 	// 唤醒前台线程
 	PostMessage(ScalingWindow::Get().Handle(), WM_NULL, 0, 0);
+
+	_frameTimings.Record(FrameTimingRecorder::Stage::Handoff,
+		FloatMs(std::chrono::steady_clock::now() - effectsEndTime).count());
 }
 
 bool Renderer::_UpdateDynamicConstants() const noexcept {
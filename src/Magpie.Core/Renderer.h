@@ -6,10 +6,17 @@
 #include "CursorDrawer.h"
 #include "StepTimer.h"
 #include "EffectsProfiler.h"
+#include "EffectHotReloader.h"
+#include "RegionPropagator.h"
+#include "FrameTimingRecorder.h"
+#include "FrameHandoff.h"
+#include "BackendScheduler.h"
+#include "LetterboxDetector.h"
 
 namespace Magpie::Core {
 
 class FrameSourceBase;
+class AutoCropper;
 
 class Renderer {
 public:
@@ -40,6 +47,20 @@ public:
 		return *_frameSource;
 	}
 
+	bool IsFramePacingEnabled() const noexcept {
+		return _stepTimer.IsPacingEnabled();
+	}
+
+	// 从捕获到显示的延迟的中位数和 99% 分位数，单位为毫秒
+	std::pair<float, float> FrameLatency() const noexcept {
+		return _stepTimer.Latency();
+	}
+
+	// 可从前端线程读取
+	const FrameTimingRecorder& FrameTimings() const noexcept {
+		return _frameTimings;
+	}
+
 	void OnCursorVisibilityChanged(bool isVisible, bool onDestory);
 
 	void MessageHandler(UINT msg, WPARAM wParam, LPARAM lParam) noexcept;
@@ -59,18 +80,41 @@ private:
 
 	void _BackendThreadProc() noexcept;
 
+	// 后端线程只在这里等待。hEvent 触发、到达 deadline 或有新消息（包括 DispatcherQueue 的任务、
+	// Graphics Capture 的新帧和 WM_QUIT）时返回。hEvent 可以为空，deadline 为空表示不限时
+	void _WaitForBackendEvents(HANDLE hEvent, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept;
+
 	ID3D11Texture2D* _InitBackend() noexcept;
 
 	bool _InitFrameSource() noexcept;
 
 	ID3D11Texture2D* _BuildEffects() noexcept;
 
-	HANDLE _CreateSharedTexture(ID3D11Texture2D* effectsOutput) noexcept;
+	// 对整个效果链规划中间纹理，尺寸和格式相同且生命周期不重叠的纹理共享显存。返回效果链的输出。
+	// 帧源能报告变化的区域时同时初始化 _regionPropagator，此时纹理需要保留内容，不再共享。
+	// 可以再次调用以重新创建，之前的纹理被释放
+	ID3D11Texture2D* _CreateEffectTextures(std::span<const EffectDesc* const> descs) noexcept;
+
+	// 效果链只处理帧源的输出中的 rect 区域，重新计算尺寸并创建中间纹理。共享纹理的尺寸不变，
+	// 效果链的输出被复制到其中对应的位置，因此光标映射和前端都无需改变
+	bool _ApplyAutoCrop(const LetterboxDetector::Rect& rect) noexcept;
+
+	// 创建 FrameHandoff::BUFFER_COUNT 个共享纹理并填充 _sharedTextureHandles
+	bool _CreateSharedTextures(ID3D11Texture2D* effectsOutput) noexcept;
 
-	void _BackendRender(ID3D11Texture2D* effectsOutput) noexcept;
+	void _BackendRender() noexcept;
 
 	bool _UpdateDynamicConstants() const noexcept;
 
+	// 在热重载线程中调用，isInputCropped 为初始化时第一个效果的输入是否被裁剪
+	void _HotReloadEffects(
+		bool isInputCropped,
+		const SmallVector<EffectHotReloader::ChangedEffect>& changedEffects
+	) noexcept;
+
+	// 在后台线程中调用
+	void _ApplyReloadedEffect(uint32_t effectIdx, std::shared_ptr<const EffectDesc> desc) noexcept;
+
 	static LRESULT CALLBACK _LowLevelKeyboardHook(int nCode, WPARAM wParam, LPARAM lParam);
 
 	// 只能由前台线程访问
@@ -79,7 +123,6 @@ private:
 	wil::unique_event_nothrow _frameLatencyWaitableObject;
 	winrt::com_ptr<ID3D11Texture2D> _backBuffer;
 	winrt::com_ptr<ID3D11RenderTargetView> _backBufferRtv;
-	uint64_t _lastAccessMutexKey = 0;
 
 	CursorDrawer _cursorDrawer;
 	std::unique_ptr<class OverlayDrawer> _overlayDrawer;
@@ -88,8 +131,8 @@ private:
 	POINT _lastCursorPos{ std::numeric_limits<LONG>::max(), std::numeric_limits<LONG>::max() };
 	uint32_t _lastFPS = std::numeric_limits<uint32_t>::max();
 
-	winrt::com_ptr<ID3D11Texture2D> _frontendSharedTexture;
-	winrt::com_ptr<IDXGIKeyedMutex> _frontendSharedTextureMutex;
+	std::array<winrt::com_ptr<ID3D11Texture2D>, FrameHandoff::BUFFER_COUNT> _frontendSharedTextures;
+	std::array<winrt::com_ptr<IDXGIKeyedMutex>, FrameHandoff::BUFFER_COUNT> _frontendSharedTextureMutexes;
 	RECT _destRect{};
 	
 	std::thread _backendThread;
@@ -101,28 +144,68 @@ private:
 	Magpie::Core::BackendDescriptorStore _backendDescriptorStore;
 	std::unique_ptr<FrameSourceBase> _frameSource;
 	std::vector<EffectDrawer> _effectDrawers;
+	// 效果链的输出，裁剪黑边后会被重新创建
+	ID3D11Texture2D* _effectsOutput = nullptr;
+	// _CreateEffectTextures 创建的纹理。EffectDrawer 也持有它们，保留在这里是为了重新创建时释放视图
+	std::vector<winrt::com_ptr<ID3D11Texture2D>> _effectTextures;
 
 	StepTimer _stepTimer;
+	BackendScheduler _backendScheduler;
+	wil::unique_handle _hBackendTimer;
 	EffectsProfiler _effectsProfiler;
+	// Present 由前端写入，其他阶段由后端写入
+	FrameTimingRecorder _frameTimings;
 
 	winrt::com_ptr<ID3D11Fence> _d3dFence;
 	uint64_t _fenceValue = 0;
 	wil::unique_event_nothrow _fenceEvent;
 
-	winrt::com_ptr<ID3D11Texture2D> _backendSharedTexture;
-	winrt::com_ptr<IDXGIKeyedMutex> _backendSharedTextureMutex;
+	std::array<winrt::com_ptr<ID3D11Texture2D>, FrameHandoff::BUFFER_COUNT> _backendSharedTextures;
+	std::array<winrt::com_ptr<IDXGIKeyedMutex>, FrameHandoff::BUFFER_COUNT> _backendSharedTextureMutexes;
+	// 仅在自动裁剪黑边时创建，用于清除效果链的输出之外的区域
+	std::array<winrt::com_ptr<ID3D11RenderTargetView>, FrameHandoff::BUFFER_COUNT> _backendSharedTextureRtvs;
 
 	winrt::com_ptr<ID3D11Buffer> _dynamicCB;
 	uint32_t _firstDynamicEffectIdx = std::numeric_limits<uint32_t>::max();
 
+	// 只重新渲染变化的区域，见 RegionPropagator
+	RegionPropagator _regionPropagator;
+	// 有 FOOTPRINT 的通道每次调度的起始块
+	winrt::com_ptr<ID3D11Buffer> _tileOffsetCB;
+	bool _isRegionRenderingEnabled = false;
+	// 中间纹理的内容无效，如刚创建或热重载之后
+	bool _isFullRenderNeeded = true;
+
+	// 自动裁剪黑边，见 ScalingFlags::AutoCropping
+	std::unique_ptr<AutoCropper> _autoCropper;
+	// 每个 EffectDrawer 的 EffectDesc 和选项，裁剪变化时据此重新计算尺寸
+	std::vector<std::shared_ptr<const EffectDesc>> _drawerDescs;
+	std::vector<EffectOption> _drawerOptions;
+	// 效果链处理的区域，未裁剪时为整个输出
+	LetterboxDetector::Rect _autoCropRect;
+	// 第一个效果不能直接读取捕获的纹理时，每帧把裁剪的区域复制到这里作为 INPUT
+	winrt::com_ptr<ID3D11Texture2D> _autoCropInput;
+	// 效果链的输出在共享纹理中的位置
+	POINT _autoCropDestOffset{};
+	// 裁剪变化后这些共享纹理需要先填充黑色，每个缓冲区一位
+	uint32_t _sharedTexturesToClear = 0;
+
+	// 仅在启用热重载时使用，新的编译结果需要和当前的布局比较
+	std::vector<std::shared_ptr<const EffectDesc>> _effectDescs;
+	std::unique_ptr<EffectHotReloader> _effectHotReloader;
+	// 热重载后即使没有新帧也要渲染一次
+	bool _isEffectsReloaded = false;
+
 	// 可由所有线程访问
 	winrt::Windows::System::DispatcherQueue _backendThreadDispatcher{ nullptr };
 
-	std::atomic<uint64_t> _sharedTextureMutexKey = 0;
+	// 前后端通过它交换共享纹理，双方都不会等待对方
+	FrameHandoff _frameHandoff;
 
-	// INVALID_HANDLE_VALUE 表示后端初始化失败
+	// 第一个共享纹理的句柄，INVALID_HANDLE_VALUE 表示后端初始化失败
 	std::atomic<HANDLE> _sharedTextureHandle{ NULL };
 	// 初始化时由 _sharedTextureHandle 同步
+	std::array<HANDLE, FrameHandoff::BUFFER_COUNT> _sharedTextureHandles{};
 	RECT _srcRect{};
 
 	// 供游戏内叠加层使用
@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "ReplayFrameSource.h"
+#include "Logger.h"
+#include "ScalingOptions.h"
+#include "ScalingWindow.h"
+#include "DeviceResources.h"
+#include "DirectXHelper.h"
+#include "TextureLoader.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include "FrameTimingRecorder.h"
+
+namespace Magpie::Core {
+
+static bool IsImageFile(std::wstring_view fileName) noexcept {
+	const size_t dotPos = fileName.find_last_of(L'.');
+	if (dotPos == std::wstring_view::npos) {
+		return false;
+	}
+
+	// 和 TextureLoader 支持的格式相同
+	const std::wstring_view suffix = fileName.substr(dotPos + 1);
+	return suffix == L"bmp" || suffix == L"jpg" || suffix == L"jpeg" || suffix == L"png"
+		|| suffix == L"tif" || suffix == L"tiff" || suffix == L"dds";
+}
+
+ReplayFrameSource::~ReplayFrameSource() {
+	if (_hTimer) {
+		Logger::Get().Info(fmt::format("回放帧源共提供 {} 帧，其中 {} 帧晚于预定时间", _replayIndex, _lateCount));
+	}
+}
+
+bool ReplayFrameSource::_Initialize() noexcept {
+	// 源窗口仍决定缩放窗口的位置
+	if (!_CalcSrcRect()) {
+		Logger::Get().Error("_CalcSrcRect 失败");
+		return false;
+	}
+
+	const ScalingOptions& options = ScalingWindow::Get().Options();
+	if (options.replayPath.empty()) {
+		if (!_InitTestPattern()) {
+			Logger::Get().Error("_InitTestPattern 失败");
+			return false;
+		}
+	} else if (!_LoadFrames(options.replayPath)) {
+		Logger::Get().Error("_LoadFrames 失败");
+		return false;
+	}
+
+	if (options.replayFrameRate > 0) {
+		// 高精度定时器需要 Win10 v1803，不支持时回落到普通定时器
+		_hTimer.reset(CreateWaitableTimerEx(nullptr, nullptr,
+			CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+		if (!_hTimer) {
+			_hTimer.reset(CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+			if (!_hTimer) {
+				Logger::Get().Win32Error("CreateWaitableTimerEx 失败");
+				return false;
+			}
+		}
+
+		_frameInterval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::duration<float>(1 / options.replayFrameRate));
+
+		// 第一帧立即可用
+		_nextFrameTime = std::chrono::steady_clock::now();
+		LARGE_INTEGER liDueTime{ .QuadPart = -1 };
+		if (!SetWaitableTimerEx(_hTimer.get(), &liDueTime, 0, NULL, NULL, NULL, 0)) {
+			Logger::Get().Win32Error("SetWaitableTimerEx 失败");
+			return false;
+		}
+	}
+
+	Logger::Get().Info(fmt::format("ReplayFrameSource 初始化完成，帧率: {}", options.replayFrameRate));
+	return true;
+}
+
+FrameSourceBase::UpdateState ReplayFrameSource::_Update() noexcept {
+	if (_hTimer) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now < _nextFrameTime) {
+			// 因其他事件被唤醒
+			return UpdateState::Waiting;
+		}
+
+		_frameTimings->Record(FrameTimingRecorder::Stage::SourceQueue,
+			std::chrono::duration<float, std::milli>(now - _nextFrameTime).count());
+
+		// 按固定间隔提供新帧，落后时不追赶
+		_nextFrameTime += _frameInterval;
+		if (_nextFrameTime < now) {
+			_nextFrameTime = now;
+			++_lateCount;
+		}
+
+		// 负值表示相对时间，单位为 100ns
+		LARGE_INTEGER liDueTime{
+			.QuadPart = -std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				_nextFrameTime - now).count() / 100, 1)
+		};
+		if (!SetWaitableTimerEx(_hTimer.get(), &liDueTime, 0, NULL, NULL, NULL, 0)) {
+			Logger::Get().Win32Error("SetWaitableTimerEx 失败");
+			return UpdateState::Error;
+		}
+	}
+
+	if (!_frames.empty()) {
+		if (!_UpdateOutput(_frames[_replayIndex % _frames.size()].get())) {
+			return UpdateState::Error;
+		}
+	} else {
+		ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
+
+		if (_replayIndex == 0) {
+			// 第一帧上传完整画面
+			const uint32_t width = _frameBox.right;
+			_testPattern.Render(0, { 0, 0, width, _frameBox.bottom }, _patternBuffer.data(), width * 4);
+			d3dDC->UpdateSubresource(_output.get(), 0, nullptr, _patternBuffer.data(), width * 4, 0);
+
+			// 显式报告整个输出，不依赖未报告变化区域时的默认行为
+			_AddDirtyRect({ 0, 0, (LONG)width, (LONG)_frameBox.bottom });
+		} else {
+			// 之后只上传变化的区域
+			_testPattern.ChangedRects(_replayIndex, _changedRects);
+			for (const TestPattern::Rect& rect : _changedRects) {
+				const uint32_t pitch = (rect.right - rect.left) * 4;
+				_testPattern.Render(_replayIndex, rect, _patternBuffer.data(), pitch);
+
+				const D3D11_BOX box{ rect.left, rect.top, 0, rect.right, rect.bottom, 1 };
+				d3dDC->UpdateSubresource(_output.get(), 0, &box, _patternBuffer.data(), pitch, 0);
+
+				_AddDirtyRect({ (LONG)rect.left, (LONG)rect.top, (LONG)rect.right, (LONG)rect.bottom });
+			}
+		}
+	}
+
+	++_replayIndex;
+	return UpdateState::NewFrame;
+}
+
+bool ReplayFrameSource::_LoadFrames(const std::wstring& dir) noexcept {
+	std::vector<std::wstring> fileNames;
+	WIN32_FIND_DATA findData{};
+	wil::unique_hfind hFind(FindFirstFileEx(StrUtils::Concat(dir, L"\\*").c_str(),
+		FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
+	if (hFind) {
+		do {
+			if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && IsImageFile(findData.cFileName)) {
+				fileNames.emplace_back(findData.cFileName);
+			}
+		} while (FindNextFile(hFind.get(), &findData));
+	}
+
+	if (fileNames.empty()) {
+		Logger::Get().Error("回放的文件夹中没有图像");
+		return false;
+	}
+
+	// 预先加载所有图像，回放时不读取文件
+	std::sort(fileNames.begin(), fileNames.end());
+	ID3D11Device5* d3dDevice = _deviceResources->GetD3DDevice();
+	D3D11_TEXTURE2D_DESC frameDesc{};
+	_frames.reserve(fileNames.size());
+	for (const std::wstring& fileName : fileNames) {
+		winrt::com_ptr<ID3D11Texture2D> frame =
+			TextureLoader::Load(StrUtils::Concat(dir, L"\\", fileName).c_str(), d3dDevice);
+		if (!frame) {
+			Logger::Get().Error(StrUtils::Concat("加载 ", StrUtils::UTF16ToUTF8(fileName), " 失败"));
+			return false;
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		frame->GetDesc(&desc);
+		if (_frames.empty()) {
+			frameDesc = desc;
+		} else if (desc.Width != frameDesc.Width || desc.Height != frameDesc.Height || desc.Format != frameDesc.Format) {
+			Logger::Get().Error(StrUtils::Concat(
+				StrUtils::UTF16ToUTF8(fileName), " 和第一帧的尺寸或格式不同"));
+			return false;
+		}
+
+		_frames.push_back(std::move(frame));
+	}
+
+	// 每帧复制一次，开销和捕获窗口相当。_output 使用图像的格式，以便直接复制
+	_frameBox = { 0, 0, 0, frameDesc.Width, frameDesc.Height, 1 };
+	_output = DirectXHelper::CreateTexture2D(
+		d3dDevice,
+		frameDesc.Format,
+		frameDesc.Width,
+		frameDesc.Height,
+		D3D11_BIND_SHADER_RESOURCE
+	);
+	if (!_output) {
+		Logger::Get().Error("创建纹理失败");
+		return false;
+	}
+
+	Logger::Get().Info(fmt::format("已加载 {} 帧，尺寸: {}x{}", _frames.size(), frameDesc.Width, frameDesc.Height));
+	return true;
+}
+
+bool ReplayFrameSource::_InitTestPattern() noexcept {
+	// 测试画面和源窗口的尺寸相同
+	const SIZE srcSize = Win32Utils::GetSizeOfRect(_srcRect);
+	_testPattern.Initialize((uint32_t)srcSize.cx, (uint32_t)srcSize.cy);
+	_patternBuffer.resize((size_t)srcSize.cx * srcSize.cy * 4);
+
+	_frameBox = { 0, 0, 0, (UINT)srcSize.cx, (UINT)srcSize.cy, 1 };
+	_output = DirectXHelper::CreateTexture2D(
+		_deviceResources->GetD3DDevice(),
+		DXGI_FORMAT_B8G8R8A8_UNORM,
+		srcSize.cx,
+		srcSize.cy,
+		D3D11_BIND_SHADER_RESOURCE
+	);
+	if (!_output) {
+		Logger::Get().Error("创建纹理失败");
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "FrameSourceBase.h"
+#include "TestPattern.h"
+
+namespace Magpie::Core {
+
+// 不捕获源窗口，而是按文件名顺序循环回放文件夹中的图像，未指定文件夹时生成测试画面，见 TestPattern。
+// 用于在没有真实窗口时可重复地测量渲染管线的吞吐量和延迟。按 ScalingOptions::replayFrameRate 提供新帧，
+// 为 0 时每次 Update 都有新帧
+class ReplayFrameSource final : public FrameSourceBase {
+public:
+	virtual ~ReplayFrameSource();
+
+	bool IsScreenCapture() const noexcept override {
+		return false;
+	}
+
+	FrameSourceWaitType WaitType() const noexcept override {
+		return _hTimer ? WaitForEvent : NoWait;
+	}
+
+	HANDLE NewFrameEvent() const noexcept override {
+		return _hTimer.get();
+	}
+
+	const char* Name() const noexcept override {
+		return "Replay";
+	}
+
+	bool CanReportDirtyRects() const noexcept override {
+		// 测试画面的变化区域是已知的
+		return _frames.empty() || FrameSourceBase::CanReportDirtyRects();
+	}
+
+protected:
+	bool _Initialize() noexcept override;
+
+	UpdateState _Update() noexcept override;
+
+	bool _HasRoundCornerInWin11() noexcept override {
+		return false;
+	}
+
+	bool _CanCaptureTitleBar() noexcept override {
+		return false;
+	}
+
+private:
+	bool _LoadFrames(const std::wstring& dir) noexcept;
+
+	bool _InitTestPattern() noexcept;
+
+	// 回放的图像，为空时使用 _testPattern
+	std::vector<winrt::com_ptr<ID3D11Texture2D>> _frames;
+
+	TestPattern _testPattern;
+	// 测试画面变化区域的像素，每帧重新渲染后上传
+	std::vector<uint8_t> _patternBuffer;
+	std::vector<TestPattern::Rect> _changedRects;
+
+	// 下一个新帧的序号
+	uint64_t _replayIndex = 0;
+
+	// 限制帧率时为同步定时器，到达下一帧的时间时触发
+	wil::unique_handle _hTimer;
+	std::chrono::nanoseconds _frameInterval{};
+	std::chrono::steady_clock::time_point _nextFrameTime;
+	// 因后端落后而推迟的帧数
+	uint64_t _lateCount = 0;
+};
+
+}
@@ -44,6 +44,7 @@ void ScalingOptions::Log() const noexcept {
 	IsFontCacheDisabled: {}
 	IsSaveEffectSources: {}
 	IsWarningsAreErrors: {}
+	IsEffectHotReloadEnabled: {}
 	IsAllowScalingMaximized: {}
 	IsSimulateExclusiveFullscreen: {}
 	Is3DGameMode: {}
@@ -54,6 +55,7 @@ void ScalingOptions::Log() const noexcept {
 	IsDirectFlipDisabled: {}
 	IsStatisticsForDynamicDetectionEnabled: {}
 	IsTouchSupportEnabled: {}
+	IsAutoCroppingEnabled: {}
 	cropping: {},{},{},{}
 	graphicsCard: {}
 	maxFrameRate: {}
@@ -62,6 +64,9 @@ void ScalingOptions::Log() const noexcept {
 	multiMonitorUsage: {}
 	cursorInterpolationMode: {}
 	duplicateFrameDetectionMode: {}
+	framePacingMode: {}
+	replayPath: {}
+	replayFrameRate: {}
 	effects: {})",
 		IsWindowResizingDisabled(),
 		IsDebugMode(),
@@ -69,6 +74,7 @@ void ScalingOptions::Log() const noexcept {
 		IsFontCacheDisabled(),
 		IsSaveEffectSources(),
 		IsWarningsAreErrors(),
+		IsEffectHotReloadEnabled(),
 		IsAllowScalingMaximized(),
 		IsSimulateExclusiveFullscreen(),
 		Is3DGameMode(),
@@ -79,6 +85,7 @@ void ScalingOptions::Log() const noexcept {
 		IsDirectFlipDisabled(),
 		IsStatisticsForDynamicDetectionEnabled(),
 		IsTouchSupportEnabled(),
+		IsAutoCroppingEnabled(),
 		cropping.Left, cropping.Top, cropping.Right, cropping.Bottom,
 		graphicsCard,
 		maxFrameRate.has_value() ? *maxFrameRate : 0.0f,
@@ -87,6 +94,9 @@ void ScalingOptions::Log() const noexcept {
 		(int)multiMonitorUsage,
 		(int)cursorInterpolationMode,
 		(int)duplicateFrameDetectionMode,
+		(int)framePacingMode,
+		StrUtils::UTF16ToUTF8(replayPath),
+		replayFrameRate,
 		LogEffects(effects)
 	));
 }
@@ -8,6 +8,8 @@ enum class CaptureMethod {
 	DesktopDuplication,
 	GDI,
 	DwmSharedSurface,
+	// 回放图像序列或测试画面，见 ReplayFrameSource
+	Replay,
 };
 
 enum class MultiMonitorUsage {
@@ -47,6 +49,10 @@ struct ScalingFlags {
 	// Magpie.Core 不负责启动 TouchHelper.exe，指定此标志会使 Magpie.Core 创建辅助窗口以拦截
 	// 黑边上的触控输入
 	static constexpr uint32_t IsTouchSupportEnabled = 1 << 17;
+	// 监视 effects 文件夹，源文件更改时重新编译受影响的效果并热替换着色器
+	static constexpr uint32_t EffectHotReload = 1 << 18;
+	// 检测画面四周的黑边，效果只处理有效区域，见 AutoCropper
+	static constexpr uint32_t AutoCropping = 1 << 19;
 };
 
 enum class ScalingType {
@@ -80,6 +86,13 @@ enum class DuplicateFrameDetectionMode {
 	Never
 };
 
+enum class FramePacingMode {
+	// 按固定间隔检查新帧
+	Off,
+	LowestLatency,
+	Smoothest
+};
+
 struct ScalingOptions {
 	DEFINE_FLAG_ACCESSOR(IsWindowResizingDisabled, ScalingFlags::DisableWindowResizing, flags)
 	DEFINE_FLAG_ACCESSOR(IsDebugMode, ScalingFlags::BreakpointMode, flags)
@@ -87,6 +100,7 @@ struct ScalingOptions {
 	DEFINE_FLAG_ACCESSOR(IsFontCacheDisabled, ScalingFlags::DisableFontCache, flags)
 	DEFINE_FLAG_ACCESSOR(IsSaveEffectSources, ScalingFlags::SaveEffectSources, flags)
 	DEFINE_FLAG_ACCESSOR(IsWarningsAreErrors, ScalingFlags::WarningsAreErrors, flags)
+	DEFINE_FLAG_ACCESSOR(IsEffectHotReloadEnabled, ScalingFlags::EffectHotReload, flags)
 	DEFINE_FLAG_ACCESSOR(IsAllowScalingMaximized, ScalingFlags::AllowScalingMaximized, flags)
 	DEFINE_FLAG_ACCESSOR(IsSimulateExclusiveFullscreen, ScalingFlags::SimulateExclusiveFullscreen, flags)
 	DEFINE_FLAG_ACCESSOR(Is3DGameMode, ScalingFlags::Is3DGameMode, flags)
@@ -97,6 +111,7 @@ struct ScalingOptions {
 	DEFINE_FLAG_ACCESSOR(IsDirectFlipDisabled, ScalingFlags::DisableDirectFlip, flags)
 	DEFINE_FLAG_ACCESSOR(IsStatisticsForDynamicDetectionEnabled, ScalingFlags::EnableStatisticsForDynamicDetection, flags)
 	DEFINE_FLAG_ACCESSOR(IsTouchSupportEnabled, ScalingFlags::IsTouchSupportEnabled, flags)
+	DEFINE_FLAG_ACCESSOR(IsAutoCroppingEnabled, ScalingFlags::AutoCropping, flags)
 
 	Cropping cropping{};
 	uint32_t flags = ScalingFlags::AdjustCursorSpeed | ScalingFlags::DrawCursor;	// ScalingFlags
@@ -110,6 +125,11 @@ struct ScalingOptions {
 	std::vector<EffectOption> effects;
 
 	DuplicateFrameDetectionMode duplicateFrameDetectionMode = DuplicateFrameDetectionMode::Dynamic;
+	FramePacingMode framePacingMode = FramePacingMode::Off;
+
+	// 以下只用于 CaptureMethod::Replay。replayPath 为空时生成测试画面，replayFrameRate 为 0 时不限帧率
+	std::wstring replayPath;
+	float replayFrameRate = 60.0f;
 
 	void Log() const noexcept;
 };
@@ -1,43 +1,78 @@
 #include "pch.h"
 #include "StepTimer.h"
+#include "Logger.h"
 
 using namespace std::chrono;
 
 namespace Magpie::Core {
 
-void StepTimer::Initialize(std::optional<float> maxFrameRate) noexcept {
+// MSVC 的 steady_clock 基于 QueryPerformanceCounter，这里使用相同的换算
+static int64_t QpcToNs(int64_t qpc) noexcept {
+	static const int64_t freq = []() {
+		LARGE_INTEGER value;
+		QueryPerformanceFrequency(&value);
+		return value.QuadPart;
+	}();
+	return qpc / freq * 1'000'000'000 + qpc % freq * 1'000'000'000 / freq;
+}
+
+void StepTimer::Initialize(std::optional<float> maxFrameRate, FramePacingMode pacingMode) noexcept {
 	if (maxFrameRate) {
 		_minInterval = duration_cast<nanoseconds>(duration<float>(1 / *maxFrameRate));
-		_hTimer.reset(CreateWaitableTimerEx(nullptr, nullptr,
-			CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	}
+
+	if (pacingMode != FramePacingMode::Off) {
+		_framePacer.emplace();
+		_framePacer->Initialize(pacingMode == FramePacingMode::Smoothest ?
+			FramePacer::Policy::Smoothest : FramePacer::Policy::LowestLatency);
+
+		_UpdateVBlank();
+		if (!_framePacer->HasVBlank()) {
+			Logger::Get().Error("无法获取垂直同步的时间，已禁用帧节奏");
+			_framePacer.reset();
+		}
 	}
 }
 
-bool StepTimer::WaitForNextFrame() noexcept {
-	if (!_minInterval) {
+bool StepTimer::IsNextFrameDue(time_point<steady_clock>& wakeTime) noexcept {
+	if (!_minInterval && !_framePacer) {
 		return true;
 	}
 
 	const time_point<steady_clock> now = steady_clock::now();
-	const nanoseconds delta = now - _lastFrameTime;
-	if (delta >= *_minInterval) {
-		_lastFrameTime = now - delta % *_minInterval;
-		return true;
+
+	nanoseconds rest{};
+	if (_minInterval) {
+		const nanoseconds delta = now - _lastFrameTime;
+		if (delta < *_minInterval) {
+			rest = *_minInterval - delta;
+		}
 	}
 
-	const nanoseconds rest = *_minInterval - delta;
-	if (rest > 1ms) {
-		// Sleep 精度太低，我们使用 WaitableTimer 睡眠。负值表示相对时间
-		LARGE_INTEGER liDueTime{
-			.QuadPart = (rest - 1ms).count() / -100
-		};
-		SetWaitableTimerEx(_hTimer.get(), &liDueTime, 0, NULL, NULL, 0, 0);
-		_hTimer.wait();
-	} else {
-		// 剩余时间在 1ms 以内则“忙等待”
-		Sleep(0);
+	if (_framePacer) {
+		if (!_pacedWakeTime) {
+			// 定期更新以跟踪垂直同步的漂移
+			if (now - _lastVBlankQueryTime >= 1s) {
+				_UpdateVBlank();
+			}
+
+			const int64_t nowNs = duration_cast<nanoseconds>(now.time_since_epoch()).count();
+			_pacedWakeTime = now + nanoseconds(_framePacer->NextWakeTime(nowNs) - nowNs);
+		}
+
+		rest = std::max(rest, duration_cast<nanoseconds>(*_pacedWakeTime - now));
 	}
 
+	if (rest <= 0ns) {
+		if (_minInterval) {
+			const nanoseconds delta = now - _lastFrameTime;
+			_lastFrameTime = now - delta % *_minInterval;
+		}
+		_pacedWakeTime.reset();
+		return true;
+	}
+
+	wakeTime = now + rest;
 	return false;
 }
 
@@ -67,8 +102,41 @@ void StepTimer::UpdateFPS(bool newFrame) noexcept {
 
 		_framesPerSecond.store(_framesThisSecond, std::memory_order_relaxed);
 		_framesThisSecond = 0;
+
+		if (_framePacer) {
+			const FramePacer::Statistics statistics = _framePacer->GetStatistics();
+			_latency.store(std::make_pair(statistics.latencyP50 / 1e6f, statistics.latencyP99 / 1e6f),
+				std::memory_order_relaxed);
+		}
 	}
 	
 }
 
+void StepTimer::OnFrameRendered(
+	time_point<steady_clock> frameTime,
+	time_point<steady_clock> renderEnd
+) noexcept {
+	if (!_framePacer) {
+		return;
+	}
+
+	// 尚不知道帧源捕获这一帧的准确时间，以后端取得这一帧的时间代替
+	const int64_t frameTimeNs = duration_cast<nanoseconds>(frameTime.time_since_epoch()).count();
+	_framePacer->OnFrameRendered(frameTimeNs, frameTimeNs,
+		duration_cast<nanoseconds>(renderEnd.time_since_epoch()).count());
+}
+
+void StepTimer::_UpdateVBlank() noexcept {
+	_lastVBlankQueryTime = steady_clock::now();
+
+	DWM_TIMING_INFO info{ .cbSize = sizeof(DWM_TIMING_INFO) };
+	HRESULT hr = DwmGetCompositionTimingInfo(NULL, &info);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("DwmGetCompositionTimingInfo 失败", hr);
+		return;
+	}
+
+	_framePacer->OnVBlank(QpcToNs((int64_t)info.qpcVBlank), QpcToNs((int64_t)info.qpcRefreshPeriod));
+}
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "Win32Utils.h"
+#include "FramePacer.h"
+#include "ScalingOptions.h"
 
 namespace Magpie::Core {
 
@@ -10,12 +12,23 @@ public:
 	StepTimer(const StepTimer&) = delete;
 	StepTimer(StepTimer&&) = delete;
 
-	void Initialize(std::optional<float> maxFrameRate) noexcept;
+	void Initialize(std::optional<float> maxFrameRate, FramePacingMode pacingMode) noexcept;
 
-	bool WaitForNextFrame() noexcept;
+	// 不会阻塞。返回 false 时 wakeTime 为应再次检查的时间，由调用者等待
+	bool IsNextFrameDue(std::chrono::steady_clock::time_point& wakeTime) noexcept;
 
 	void UpdateFPS(bool newFrame) noexcept;
 
+	// 后端完成一帧。frameTime 为后端取得这一帧的时间，renderEnd 为新帧交给前端的时间
+	void OnFrameRendered(
+		std::chrono::steady_clock::time_point frameTime,
+		std::chrono::steady_clock::time_point renderEnd
+	) noexcept;
+
+	bool IsPacingEnabled() const noexcept {
+		return _framePacer.has_value();
+	}
+
 	uint32_t FrameCount() const noexcept {
 		return _frameCount;
 	}
@@ -25,9 +38,21 @@ public:
 		return _framesPerSecond.load(std::memory_order_relaxed);
 	}
 
+	// 从前端线程调用，最近一段时间从捕获到显示的延迟的中位数和 99% 分位数，单位为毫秒
+	std::pair<float, float> Latency() const noexcept {
+		return _latency.load(std::memory_order_relaxed);
+	}
+
 private:
+	void _UpdateVBlank() noexcept;
+
 	std::optional<std::chrono::nanoseconds> _minInterval;
-	wil::unique_event_nothrow _hTimer;
+
+	// 未启用帧节奏时为空
+	std::optional<FramePacer> _framePacer;
+	// 每帧只计算一次，否则被定时器推迟唤醒后可能改为下一个垂直同步
+	std::optional<std::chrono::time_point<std::chrono::steady_clock>> _pacedWakeTime;
+	std::chrono::time_point<std::chrono::steady_clock> _lastVBlankQueryTime;
 
 	std::chrono::time_point<std::chrono::steady_clock> _lastFrameTime;
 	std::chrono::time_point<std::chrono::steady_clock> _lastSecondTime;
@@ -35,6 +60,8 @@ private:
 	uint32_t _frameCount = 0;
 	std::atomic<uint32_t> _framesPerSecond = 0;
 	uint32_t _framesThisSecond = 0;
+
+	std::atomic<std::pair<float, float>> _latency;
 };
 
 }
@@ -0,0 +1,265 @@
+// 不使用预编译头，以便在其他平台构建
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Magpie::Core {
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t ElapsedNs(Clock::time_point start, Clock::time_point end) noexcept {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void AtomicMax(std::atomic<uint64_t>& target, uint64_t value) noexcept {
+	uint64_t cur = target.load(std::memory_order_relaxed);
+	while (cur < value && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+struct TaskScheduler::_Task {
+	std::function<void(Context&)> func;
+	std::function<void()> onComplete;
+	_Task* parent = nullptr;
+	// 自身和尚未完成的子任务数
+	std::atomic<uint32_t> pending = 1;
+	// 本任务的执行时间
+	uint64_t funcNs = 0;
+	// 子任务中最长的关键路径
+	std::atomic<uint64_t> childCriticalPathNs = 0;
+};
+
+struct TaskScheduler::_Worker {
+	// 任务很粗（编译一个通道需要几毫秒到几百毫秒），使用互斥锁保护的队列足够
+	std::mutex mutex;
+	std::deque<_Task*> tasks;
+};
+
+TaskScheduler::TaskScheduler() noexcept {
+	// Run 之前提交的任务放在第一个队列中
+	_workers.emplace_back(std::make_unique<_Worker>());
+}
+
+TaskScheduler::TaskScheduler(uint32_t threadCount) noexcept : _isShared(true) {
+	_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		_workers.emplace_back(std::make_unique<_Worker>());
+	}
+
+	// 所有队列创建后才能启动线程，否则窃取时可能访问正在修改的 _workers
+	_threads.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		_threads.emplace_back(&TaskScheduler::_WorkerProc, this, i);
+	}
+}
+
+TaskScheduler::~TaskScheduler() noexcept {
+	if (_isShared) {
+		_stopping.store(true, std::memory_order_release);
+		_signal.fetch_add(1, std::memory_order_release);
+		_signal.notify_all();
+
+		for (std::thread& t : _threads) {
+			t.join();
+		}
+	}
+
+	assert(_remaining.load(std::memory_order_relaxed) == 0);
+}
+
+TaskScheduler& TaskScheduler::Shared() noexcept {
+	static TaskScheduler instance(std::max(1u, std::thread::hardware_concurrency()));
+	return instance;
+}
+
+void TaskScheduler::RunAndWait(std::function<void(Context&)> func, std::function<void()> onComplete) noexcept {
+	assert(_isShared);
+
+	// 由任务持有共享的状态，调用者返回后完成回调仍可能在访问它
+	std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+	Submit(std::move(func), [done, onComplete(std::move(onComplete))]() {
+		if (onComplete) {
+			onComplete();
+		}
+
+		done->store(true, std::memory_order_release);
+		done->notify_one();
+	});
+
+	done->wait(false, std::memory_order_acquire);
+}
+
+void TaskScheduler::Context::Spawn(std::function<void(Context&)> func, std::function<void()> onComplete) noexcept {
+	_scheduler._Push(_workerIdx, _scheduler._CreateTask(_task, std::move(func), std::move(onComplete)));
+}
+
+void TaskScheduler::Submit(std::function<void(Context&)> func, std::function<void()> onComplete) noexcept {
+	_Push(0, _CreateTask(nullptr, std::move(func), std::move(onComplete)));
+}
+
+TaskScheduler::_Task* TaskScheduler::_CreateTask(
+	_Task* parent,
+	std::function<void(Context&)>&& func,
+	std::function<void()>&& onComplete
+) noexcept {
+	_Task* task = new _Task{
+		.func = std::move(func),
+		.onComplete = std::move(onComplete),
+		.parent = parent
+	};
+
+	if (parent) {
+		// 父任务正在执行，pending 至少为 1，不会在此期间完成
+		parent->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	_remaining.fetch_add(1, std::memory_order_relaxed);
+	_taskCount.fetch_add(1, std::memory_order_relaxed);
+	return task;
+}
+
+void TaskScheduler::_Push(uint32_t workerIdx, _Task* task) noexcept {
+	{
+		_Worker& worker = *_workers[workerIdx];
+		std::scoped_lock lock(worker.mutex);
+		worker.tasks.push_back(task);
+	}
+
+	_signal.fetch_add(1, std::memory_order_release);
+	_signal.notify_one();
+}
+
+TaskScheduler::_Task* TaskScheduler::_Pop(uint32_t workerIdx) noexcept {
+	// 优先从自己的队列尾部取出，最近提交的任务的数据更可能还在缓存中
+	{
+		_Worker& worker = *_workers[workerIdx];
+		std::scoped_lock lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			_Task* task = worker.tasks.back();
+			worker.tasks.pop_back();
+			return task;
+		}
+	}
+
+	// 从其他线程的队列头部窃取，头部的任务更早提交，通常会产生更多子任务
+	const uint32_t workerCount = (uint32_t)_workers.size();
+	for (uint32_t i = 1; i < workerCount; ++i) {
+		_Worker& victim = *_workers[(workerIdx + i) % workerCount];
+		std::scoped_lock lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			_Task* task = victim.tasks.front();
+			victim.tasks.pop_front();
+			_stealCount.fetch_add(1, std::memory_order_relaxed);
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+void TaskScheduler::Run(uint32_t threadCount) noexcept {
+	assert(!_isShared);
+
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	while (_workers.size() < threadCount) {
+		_workers.emplace_back(std::make_unique<_Worker>());
+	}
+
+	const Clock::time_point start = Clock::now();
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		threads.emplace_back(&TaskScheduler::_WorkerProc, this, i);
+	}
+
+	_WorkerProc(0);
+
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	_stats = {
+		.taskCount = _taskCount.load(std::memory_order_relaxed),
+		.stealCount = _stealCount.load(std::memory_order_relaxed),
+		.threadCount = threadCount,
+		.wallMs = ElapsedNs(start, Clock::now()) / 1e6,
+		.workMs = _workNs.load(std::memory_order_relaxed) / 1e6,
+		.criticalPathMs = _criticalPathNs.load(std::memory_order_relaxed) / 1e6
+	};
+}
+
+void TaskScheduler::_WorkerProc(uint32_t workerIdx) noexcept {
+	while (true) {
+		// 必须在查找任务前读取，否则可能错过查找之后提交的任务的通知
+		const uint32_t signal = _signal.load(std::memory_order_acquire);
+
+		if (_Task* task = _Pop(workerIdx)) {
+			_Execute(task, workerIdx);
+			continue;
+		}
+
+		// 常驻的线程直到析构时才退出
+		if (_isShared ? _stopping.load(std::memory_order_acquire)
+			: _remaining.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+
+		_signal.wait(signal, std::memory_order_acquire);
+	}
+}
+
+void TaskScheduler::_Execute(_Task* task, uint32_t workerIdx) noexcept {
+	const Clock::time_point start = Clock::now();
+	{
+		Context context(*this, task, workerIdx);
+		task->func(context);
+	}
+	task->funcNs = ElapsedNs(start, Clock::now());
+	_workNs.fetch_add(task->funcNs, std::memory_order_relaxed);
+
+	// 释放捕获的资源
+	task->func = nullptr;
+
+	_Finish(task);
+}
+
+void TaskScheduler::_Finish(_Task* task) noexcept {
+	while (task && task->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		// 任务和所有子任务都已完成
+		uint64_t completeNs = 0;
+		if (task->onComplete) {
+			const Clock::time_point start = Clock::now();
+			task->onComplete();
+			completeNs = ElapsedNs(start, Clock::now());
+			_workNs.fetch_add(completeNs, std::memory_order_relaxed);
+		}
+
+		const uint64_t criticalPathNs = task->funcNs
+			+ task->childCriticalPathNs.load(std::memory_order_relaxed) + completeNs;
+
+		_Task* parent = task->parent;
+		if (parent) {
+			AtomicMax(parent->childCriticalPathNs, criticalPathNs);
+		} else {
+			AtomicMax(_criticalPathNs, criticalPathNs);
+		}
+
+		delete task;
+		task = parent;
+
+		if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			// 唤醒所有空闲的线程以便退出
+			_signal.fetch_add(1, std::memory_order_release);
+			_signal.notify_all();
+		}
+	}
+}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 可窃取任务的调度器，任务和它的所有子任务完成后才执行它的 onComplete
+class TaskScheduler {
+	struct _Task;
+	struct _Worker;
+
+public:
+	class Context {
+	public:
+		// 提交当前任务的子任务
+		void Spawn(std::function<void(Context&)> func, std::function<void()> onComplete = {}) noexcept;
+
+		uint32_t WorkerIndex() const noexcept {
+			return _workerIdx;
+		}
+
+	private:
+		friend class TaskScheduler;
+
+		Context(TaskScheduler& scheduler, _Task* task, uint32_t workerIdx) noexcept
+			: _scheduler(scheduler), _task(task), _workerIdx(workerIdx) {}
+
+		TaskScheduler& _scheduler;
+		_Task* _task;
+		uint32_t _workerIdx;
+	};
+
+	struct Stats {
+		uint32_t taskCount = 0;
+		uint32_t stealCount = 0;
+		uint32_t threadCount = 0;
+		// 从 Run 开始到所有任务完成
+		double wallMs = 0;
+		// 所有任务执行时间之和
+		double workMs = 0;
+		// 最长的依赖链，即使线程无限多也无法短于它
+		double criticalPathMs = 0;
+	};
+
+	TaskScheduler() noexcept;
+	~TaskScheduler() noexcept;
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler(TaskScheduler&&) = delete;
+
+	// 提交根任务，只能在 Run 之前调用
+	void Submit(std::function<void(Context&)> func, std::function<void()> onComplete = {}) noexcept;
+
+	// 执行所有任务直到完成，调用线程也参与执行。threadCount 为 0 表示使用所有核心。
+	// 不能用于 Shared 返回的调度器
+	void Run(uint32_t threadCount = 0) noexcept;
+
+	// 进程内共享的调度器，第一次调用时创建和核心数相同的工作线程，之后一直使用它们。
+	// 只能通过 RunAndWait 使用，GetStats 无意义
+	static TaskScheduler& Shared() noexcept;
+
+	// 把任务提交到常驻的工作线程并阻塞到它和所有子任务完成，调用线程不参与执行。
+	// 可以在多个线程同时调用
+	void RunAndWait(std::function<void(Context&)> func, std::function<void()> onComplete = {}) noexcept;
+
+	const Stats& GetStats() const noexcept {
+		return _stats;
+	}
+
+private:
+	explicit TaskScheduler(uint32_t threadCount) noexcept;
+
+	_Task* _CreateTask(_Task* parent, std::function<void(Context&)>&& func, std::function<void()>&& onComplete) noexcept;
+
+	void _Push(uint32_t workerIdx, _Task* task) noexcept;
+
+	_Task* _Pop(uint32_t workerIdx) noexcept;
+
+	void _WorkerProc(uint32_t workerIdx) noexcept;
+
+	void _Execute(_Task* task, uint32_t workerIdx) noexcept;
+
+	void _Finish(_Task* task) noexcept;
+
+	std::vector<std::unique_ptr<_Worker>> _workers;
+	// 尚未完成的任务数，包括正在等待子任务的任务
+	std::atomic<uint32_t> _remaining = 0;
+	// 提交任务或所有任务完成时递增，用于唤醒空闲的线程
+	std::atomic<uint32_t> _signal = 0;
+
+	// 以下仅用于 Shared 返回的调度器
+	std::vector<std::thread> _threads;
+	std::atomic<bool> _stopping = false;
+	// 工作线程启动前设置，线程不能读取正在填充的 _threads
+	bool _isShared = false;
+
+	std::atomic<uint32_t> _taskCount = 0;
+	std::atomic<uint32_t> _stealCount = 0;
+	std::atomic<uint64_t> _workNs = 0;
+	std::atomic<uint64_t> _criticalPathNs = 0;
+
+	Stats _stats;
+};
+
+}
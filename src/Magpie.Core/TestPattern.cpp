@@ -0,0 +1,111 @@
+// 不使用预编译头，以便在其他平台构建
+#include "TestPattern.h"
+#include <algorithm>
+#include <cassert>
+
+namespace Magpie::Core {
+
+// 棋盘格每格的边长
+static constexpr uint32_t CHECKER_SIZE = 32;
+
+void TestPattern::Initialize(uint32_t width, uint32_t height) noexcept {
+	assert(width > 0 && height > 0);
+
+	_width = width;
+	_height = height;
+	_barWidth = std::max(width / 16, 1u);
+}
+
+void TestPattern::Render(uint64_t frameIndex, const Rect& rect, uint8_t* dst, uint32_t pitch) const noexcept {
+	assert(rect.right <= _width && rect.bottom <= _height);
+
+	const Rect indexRect = _IndexRect();
+	const uint32_t barLeft = _BarLeft(frameIndex);
+	const uint32_t barRight = barLeft + _barWidth;
+	// 避免尺寸为 1 时除以 0
+	const uint32_t xMax = std::max(_width - 1, 1u);
+	const uint32_t yMax = std::max(_height - 1, 1u);
+
+	for (uint32_t y = rect.top; y < rect.bottom; ++y) {
+		uint8_t* pixel = dst + size_t(y - rect.top) * pitch;
+
+		for (uint32_t x = rect.left; x < rect.right; ++x, pixel += 4) {
+			if (x < indexRect.right && y < indexRect.bottom) {
+				const uint8_t value = (frameIndex >> (x / INDEX_BLOCK_SIZE)) & 1 ? 255 : 0;
+				pixel[0] = value;
+				pixel[1] = value;
+				pixel[2] = value;
+			} else if (x >= barLeft && x < barRight) {
+				pixel[0] = 40;
+				pixel[1] = 220;
+				pixel[2] = 255;
+			} else {
+				const bool isOdd = ((x / CHECKER_SIZE) ^ (y / CHECKER_SIZE)) & 1;
+				pixel[0] = isOdd ? 192 : 64;
+				pixel[1] = uint8_t(y * 255 / yMax);
+				pixel[2] = uint8_t(x * 255 / xMax);
+			}
+
+			pixel[3] = 255;
+		}
+	}
+}
+
+void TestPattern::ChangedRects(uint64_t frameIndex, std::vector<Rect>& rects) const noexcept {
+	assert(frameIndex > 0);
+
+	rects.clear();
+
+	// 帧序号每帧都变化
+	rects.push_back(_IndexRect());
+
+	const uint32_t prevLeft = _BarLeft(frameIndex - 1);
+	const uint32_t curLeft = _BarLeft(frameIndex);
+	if (prevLeft == curLeft) {
+		// 帧太窄，竖条无法移动
+		return;
+	}
+
+	if (std::max(prevLeft, curLeft) - std::min(prevLeft, curLeft) < _barWidth) {
+		// 前后两帧的竖条重叠，合并为一个区域
+		rects.push_back({ std::min(prevLeft, curLeft), 0, std::max(prevLeft, curLeft) + _barWidth, _height });
+	} else {
+		rects.push_back({ prevLeft, 0, prevLeft + _barWidth, _height });
+		rects.push_back({ curLeft, 0, curLeft + _barWidth, _height });
+	}
+}
+
+uint32_t TestPattern::DecodeIndex(const uint8_t* pixels, uint32_t pitch) const noexcept {
+	if (_width < INDEX_BITS * INDEX_BLOCK_SIZE || _height < INDEX_BLOCK_SIZE) {
+		return 0;
+	}
+
+	// 取每个方块的中心
+	const uint8_t* row = pixels + size_t(INDEX_BLOCK_SIZE / 2) * pitch;
+
+	uint32_t result = 0;
+	for (uint32_t i = 0; i < INDEX_BITS; ++i) {
+		const uint8_t* pixel = row + size_t(i * INDEX_BLOCK_SIZE + INDEX_BLOCK_SIZE / 2) * 4;
+		if (pixel[1] >= 128) {
+			result |= 1u << i;
+		}
+	}
+	return result;
+}
+
+uint32_t TestPattern::_BarLeft(uint64_t frameIndex) const noexcept {
+	// 从左到右移动，到达右边后回到最左边
+	const uint32_t travel = _width - _barWidth + 1;
+	return uint32_t(frameIndex * BAR_STEP % travel);
+}
+
+TestPattern::Rect TestPattern::_IndexRect() const noexcept {
+	return {
+		0,
+		0,
+		std::min(_width, INDEX_BITS * INDEX_BLOCK_SIZE),
+		std::min(_height, INDEX_BLOCK_SIZE)
+	};
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Magpie::Core {
+
+// ReplayFrameSource 使用的测试画面，相邻两帧只有竖条和帧序号的区域不同。像素格式为 BGRA8
+class TestPattern {
+public:
+	static constexpr uint32_t BAR_STEP = 8;
+	// 帧序号的每一位是一个这样大小的方块
+	static constexpr uint32_t INDEX_BLOCK_SIZE = 8;
+	static constexpr uint32_t INDEX_BITS = 16;
+
+	// 单位为像素，right 和 bottom 不包含在内
+	struct Rect {
+		uint32_t left = 0;
+		uint32_t top = 0;
+		uint32_t right = 0;
+		uint32_t bottom = 0;
+
+		bool operator==(const Rect&) const noexcept = default;
+	};
+
+	void Initialize(uint32_t width, uint32_t height) noexcept;
+
+	// 渲染第 frameIndex 帧中的 rect 区域，dst 指向 rect 的左上角，pitch 单位为字节
+	void Render(uint64_t frameIndex, const Rect& rect, uint8_t* dst, uint32_t pitch) const noexcept;
+
+	// 第 frameIndex 帧和上一帧不同的区域，frameIndex 不能为 0。区域可能重叠
+	void ChangedRects(uint64_t frameIndex, std::vector<Rect>& rects) const noexcept;
+
+	// 从渲染结果的左上角解码帧序号的低 INDEX_BITS 位，帧太小无法容纳编码时返回 0
+	uint32_t DecodeIndex(const uint8_t* pixels, uint32_t pitch) const noexcept;
+
+private:
+	uint32_t _BarLeft(uint64_t frameIndex) const noexcept;
+
+	Rect _IndexRect() const noexcept;
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	uint32_t _barWidth = 0;
+};
+
+}
@@ -0,0 +1,100 @@
+// 不使用预编译头，以便在其他平台构建
+#include "TextureAliasPlanner.h"
+#include <algorithm>
+#include <numeric>
+
+namespace Magpie::Core {
+
+TextureAliasPlanner::Result TextureAliasPlanner::Plan(
+	std::span<const Texture> textures,
+	std::span<const Pass> passes
+) noexcept {
+	const uint32_t textureCount = (uint32_t)textures.size();
+	const uint32_t passCount = (uint32_t)passes.size();
+
+	Result result;
+	result.allocations.assign(textureCount, NO_ALLOCATION);
+	result.lifetimes.resize(textureCount);
+
+	// 同一通道中先处理输入，同时读写的纹理视为先读取
+	const auto touch = [&](uint32_t textureIdx, uint32_t passIdx, bool isRead) {
+		Lifetime& lifetime = result.lifetimes[textureIdx];
+		if (lifetime.firstPass == NO_ALLOCATION) {
+			lifetime.firstPass = passIdx;
+			lifetime.isReadFirst = isRead;
+		}
+		lifetime.lastPass = passIdx;
+	};
+	for (uint32_t i = 0; i < passCount; ++i) {
+		for (uint32_t idx : passes[i].inputs) {
+			touch(idx, i, true);
+		}
+		for (uint32_t idx : passes[i].outputs) {
+			touch(idx, i, false);
+		}
+	}
+
+	struct Allocation {
+		uint32_t textureIdx;
+		// 在此通道之后空闲，持久的物理纹理永远不会空闲
+		uint32_t busyUntil;
+	};
+	std::vector<Allocation> allocations;
+
+	// 按第一次使用的顺序分配，对每组尺寸和格式相同的纹理，这样得到的物理纹理数等于同时存活的纹理数的最大值
+	std::vector<uint32_t> order(textureCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) {
+		return result.lifetimes[l].firstPass < result.lifetimes[r].firstPass;
+	});
+
+	for (uint32_t idx : order) {
+		const Texture& texture = textures[idx];
+		Lifetime& lifetime = result.lifetimes[idx];
+		if (texture.isExternal || lifetime.firstPass == NO_ALLOCATION) {
+			continue;
+		}
+
+		result.unaliasedBytes += texture.byteSize;
+
+		const bool isPersistent = texture.isPersistent || lifetime.isReadFirst;
+		if (isPersistent) {
+			// 内容需要跨帧保留
+			lifetime.firstPass = 0;
+			lifetime.lastPass = passCount - 1;
+		}
+		const uint32_t busyUntil = isPersistent ? NO_ALLOCATION : lifetime.lastPass;
+
+		uint32_t allocationIdx = NO_ALLOCATION;
+		if (!isPersistent) {
+			// 选择最近空闲的，它的内容更可能还在缓存中
+			for (uint32_t i = 0; i < (uint32_t)allocations.size(); ++i) {
+				const Allocation& allocation = allocations[i];
+				const Texture& other = textures[allocation.textureIdx];
+				if (allocation.busyUntil >= lifetime.firstPass || other.width != texture.width
+					|| other.height != texture.height || other.format != texture.format) {
+					continue;
+				}
+
+				if (allocationIdx == NO_ALLOCATION || allocation.busyUntil > allocations[allocationIdx].busyUntil) {
+					allocationIdx = i;
+				}
+			}
+		}
+
+		if (allocationIdx == NO_ALLOCATION) {
+			allocationIdx = (uint32_t)allocations.size();
+			allocations.push_back({ idx, busyUntil });
+			result.allocationTextures.push_back(idx);
+			result.aliasedBytes += texture.byteSize;
+		} else {
+			allocations[allocationIdx].busyUntil = busyUntil;
+		}
+
+		result.allocations[idx] = allocationIdx;
+	}
+
+	return result;
+}
+
+}
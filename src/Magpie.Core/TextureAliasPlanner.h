@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+// 尺寸和格式相同且生命周期不重叠的中间纹理共享物理纹理。第一次使用是读取的纹理需要保留上一帧的内容，
+// 不和其他纹理共享
+struct TextureAliasPlanner {
+	static constexpr uint32_t NO_ALLOCATION = UINT32_MAX;
+
+	struct Texture {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// 只有格式相同的纹理才能共享，规划器不关心它的含义
+		uint32_t format = 0;
+		// 仅用于统计
+		uint64_t byteSize = 0;
+		// 不由规划器分配，如帧源的输出和从文件加载的纹理
+		bool isExternal = false;
+		// 在所有通道之后仍需要保留内容，如效果链的输出
+		bool isPersistent = false;
+	};
+
+	struct Pass {
+		SmallVector<uint32_t> inputs;
+		SmallVector<uint32_t> outputs;
+	};
+
+	struct Lifetime {
+		uint32_t firstPass = NO_ALLOCATION;
+		uint32_t lastPass = 0;
+		// 第一次使用是读取
+		bool isReadFirst = false;
+	};
+
+	struct Result {
+		// 每个纹理对应的物理纹理，外部纹理和未被使用的纹理为 NO_ALLOCATION
+		std::vector<uint32_t> allocations;
+		// 每个物理纹理的第一个纹理，物理纹理使用它的尺寸和格式
+		std::vector<uint32_t> allocationTextures;
+		std::vector<Lifetime> lifetimes;
+		// 不共享时需要的字节数和实际需要的字节数，不包括外部纹理
+		uint64_t unaliasedBytes = 0;
+		uint64_t aliasedBytes = 0;
+	};
+
+	static Result Plan(std::span<const Texture> textures, std::span<const Pass> passes) noexcept;
+};
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include "../ScalingOptions.h"
 #include "../ScalingRuntime.h"
+#include "../OfflineRenderer.h"
 #include "../LoggerHelper.h"
 #include "../EffectCompiler.h"
 #include "../EffectDesc.h"
+#include "../EffectMetadataIndex.h"
 #include "../WindowHelper.h"
@@ -1,35 +1,42 @@
-// 无需同步
+// result[0] 表示是否有变化，之后按行优先每个 16x16 的块占一位，见 ChangeMask
 RWBuffer<uint> result : register(u0);
 
+// tex1 为当前帧，输出为其中从 offset 开始的区域；tex2 为上一帧，尺寸和输出相同
 Texture2D tex1 : register(t0);
 Texture2D tex2 : register(t1);
 
+cbuffer __CB1 : register(b0) {
+	uint2 offset;
+};
+
 SamplerState sam : register(s0);
 
 [numthreads(8, 8, 1)]
 void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {
-	if (result[0]) {
-		return;
-	}
-	
-	const int2 gxy = (gid.xy << 4) + (tid.xy << 1);
-	
 	// 不知为何这比通过 cbuffer 传入更快
 	uint width, height;
-	tex1.GetDimensions(width, height);
-	const float2 pos = (gxy + 1) / float2(width, height);
-	
-	if (any(tex1.GatherRed(sam, pos) != tex2.GatherRed(sam, pos))) {
-		result[0] = 1u;
-		return;
-	}
-	
-	if (any(tex1.GatherGreen(sam, pos) != tex2.GatherGreen(sam, pos))) {
-		result[0] = 1u;
+	tex2.GetDimensions(width, height);
+	uint textureWidth, textureHeight;
+	tex1.GetDimensions(textureWidth, textureHeight);
+
+	const uint tileIdx = gid.y * ((width + 15) >> 4) + gid.x;
+	const uint wordIdx = 1 + (tileIdx >> 5);
+	const uint bit = 1u << (tileIdx & 31);
+
+	// 无需同步，其他线程已发现变化时可以提前退出
+	if (result[wordIdx] & bit) {
 		return;
 	}
-	
-	if (any(tex1.GatherBlue(sam, pos) != tex2.GatherBlue(sam, pos))) {
+
+	// 尺寸为奇数时最后一列（行）和前一列（行）一起读取，使 tex1 不会读取输出以外的像素
+	const uint2 center = min((gid.xy << 4) + (tid.xy << 1) + 1, uint2(width, height) - 1);
+	const float2 pos1 = (center + offset) / float2(textureWidth, textureHeight);
+	const float2 pos2 = center / float2(width, height);
+
+	if (any(tex1.GatherRed(sam, pos1) != tex2.GatherRed(sam, pos2))
+		|| any(tex1.GatherGreen(sam, pos1) != tex2.GatherGreen(sam, pos2))
+		|| any(tex1.GatherBlue(sam, pos1) != tex2.GatherBlue(sam, pos2))) {
+		InterlockedOr(result[wordIdx], bit);
 		result[0] = 1u;
 	}
 }
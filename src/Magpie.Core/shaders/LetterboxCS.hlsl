@@ -0,0 +1,56 @@
+// 把输入按 8x8 的单元归约，见 LetterboxDetector。result 的前 rowCount 个元素为每行单元的最大值，
+// 之后为每列单元的最大值，值为像素 max(r,g,b) 量化到 0~255。调用前需置零
+RWBuffer<uint> result : register(u0);
+
+// 输入为 tex 中从 offset 开始尺寸为 size 的区域
+Texture2D tex : register(t0);
+
+cbuffer __CB1 : register(b0) {
+	uint2 offset;
+	uint2 size;
+	uint rowCount;
+};
+
+// 每个线程组处理 16x16 个像素，即 2x2 个单元
+groupshared uint rowMax[2];
+groupshared uint colMax[2];
+
+[numthreads(8, 8, 1)]
+void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID, uint gi : SV_GroupIndex) {
+	if (gi < 2) {
+		rowMax[gi] = 0;
+		colMax[gi] = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// 每个线程读取 2x2 个像素，它们总在同一个单元中。不使用 Gather，因为尺寸为奇数时
+	// 它会读取相邻单元的像素
+	const uint2 pos = (gid.xy << 4) + (tid.xy << 1);
+	if (all(pos < size)) {
+		float value = 0;
+		[unroll]
+		for (uint i = 0; i < 4; ++i) {
+			const uint2 p = pos + uint2(i & 1, i >> 1);
+			if (all(p < size)) {
+				const float3 color = tex.Load(uint3(p + offset, 0)).rgb;
+				value = max(value, max(max(color.r, color.g), color.b));
+			}
+		}
+
+		const uint quantized = (uint)round(saturate(value) * 255);
+		InterlockedMax(rowMax[tid.y >> 2], quantized);
+		InterlockedMax(colMax[tid.x >> 2], quantized);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (gi < 2) {
+		// 最后一行（列）单元可能只有一个在输入内
+		const uint2 cell = (gid.xy << 1) + gi;
+		if ((cell.y << 3) < size.y) {
+			InterlockedMax(result[cell.y], rowMax[gi]);
+		}
+		if ((cell.x << 3) < size.x) {
+			InterlockedMax(result[rowCount + cell.x], colMax[gi]);
+		}
+	}
+}
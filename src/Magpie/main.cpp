@@ -54,24 +54,35 @@ int APIENTRY wWinMain(
 	// 堆损坏时终止进程
 	HeapSetInformation(NULL, HeapEnableTerminationOnCorruption, nullptr, 0);
 
-	SetWorkingDir();
-
 	enum {
 		Normal,
 		RegisterTouchHelper,
-		UnRegisterTouchHelper
+		UnRegisterTouchHelper,
+		OfflineRender
 	} mode = [&]() {
-		if (lpCmdLine == L"-r"sv) {
+		const std::wstring_view cmdLine(lpCmdLine);
+		if (cmdLine == L"-r"sv) {
 			return RegisterTouchHelper;
-		} else if (lpCmdLine == L"-ur"sv) {
+		} else if (cmdLine == L"-ur"sv) {
 			return UnRegisterTouchHelper;
+		} else if (cmdLine.starts_with(CommonSharedConstants::OPTION_OFFLINE_RENDER)) {
+			return OfflineRender;
 		} else {
 			return Normal;
 		}
 	}();
 
-	InitializeLogger(mode == Normal ?
-		CommonSharedConstants::LOG_PATH :
+	// 离线渲染时命令行中的相对路径基于启动时的当前目录
+	std::wstring callerDir;
+	if (mode == OfflineRender) {
+		callerDir.resize(GetCurrentDirectory(0, nullptr));
+		callerDir.resize(GetCurrentDirectory((DWORD)callerDir.size(), callerDir.data()));
+	}
+
+	SetWorkingDir();
+
+	InitializeLogger(mode == Normal ? CommonSharedConstants::LOG_PATH :
+		mode == OfflineRender ? CommonSharedConstants::OFFLINE_RENDER_LOG_PATH :
 		CommonSharedConstants::REGISTER_TOUCH_HELPER_LOG_PATH);
 
 	Logger::Get().Info(fmt::format("程序启动\n\t版本: {}\n\t管理员: {}",
@@ -88,6 +99,11 @@ int APIENTRY wWinMain(
 		return Magpie::TouchHelper::Register() ? 0 : 1;
 	} else if (mode == UnRegisterTouchHelper) {
 		return Magpie::TouchHelper::Unregister() ? 0 : 1;
+	} else if (mode == OfflineRender) {
+		// 不检查单实例，可以和正在运行的 Magpie 同时使用
+		winrt::init_apartment(winrt::apartment_type::single_threaded);
+		winrt::Magpie::App::LoggerHelper::Initialize((uint64_t)&Logger::Get());
+		return winrt::Magpie::App::OfflineRenderHelper::Run(lpCmdLine, callerDir);
 	}
 
 	auto& app = Magpie::XamlApp::Get();
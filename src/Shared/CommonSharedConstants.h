@@ -24,6 +24,7 @@ struct CommonSharedConstants {
 
 	static constexpr const char* LOG_PATH = "logs\\magpie.log";
 	static constexpr const char* REGISTER_TOUCH_HELPER_LOG_PATH = "logs\\register_touch_helper.log";
+	static constexpr const char* OFFLINE_RENDER_LOG_PATH = "logs\\offline_render.log";
 	static constexpr const wchar_t* CONFIG_DIR = L"config\\";
 	static constexpr const wchar_t* CONFIG_FILENAME = L"config.json";
 	static constexpr const wchar_t* SOURCES_DIR = L"sources\\";
@@ -33,6 +34,8 @@ struct CommonSharedConstants {
 	static constexpr const wchar_t* UPDATE_DIR = L"update\\";
 
 	static constexpr const wchar_t* OPTION_LAUNCH_WITHOUT_WINDOW = L"-t";
+	// 不显示界面，对图像执行缩放模式中的效果，见 OfflineRenderer
+	static constexpr const wchar_t* OPTION_OFFLINE_RENDER = L"-render";
 
 #ifndef IDI_APP
 	// 来自 Magpie\resource.h
@@ -2,7 +2,6 @@
 #include <string>
 #include <vector>
 #include <cwctype>
-#include <wtypes.h>	// BSTR
 #include "SmallVector.h"
 
 struct StrUtils {
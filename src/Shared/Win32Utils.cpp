@@ -151,6 +151,27 @@ bool Win32Utils::GetWindowFrameRect(HWND hWnd, RECT& rect) noexcept {
 	return true;
 }
 
+uint32_t Win32Utils::GetMonitorRefreshRate(HWND hWnd) noexcept {
+	HMONITOR hMon = MonitorFromWindow(hWnd, MONITOR_DEFAULTTONEAREST);
+	if (!hMon) {
+		return 0;
+	}
+
+	MONITORINFOEX mi{ sizeof(MONITORINFOEX) };
+	if (!GetMonitorInfo(hMon, &mi)) {
+		Logger::Get().Win32Error("GetMonitorInfo 失败");
+		return 0;
+	}
+
+	DEVMODE dm{ .dmSize = sizeof(DEVMODE) };
+	if (!EnumDisplaySettings(mi.szDevice, ENUM_CURRENT_SETTINGS, &dm)) {
+		Logger::Get().Win32Error("EnumDisplaySettings 失败");
+		return 0;
+	}
+
+	return dm.dmDisplayFrequency;
+}
+
 bool Win32Utils::ReadFile(const wchar_t* fileName, std::vector<uint8_t>& result) noexcept {
 	Logger::Get().Info(StrUtils::Concat("读取文件: ", StrUtils::UTF16ToUTF8(fileName)));
 
@@ -22,6 +22,9 @@ struct Win32Utils {
 
 	static bool GetWindowFrameRect(HWND hWnd, RECT& rect) noexcept;
 
+	// 窗口所在屏幕的刷新率，失败时返回 0
+	static uint32_t GetMonitorRefreshRate(HWND hWnd) noexcept;
+
 	static bool ReadFile(const wchar_t* fileName, std::vector<uint8_t>& result) noexcept;
 
 	static bool ReadTextFile(const wchar_t* fileName, std::string& result) noexcept;
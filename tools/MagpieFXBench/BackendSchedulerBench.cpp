@@ -0,0 +1,353 @@
+// BackendSchedulerBench.cpp : 用模拟的帧源验证 BackendScheduler
+//
+// 用法: magpiefx-backend-bench [-s 每个场景的秒数]
+//
+// 按 Renderer::_BackendThreadProc 的逻辑模拟后端线程：帧源按合成的时间线产生内容帧，同时不断有消息（DispatcherQueue
+// 的任务等）到达。三种帧源分别对应 Graphics Capture（新帧通过消息唤醒后端）、GDI（只能轮询，捕获后检查重复帧）和
+// Desktop Duplication（捕获时阻塞等待新帧）。和之前的实现比较：轮询的帧源遇到重复帧后立即再次捕获，Desktop
+// Duplication 每次只等待 1 毫秒，StepTimer 在最后 1 毫秒忙等待且不处理消息。
+// 输出每秒唤醒和捕获的次数、测得的内容帧率、从内容帧产生到被捕获的延迟、丢失的内容帧以及消息的延迟。
+// 检查后端从不忙等待，测得的内容帧率和真实值的误差在 3% 以内，捕获次数不多于之前的实现，新帧和消息的延迟有上限。
+// 任何检查失败时返回非零值
+
+#include "pch.h"
+#include "BackendScheduler.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+struct Scenario {
+	const char* name;
+	BackendScheduler::SourceKind kind;
+	double refreshRate;
+	// 相邻两个内容帧的间隔，t 为上一帧的时间。为空表示内容静止
+	std::function<int64_t(std::mt19937& rng, int64_t t)> frameInterval;
+	// 帧源能否发现重复帧。不能时每次捕获都是新帧
+	bool canDetectDuplicate = true;
+	// 真实的内容帧率，为 0 表示不检查测得的帧率
+	double contentFrameRate = 0;
+};
+
+struct SimulationResult {
+	uint64_t wakeupCount = 0;
+	uint64_t captureCount = 0;
+	uint64_t renderCount = 0;
+	// 从内容帧产生到捕获完成
+	std::vector<int64_t> frameLatencies;
+	// 从未被捕获的内容帧，不包括一个刷新周期内就被替换的帧，它们无论如何都不会被显示
+	uint32_t missedFrameCount = 0;
+	// 从消息到达到被处理
+	std::vector<int64_t> messageLatencies;
+	float contentFrameRate = 0;
+};
+
+// 捕获和渲染的用时
+static constexpr int64_t POLLED_CAPTURE_TIME = MS * 2 / 5;
+static constexpr int64_t CAPTURE_TIME = MS / 10;
+static constexpr int64_t RENDER_TIME = 2 * MS;
+// 平均每秒到达的消息
+static constexpr double MESSAGE_RATE = 20;
+
+static bool Simulate(
+	const Scenario& scenario,
+	bool isLegacy,
+	uint32_t seconds,
+	SimulationResult& result,
+	std::string& errorMsg
+) {
+	// 不同来源的随机数互不影响，使两种实现中帧源和消息的序列相同
+	std::mt19937 sourceRng(1);
+	std::mt19937 messageRng(2);
+	std::mt19937 osRng(3);
+
+	const int64_t endTime = (int64_t)seconds * 1'000 * MS;
+	const int64_t period = (int64_t)std::llround(1e9 / scenario.refreshRate);
+	const bool isPolled = scenario.kind == BackendScheduler::SourceKind::Polled;
+
+	// 内容帧产生的时间，第一帧在开始时已存在
+	std::vector<int64_t> arrivals{ 0 };
+	if (scenario.frameInterval) {
+		while (true) {
+			const int64_t t = arrivals.back() + scenario.frameInterval(sourceRng, arrivals.back());
+			if (t >= endTime) {
+				break;
+			}
+			arrivals.push_back(t);
+		}
+	}
+
+	std::vector<int64_t> messages;
+	for (int64_t t = 0;;) {
+		t += (int64_t)(std::exponential_distribution<double>(MESSAGE_RATE)(messageRng) * 1e9);
+		if (t >= endTime) {
+			break;
+		}
+		messages.push_back(t);
+	}
+
+	BackendScheduler scheduler;
+	// 和 Renderer 相同，轮询间隔为刷新周期
+	scheduler.Initialize(scenario.kind, isPolled ? period : 0);
+	const int64_t blockingTimeout = isLegacy ? MS : (int64_t)scheduler.BlockingTimeout() * MS;
+
+	// 唤醒有少许延迟，偶尔被系统调度推迟
+	const auto wakeDelay = [&]() {
+		int64_t delay = std::uniform_int_distribution<int64_t>(0, MS / 10)(osRng);
+		if (std::uniform_int_distribution<int>(0, 99)(osRng) == 0) {
+			delay += MS;
+		}
+		return delay;
+	};
+
+	int64_t time = 0;
+	// 上一次捕获没有新帧并且之后尚未等待过，此时再次捕获即为忙等待
+	bool isSpinning = false;
+	size_t nextMessage = 0;
+	// 下一个尚未被捕获的内容帧
+	size_t nextArrival = 0;
+
+	// 等待到 deadline，wakeOnMessage 和 wakeOnFrame 表示消息和新帧也能唤醒，后者对应 Graphics Capture
+	const auto wait = [&](int64_t deadline, bool wakeOnMessage, bool wakeOnFrame) {
+		if (deadline <= time) {
+			errorMsg = fmt::format("{:.3f} 毫秒处忙等待", time / (double)MS);
+			return false;
+		}
+
+		if (wakeOnMessage && nextMessage < messages.size()) {
+			deadline = std::min(deadline, messages[nextMessage]);
+		}
+		if (wakeOnFrame && nextArrival < arrivals.size()) {
+			deadline = std::min(deadline, arrivals[nextArrival]);
+		}
+		if (deadline <= time) {
+			// 已有消息或新帧，立即返回
+			isSpinning = false;
+			return true;
+		}
+
+		time = std::min(deadline, endTime) + wakeDelay();
+		++result.wakeupCount;
+		isSpinning = false;
+		return true;
+	};
+
+	// 一次捕获，返回是否有新帧。捕获开始前已产生的内容帧中只有最新的一个被捕获
+	const auto capture = [&](int64_t captureStart) {
+		++result.captureCount;
+
+		bool hasNewContent = false;
+		while (nextArrival < arrivals.size() && arrivals[nextArrival] <= captureStart) {
+			if (hasNewContent && arrivals[nextArrival] - arrivals[nextArrival - 1] > period) {
+				++result.missedFrameCount;
+			}
+			hasNewContent = true;
+			++nextArrival;
+		}
+
+		if (hasNewContent) {
+			result.frameLatencies.push_back(time - arrivals[nextArrival - 1]);
+		}
+		return hasNewContent || !scenario.canDetectDuplicate;
+	};
+
+	bool waitingForStepTimer = true;
+	int64_t lastFrameTime = INT64_MIN;
+	while (time < endTime) {
+		while (nextMessage < messages.size() && messages[nextMessage] <= time) {
+			result.messageLatencies.push_back(time - messages[nextMessage]);
+			++nextMessage;
+		}
+
+		if (waitingForStepTimer) {
+			// 和 Renderer 相同，只能轮询的帧源被限制为刷新率
+			if (isPolled && lastFrameTime != INT64_MIN && time < lastFrameTime + period) {
+				const int64_t due = lastFrameTime + period;
+				if (!isLegacy) {
+					if (!wait(due, true, false)) {
+						return false;
+					}
+				} else if (due - time > MS) {
+					// 之前的 StepTimer 等待时不处理消息，提前 1 毫秒醒来
+					time = due - MS + wakeDelay();
+					++result.wakeupCount;
+				} else {
+					// Sleep(0)
+					time += MS / 50;
+					++result.wakeupCount;
+				}
+				continue;
+			}
+			waitingForStepTimer = false;
+		}
+
+		const int64_t captureTime = isLegacy ? time : scheduler.NextCaptureTime(time);
+		if (captureTime > time) {
+			if (!wait(captureTime, true, false)) {
+				return false;
+			}
+			continue;
+		}
+
+		const int64_t captureStart = time;
+		if (scenario.kind == BackendScheduler::SourceKind::Blocking
+			&& (nextArrival == arrivals.size() || arrivals[nextArrival] > time)) {
+			// 阻塞等待新帧，期间不处理消息
+			int64_t deadline = time + blockingTimeout;
+			if (nextArrival < arrivals.size()) {
+				deadline = std::min(deadline, arrivals[nextArrival]);
+			}
+			time = deadline + wakeDelay();
+			++result.wakeupCount;
+			isSpinning = false;
+		}
+
+		if (isSpinning && !isLegacy) {
+			errorMsg = fmt::format("{:.3f} 毫秒处没有等待就再次捕获", time / (double)MS);
+			return false;
+		}
+		time += isPolled ? POLLED_CAPTURE_TIME : CAPTURE_TIME;
+		// Desktop Duplication 返回的是等待结束时的帧
+		const bool isNewFrame = capture(scenario.kind == BackendScheduler::SourceKind::Blocking ? time : captureStart);
+		scheduler.OnCaptured(captureStart, isNewFrame);
+		isSpinning = !isNewFrame;
+
+		if (isNewFrame) {
+			time += RENDER_TIME;
+			++result.renderCount;
+			lastFrameTime = captureStart;
+			waitingForStepTimer = true;
+		} else if (scenario.kind == BackendScheduler::SourceKind::Event) {
+			if (!wait(INT64_MAX, true, true)) {
+				return false;
+			}
+		}
+	}
+
+	result.contentFrameRate = scheduler.ContentFrameRate();
+
+	const BackendScheduler::Statistics& stats = scheduler.GetStatistics();
+	if (stats.captureCount != result.captureCount || stats.newFrameCount != result.renderCount) {
+		errorMsg = "BackendScheduler 的统计结果不正确";
+		return false;
+	}
+
+	return true;
+}
+
+static int64_t JitteredInterval(std::mt19937& rng, double fps, int64_t jitter) {
+	return (int64_t)(1e9 / fps) + std::uniform_int_distribution<int64_t>(-jitter, jitter)(rng);
+}
+
+// 比较之前 (results[0]) 和现在 (results[1]) 的实现，返回未通过的检查
+static std::vector<std::string> CheckResults(const Scenario& scenario, const std::array<SimulationResult, 2>& results) {
+	const SimulationResult& legacy = results[0];
+	const SimulationResult& current = results[1];
+	const double period = 1e9 / scenario.refreshRate;
+
+	std::vector<std::string> errors;
+	if (scenario.contentFrameRate > 0
+		&& std::abs(current.contentFrameRate - scenario.contentFrameRate) > scenario.contentFrameRate * 0.03) {
+		errors.push_back(fmt::format("测得的内容帧率为 {:.2f}，应为 {:.2f}", current.contentFrameRate, scenario.contentFrameRate));
+	}
+	if (current.captureCount > legacy.captureCount) {
+		errors.push_back("捕获次数多于之前的实现");
+	}
+	if (current.missedFrameCount > legacy.missedFrameCount + legacy.frameLatencies.size() / 100) {
+		errors.push_back("丢失的内容帧多于之前的实现");
+	}
+
+	// 新帧最多推迟一次轮询、一帧的渲染和唤醒延迟
+	double maxFrameLatency = RENDER_TIME + 2.0 * MS;
+	if (scenario.kind == BackendScheduler::SourceKind::Polled) {
+		maxFrameLatency += period + POLLED_CAPTURE_TIME;
+	}
+	if (PercentileMs(current.frameLatencies, 0.99) * MS > maxFrameLatency) {
+		errors.push_back("新帧的延迟过高");
+	}
+	// 推迟轮询时预测错误的新帧最多再推迟一个周期
+	if (PercentileMs(current.frameLatencies, 1) * MS > maxFrameLatency + period) {
+		errors.push_back("新帧的最大延迟过高");
+	}
+
+	// 消息最多等待一次捕获和渲染，Desktop Duplication 还要加上阻塞等待的时间
+	double maxMessageLatency = RENDER_TIME + POLLED_CAPTURE_TIME + 2.0 * MS;
+	if (scenario.kind == BackendScheduler::SourceKind::Blocking) {
+		maxMessageLatency += BackendScheduler::MAX_BLOCKING_WAIT;
+	}
+	if (PercentileMs(current.messageLatencies, 1) * MS > maxMessageLatency) {
+		errors.push_back("消息的延迟过高");
+	}
+
+	return errors;
+}
+
+static bool RunSimulations(uint32_t seconds) {
+	using Kind = BackendScheduler::SourceKind;
+	const Scenario scenarios[] = {
+		{ "Graphics Capture，60 FPS 的游戏，60Hz", Kind::Event, 60, [](std::mt19937& rng, int64_t) {
+			return JitteredInterval(rng, 60, MS);
+		}, true, 60 },
+		{ "Graphics Capture，静止的窗口，60Hz", Kind::Event, 60, nullptr },
+		{ "GDI，30 FPS 的游戏，144Hz", Kind::Polled, 144, [](std::mt19937& rng, int64_t) {
+			return JitteredInterval(rng, 30, MS);
+		}, true, 30 },
+		{ "GDI，24 FPS 的视频，60Hz", Kind::Polled, 60, [](std::mt19937&, int64_t) {
+			return (int64_t)(1e9 / 23.976);
+		}, true, 23.976 },
+		{ "GDI，60 FPS 的游戏，60Hz", Kind::Polled, 60, [](std::mt19937& rng, int64_t) {
+			return JitteredInterval(rng, 60, MS / 2);
+		}, true, 60 },
+		{ "GDI，每 2 秒在 20 和 60 FPS 间切换，144Hz", Kind::Polled, 144, [](std::mt19937& rng, int64_t t) {
+			return JitteredInterval(rng, t / (2000 * MS) % 2 ? 60 : 20, MS / 2);
+		} },
+		{ "GDI，不规则的帧间隔，60Hz", Kind::Polled, 60, [](std::mt19937& rng, int64_t) {
+			return std::uniform_int_distribution<int64_t>(10 * MS, 120 * MS)(rng);
+		} },
+		{ "GDI，光标闪烁间偶尔打字，60Hz", Kind::Polled, 60, [](std::mt19937& rng, int64_t) {
+			// 光标每 530 毫秒闪烁一次，两次闪烁之间有时有按键
+			return std::uniform_int_distribution<int>(0, 3)(rng) == 0
+				? std::uniform_int_distribution<int64_t>(40 * MS, 500 * MS)(rng) : 530 * MS;
+		} },
+		{ "GDI，静止的窗口，60Hz", Kind::Polled, 60, nullptr },
+		{ "GDI，不检查重复帧，60Hz", Kind::Polled, 60, [](std::mt19937& rng, int64_t) {
+			return JitteredInterval(rng, 30, MS);
+		}, false, 60 },
+		{ "Desktop Duplication，30 FPS 的游戏，60Hz", Kind::Blocking, 60, [](std::mt19937& rng, int64_t) {
+			return JitteredInterval(rng, 30, MS);
+		}, true, 30 },
+		{ "Desktop Duplication，静止的桌面，60Hz", Kind::Blocking, 60, nullptr },
+	};
+
+	// 先模拟之前的实现
+	const bool isLegacyValues[] = { true, false };
+
+	return RunScenarios<SimulationResult>(scenarios, isLegacyValues,
+		[&](const Scenario& scenario, bool isLegacy, SimulationResult& result, std::string& errorMsg) {
+			return Simulate(scenario, isLegacy, seconds, result, errorMsg);
+		},
+		[](bool isLegacy) { return isLegacy ? "之前" : "现在"; },
+		[&](const SimulationResult& result) {
+			return fmt::format("每秒唤醒 {:.1f} 次，捕获 {:.1f} 次，渲染 {:.1f} 帧；内容帧率 {:.2f}；"
+				"新帧延迟 p50 {:.2f}，p99 {:.2f} 毫秒，丢失 {} 帧；消息延迟 p99 {:.2f} 毫秒",
+				(double)result.wakeupCount / seconds, (double)result.captureCount / seconds,
+				(double)result.renderCount / seconds, result.contentFrameRate,
+				PercentileMs(result.frameLatencies, 0.5), PercentileMs(result.frameLatencies, 0.99),
+				result.missedFrameCount, PercentileMs(result.messageLatencies, 0.99));
+		},
+		CheckResults);
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t seconds = 60;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-s") {
+			seconds = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-s 每个场景的秒数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	return RunSimulations(seconds) ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+#pragma once
+// 各个工具共用的辅助函数
+
+#include "EffectDesc.h"
+#include "EffectParser.h"
+
+inline bool ReadFile(const std::filesystem::path& path, std::string& result) {
+	std::ifstream fs(path, std::ios::binary);
+	if (!fs) {
+		return false;
+	}
+
+	fs.seekg(0, std::ios::end);
+	result.resize((size_t)fs.tellg());
+	fs.seekg(0, std::ios::beg);
+	fs.read(result.data(), result.size());
+	return (bool)fs;
+}
+
+inline bool IsSameDesc(const Magpie::Core::EffectDesc& l, const Magpie::Core::EffectDesc& r) {
+	using namespace Magpie::Core;
+
+	if (l.name != r.name || l.flags != r.flags || l.params.size() != r.params.size()
+		|| l.textures.size() != r.textures.size() || l.samplers.size() != r.samplers.size()
+		|| l.passes.size() != r.passes.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < l.params.size(); ++i) {
+		const EffectParameterDesc& lp = l.params[i];
+		const EffectParameterDesc& rp = r.params[i];
+		if (lp.name != rp.name || lp.label != rp.label || lp.constant.index() != rp.constant.index()
+			|| std::memcmp(&lp.constant, &rp.constant, sizeof(lp.constant)) != 0) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.textures.size(); ++i) {
+		const EffectIntermediateTextureDesc& lt = l.textures[i];
+		const EffectIntermediateTextureDesc& rt = r.textures[i];
+		if (lt.sizeExpr != rt.sizeExpr || lt.format != rt.format || lt.name != rt.name || lt.source != rt.source) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.samplers.size(); ++i) {
+		const EffectSamplerDesc& ls = l.samplers[i];
+		const EffectSamplerDesc& rs = r.samplers[i];
+		if (ls.filterType != rs.filterType || ls.addressType != rs.addressType || ls.name != rs.name) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < l.passes.size(); ++i) {
+		const EffectPassDesc& lp = l.passes[i];
+		const EffectPassDesc& rp = r.passes[i];
+		if (!std::ranges::equal(lp.cso, rp.cso) || lp.inputs != rp.inputs || lp.outputs != rp.outputs
+			|| lp.numThreads != rp.numThreads || lp.blockSize != rp.blockSize
+			|| lp.desc != rp.desc || lp.isPSStyle != rp.isPSStyle
+			|| lp.hasFootprint != rp.hasFootprint || lp.footprint != rp.footprint) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// 查找 effectsDir 中的所有效果，按路径排序
+inline std::vector<std::filesystem::path> FindEffects(const std::filesystem::path& effectsDir) {
+	std::vector<std::filesystem::path> files;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(effectsDir, ec)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".hlsl") {
+			files.push_back(entry.path());
+		}
+	}
+	if (ec) {
+		return {};
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+// 和 EffectsService 相同，效果名为不含扩展名的相对路径，使用反斜杠分隔
+inline std::string GetEffectName(const std::filesystem::path& effectsDir, const std::filesystem::path& path) {
+	std::filesystem::path relPath = path.lexically_relative(effectsDir);
+	relPath.replace_extension();
+	std::string name = relPath.generic_string();
+	std::replace(name.begin(), name.end(), '/', '\\');
+	return name;
+}
+
+// 格式化有 left、top、right 和 bottom 的矩形
+template <typename Rect>
+inline std::string ToString(const Rect& rect) {
+	return fmt::format("({},{})-({},{})", rect.left, rect.top, rect.right, rect.bottom);
+}
+
+// 时间以纳秒为单位
+inline constexpr int64_t MS = 1'000'000;
+
+// 第 p 个百分位数，单位为毫秒
+inline double PercentileMs(std::vector<int64_t> values, double p) {
+	if (values.empty()) {
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * values.size()))] / (double)MS;
+}
+
+// 在每个场景中依次模拟各个实现并输出结果。simulate(scenario, variant, result, errorMsg) 模拟一次，
+// describe(result) 返回一次模拟的概况，所有实现都模拟成功后 check(scenario, results) 返回未通过的检查
+template <typename Result, typename Scenarios, typename Variant, size_t N,
+	typename SimulateFn, typename NameFn, typename DescribeFn, typename CheckFn>
+bool RunScenarios(
+	const Scenarios& scenarios,
+	const Variant (&variants)[N],
+	SimulateFn&& simulate,
+	NameFn&& variantName,
+	DescribeFn&& describe,
+	CheckFn&& check
+) {
+	bool success = true;
+	for (const auto& scenario : scenarios) {
+		fmt::print("{}\n", scenario.name);
+
+		std::array<Result, N> results{};
+		bool simulated = true;
+		for (size_t i = 0; i < N; ++i) {
+			std::string errorMsg;
+			if (!simulate(scenario, variants[i], results[i], errorMsg)) {
+				fmt::print(stderr, "  {}: {}\n", variantName(variants[i]), errorMsg);
+				simulated = false;
+				continue;
+			}
+
+			fmt::print("  {}: {}\n", variantName(variants[i]), describe(results[i]));
+		}
+
+		if (!simulated) {
+			success = false;
+			continue;
+		}
+
+		const std::vector<std::string> errors = check(scenario, std::as_const(results));
+		for (const std::string& error : errors) {
+			fmt::print(stderr, "  {}\n", error);
+		}
+		success = success && errors.empty();
+	}
+
+	return success;
+}
+
+struct Size {
+	long cx;
+	long cy;
+};
+
+// 计算尺寸表达式，支持数字、四个尺寸常量、四则运算和括号
+class SizeExprEvaluator {
+public:
+	SizeExprEvaluator(Size inputSize, Size outputSize) : _inputSize(inputSize), _outputSize(outputSize) {}
+
+	bool Eval(std::string_view expr, double& result) {
+		_expr = expr;
+		_pos = 0;
+		return _ParseSum(result) && (_SkipSpaces(), _pos == _expr.size());
+	}
+
+private:
+	void _SkipSpaces() {
+		while (_pos < _expr.size() && std::isspace((unsigned char)_expr[_pos])) {
+			++_pos;
+		}
+	}
+
+	bool _ParseSum(double& result) {
+		if (!_ParseProduct(result)) {
+			return false;
+		}
+		while (true) {
+			_SkipSpaces();
+			if (_pos == _expr.size() || (_expr[_pos] != '+' && _expr[_pos] != '-')) {
+				return true;
+			}
+			const char op = _expr[_pos++];
+			double rhs;
+			if (!_ParseProduct(rhs)) {
+				return false;
+			}
+			result = op == '+' ? result + rhs : result - rhs;
+		}
+	}
+
+	bool _ParseProduct(double& result) {
+		if (!_ParseFactor(result)) {
+			return false;
+		}
+		while (true) {
+			_SkipSpaces();
+			if (_pos == _expr.size() || (_expr[_pos] != '*' && _expr[_pos] != '/')) {
+				return true;
+			}
+			const char op = _expr[_pos++];
+			double rhs;
+			if (!_ParseFactor(rhs)) {
+				return false;
+			}
+			result = op == '*' ? result * rhs : result / rhs;
+		}
+	}
+
+	bool _ParseFactor(double& result) {
+		_SkipSpaces();
+		if (_pos == _expr.size()) {
+			return false;
+		}
+
+		if (_expr[_pos] == '(') {
+			++_pos;
+			if (!_ParseSum(result)) {
+				return false;
+			}
+			_SkipSpaces();
+			return _pos < _expr.size() && _expr[_pos++] == ')';
+		}
+
+		const size_t start = _pos;
+		while (_pos < _expr.size() && (std::isalnum((unsigned char)_expr[_pos]) || _expr[_pos] == '_' || _expr[_pos] == '.')) {
+			++_pos;
+		}
+		const std::string token(_expr.substr(start, _pos - start));
+		if (token == "INPUT_WIDTH") {
+			result = _inputSize.cx;
+		} else if (token == "INPUT_HEIGHT") {
+			result = _inputSize.cy;
+		} else if (token == "OUTPUT_WIDTH") {
+			result = _outputSize.cx;
+		} else if (token == "OUTPUT_HEIGHT") {
+			result = _outputSize.cy;
+		} else {
+			char* end = nullptr;
+			result = std::strtod(token.c_str(), &end);
+			return !token.empty() && end == token.c_str() + token.size();
+		}
+		return true;
+	}
+
+	std::string_view _expr;
+	size_t _pos = 0;
+	Size _inputSize;
+	Size _outputSize;
+};
+
+inline bool EvalSize(SizeExprEvaluator& evaluator, const std::pair<std::string, std::string>& expr, Size& size) {
+	double width, height;
+	if (!evaluator.Eval(expr.first, width) || !evaluator.Eval(expr.second, height)) {
+		return false;
+	}
+	size = { std::lround(width), std::lround(height) };
+	return size.cx > 0 && size.cy > 0;
+}
+
+// 读取并解析 effectsDir 中名为 name 的效果，不编译
+inline bool ParseEffectFile(const std::filesystem::path& effectsDir, const std::string& name, Magpie::Core::EffectDesc& desc) {
+	using namespace Magpie::Core;
+
+	std::string relPath = name + ".hlsl";
+	std::replace(relPath.begin(), relPath.end(), '\\', '/');
+
+	std::string source;
+	if (!ReadFile(effectsDir / relPath, source)) {
+		fmt::print(stderr, "读取 {} 失败\n", name);
+		return false;
+	}
+
+	EffectBlocks blocks;
+	std::string errorMsg;
+	desc.name = name;
+	if (EffectParser::RemoveComments(source, blocks) || EffectParser::SplitBlocks(source, blocks)
+		|| EffectParser::ResolveBlocks(blocks, desc, false, errorMsg)) {
+		fmt::print(stderr, "解析 {} 失败 {}\n", name, errorMsg);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,295 @@
+// ChangeMaskBench.cpp : 验证 ChangeMask 并统计逐块比较可以省去的复制
+//
+// 用法: magpiefx-mask-bench [-w 宽度] [-h 高度] [-r 随机测试次数]
+//
+// 用随机的画面和变化检查 CPU 参考实现和逐像素比较的结果相同，模拟 DuplicateFrameCS 的线程组和 Gather
+// 得到相同的结果，变化的矩形互不重叠且恰好覆盖变化的块，只把这些矩形复制到上一帧后两帧不再有差异。
+// 然后输出几种典型变化下需要复制的像素占整帧的比例。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "ChangeMask.h"
+
+using namespace Magpie::Core;
+
+using Rect = RegionPropagator::Rect;
+
+static constexpr uint32_t RGB_MASK = 0x00FFFFFF;
+
+static uint32_t TileCount(uint32_t size) {
+	return (size + ChangeMask::TILE_SIZE - 1) / ChangeMask::TILE_SIZE;
+}
+
+// 逐像素比较，每个块是否变化
+static std::vector<bool> NaiveTiles(
+	const std::vector<uint32_t>& cur,
+	const std::vector<uint32_t>& prev,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pitch
+) {
+	const uint32_t tilesX = TileCount(width);
+	std::vector<bool> result((size_t)tilesX * TileCount(height));
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			const size_t i = (size_t)y * pitch + x;
+			if ((cur[i] ^ prev[i]) & RGB_MASK) {
+				result[(y / ChangeMask::TILE_SIZE) * tilesX + x / ChangeMask::TILE_SIZE] = true;
+			}
+		}
+	}
+	return result;
+}
+
+// 和 DuplicateFrameCS 相同：每个线程组 8x8 个线程，每个线程用 Gather 比较 2x2 个像素，采样器为夹取
+static std::vector<uint32_t> EmulateShader(
+	const std::vector<uint32_t>& cur,
+	const std::vector<uint32_t>& prev,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pitch
+) {
+	std::vector<uint32_t> result(ChangeMask::WordCount(width, height));
+
+	const uint32_t groupsX = TileCount(width);
+	const uint32_t groupsY = TileCount(height);
+	for (uint32_t gy = 0; gy < groupsY; ++gy) {
+		for (uint32_t gx = 0; gx < groupsX; ++gx) {
+			const uint32_t tileIdx = gy * ((width + 15) >> 4) + gx;
+			const uint32_t wordIdx = 1 + (tileIdx >> 5);
+			const uint32_t bit = 1u << (tileIdx & 31);
+
+			for (uint32_t ty = 0; ty < 8; ++ty) {
+				for (uint32_t tx = 0; tx < 8; ++tx) {
+					if (result[wordIdx] & bit) {
+						continue;
+					}
+
+					const uint32_t baseX = (gx << 4) + (tx << 1);
+					const uint32_t baseY = (gy << 4) + (ty << 1);
+					for (uint32_t i = 0; i < 4; ++i) {
+						const uint32_t x = std::min(baseX + (i & 1), width - 1);
+						const uint32_t y = std::min(baseY + (i >> 1), height - 1);
+						const size_t k = (size_t)y * pitch + x;
+						if ((cur[k] ^ prev[k]) & RGB_MASK) {
+							result[wordIdx] |= bit;
+							result[0] = 1;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static bool CheckRects(
+	std::span<const Rect> rects,
+	std::span<const uint32_t> mask,
+	uint32_t width,
+	uint32_t height,
+	std::string& errorMsg
+) {
+	// 每个像素被覆盖的次数
+	std::vector<uint8_t> coverage((size_t)width * height);
+	for (const Rect& rect : rects) {
+		if (rect.IsEmpty() || rect.left < 0 || rect.top < 0
+			|| rect.right > (int32_t)width || rect.bottom > (int32_t)height) {
+			errorMsg = "矩形超出范围";
+			return false;
+		}
+
+		for (int32_t y = rect.top; y < rect.bottom; ++y) {
+			for (int32_t x = rect.left; x < rect.right; ++x) {
+				if (++coverage[(size_t)y * width + x] > 1) {
+					errorMsg = "矩形重叠";
+					return false;
+				}
+			}
+		}
+	}
+
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			const bool isChanged = ChangeMask::IsTileChanged(
+				mask, width, x / ChangeMask::TILE_SIZE, y / ChangeMask::TILE_SIZE);
+			if (isChanged != (coverage[(size_t)y * width + x] == 1)) {
+				errorMsg = fmt::format("像素 ({}, {}) 的覆盖不正确", x, y);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool RunRandomTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		const uint32_t width = rand(1, 200);
+		const uint32_t height = rand(1, 200);
+		const uint32_t pitch = width + rand(0, 8);
+
+		std::vector<uint32_t> prev((size_t)pitch * height);
+		for (uint32_t& pixel : prev) {
+			pixel = (uint32_t)rng();
+		}
+		std::vector<uint32_t> cur = prev;
+
+		// 单个像素、只改变 Alpha 通道和矩形
+		for (uint32_t i = rand(0, 6); i > 0; --i) {
+			const uint32_t kind = rand(0, 2);
+			const uint32_t left = rand(0, width - 1);
+			const uint32_t top = rand(0, height - 1);
+			const uint32_t right = kind == 2 ? rand(left + 1, width) : left + 1;
+			const uint32_t bottom = kind == 2 ? rand(top + 1, height) : top + 1;
+			for (uint32_t y = top; y < bottom; ++y) {
+				for (uint32_t x = left; x < right; ++x) {
+					uint32_t& pixel = cur[(size_t)y * pitch + x];
+					pixel = kind == 1 ? pixel ^ 0xFF000000 : pixel ^ (1u << rand(0, 23));
+				}
+			}
+		}
+
+		std::string errorMsg;
+		std::vector<uint32_t> mask(ChangeMask::WordCount(width, height));
+		ChangeMask::Compute(cur.data(), prev.data(), width, height, pitch, mask);
+
+		const std::vector<bool> naive = NaiveTiles(cur, prev, width, height, pitch);
+		bool anyChanged = false;
+		for (uint32_t ty = 0; ty < TileCount(height) && errorMsg.empty(); ++ty) {
+			for (uint32_t tx = 0; tx < TileCount(width); ++tx) {
+				const bool expected = naive[(size_t)ty * TileCount(width) + tx];
+				anyChanged |= expected;
+				if (ChangeMask::IsTileChanged(mask, width, tx, ty) != expected) {
+					errorMsg = fmt::format("块 ({}, {}) 和逐像素比较不同", tx, ty);
+					break;
+				}
+			}
+		}
+		if (errorMsg.empty() && (mask[0] != 0) != anyChanged) {
+			errorMsg = "第一个元素不正确";
+		}
+		if (errorMsg.empty() && EmulateShader(cur, prev, width, height, pitch) != mask) {
+			errorMsg = "和着色器的结果不同";
+		}
+
+		SmallVector<Rect> rects;
+		ChangeMask::ToRects(mask, width, height, rects);
+		if (errorMsg.empty()) {
+			CheckRects(rects, mask, width, height, errorMsg);
+		}
+
+		if (errorMsg.empty()) {
+			// 只复制变化的矩形
+			for (const Rect& rect : rects) {
+				for (int32_t y = rect.top; y < rect.bottom; ++y) {
+					std::copy_n(&cur[(size_t)y * pitch + rect.left], rect.right - rect.left, &prev[(size_t)y * pitch + rect.left]);
+				}
+			}
+
+			ChangeMask::Compute(cur.data(), prev.data(), width, height, pitch, mask);
+			if (mask[0] != 0) {
+				errorMsg = "复制变化的矩形后仍有差异";
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{} ({}x{}): {}\n", r, width, height, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+static void RunScenarios(uint32_t width, uint32_t height) {
+	std::vector<uint32_t> prev((size_t)width * height);
+	std::mt19937 rng(0);
+	for (uint32_t& pixel : prev) {
+		pixel = (uint32_t)rng() | 0xFF000000;
+	}
+
+	struct Scenario {
+		const char* name;
+		// 以尺寸的比例表示
+		SmallVector<std::array<float, 4>> rects;
+	};
+	const Scenario scenarios[] = {
+		{ "文本框逐字显示", { { 0.10f, 0.78f, 0.30f, 0.82f } } },
+		{ "闪烁的光标", { { 0.50f, 0.50f, 0.505f, 0.52f } } },
+		{ "时钟和进度条", { { 0.90f, 0.96f, 0.98f, 0.99f }, { 0.05f, 0.90f, 0.60f, 0.91f } } },
+		{ "散布的粒子", {} },
+		{ "整帧", { { 0.0f, 0.0f, 1.0f, 1.0f } } },
+	};
+
+	fmt::print("{}x{}，{}x{} 的块\n", width, height, ChangeMask::TILE_SIZE, ChangeMask::TILE_SIZE);
+
+	std::vector<uint32_t> mask(ChangeMask::WordCount(width, height));
+	for (const Scenario& scenario : scenarios) {
+		std::vector<uint32_t> cur = prev;
+		const auto change = [&](uint32_t x, uint32_t y) {
+			cur[(size_t)y * width + x] ^= 1;
+		};
+
+		if (scenario.rects.empty()) {
+			for (uint32_t i = 0; i < 200; ++i) {
+				change((uint32_t)rng() % width, (uint32_t)rng() % height);
+			}
+		}
+		for (const std::array<float, 4>& rect : scenario.rects) {
+			const uint32_t right = std::min((uint32_t)std::lround(width * rect[2]), width);
+			const uint32_t bottom = std::min((uint32_t)std::lround(height * rect[3]), height);
+			for (uint32_t y = (uint32_t)std::lround(height * rect[1]); y < bottom; ++y) {
+				for (uint32_t x = (uint32_t)std::lround(width * rect[0]); x < right; ++x) {
+					change(x, y);
+				}
+			}
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		ChangeMask::Compute(cur.data(), prev.data(), width, height, width, mask);
+		SmallVector<Rect> rects;
+		ChangeMask::ToRects(mask, width, height, rects);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		int64_t area = 0;
+		for (const Rect& rect : rects) {
+			area += rect.Area();
+		}
+
+		fmt::print("  {}: {} 个矩形，复制 {:.2f}% 的像素，CPU 参考实现用时 {:.2f} 毫秒\n",
+			scenario.name, rects.size(), area * 100.0 / ((int64_t)width * height), ms);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t randomTestCount = 1000;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-w") {
+			width = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-h") {
+			height = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-w 宽度] [-h 高度] [-r 随机测试次数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const bool success = RunRandomTests(randomTestCount);
+	RunScenarios(width, height);
+	return success ? 0 : 1;
+}
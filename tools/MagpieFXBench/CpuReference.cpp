@@ -0,0 +1,329 @@
+#include "pch.h"
+#include "CpuReference.h"
+#include "TaskScheduler.h"
+#include <bit>
+#include <cmath>
+
+using namespace Magpie::Core;
+
+namespace CpuReference {
+
+// 舍入到最接近的半精度浮点数，超出范围时截断到最大值
+static float RoundToHalf(float v) noexcept {
+	static constexpr float MAX_HALF = 65504.0f;
+	// 半精度最小的正规数，小于它时精度固定为 2^-24
+	static constexpr float MIN_NORMAL_HALF = 6.103515625e-05f;
+
+	if (std::isnan(v)) {
+		return v;
+	}
+
+	const float a = std::abs(v);
+	if (a >= MAX_HALF) {
+		return std::copysign(MAX_HALF, v);
+	}
+	if (a < MIN_NORMAL_HALF) {
+		return std::nearbyint(v * 16777216.0f) / 16777216.0f;
+	}
+
+	// 尾数从 23 位舍入到 10 位，就近舍入到偶数
+	uint32_t bits = std::bit_cast<uint32_t>(v);
+	bits += 0xFFF + ((bits >> 13) & 1);
+	bits &= ~0x1FFFu;
+	return std::bit_cast<float>(bits);
+}
+
+static float RoundToUnorm(float v, float maxValue) noexcept {
+	return std::nearbyint(std::clamp(v, 0.0f, 1.0f) * maxValue) / maxValue;
+}
+
+static float RoundToSnorm(float v, float maxValue) noexcept {
+	return std::nearbyint(std::clamp(v, -1.0f, 1.0f) * maxValue) / maxValue;
+}
+
+// 返回格式的通道数
+static int GetChannelCount(EffectIntermediateTextureFormat format) noexcept {
+	switch (format) {
+	case EffectIntermediateTextureFormat::R32G32B32A32_FLOAT:
+	case EffectIntermediateTextureFormat::R16G16B16A16_FLOAT:
+	case EffectIntermediateTextureFormat::R16G16B16A16_UNORM:
+	case EffectIntermediateTextureFormat::R16G16B16A16_SNORM:
+	case EffectIntermediateTextureFormat::R10G10B10A2_UNORM:
+	case EffectIntermediateTextureFormat::R8G8B8A8_UNORM:
+	case EffectIntermediateTextureFormat::R8G8B8A8_SNORM:
+		return 4;
+	case EffectIntermediateTextureFormat::R11G11B10_FLOAT:
+		return 3;
+	case EffectIntermediateTextureFormat::R32G32_FLOAT:
+	case EffectIntermediateTextureFormat::R16G16_FLOAT:
+	case EffectIntermediateTextureFormat::R16G16_UNORM:
+	case EffectIntermediateTextureFormat::R16G16_SNORM:
+	case EffectIntermediateTextureFormat::R8G8_UNORM:
+	case EffectIntermediateTextureFormat::R8G8_SNORM:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+// 按格式的精度量化一个分量。R10G10B10A2 和 R11G11B10 只近似
+static float Quantize(EffectIntermediateTextureFormat format, int component, float v) noexcept {
+	switch (format) {
+	case EffectIntermediateTextureFormat::R16G16B16A16_FLOAT:
+	case EffectIntermediateTextureFormat::R16G16_FLOAT:
+	case EffectIntermediateTextureFormat::R16_FLOAT:
+	case EffectIntermediateTextureFormat::R11G11B10_FLOAT:
+		return RoundToHalf(v);
+	case EffectIntermediateTextureFormat::R16G16B16A16_UNORM:
+	case EffectIntermediateTextureFormat::R16G16_UNORM:
+	case EffectIntermediateTextureFormat::R16_UNORM:
+		return RoundToUnorm(v, 65535.0f);
+	case EffectIntermediateTextureFormat::R16G16B16A16_SNORM:
+	case EffectIntermediateTextureFormat::R16G16_SNORM:
+	case EffectIntermediateTextureFormat::R16_SNORM:
+		return RoundToSnorm(v, 32767.0f);
+	case EffectIntermediateTextureFormat::R10G10B10A2_UNORM:
+		return RoundToUnorm(v, component == 3 ? 3.0f : 1023.0f);
+	case EffectIntermediateTextureFormat::R8G8B8A8_UNORM:
+	case EffectIntermediateTextureFormat::R8G8_UNORM:
+	case EffectIntermediateTextureFormat::R8_UNORM:
+		return RoundToUnorm(v, 255.0f);
+	case EffectIntermediateTextureFormat::R8G8B8A8_SNORM:
+	case EffectIntermediateTextureFormat::R8G8_SNORM:
+	case EffectIntermediateTextureFormat::R8_SNORM:
+		return RoundToSnorm(v, 127.0f);
+	default:
+		return v;
+	}
+}
+
+CpuTexture::CpuTexture(uint32_t width, uint32_t height, EffectIntermediateTextureFormat format)
+	: _pixels((size_t)width * height, float4(0, 0, 0, 1)), _width(width), _height(height), _format(format) {}
+
+float4 CpuTexture::Load(int x, int y) const noexcept {
+	if (x < 0 || y < 0 || x >= (int)_width || y >= (int)_height) {
+		return float4(0);
+	}
+	return _pixels[(size_t)y * _width + x];
+}
+
+const float4& CpuTexture::_Fetch(int x, int y, EffectSamplerAddressType addressType) const noexcept {
+	if (addressType == EffectSamplerAddressType::Wrap) {
+		x %= (int)_width;
+		y %= (int)_height;
+		if (x < 0) {
+			x += _width;
+		}
+		if (y < 0) {
+			y += _height;
+		}
+	} else {
+		x = std::clamp(x, 0, (int)_width - 1);
+		y = std::clamp(y, 0, (int)_height - 1);
+	}
+	return _pixels[(size_t)y * _width + x];
+}
+
+float4 CpuTexture::SampleLevel(const EffectSamplerDesc& sampler, float2 pos) const noexcept {
+	const float x = pos.x * _width;
+	const float y = pos.y * _height;
+
+	if (sampler.filterType == EffectSamplerFilterType::Point) {
+		return _Fetch((int)std::floor(x), (int)std::floor(y), sampler.addressType);
+	}
+
+	// 以像素中心为整数点做双线性插值
+	const float fx = x - 0.5f;
+	const float fy = y - 0.5f;
+	const int x0 = (int)std::floor(fx);
+	const int y0 = (int)std::floor(fy);
+	const float tx = fx - x0;
+	const float ty = fy - y0;
+
+	const float4 top = lerp(_Fetch(x0, y0, sampler.addressType), _Fetch(x0 + 1, y0, sampler.addressType), tx);
+	const float4 bottom = lerp(_Fetch(x0, y0 + 1, sampler.addressType), _Fetch(x0 + 1, y0 + 1, sampler.addressType), tx);
+	return lerp(top, bottom, ty);
+}
+
+float4 CpuTexture::Gather(const EffectSamplerDesc& sampler, float2 pos, int component) const noexcept {
+	const int x0 = (int)std::floor(pos.x * _width - 0.5f);
+	const int y0 = (int)std::floor(pos.y * _height - 0.5f);
+
+	return float4(
+		_Fetch(x0, y0 + 1, sampler.addressType)[component],
+		_Fetch(x0 + 1, y0 + 1, sampler.addressType)[component],
+		_Fetch(x0 + 1, y0, sampler.addressType)[component],
+		_Fetch(x0, y0, sampler.addressType)[component]
+	);
+}
+
+void CpuTexture::Store(uint32_t x, uint32_t y, const float4& value) noexcept {
+	assert(x < _width && y < _height);
+
+	// 格式中没有的分量读取时为 0，alpha 为 1
+	const int channelCount = GetChannelCount(_format);
+	float4 result(0, 0, 0, 1);
+	for (int i = 0; i < channelCount; ++i) {
+		result[i] = Quantize(_format, i, value[i]);
+	}
+	_pixels[(size_t)y * _width + x] = result;
+}
+
+bool CpuEffectExecutor::Initialize(
+	const EffectDesc& desc,
+	Size inputSize,
+	Size outputSize,
+	const std::map<std::string, float>& params,
+	std::string& errorMsg
+) {
+	const auto& allKernels = GetKernels();
+	auto it = allKernels.find(desc.name);
+	if (it == allKernels.end()) {
+		errorMsg = "没有 C++ 实现";
+		return false;
+	}
+	const CpuEffectKernels& kernels = it->second;
+
+	if (kernels.passes.size() != desc.passes.size()) {
+		errorMsg = fmt::format("通道数不一致: HLSL 中有 {} 个，C++ 实现有 {} 个", desc.passes.size(), kernels.passes.size());
+		return false;
+	}
+	if (kernels.params.size() != desc.params.size() || !std::equal(kernels.params.begin(), kernels.params.end(),
+		desc.params.begin(), [](std::string_view l, const EffectParameterDesc& r) { return l == r.name; })) {
+		errorMsg = "参数和 HLSL 中不一致";
+		return false;
+	}
+	for (size_t i = 0; i < desc.passes.size(); ++i) {
+		if (desc.passes[i].isPSStyle != (kernels.passes[i].ps != nullptr)) {
+			errorMsg = fmt::format("通道 {} 的类型和 HLSL 中不一致", i + 1);
+			return false;
+		}
+	}
+
+	for (const auto& [name, value] : params) {
+		if (std::find(kernels.params.begin(), kernels.params.end(), name) == kernels.params.end()) {
+			errorMsg = fmt::format("参数 {} 不存在", name);
+			return false;
+		}
+	}
+
+	// 和 EffectDrawer 相同，OUTPUT 未指定尺寸时使用 outputSize
+	SizeExprEvaluator evaluator(inputSize, outputSize);
+	_textures.clear();
+	_textures.reserve(desc.textures.size());
+	for (size_t i = 0; i < desc.textures.size(); ++i) {
+		const EffectIntermediateTextureDesc& texDesc = desc.textures[i];
+
+		Size size;
+		if (i == 0) {
+			size = inputSize;
+		} else if (i == 1 && texDesc.sizeExpr.first.empty()) {
+			size = outputSize;
+		} else if (!texDesc.source.empty()) {
+			errorMsg = fmt::format("不支持从文件加载纹理 {}", texDesc.name);
+			return false;
+		} else if (!EvalSize(evaluator, texDesc.sizeExpr, size)) {
+			errorMsg = fmt::format("计算纹理 {} 的尺寸失败", texDesc.name);
+			return false;
+		}
+
+		// INPUT 和 OUTPUT 没有格式，和交换链相同使用 R8G8B8A8_UNORM
+		_textures.emplace_back((uint32_t)size.cx, (uint32_t)size.cy,
+			texDesc.format == EffectIntermediateTextureFormat::UNKNOWN ?
+			EffectIntermediateTextureFormat::R8G8B8A8_UNORM : texDesc.format);
+	}
+
+	std::vector<float> paramValues;
+	paramValues.reserve(desc.params.size());
+	for (const EffectParameterDesc& paramDesc : desc.params) {
+		auto paramIt = params.find(paramDesc.name);
+		if (paramIt != params.end()) {
+			paramValues.push_back(paramIt->second);
+		} else if (paramDesc.constant.index() == 0) {
+			paramValues.push_back(std::get<0>(paramDesc.constant).defaultValue);
+		} else {
+			paramValues.push_back((float)std::get<1>(paramDesc.constant).defaultValue);
+		}
+	}
+
+	// 和 GetInputSize、GetOutputSize 等内置函数相同，尺寸始终是 INPUT 和 OUTPUT 的尺寸
+	const uint2 effectInputSize{ _textures[0].Width(), _textures[0].Height() };
+	const uint2 effectOutputSize{ _textures[1].Width(), _textures[1].Height() };
+
+	_passContexts.clear();
+	_passContexts.resize(desc.passes.size());
+	for (size_t i = 0; i < desc.passes.size(); ++i) {
+		CpuPassContext& ctx = _passContexts[i];
+		for (uint32_t idx : desc.passes[i].inputs) {
+			ctx.inputs.push_back(&_textures[idx]);
+		}
+		for (uint32_t idx : desc.passes[i].outputs) {
+			ctx.outputs.push_back(&_textures[idx]);
+		}
+		ctx.samplers = &desc.samplers;
+		ctx.params = paramValues;
+		ctx.inputSize = effectInputSize;
+		ctx.outputSize = effectOutputSize;
+		ctx.inputPt = float2(1.0f / effectInputSize.x, 1.0f / effectInputSize.y);
+		ctx.outputPt = float2(1.0f / effectOutputSize.x, 1.0f / effectOutputSize.y);
+	}
+
+	_desc = &desc;
+	_kernels = &kernels;
+	return true;
+}
+
+void CpuEffectExecutor::_ExecuteBlock(uint32_t passIdx, uint2 blockStart) const {
+	const EffectPassDesc& passDesc = _desc->passes[passIdx];
+	const CpuPassKernel& kernel = _kernels->passes[passIdx];
+	const CpuPassContext& ctx = _passContexts[passIdx];
+
+	if (kernel.ps) {
+		// 和生成的着色器入口相同，pos 为通道输出的像素中心
+		CpuTexture& output = *ctx.outputs[0];
+		const float2 outputPt(1.0f / output.Width(), 1.0f / output.Height());
+		const uint32_t right = std::min(blockStart.x + passDesc.blockSize.first, output.Width());
+		const uint32_t bottom = std::min(blockStart.y + passDesc.blockSize.second, output.Height());
+
+		for (uint32_t y = blockStart.y; y < bottom; ++y) {
+			for (uint32_t x = blockStart.x; x < right; ++x) {
+				output.Store(x, y, kernel.ps(ctx, float2((x + 0.5f) * outputPt.x, (y + 0.5f) * outputPt.y)));
+			}
+		}
+		return;
+	}
+
+	for (uint32_t z = 0; z < passDesc.numThreads[2]; ++z) {
+		for (uint32_t y = 0; y < passDesc.numThreads[1]; ++y) {
+			for (uint32_t x = 0; x < passDesc.numThreads[0]; ++x) {
+				kernel.cs(ctx, blockStart, uint3{ x, y, z });
+			}
+		}
+	}
+}
+
+void CpuEffectExecutor::Execute(uint32_t threadCount) {
+	assert(_desc);
+
+	for (uint32_t passIdx = 0; passIdx < (uint32_t)_desc->passes.size(); ++passIdx) {
+		const EffectPassDesc& passDesc = _desc->passes[passIdx];
+		const CpuTexture& output = *_passContexts[passIdx].outputs[0];
+		const uint32_t blockWidth = passDesc.blockSize.first;
+		const uint32_t blockHeight = passDesc.blockSize.second;
+		const uint32_t blockCountX = (output.Width() + blockWidth - 1) / blockWidth;
+		const uint32_t blockCountY = (output.Height() + blockHeight - 1) / blockHeight;
+
+		// 每行块为一个任务，块之间没有依赖，下一个通道必须等待所有块完成
+		TaskScheduler scheduler;
+		for (uint32_t by = 0; by < blockCountY; ++by) {
+			scheduler.Submit([this, passIdx, by, blockCountX, blockWidth, blockHeight](TaskScheduler::Context&) {
+				for (uint32_t bx = 0; bx < blockCountX; ++bx) {
+					_ExecuteBlock(passIdx, uint2{ bx * blockWidth, by * blockHeight });
+				}
+			});
+		}
+		scheduler.Run(threadCount);
+	}
+}
+
+}
@@ -0,0 +1,231 @@
+#pragma once
+// CPU 参考执行器: 在没有 GPU 的机器上执行常用效果，用于回归测试和性能测量。
+// 每个效果的通道由手工移植的 C++ 实现，写法尽量和 HLSL 保持一致以便对照；纹理、尺寸和分块
+// 仍来自 EffectParser 解析的 EffectDesc，和 GPU 上的执行方式相同
+
+#include "EffectDesc.h"
+#include "BenchUtils.h"
+#include <cmath>
+
+namespace CpuReference {
+
+// 和 HLSL 相同的向量类型，只实现移植效果所需的运算
+struct float2 {
+	float x = 0, y = 0;
+
+	float2() = default;
+	float2(float v) : x(v), y(v) {}
+	float2(float x_, float y_) : x(x_), y(y_) {}
+
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+};
+
+struct float3 {
+	float x = 0, y = 0, z = 0;
+
+	float3() = default;
+	float3(float v) : x(v), y(v), z(v) {}
+	float3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+};
+
+struct float4 {
+	float x = 0, y = 0, z = 0, w = 0;
+
+	float4() = default;
+	float4(float v) : x(v), y(v), z(v), w(v) {}
+	float4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+	float4(const float3& v, float w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+
+	float3 rgb() const { return { x, y, z }; }
+};
+
+struct uint2 {
+	uint32_t x = 0, y = 0;
+};
+
+struct uint3 {
+	uint32_t x = 0, y = 0, z = 0;
+};
+
+template <typename T> inline constexpr int VECTOR_SIZE = 0;
+template <> inline constexpr int VECTOR_SIZE<float2> = 2;
+template <> inline constexpr int VECTOR_SIZE<float3> = 3;
+template <> inline constexpr int VECTOR_SIZE<float4> = 4;
+
+template <typename T>
+concept FloatVector = VECTOR_SIZE<T> > 0;
+
+// 逐分量运算，循环次数是编译期常量，编译器可以将其向量化
+template <FloatVector T, typename F>
+inline T Map(const T& a, F&& f) {
+	T r;
+	for (int i = 0; i < VECTOR_SIZE<T>; ++i) {
+		r[i] = f(a[i]);
+	}
+	return r;
+}
+
+template <FloatVector T, typename F>
+inline T Map(const T& a, const T& b, F&& f) {
+	T r;
+	for (int i = 0; i < VECTOR_SIZE<T>; ++i) {
+		r[i] = f(a[i], b[i]);
+	}
+	return r;
+}
+
+#define CPU_REFERENCE_VECTOR_OPERATOR(op) \
+	template <FloatVector T> inline T operator op(const T& a, const T& b) { return Map(a, b, [](float l, float r) { return l op r; }); } \
+	template <FloatVector T> inline T operator op(const T& a, float b) { return Map(a, [b](float l) { return l op b; }); } \
+	template <FloatVector T> inline T operator op(float a, const T& b) { return Map(b, [a](float r) { return a op r; }); } \
+	template <FloatVector T> inline T& operator op##=(T& a, const T& b) { return a = a op b; } \
+	template <FloatVector T> inline T& operator op##=(T& a, float b) { return a = a op b; }
+
+CPU_REFERENCE_VECTOR_OPERATOR(+)
+CPU_REFERENCE_VECTOR_OPERATOR(-)
+CPU_REFERENCE_VECTOR_OPERATOR(*)
+CPU_REFERENCE_VECTOR_OPERATOR(/)
+
+#undef CPU_REFERENCE_VECTOR_OPERATOR
+
+template <FloatVector T>
+inline T operator-(const T& a) {
+	return Map(a, [](float v) { return -v; });
+}
+
+// HLSL 内置函数，标量和向量版本。和 GPU 相同，min 和 max 的一个参数为 NaN 时返回另一个，
+// saturate(NaN) 为 0。FSR 和 CAS 在平坦区域依赖这一点
+inline float min(float a, float b) { return std::fmin(a, b); }
+inline float max(float a, float b) { return std::fmax(a, b); }
+inline float abs(float v) { return std::abs(v); }
+inline float floor(float v) { return std::floor(v); }
+inline float sqrt(float v) { return std::sqrt(v); }
+inline float saturate(float v) { return v > 0 ? (v < 1 ? v : 1.0f) : 0.0f; }
+inline float rcp(float v) { return 1.0f / v; }
+inline float rsqrt(float v) { return 1.0f / std::sqrt(v); }
+inline float frac(float v) { return v - std::floor(v); }
+inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+template <FloatVector T> inline T min(const T& a, const T& b) { return Map(a, b, [](float l, float r) { return min(l, r); }); }
+template <FloatVector T> inline T max(const T& a, const T& b) { return Map(a, b, [](float l, float r) { return max(l, r); }); }
+template <FloatVector T> inline T clamp(const T& v, const T& lo, const T& hi) { return min(max(v, lo), hi); }
+template <FloatVector T> inline T abs(const T& a) { return Map(a, [](float v) { return std::abs(v); }); }
+template <FloatVector T> inline T floor(const T& a) { return Map(a, [](float v) { return std::floor(v); }); }
+template <FloatVector T> inline T frac(const T& a) { return Map(a, [](float v) { return frac(v); }); }
+template <FloatVector T> inline T sin(const T& a) { return Map(a, [](float v) { return std::sin(v); }); }
+template <FloatVector T> inline T sqrt(const T& a) { return Map(a, [](float v) { return std::sqrt(v); }); }
+template <FloatVector T> inline T rcp(const T& a) { return Map(a, [](float v) { return 1.0f / v; }); }
+template <FloatVector T> inline T saturate(const T& a) { return Map(a, [](float v) { return saturate(v); }); }
+template <FloatVector T> inline T lerp(const T& a, const T& b, float t) { return a + (b - a) * t; }
+
+template <FloatVector T>
+inline float dot(const T& a, const T& b) {
+	float r = 0;
+	for (int i = 0; i < VECTOR_SIZE<T>; ++i) {
+		r += a[i] * b[i];
+	}
+	return r;
+}
+
+// 模拟 Texture2D，以 float4 保存每个像素。写入时按格式量化，和 GPU 上的中间纹理精度相同
+class CpuTexture {
+public:
+	CpuTexture() = default;
+	CpuTexture(uint32_t width, uint32_t height, Magpie::Core::EffectIntermediateTextureFormat format);
+
+	uint32_t Width() const noexcept { return _width; }
+	uint32_t Height() const noexcept { return _height; }
+
+	// 越界时返回 0，和 D3D 相同
+	float4 Load(int x, int y) const noexcept;
+
+	float4 SampleLevel(const Magpie::Core::EffectSamplerDesc& sampler, float2 pos) const noexcept;
+
+	// 返回 pos 周围的 2x2 像素的某个分量，顺序和 D3D 相同:
+	// w z
+	// x y
+	float4 Gather(const Magpie::Core::EffectSamplerDesc& sampler, float2 pos, int component) const noexcept;
+
+	void Store(uint32_t x, uint32_t y, const float4& value) noexcept;
+
+	std::span<float4> Pixels() noexcept { return _pixels; }
+	std::span<const float4> Pixels() const noexcept { return _pixels; }
+
+private:
+	const float4& _Fetch(int x, int y, Magpie::Core::EffectSamplerAddressType addressType) const noexcept;
+
+	std::vector<float4> _pixels;
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	Magpie::Core::EffectIntermediateTextureFormat _format = Magpie::Core::EffectIntermediateTextureFormat::UNKNOWN;
+};
+
+// 执行某个通道时可以访问的资源，相当于 GPU 上的常量缓冲区和绑定的纹理
+struct CpuPassContext {
+	std::vector<const CpuTexture*> inputs;
+	std::vector<CpuTexture*> outputs;
+	const std::vector<Magpie::Core::EffectSamplerDesc>* samplers = nullptr;
+	// 顺序和效果中的参数相同
+	std::vector<float> params;
+	uint2 inputSize;
+	uint2 outputSize;
+	float2 inputPt;
+	float2 outputPt;
+
+	const Magpie::Core::EffectSamplerDesc& Sampler(size_t idx) const noexcept {
+		return (*samplers)[idx];
+	}
+};
+
+// 某个通道的 C++ 实现，两者只能有一个，和 EffectPassDesc::isPSStyle 对应
+struct CpuPassKernel {
+	// 返回 pos 处的输出，pos 为输出像素中心的纹理坐标
+	float4 (*ps)(const CpuPassContext& ctx, float2 pos) = nullptr;
+	// 和 HLSL 中的 PassN(uint2 blockStart, uint3 threadId) 相同，由内核自己写入输出
+	void (*cs)(const CpuPassContext& ctx, uint2 blockStart, uint3 threadId) = nullptr;
+};
+
+struct CpuEffectKernels {
+	// 效果的参数名，用于检查 C++ 实现和 HLSL 中的参数一致
+	std::vector<std::string_view> params;
+	std::vector<CpuPassKernel> passes;
+};
+
+// 所有有 C++ 实现的效果，键为效果名
+const std::map<std::string, CpuEffectKernels, std::less<>>& GetKernels() noexcept;
+
+class CpuEffectExecutor {
+public:
+	// 检查 C++ 实现和 desc 一致并创建纹理。inputSize 为 INPUT 的尺寸，outputSize 用于计算尺寸表达式，
+	// OUTPUT 未指定尺寸时即为它的尺寸。params 可以覆盖参数的默认值
+	bool Initialize(
+		const Magpie::Core::EffectDesc& desc,
+		Size inputSize,
+		Size outputSize,
+		const std::map<std::string, float>& params,
+		std::string& errorMsg
+	);
+
+	CpuTexture& Input() noexcept { return _textures[0]; }
+	const CpuTexture& Output() const noexcept { return _textures[1]; }
+
+	// 依次执行每个通道，通道内按 BLOCK_SIZE 分块，在 threadCount 个线程上并行
+	void Execute(uint32_t threadCount);
+
+private:
+	void _ExecuteBlock(uint32_t passIdx, uint2 blockStart) const;
+
+	const Magpie::Core::EffectDesc* _desc = nullptr;
+	const CpuEffectKernels* _kernels = nullptr;
+	std::vector<CpuTexture> _textures;
+	std::vector<CpuPassContext> _passContexts;
+};
+
+}
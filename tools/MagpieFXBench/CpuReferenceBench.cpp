@@ -0,0 +1,362 @@
+// CpuReferenceBench.cpp : 在 CPU 上执行常用效果，和之前的快照比较并测量性能
+//
+// 用法: magpiefx-cpuref-bench <效果目录> [-d 快照目录] [-u] [-t 线程数] [-s 宽x高]
+//
+// 效果的描述来自效果目录中的 HLSL，通道由 CpuReferenceKernels.cpp 中的 C++ 实现执行。对每个效果:
+// 0. HLSL 和移植时相同。快照也由移植的实现生成，无法发现着色器的修改，因此固定源码的哈希
+// 1. 纯色输入的输出仍为同一颜色
+// 2. 插值算法以原尺寸执行时输出等于输入
+// 3. 单线程和多线程分块执行的结果逐位相同
+// 4. 合成图像的输出和快照一致。每个分量最多相差 1 即视为一致，因此不同编译器和平台的浮点误差
+//    不会导致失败。快照只能发现移植的实现的变化，不能说明它和 GPU 上的结果相同
+// 最后以 -s 指定的输入尺寸测量每个效果的耗时。-u 根据当前结果重新生成快照，修改效果后使用。
+// 任何检查失败时返回非零值
+
+#include "pch.h"
+#include "CpuReference.h"
+#include "EffectBundle.h"
+
+using namespace Magpie::Core;
+using namespace CpuReference;
+
+struct TestCase {
+	const char* effectName;
+	// 输出尺寸和输入尺寸的比例，OUTPUT 指定了尺寸的效果忽略它
+	float scale;
+	// 是否为插值算法，以原尺寸执行时应输出原图
+	bool isInterpolation;
+	// 移植时 HLSL 的 EffectBundle::HashText。修改着色器后需同步修改 CpuReferenceKernels.cpp，
+	// 再更新它和快照
+	uint64_t sourceHash;
+};
+
+static constexpr TestCase TEST_CASES[] = {
+	{ "Bilinear", 2.0f, true, 0xcad0c4a6b90113a2 },
+	{ "Bicubic", 1.5f, false, 0x98b76d9a2fd033f1 },
+	{ "Lanczos", 2.0f, true, 0x43b6598acd2f1e34 },
+	{ "FSR\\FSR_EASU", 1.5f, false, 0xc9210adaad727fe5 },
+	{ "FSR\\FSR_RCAS", 1.0f, false, 0x4c43f60e8318d873 },
+	{ "CAS\\CAS", 1.0f, false, 0x6633cffecf0b4e9c }
+};
+
+// 奇数尺寸使最后一行和一列的块不完整
+static constexpr Size TEST_INPUT_SIZE = { 61, 37 };
+
+static Size ScaleSize(Size size, float scale) {
+	return { std::lround(size.cx * scale), std::lround(size.cy * scale) };
+}
+
+static float ToUnorm8(float v) {
+	return std::nearbyint(std::clamp(v, 0.0f, 1.0f) * 255.0f) / 255.0f;
+}
+
+// 合成的测试图像: 渐变、棋盘格、斜边和噪声，覆盖平坦区域、锐利边缘和各个方向的梯度。
+// 只使用整数运算和 mt19937 的原始输出，各平台生成的图像相同
+static void FillTestImage(CpuTexture& texture) {
+	std::mt19937 rng(42);
+	const uint32_t width = texture.Width();
+	const uint32_t height = texture.Height();
+
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint32_t r, g, b;
+			if (x < width / 3) {
+				r = x * 255 / width;
+				g = y * 255 / height;
+				b = 128;
+			} else if (x < width * 2 / 3) {
+				const bool isWhite = ((x / 4) + (y / 4)) % 2 == 0;
+				r = g = b = isWhite ? 230 : 20;
+				if (x + y * 2 < width) {
+					b = 200;
+				}
+			} else {
+				const bool isAbove = x * height > y * width;
+				r = isAbove ? 200 : 40;
+				g = isAbove ? 60 : 180;
+				b = 90;
+			}
+
+			const uint32_t noise = rng() >> 28;
+			texture.Store(x, y, float4(
+				std::min(r + noise, 255u) / 255.0f,
+				std::min(g + noise, 255u) / 255.0f,
+				std::min(b + noise, 255u) / 255.0f,
+				1.0f
+			));
+		}
+	}
+}
+
+static void FillSolidImage(CpuTexture& texture, const float4& color) {
+	for (uint32_t y = 0; y < texture.Height(); ++y) {
+		for (uint32_t x = 0; x < texture.Width(); ++x) {
+			texture.Store(x, y, color);
+		}
+	}
+}
+
+// 只比较 RGB，所有效果都输出 alpha 为 1
+static float MaxRgbDiff(const float4& l, const float4& r) {
+	return std::max({ std::abs(l.x - r.x), std::abs(l.y - r.y), std::abs(l.z - r.z) });
+}
+
+// 以二进制 PPM 保存快照，可以直接用看图软件查看
+static std::filesystem::path GetSnapshotPath(const std::filesystem::path& snapshotDir, std::string_view effectName) {
+	std::string fileName(effectName);
+	std::replace(fileName.begin(), fileName.end(), '\\', '_');
+	return snapshotDir / (fileName + ".ppm");
+}
+
+static std::vector<uint8_t> ToRgb8(const CpuTexture& texture) {
+	std::vector<uint8_t> result;
+	result.reserve(texture.Pixels().size() * 3);
+	for (const float4& pixel : texture.Pixels()) {
+		for (int i = 0; i < 3; ++i) {
+			result.push_back((uint8_t)std::lround(ToUnorm8(pixel[i]) * 255));
+		}
+	}
+	return result;
+}
+
+static bool ReadPPM(const std::filesystem::path& path, Size& size, std::vector<uint8_t>& rgb) {
+	std::ifstream fs(path, std::ios::binary);
+	std::string magic;
+	int maxValue = 0;
+	if (!(fs >> magic >> size.cx >> size.cy >> maxValue) || magic != "P6" || maxValue != 255 || size.cx <= 0 || size.cy <= 0) {
+		return false;
+	}
+	// 跳过头部之后的一个空白字符
+	fs.get();
+
+	rgb.resize((size_t)size.cx * size.cy * 3);
+	fs.read((char*)rgb.data(), rgb.size());
+	return (bool)fs;
+}
+
+static bool WritePPM(const std::filesystem::path& path, Size size, const std::vector<uint8_t>& rgb) {
+	std::ofstream fs(path, std::ios::binary);
+	fs << fmt::format("P6\n{} {}\n255\n", size.cx, size.cy);
+	fs.write((const char*)rgb.data(), rgb.size());
+	return (bool)fs;
+}
+
+// 执行各项检查，errors 中为所有失败的检查
+static void TestEffect(
+	const EffectDesc& desc,
+	const TestCase& testCase,
+	uint32_t threadCount,
+	Size& resultSize,
+	std::vector<uint8_t>& result,
+	std::vector<std::string>& errors
+) {
+	const Size outputSize = ScaleSize(TEST_INPUT_SIZE, testCase.scale);
+
+	std::string errorMsg;
+	CpuEffectExecutor executor;
+	if (!executor.Initialize(desc, TEST_INPUT_SIZE, outputSize, {}, errorMsg)) {
+		errors.push_back(fmt::format("初始化失败: {}", errorMsg));
+		return;
+	}
+
+	// 1. 纯色
+	{
+		const float4 color(ToUnorm8(0.25f), ToUnorm8(0.5f), ToUnorm8(0.75f), 1.0f);
+		FillSolidImage(executor.Input(), color);
+		executor.Execute(threadCount);
+
+		float maxDiff = 0;
+		for (const float4& pixel : executor.Output().Pixels()) {
+			maxDiff = std::max(maxDiff, MaxRgbDiff(pixel, color));
+		}
+		if (!(maxDiff <= 1.5f / 255)) {
+			errors.push_back(fmt::format("纯色输入的输出偏差 {:.1f}/255", maxDiff * 255));
+		}
+	}
+
+	// 2. 原尺寸
+	if (testCase.isInterpolation) {
+		CpuEffectExecutor identityExecutor;
+		if (identityExecutor.Initialize(desc, TEST_INPUT_SIZE, TEST_INPUT_SIZE, {}, errorMsg)) {
+			FillTestImage(identityExecutor.Input());
+			identityExecutor.Execute(threadCount);
+
+			float maxDiff = 0;
+			for (size_t i = 0; i < identityExecutor.Output().Pixels().size(); ++i) {
+				maxDiff = std::max(maxDiff, MaxRgbDiff(identityExecutor.Output().Pixels()[i], identityExecutor.Input().Pixels()[i]));
+			}
+			if (!(maxDiff <= 1.5f / 255)) {
+				errors.push_back(fmt::format("原尺寸的输出和输入相差 {:.1f}/255", maxDiff * 255));
+			}
+		} else {
+			errors.push_back(fmt::format("以原尺寸初始化失败: {}", errorMsg));
+		}
+	}
+
+	// 3. 单线程和多线程
+	FillTestImage(executor.Input());
+	executor.Execute(1);
+	const std::vector<float4> singleThreaded(executor.Output().Pixels().begin(), executor.Output().Pixels().end());
+
+	executor.Execute(threadCount);
+	const auto pixels = executor.Output().Pixels();
+	if (!std::equal(pixels.begin(), pixels.end(), singleThreaded.begin(), singleThreaded.end(),
+		[](const float4& l, const float4& r) { return std::memcmp(&l, &r, sizeof(float4)) == 0; })) {
+		errors.push_back(fmt::format("{} 个线程的结果和单线程不同", threadCount));
+	}
+
+	resultSize = { (long)executor.Output().Width(), (long)executor.Output().Height() };
+	result = ToRgb8(executor.Output());
+}
+
+static void MeasureEffect(const EffectDesc& desc, const TestCase& testCase, Size inputSize, uint32_t threadCount) {
+	const Size outputSize = ScaleSize(inputSize, testCase.scale);
+
+	std::string errorMsg;
+	CpuEffectExecutor executor;
+	if (!executor.Initialize(desc, inputSize, outputSize, {}, errorMsg)) {
+		return;
+	}
+	FillTestImage(executor.Input());
+
+	auto measure = [&](uint32_t threads) {
+		// 先执行一次预热
+		executor.Execute(threads);
+
+		static constexpr uint32_t REPEAT = 3;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < REPEAT; ++i) {
+			executor.Execute(threads);
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEAT;
+	};
+
+	const double singleMs = measure(1);
+	const double multiMs = threadCount > 1 ? measure(threadCount) : singleMs;
+	const double megaPixels = (double)executor.Output().Width() * executor.Output().Height() / 1e6;
+
+	fmt::print("{:<16} {:>5}x{:<5} {:>10.2f} {:>10.2f} {:>10.1f}\n", desc.name, executor.Output().Width(),
+		executor.Output().Height(), singleMs, multiMs, megaPixels / (multiMs / 1000));
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fmt::print(stderr, "用法: {} <效果目录> [-d 快照目录] [-u] [-t 线程数] [-s 宽x高]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+	std::filesystem::path snapshotDir = MAGPIEFX_CPUREF_SNAPSHOT_DIR;
+	bool isUpdate = false;
+	// 单核机器上也使用多个线程，以检查分块执行的结果和单线程相同
+	uint32_t threadCount = std::max(4u, std::thread::hardware_concurrency());
+	Size benchInputSize = { 480, 270 };
+	for (int i = 2; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-d") {
+			snapshotDir = argv[++i];
+		} else if (arg == "-u") {
+			isUpdate = true;
+		} else if (i + 1 < argc && arg == "-t") {
+			threadCount = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-s") {
+			if (std::sscanf(argv[++i], "%ldx%ld", &benchInputSize.cx, &benchInputSize.cy) != 2
+				|| benchInputSize.cx <= 0 || benchInputSize.cy <= 0) {
+				fmt::print(stderr, "尺寸不合法\n");
+				return 1;
+			}
+		} else {
+			fmt::print(stderr, "未知参数 {}\n", arg);
+			return 1;
+		}
+	}
+
+	std::vector<EffectDesc> descs(std::size(TEST_CASES));
+	uint32_t failedCount = 0;
+
+	for (size_t i = 0; i < std::size(TEST_CASES); ++i) {
+		const TestCase& testCase = TEST_CASES[i];
+		EffectDesc& desc = descs[i];
+
+		std::vector<std::string> errors;
+		Size resultSize{};
+		std::vector<uint8_t> result;
+
+		// 0. 源码
+		{
+			std::string relPath = std::string(testCase.effectName) + ".hlsl";
+			std::replace(relPath.begin(), relPath.end(), '\\', '/');
+
+			std::string source;
+			if (ReadFile(effectsDir / relPath, source)) {
+				const uint64_t sourceHash = EffectBundle::HashText(source);
+				if (sourceHash != testCase.sourceHash) {
+					errors.push_back(fmt::format("HLSL 已修改 (0x{:016x})，需同步修改移植的实现", sourceHash));
+				}
+			}
+		}
+
+		if (!ParseEffectFile(effectsDir, testCase.effectName, desc)) {
+			errors.push_back("解析失败");
+		} else {
+			TestEffect(desc, testCase, threadCount, resultSize, result, errors);
+		}
+
+		// 4. 快照
+		const std::filesystem::path snapshotPath = GetSnapshotPath(snapshotDir, testCase.effectName);
+		std::string snapshotStatus;
+		if (!errors.empty()) {
+			// 未通过其他检查时不更新快照
+		} else if (isUpdate) {
+			std::error_code ec;
+			std::filesystem::create_directories(snapshotDir, ec);
+			if (WritePPM(snapshotPath, resultSize, result)) {
+				snapshotStatus = "，已更新快照";
+			} else {
+				errors.push_back(fmt::format("写入 {} 失败", snapshotPath.string()));
+			}
+		} else {
+			Size snapshotSize{};
+			std::vector<uint8_t> snapshot;
+			if (!ReadPPM(snapshotPath, snapshotSize, snapshot)) {
+				errors.push_back(fmt::format("读取 {} 失败", snapshotPath.string()));
+			} else if (snapshotSize.cx != resultSize.cx || snapshotSize.cy != resultSize.cy) {
+				errors.push_back("输出尺寸和快照不同");
+			} else {
+				int maxDiff = 0;
+				uint32_t diffCount = 0;
+				for (size_t j = 0; j < result.size(); ++j) {
+					const int diff = std::abs((int)result[j] - (int)snapshot[j]);
+					maxDiff = std::max(maxDiff, diff);
+					diffCount += diff > 1;
+				}
+
+				if (diffCount > 0) {
+					errors.push_back(fmt::format("{} 个分量和快照相差超过 1，最大相差 {}", diffCount, maxDiff));
+				} else {
+					snapshotStatus = maxDiff == 0 ? "，和快照逐位相同" : "，和快照最多相差 1";
+				}
+			}
+		}
+
+		if (errors.empty()) {
+			fmt::print("{:<16} 通过{}\n", testCase.effectName, snapshotStatus);
+		} else {
+			++failedCount;
+			for (const std::string& error : errors) {
+				fmt::print(stderr, "{:<16} {}\n", testCase.effectName, error);
+			}
+		}
+	}
+
+	fmt::print("\n输入 {}x{}，单线程和 {} 个线程的耗时 (ms)\n", benchInputSize.cx, benchInputSize.cy, threadCount);
+	fmt::print("{:<16} {:>11} {:>10} {:>10} {:>10}\n", "效果", "输出", "单线程", "多线程", "MP/s");
+	for (size_t i = 0; i < std::size(TEST_CASES); ++i) {
+		if (!descs[i].passes.empty()) {
+			MeasureEffect(descs[i], TEST_CASES[i], benchInputSize, threadCount);
+		}
+	}
+
+	fmt::print("\n{}/{} 个效果通过\n", std::size(TEST_CASES) - failedCount, std::size(TEST_CASES));
+	return failedCount == 0 ? 0 : 1;
+}
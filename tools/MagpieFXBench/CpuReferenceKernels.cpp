@@ -0,0 +1,631 @@
+// 常用效果的 C++ 实现，逐行对照 src/Effects 中的 HLSL 移植。修改 HLSL 时应同步修改这里，
+// 否则结果将和 GPU 上的不一致，magpiefx-cpuref-bench 的快照无法发现这一点。
+// 只实现 FP32 路径，MP_FP16 时 GPU 上的结果精度略低
+
+#include "pch.h"
+#include "CpuReference.h"
+#include <cmath>
+
+namespace CpuReference {
+
+// 和生成的着色器中的 Rmp8x8 相同，把 64 个线程映射到 8x8 的像素
+static uint2 Rmp8x8(uint32_t a) {
+	const uint32_t bfe = (a >> 3) & 7;
+	return { (a >> 1) & 7, (bfe & ~1u) | (a & 1) };
+}
+
+static float3 Rgb(const float4& v) {
+	return v.rgb();
+}
+
+static void StoreIfInside(const CpuPassContext& ctx, uint2 gxy, const float3& color) {
+	if (gxy.x < ctx.outputSize.x && gxy.y < ctx.outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(color, 1));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bilinear.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float4 BilinearPass1(const CpuPassContext& ctx, float2 pos) {
+	return ctx.inputs[0]->SampleLevel(ctx.Sampler(0), pos);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bicubic.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float BicubicWeight(float x, float B, float C) {
+	const float ax = abs(x);
+
+	if (ax < 1.0f) {
+		return (x * x * ((12.0f - 9.0f * B - 6.0f * C) * ax + (-18.0f + 12.0f * B + 6.0f * C)) + (6.0f - 2.0f * B)) / 6.0f;
+	} else if (ax >= 1.0f && ax < 2.0f) {
+		return (x * x * ((-B - 6.0f * C) * ax + (6.0f * B + 30.0f * C)) + (-12.0f * B - 48.0f * C) * ax + (8.0f * B + 24.0f * C)) / 6.0f;
+	} else {
+		return 0.0f;
+	}
+}
+
+static float4 BicubicWeight4(float x, float B, float C) {
+	return float4(
+		BicubicWeight(x - 2.0f, B, C),
+		BicubicWeight(x - 1.0f, B, C),
+		BicubicWeight(x, B, C),
+		BicubicWeight(x + 1.0f, B, C)
+	);
+}
+
+static float4 BicubicPass1(const CpuPassContext& ctx, float2 pos) {
+	const CpuTexture& INPUT = *ctx.inputs[0];
+	const auto& sam = ctx.Sampler(0);
+	const float B = ctx.params[0];
+	const float C = ctx.params[1];
+	const float2 inputPt = ctx.inputPt;
+	const float2 inputSize((float)ctx.inputSize.x, (float)ctx.inputSize.y);
+
+	pos *= inputSize;
+	const float2 pos1 = floor(pos - 0.5f) + 0.5f;
+	const float2 f = pos - pos1;
+
+	float4 rowtaps = BicubicWeight4(1 - f.x, B, C);
+	float4 coltaps = BicubicWeight4(1 - f.y, B, C);
+
+	rowtaps /= rowtaps.x + rowtaps.y + rowtaps.z + rowtaps.w;
+	coltaps /= coltaps.x + coltaps.y + coltaps.z + coltaps.w;
+
+	const float2 uv1 = pos1 * inputPt;
+	const float2 uv0 = uv1 - inputPt;
+	const float2 uv2 = uv1 + inputPt;
+	const float2 uv3 = uv2 + inputPt;
+
+	const float u_weight_sum = rowtaps.y + rowtaps.z;
+	const float u_middle_offset = rowtaps.z * inputPt.x / u_weight_sum;
+	const float u_middle = uv1.x + u_middle_offset;
+
+	const float v_weight_sum = coltaps.y + coltaps.z;
+	const float v_middle_offset = coltaps.z * inputPt.y / v_weight_sum;
+	const float v_middle = uv1.y + v_middle_offset;
+
+	// int2 向零取整
+	const float2 topLeft = max(uv0 * inputSize, float2(0.5f));
+	const float2 bottomRight = min(uv3 * inputSize, inputSize - 0.5f);
+	const int left = (int)topLeft.x, top_ = (int)topLeft.y;
+	const int right = (int)bottomRight.x, bottom_ = (int)bottomRight.y;
+
+	float3 top = Rgb(INPUT.Load(left, top_)) * rowtaps.x;
+	top += Rgb(INPUT.SampleLevel(sam, float2(u_middle, uv0.y))) * u_weight_sum;
+	top += Rgb(INPUT.Load(right, top_)) * rowtaps.w;
+	float3 total = top * coltaps.x;
+
+	float3 middle = Rgb(INPUT.SampleLevel(sam, float2(uv0.x, v_middle))) * rowtaps.x;
+	middle += Rgb(INPUT.SampleLevel(sam, float2(u_middle, v_middle))) * u_weight_sum;
+	middle += Rgb(INPUT.SampleLevel(sam, float2(uv3.x, v_middle))) * rowtaps.w;
+	total += middle * v_weight_sum;
+
+	float3 bottom = Rgb(INPUT.Load(left, bottom_)) * rowtaps.x;
+	bottom += Rgb(INPUT.SampleLevel(sam, float2(u_middle, uv3.y))) * u_weight_sum;
+	bottom += Rgb(INPUT.Load(right, bottom_)) * rowtaps.w;
+	total += bottom * coltaps.w;
+
+	return float4(total, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lanczos.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float3 LanczosWeight3(float x) {
+	static constexpr float PI = 3.14159265359f;
+	const float rcpRadius = 1.0f / 3.0f;
+	// FIX(c) max(abs(c), 1e-5)
+	const float3 s = max(abs(2.0f * PI * float3(x - 1.5f, x - 0.5f, x + 0.5f)), float3(1e-5f));
+	return sin(s) * sin(s * rcpRadius) * rcp(s * s);
+}
+
+// mul(float3, float3x3)，矩阵的三行为 r0、r1、r2
+static float3 Mul(const float3& v, const float3& r0, const float3& r1, const float3& r2) {
+	return r0 * v.x + r1 * v.y + r2 * v.z;
+}
+
+static float4 LanczosPass1(const CpuPassContext& ctx, float2 pos) {
+	const CpuTexture& INPUT = *ctx.inputs[0];
+	const auto& sam = ctx.Sampler(0);
+	const float ARStrength = ctx.params[0];
+
+	pos *= float2((float)ctx.inputSize.x, (float)ctx.inputSize.y);
+	const float2 inputPt = ctx.inputPt;
+
+	const float2 f = frac(pos + 0.5f);
+	float3 linetaps1 = LanczosWeight3(0.5f - f.x * 0.5f);
+	float3 linetaps2 = LanczosWeight3(1.0f - f.x * 0.5f);
+	float3 columntaps1 = LanczosWeight3(0.5f - f.y * 0.5f);
+	float3 columntaps2 = LanczosWeight3(1.0f - f.y * 0.5f);
+
+	const float suml = dot(linetaps1, float3(1)) + dot(linetaps2, float3(1));
+	const float sumc = dot(columntaps1, float3(1)) + dot(columntaps2, float3(1));
+	linetaps1 /= suml;
+	linetaps2 /= suml;
+	columntaps1 /= sumc;
+	columntaps2 /= sumc;
+
+	pos -= f + 1.5f;
+
+	float3 src[6][6];
+	for (uint32_t i = 0; i <= 4; i += 2) {
+		for (uint32_t j = 0; j <= 4; j += 2) {
+			const float2 tpos = (pos + float2((float)i, (float)j)) * inputPt;
+			const float4 sr = INPUT.Gather(sam, tpos, 0);
+			const float4 sg = INPUT.Gather(sam, tpos, 1);
+			const float4 sb = INPUT.Gather(sam, tpos, 2);
+
+			// w z
+			// x y
+			src[i][j] = float3(sr.w, sg.w, sb.w);
+			src[i][j + 1] = float3(sr.x, sg.x, sb.x);
+			src[i + 1][j] = float3(sr.z, sg.z, sb.z);
+			src[i + 1][j + 1] = float3(sr.y, sg.y, sb.y);
+		}
+	}
+
+	float3 color(0);
+	for (uint32_t i = 0; i <= 4; i += 2) {
+		color += (Mul(linetaps1, src[0][i], src[2][i], src[4][i]) + Mul(linetaps2, src[1][i], src[3][i], src[5][i])) * columntaps1[i / 2]
+			+ (Mul(linetaps1, src[0][i + 1], src[2][i + 1], src[4][i + 1]) + Mul(linetaps2, src[1][i + 1], src[3][i + 1], src[5][i + 1])) * columntaps2[i / 2];
+	}
+
+	// 抗振铃
+	const float3 min_sample = min(min(src[2][2], src[3][2]), min(src[2][3], src[3][3]));
+	const float3 max_sample = max(max(src[2][2], src[3][2]), max(src[2][3], src[3][3]));
+	color = lerp(color, clamp(color, min_sample, max_sample), ARStrength);
+
+	return float4(color, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CAS\CAS.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float min3(float a, float b, float c) { return min(a, min(b, c)); }
+static float max3(float a, float b, float c) { return max(a, max(b, c)); }
+
+static float3 CasFilter(const float3 (&src)[4][4], uint2 pos, float peak) {
+	// a b c
+	// d e f
+	// g h i
+	const float3& b = src[pos.x][pos.y - 1];
+	const float3& d = src[pos.x - 1][pos.y];
+	const float3& e = src[pos.x][pos.y];
+	const float3& f = src[pos.x + 1][pos.y];
+	const float3& h = src[pos.x][pos.y + 1];
+
+	// Soft min and max.
+	const float mnR = min3(min3(d.x, e.x, f.x), b.x, h.x);
+	const float mnG = min3(min3(d.y, e.y, f.y), b.y, h.y);
+	const float mnB = min3(min3(d.z, e.z, f.z), b.z, h.z);
+	const float mxR = max3(max3(d.x, e.x, f.x), b.x, h.x);
+	const float mxG = max3(max3(d.y, e.y, f.y), b.y, h.y);
+	const float mxB = max3(max3(d.z, e.z, f.z), b.z, h.z);
+
+	// Smooth minimum distance to signal limit divided by smooth max.
+	const float rcpMR = rcp(mxR);
+	const float rcpMG = rcp(mxG);
+	const float rcpMB = rcp(mxB);
+
+	float ampR = saturate(min(mnR, 1.0f - mxR) * rcpMR);
+	float ampG = saturate(min(mnG, 1.0f - mxG) * rcpMG);
+	float ampB = saturate(min(mnB, 1.0f - mxB) * rcpMB);
+
+	// Shaping amount of sharpening.
+	ampR = sqrt(ampR);
+	ampG = sqrt(ampG);
+	ampB = sqrt(ampB);
+
+	// Filter shape. 只使用绿色通道的系数
+	const float wG = ampG * peak;
+	const float rcpWeight = rcp(1.0f + 4.0f * wG);
+
+	return float3(
+		saturate((b.x * wG + d.x * wG + f.x * wG + h.x * wG + e.x) * rcpWeight),
+		saturate((b.y * wG + d.y * wG + f.y * wG + h.y * wG + e.y) * rcpWeight),
+		saturate((b.z * wG + d.z * wG + f.z * wG + h.z * wG + e.z) * rcpWeight)
+	);
+}
+
+static void CasPass1(const CpuPassContext& ctx, uint2 blockStart, uint3 threadId) {
+	const uint2 rmp = Rmp8x8(threadId.x);
+	uint2 gxy{ blockStart.x + (rmp.x << 1), blockStart.y + (rmp.y << 1) };
+
+	if (gxy.x >= ctx.outputSize.x || gxy.y >= ctx.outputSize.y) {
+		return;
+	}
+
+	const CpuTexture& INPUT = *ctx.inputs[0];
+	const auto& sam = ctx.Sampler(0);
+	const float2 inputPt = ctx.inputPt;
+
+	float3 src[4][4];
+	for (uint32_t i = 0; i < 3; i += 2) {
+		for (uint32_t j = 0; j < 3; j += 2) {
+			const float2 tpos = float2((float)(gxy.x + i), (float)(gxy.y + j)) * inputPt;
+			const float4 sr = INPUT.Gather(sam, tpos, 0);
+			const float4 sg = INPUT.Gather(sam, tpos, 1);
+			const float4 sb = INPUT.Gather(sam, tpos, 2);
+
+			// w z
+			// x y
+			src[i][j] = float3(sr.w, sg.w, sb.w);
+			src[i][j + 1] = float3(sr.x, sg.x, sb.x);
+			src[i + 1][j] = float3(sr.z, sg.z, sb.z);
+			src[i + 1][j + 1] = float3(sr.y, sg.y, sb.y);
+		}
+	}
+
+	const float peak = -rcp(lerp(8.0f, 5.0f, ctx.params[0]));
+
+	// 和 HLSL 不同，这里检查每个像素是否越界。GPU 上越界的写入会被丢弃
+	StoreIfInside(ctx, gxy, CasFilter(src, { 1, 1 }, peak));
+
+	++gxy.x;
+	StoreIfInside(ctx, gxy, CasFilter(src, { 2, 1 }, peak));
+
+	++gxy.y;
+	StoreIfInside(ctx, gxy, CasFilter(src, { 2, 2 }, peak));
+
+	--gxy.x;
+	StoreIfInside(ctx, gxy, CasFilter(src, { 1, 2 }, peak));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FSR\FSR_EASU.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Filtering for a given tap for the scalar.
+static void FsrEasuTap(
+	float3& aC,
+	float& aW,
+	float2 off,
+	float2 dir,
+	float2 len,
+	float lob,
+	float clp,
+	const float3& c
+) {
+	// Rotate offset by direction.
+	float2 v;
+	v.x = (off.x * (dir.x)) + (off.y * dir.y);
+	v.y = (off.x * (-dir.y)) + (off.y * dir.x);
+	// Anisotropy.
+	v *= len;
+	// Compute distance^2.
+	float d2 = v.x * v.x + v.y * v.y;
+	// Limit to the window as at corner, 2 taps can easily be outside.
+	d2 = min(d2, clp);
+	// Approximation of lanczos2 without sin() or rcp(), or sqrt() to get x.
+	float wB = 2.0f / 5.0f * d2 - 1;
+	float wA = lob * d2 - 1;
+	wB *= wB;
+	wA *= wA;
+	wB = 25.0f / 16.0f * wB - (25.0f / 16.0f - 1.0f);
+	const float w = wB * wA;
+	// Do weighted average.
+	aC += c * w;
+	aW += w;
+}
+
+// Accumulate direction and length. biS 等四个参数中只有一个为 true
+static void FsrEasuSet(
+	float2& dir,
+	float& len,
+	float2 pp,
+	bool biS, bool biT, bool biU, bool biV,
+	float lA, float lB, float lC, float lD, float lE
+) {
+	float w = 0;
+	if (biS)
+		w = (1 - pp.x) * (1 - pp.y);
+	if (biT)
+		w = pp.x * (1 - pp.y);
+	if (biU)
+		w = (1.0f - pp.x) * pp.y;
+	if (biV)
+		w = pp.x * pp.y;
+
+	const float dc = lD - lC;
+	const float cb = lC - lB;
+	float lenX = max(abs(dc), abs(cb));
+	lenX = rcp(lenX);
+	const float dirX = lD - lB;
+	dir.x += dirX * w;
+	lenX = saturate(abs(dirX) * lenX);
+	lenX *= lenX;
+	len += lenX * w;
+	// Repeat for the y axis.
+	const float ec = lE - lC;
+	const float ca = lC - lA;
+	float lenY = max(abs(ec), abs(ca));
+	lenY = rcp(lenY);
+	const float dirY = lE - lA;
+	dir.y += dirY * w;
+	lenY = saturate(abs(dirY) * lenY);
+	lenY *= lenY;
+	len += lenY * w;
+}
+
+struct FsrEasuConstants {
+	float4 con0, con1, con2;
+	float2 con3;
+};
+
+static float3 FsrEasuF(const CpuPassContext& ctx, uint2 pos, const FsrEasuConstants& con) {
+	const CpuTexture& INPUT = *ctx.inputs[0];
+	const auto& sam = ctx.Sampler(0);
+
+	// Get position of 'f'.
+	float2 pp = float2((float)pos.x * con.con0.x + con.con0.z, (float)pos.y * con.con0.y + con.con0.w);
+	const float2 fp = floor(pp);
+	pp -= fp;
+
+	// 12-tap kernel.
+	//    b c
+	//  e f g h
+	//  i j k l
+	//    n o
+	const float2 p0 = fp * float2(con.con1.x, con.con1.y) + float2(con.con1.z, con.con1.w);
+	const float2 p1 = p0 + float2(con.con2.x, con.con2.y);
+	const float2 p2 = p0 + float2(con.con2.z, con.con2.w);
+	const float2 p3 = p0 + con.con3;
+
+	const float4 bczzR = INPUT.Gather(sam, p0, 0);
+	const float4 bczzG = INPUT.Gather(sam, p0, 1);
+	const float4 bczzB = INPUT.Gather(sam, p0, 2);
+	const float4 ijfeR = INPUT.Gather(sam, p1, 0);
+	const float4 ijfeG = INPUT.Gather(sam, p1, 1);
+	const float4 ijfeB = INPUT.Gather(sam, p1, 2);
+	const float4 klhgR = INPUT.Gather(sam, p2, 0);
+	const float4 klhgG = INPUT.Gather(sam, p2, 1);
+	const float4 klhgB = INPUT.Gather(sam, p2, 2);
+	const float4 zzonR = INPUT.Gather(sam, p3, 0);
+	const float4 zzonG = INPUT.Gather(sam, p3, 1);
+	const float4 zzonB = INPUT.Gather(sam, p3, 2);
+
+	// Simplest multi-channel approximate luma possible (luma times 2, in 2 FMA/MAD).
+	const float4 bczzL = bczzB * 0.5f + (bczzR * 0.5f + bczzG);
+	const float4 ijfeL = ijfeB * 0.5f + (ijfeR * 0.5f + ijfeG);
+	const float4 klhgL = klhgB * 0.5f + (klhgR * 0.5f + klhgG);
+	const float4 zzonL = zzonB * 0.5f + (zzonR * 0.5f + zzonG);
+	// Rename.
+	const float bL = bczzL.x;
+	const float cL = bczzL.y;
+	const float iL = ijfeL.x;
+	const float jL = ijfeL.y;
+	const float fL = ijfeL.z;
+	const float eL = ijfeL.w;
+	const float kL = klhgL.x;
+	const float lL = klhgL.y;
+	const float hL = klhgL.z;
+	const float gL = klhgL.w;
+	const float oL = zzonL.z;
+	const float nL = zzonL.w;
+	// Accumulate for bilinear interpolation.
+	float2 dir(0);
+	float len = 0;
+	FsrEasuSet(dir, len, pp, true, false, false, false, bL, eL, fL, gL, jL);
+	FsrEasuSet(dir, len, pp, false, true, false, false, cL, fL, gL, hL, kL);
+	FsrEasuSet(dir, len, pp, false, false, true, false, fL, iL, jL, kL, nL);
+	FsrEasuSet(dir, len, pp, false, false, false, true, gL, jL, kL, lL, oL);
+
+	// Normalize with approximation, and cleanup close to zero.
+	const float2 dir2 = dir * dir;
+	float dirR = dir2.x + dir2.y;
+	const bool zro = dirR < 1.0f / 32768.0f;
+	dirR = rsqrt(dirR);
+	dirR = zro ? 1 : dirR;
+	dir.x = zro ? 1 : dir.x;
+	dir *= dirR;
+	// Transform from {0 to 2} to {0 to 1} range, and shape with square.
+	len = len * 0.5f;
+	len *= len;
+	// Stretch kernel {1.0 vert|horz, to sqrt(2.0) on diagonal}.
+	const float stretch = (dir.x * dir.x + dir.y * dir.y) * rcp(max(abs(dir.x), abs(dir.y)));
+	// Anisotropic length after rotation.
+	const float2 len2(1 + (stretch - 1) * len, 1 - 0.5f * len);
+	// Based on the amount of 'edge', the window shifts from +/-{sqrt(2.0) to slightly beyond 2.0}.
+	const float lob = 0.5f + ((1.0f / 4.0f - 0.04f) - 0.5f) * len;
+	// Set distance^2 clipping point to the end of the adjustable window.
+	const float clp = rcp(lob);
+
+	// Accumulation mixed with min/max of 4 nearest.
+	const float3 min4 = min(min(float3(ijfeR.z, ijfeG.z, ijfeB.z), min(float3(klhgR.w, klhgG.w, klhgB.w),
+		float3(ijfeR.y, ijfeG.y, ijfeB.y))), float3(klhgR.x, klhgG.x, klhgB.x));
+	const float3 max4 = max(max(float3(ijfeR.z, ijfeG.z, ijfeB.z), max(float3(klhgR.w, klhgG.w, klhgB.w),
+		float3(ijfeR.y, ijfeG.y, ijfeB.y))), float3(klhgR.x, klhgG.x, klhgB.x));
+	// Accumulation.
+	float3 aC(0);
+	float aW = 0;
+	FsrEasuTap(aC, aW, float2(0.0f, -1.0f) - pp, dir, len2, lob, clp, float3(bczzR.x, bczzG.x, bczzB.x)); // b
+	FsrEasuTap(aC, aW, float2(1.0f, -1.0f) - pp, dir, len2, lob, clp, float3(bczzR.y, bczzG.y, bczzB.y)); // c
+	FsrEasuTap(aC, aW, float2(-1.0f, 1.0f) - pp, dir, len2, lob, clp, float3(ijfeR.x, ijfeG.x, ijfeB.x)); // i
+	FsrEasuTap(aC, aW, float2(0.0f, 1.0f) - pp, dir, len2, lob, clp, float3(ijfeR.y, ijfeG.y, ijfeB.y)); // j
+	FsrEasuTap(aC, aW, float2(0.0f, 0.0f) - pp, dir, len2, lob, clp, float3(ijfeR.z, ijfeG.z, ijfeB.z)); // f
+	FsrEasuTap(aC, aW, float2(-1.0f, 0.0f) - pp, dir, len2, lob, clp, float3(ijfeR.w, ijfeG.w, ijfeB.w)); // e
+	FsrEasuTap(aC, aW, float2(1.0f, 1.0f) - pp, dir, len2, lob, clp, float3(klhgR.x, klhgG.x, klhgB.x)); // k
+	FsrEasuTap(aC, aW, float2(2.0f, 1.0f) - pp, dir, len2, lob, clp, float3(klhgR.y, klhgG.y, klhgB.y)); // l
+	FsrEasuTap(aC, aW, float2(2.0f, 0.0f) - pp, dir, len2, lob, clp, float3(klhgR.z, klhgG.z, klhgB.z)); // h
+	FsrEasuTap(aC, aW, float2(1.0f, 0.0f) - pp, dir, len2, lob, clp, float3(klhgR.w, klhgG.w, klhgB.w)); // g
+	FsrEasuTap(aC, aW, float2(1.0f, 2.0f) - pp, dir, len2, lob, clp, float3(zzonR.z, zzonG.z, zzonB.z)); // o
+	FsrEasuTap(aC, aW, float2(0.0f, 2.0f) - pp, dir, len2, lob, clp, float3(zzonR.w, zzonG.w, zzonB.w)); // n
+
+	// Normalize and dering.
+	return min(max4, max(min4, aC * rcp(aW)));
+}
+
+static void FsrEasuPass1(const CpuPassContext& ctx, uint2 blockStart, uint3 threadId) {
+	const uint2 rmp = Rmp8x8(threadId.x);
+	uint2 gxy{ blockStart.x + rmp.x, blockStart.y + rmp.y };
+
+	const uint2 outputSize = ctx.outputSize;
+	if (gxy.x >= outputSize.x || gxy.y >= outputSize.y) {
+		return;
+	}
+
+	const uint2 inputSize = ctx.inputSize;
+	const float2 inputPt = ctx.inputPt;
+
+	FsrEasuConstants con;
+	// Output integer position to a pixel position in viewport.
+	con.con0[0] = (float)inputSize.x / (float)outputSize.x;
+	con.con0[1] = (float)inputSize.y / (float)outputSize.y;
+	con.con0[2] = 0.5f * con.con0[0] - 0.5f;
+	con.con0[3] = 0.5f * con.con0[1] - 0.5f;
+	// Viewport pixel position to normalized image space.
+	con.con1[0] = inputPt.x;
+	con.con1[1] = inputPt.y;
+	// Centers of gather4, first offset from upper-left of 'F'.
+	con.con1[2] = inputPt.x;
+	con.con1[3] = -inputPt.y;
+	// These are from (0) instead of 'F'.
+	con.con2[0] = -inputPt.x;
+	con.con2[1] = 2.0f * inputPt.y;
+	con.con2[2] = inputPt.x;
+	con.con2[3] = 2.0f * inputPt.y;
+	con.con3[0] = 0;
+	con.con3[1] = 4.0f * inputPt.y;
+
+	ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrEasuF(ctx, gxy, con), 1));
+
+	gxy.x += 8u;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrEasuF(ctx, gxy, con), 1));
+	}
+
+	gxy.y += 8u;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrEasuF(ctx, gxy, con), 1));
+	}
+
+	gxy.x -= 8u;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrEasuF(ctx, gxy, con), 1));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FSR\FSR_RCAS.hlsl
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// This is set at the limit of providing unnatural results for sharpening.
+static constexpr float FSR_RCAS_LIMIT = 0.25f - (1.0f / 16.0f);
+
+static float3 FsrRcasF(const float3& b, const float3& d, const float3& e, const float3& f, const float3& h, float sharpness) {
+	// Algorithm uses minimal 3x3 pixel neighborhood.
+	//    b
+	//  d e f
+	//    h
+	const float bR = b.x, bG = b.y, bB = b.z;
+	const float dR = d.x, dG = d.y, dB = d.z;
+	const float eR = e.x, eG = e.y, eB = e.z;
+	const float fR = f.x, fG = f.y, fB = f.z;
+	const float hR = h.x, hG = h.y, hB = h.z;
+
+	// Luma times 2.
+	const float bL = bB * 0.5f + (bR * 0.5f + bG);
+	const float dL = dB * 0.5f + (dR * 0.5f + dG);
+	const float eL = eB * 0.5f + (eR * 0.5f + eG);
+	const float fL = fB * 0.5f + (fR * 0.5f + fG);
+	const float hL = hB * 0.5f + (hR * 0.5f + hG);
+
+	// Noise detection.
+	float nz = 0.25f * bL + 0.25f * dL + 0.25f * fL + 0.25f * hL - eL;
+	nz = saturate(abs(nz) * rcp(max3(max3(bL, dL, eL), fL, hL) - min3(min3(bL, dL, eL), fL, hL)));
+	nz = -0.5f * nz + 1.0f;
+
+	// Min and max of ring.
+	const float mn4R = min(min3(bR, dR, fR), hR);
+	const float mn4G = min(min3(bG, dG, fG), hG);
+	const float mn4B = min(min3(bB, dB, fB), hB);
+	const float mx4R = max(max3(bR, dR, fR), hR);
+	const float mx4G = max(max3(bG, dG, fG), hG);
+	const float mx4B = max(max3(bB, dB, fB), hB);
+	// Immediate constants for peak range.
+	const float2 peakC(1.0f, -1.0f * 4.0f);
+	// Limiters, these need to be high precision RCPs.
+	const float hitMinR = min(mn4R, eR) * rcp(4.0f * mx4R);
+	const float hitMinG = min(mn4G, eG) * rcp(4.0f * mx4G);
+	const float hitMinB = min(mn4B, eB) * rcp(4.0f * mx4B);
+	const float hitMaxR = (peakC.x - max(mx4R, eR)) * rcp(4.0f * mn4R + peakC.y);
+	const float hitMaxG = (peakC.x - max(mx4G, eG)) * rcp(4.0f * mn4G + peakC.y);
+	const float hitMaxB = (peakC.x - max(mx4B, eB)) * rcp(4.0f * mn4B + peakC.y);
+	const float lobeR = max(-hitMinR, hitMaxR);
+	const float lobeG = max(-hitMinG, hitMaxG);
+	const float lobeB = max(-hitMinB, hitMaxB);
+	float lobe = max(-FSR_RCAS_LIMIT, min(max3(lobeR, lobeG, lobeB), 0.0f)) * sharpness;
+
+	// Apply noise removal.
+	lobe *= nz;
+
+	// Resolve, which needs the medium precision rcp approximation to avoid visible tonality changes.
+	const float rcpL = rcp(4.0f * lobe + 1.0f);
+	return float3(
+		(lobe * bR + lobe * dR + lobe * hR + lobe * fR + eR) * rcpL,
+		(lobe * bG + lobe * dG + lobe * hG + lobe * fG + eG) * rcpL,
+		(lobe * bB + lobe * dB + lobe * hB + lobe * fB + eB) * rcpL
+	);
+}
+
+static void FsrRcasPass1(const CpuPassContext& ctx, uint2 blockStart, uint3 threadId) {
+	const uint2 rmp = Rmp8x8(threadId.x);
+	uint2 gxy{ blockStart.x + (rmp.x << 1), blockStart.y + (rmp.y << 1) };
+
+	const uint2 outputSize = ctx.outputSize;
+	if (gxy.x >= outputSize.x || gxy.y >= outputSize.y) {
+		return;
+	}
+
+	const CpuTexture& INPUT = *ctx.inputs[0];
+	const float sharpness = ctx.params[0];
+
+	float3 src[4][4];
+	for (uint32_t i = 1; i < 3; ++i) {
+		for (uint32_t j = 0; j < 4; ++j) {
+			src[i][j] = Rgb(INPUT.Load(gxy.x + i - 1, gxy.y + j - 1));
+		}
+	}
+
+	src[0][1] = Rgb(INPUT.Load(gxy.x - 1, gxy.y));
+	src[0][2] = Rgb(INPUT.Load(gxy.x - 1, gxy.y + 1));
+	src[3][1] = Rgb(INPUT.Load(gxy.x + 2, gxy.y));
+	src[3][2] = Rgb(INPUT.Load(gxy.x + 2, gxy.y + 1));
+
+	ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrRcasF(src[1][0], src[0][1], src[1][1], src[2][1], src[1][2], sharpness), 1));
+
+	++gxy.x;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrRcasF(src[2][0], src[1][1], src[2][1], src[3][1], src[2][2], sharpness), 1));
+	}
+
+	++gxy.y;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrRcasF(src[2][1], src[1][2], src[2][2], src[3][2], src[2][3], sharpness), 1));
+	}
+
+	--gxy.x;
+	if (gxy.x < outputSize.x && gxy.y < outputSize.y) {
+		ctx.outputs[0]->Store(gxy.x, gxy.y, float4(FsrRcasF(src[1][1], src[0][2], src[1][2], src[2][2], src[1][3], sharpness), 1));
+	}
+}
+
+const std::map<std::string, CpuEffectKernels, std::less<>>& GetKernels() noexcept {
+	static const std::map<std::string, CpuEffectKernels, std::less<>> kernels = {
+		{ "Bilinear", { {}, { { .ps = BilinearPass1 } } } },
+		{ "Bicubic", { { "paramB", "paramC" }, { { .ps = BicubicPass1 } } } },
+		{ "Lanczos", { { "ARStrength" }, { { .ps = LanczosPass1 } } } },
+		{ "CAS\\CAS", { { "sharpness" }, { { .cs = CasPass1 } } } },
+		{ "FSR\\FSR_EASU", { {}, { { .cs = FsrEasuPass1 } } } },
+		{ "FSR\\FSR_RCAS", { { "sharpness" }, { { .cs = FsrRcasPass1 } } } }
+	};
+	return kernels;
+}
+
+}
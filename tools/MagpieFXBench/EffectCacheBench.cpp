@@ -0,0 +1,150 @@
+// EffectCacheBench.cpp : 从多个线程并发读取效果的内存缓存，测量吞吐量
+//
+// 用法: magpiefx-cache-bench [-t 线程数] [-n 每个线程的查找次数]
+//
+// 同时测量旧的实现（独占锁下复制整个 EffectDesc）作为对比
+
+#include "pch.h"
+#include "EffectMemCache.h"
+
+using namespace Magpie::Core;
+
+// 模拟 Renderer 常见的效果链
+static constexpr uint32_t EFFECT_COUNT = 8;
+static constexpr uint32_t PASS_COUNT = 12;
+static constexpr uint32_t CSO_SIZE = 16 * 1024;
+
+static EffectDesc CreateDesc(uint32_t idx) {
+	EffectDesc desc;
+	desc.name = fmt::format("Effect{}", idx);
+
+	for (uint32_t i = 0; i < 8; ++i) {
+		EffectParameterDesc& param = desc.params.emplace_back();
+		param.name = fmt::format("param{}", i);
+		param.label = fmt::format("Parameter {}", i);
+		param.constant = EffectConstant<float>{ 0.5f, 0.0f, 1.0f, 0.01f };
+	}
+
+	for (uint32_t i = 0; i < PASS_COUNT; ++i) {
+		EffectIntermediateTextureDesc& texture = desc.textures.emplace_back();
+		texture.name = fmt::format("tex{}", i);
+		texture.sizeExpr = { "INPUT_WIDTH * 2", "INPUT_HEIGHT * 2" };
+		texture.format = EffectIntermediateTextureFormat::R16G16B16A16_FLOAT;
+	}
+
+	std::shared_ptr<uint8_t[]> cso = std::make_shared<uint8_t[]>(CSO_SIZE);
+	for (uint32_t i = 0; i < PASS_COUNT; ++i) {
+		EffectPassDesc& pass = desc.passes.emplace_back();
+		pass.cso = { cso.get(), CSO_SIZE };
+		pass.csoOwner = cso;
+		pass.inputs = { 0, i + 1 };
+		pass.outputs = { i + 2 };
+		pass.desc = fmt::format("Pass {}", i + 1);
+	}
+
+	return desc;
+}
+
+// 旧的实现: 独占锁下复制 EffectDesc
+class LegacyMemCache {
+public:
+	void Put(const std::wstring& key, const EffectDesc& desc) {
+		std::scoped_lock lock(_mutex);
+		_entries[key] = desc;
+	}
+
+	bool Get(const std::wstring& key, EffectDesc& desc) {
+		std::scoped_lock lock(_mutex);
+		auto it = _entries.find(key);
+		if (it == _entries.end()) {
+			return false;
+		}
+		desc = it->second;
+		return true;
+	}
+
+private:
+	std::mutex _mutex;
+	std::unordered_map<std::wstring, EffectDesc> _entries;
+};
+
+template<typename Fn>
+static double RunThreads(uint32_t threadCount, Fn&& fn) {
+	std::atomic<bool> start = false;
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back([&, i]() {
+			while (!start.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			fn(i);
+		});
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	start.store(true, std::memory_order_release);
+	for (std::thread& t : threads) {
+		t.join();
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t lookups = 100000;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string_view arg(argv[i]);
+		if (arg == "-t") {
+			threadCount = std::max(1, std::atoi(argv[i + 1]));
+		} else if (arg == "-n") {
+			lookups = std::max(1, std::atoi(argv[i + 1]));
+		}
+	}
+
+	std::vector<std::wstring> keys;
+	EffectMemCache memCache(256 * 1024 * 1024);
+	LegacyMemCache legacyCache;
+	for (uint32_t i = 0; i < EFFECT_COUNT; ++i) {
+		EffectDesc desc = CreateDesc(i);
+		keys.push_back(L"cache\\Effect" + std::to_wstring(i) + L"_0");
+		legacyCache.Put(keys.back(), desc);
+		memCache.Put(keys.back(), std::make_shared<const EffectDesc>(std::move(desc)));
+	}
+
+	fmt::print("{} 个线程，每个线程查找 {} 次\n", threadCount, lookups);
+
+	std::atomic<uint64_t> checksum = 0;
+
+	double legacyMs = RunThreads(threadCount, [&](uint32_t id) {
+		uint64_t sum = 0;
+		EffectDesc desc;
+		for (uint32_t i = 0; i < lookups; ++i) {
+			if (legacyCache.Get(keys[(id + i) % EFFECT_COUNT], desc)) {
+				sum += desc.passes.size();
+			}
+		}
+		checksum += sum;
+	});
+
+	double snapshotMs = RunThreads(threadCount, [&](uint32_t id) {
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < lookups; ++i) {
+			if (std::shared_ptr<const EffectDesc> desc = memCache.Get(keys[(id + i) % EFFECT_COUNT])) {
+				sum += desc->passes.size();
+			}
+		}
+		checksum += sum;
+	});
+
+	const double totalLookups = (double)threadCount * lookups;
+	fmt::print("{:<32} {:>10.1f} ms {:>12.0f} 次/秒\n", "独占锁 + 复制", legacyMs, totalLookups / legacyMs * 1000);
+	fmt::print("{:<32} {:>10.1f} ms {:>12.0f} 次/秒\n", "共享锁 + 快照", snapshotMs, totalLookups / snapshotMs * 1000);
+
+	if (checksum != 2 * (uint64_t)totalLookups * PASS_COUNT) {
+		fmt::print(stderr, "查找结果错误\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+// EffectFusionBench.cpp : 验证 EffectFusion 的逐像素检测和融合生成的源码
+//
+// 用法: magpiefx-fusion-bench <effects 文件夹> [效果...]
+//
+// 先用内置的小效果检查逐像素的检测：只在当前像素采样 INPUT 的效果是逐像素的，采样邻域、修改采样位置、
+// 在 COMMON 块中使用 INPUT、包含文件或改变尺寸的效果不是。然后把 effects 文件夹中每个可以作为第一个
+// 效果的效果和每个逐像素的效果融合，检查生成的源码能被解析、只有一个通道、参数和采样器齐全、结果是
+// 确定的，并能为各种编译选项生成 HLSL。指定效果时输出它们融合后的源码。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "EffectParser.h"
+#include "EffectFusion.h"
+#include "EffectDesc.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+static bool ParseEffect(std::string source, const std::string& name, EffectDesc& desc, std::string& errorMsg) {
+	desc = {};
+	desc.name = name;
+
+	EffectBlocks blocks;
+	if (EffectParser::RemoveComments(source, blocks) || EffectParser::SplitBlocks(source, blocks)) {
+		errorMsg = "划分块失败";
+		return false;
+	}
+
+	return !EffectParser::ResolveBlocks(blocks, desc, false, errorMsg);
+}
+
+static std::string MakeTestEffect(std::string_view outputSize, std::string_view common, std::string_view pass) {
+	std::string result = fmt::format(R"(//!MAGPIE EFFECT
+//!VERSION {}
+
+//!TEXTURE
+Texture2D INPUT;
+
+//!TEXTURE
+{}
+Texture2D OUTPUT;
+
+//!SAMPLER
+//!FILTER POINT
+SamplerState sam;
+
+)", EffectParser::MAGPIE_FX_VERSION, outputSize);
+
+	if (!common.empty()) {
+		result.append("//!COMMON\n").append(common).append("\n\n");
+	}
+
+	result.append("//!PASS 1\n//!STYLE PS\n//!IN INPUT\n//!OUT OUTPUT\n\n").append(pass).append("\n");
+	return result;
+}
+
+static bool RunDetectionTests() {
+	static constexpr std::string_view SAME_SIZE = "//!WIDTH INPUT_WIDTH\n//!HEIGHT INPUT_HEIGHT";
+
+	struct TestCase {
+		const char* name;
+		std::string_view outputSize;
+		std::string_view common;
+		std::string_view pass;
+		bool isPixelwise;
+	};
+	static const TestCase testCases[] = {
+		{ "SampleLevel", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos, 0); }", true },
+		{ "Sample", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { return INPUT.Sample(sam, pos); }", true },
+		{ "空白和分量", SAME_SIZE, "float3 Gray(float3 c) { return dot(c, 1.0 / 3); }",
+			"float4 Pass1( float2 uv ) {\n\tfloat3 c = INPUT . SampleLevel ( sam , uv , 0 ).rgb;\n"
+			"\tif (uv.x == 0.5) { c = Gray(c); }\n\treturn float4(c, 1);\n}", true },
+		{ "采样邻域", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos + GetInputPt(), 0); }", false },
+		{ "修改采样位置", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { pos.x += 0.1; return INPUT.SampleLevel(sam, pos, 0); }", false },
+		{ "自增采样位置", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { ++pos; return INPUT.SampleLevel(sam, pos, 0); }", false },
+		{ "非零 LOD", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos, 1); }", false },
+		{ "Load", SAME_SIZE, "",
+			"float4 Pass1(float2 pos) { return INPUT.Load(int3(pos * GetInputSize(), 0)); }", false },
+		{ "COMMON 中使用 INPUT", SAME_SIZE, "float4 Read(float2 pos) { return INPUT.SampleLevel(sam, pos, 0); }",
+			"float4 Pass1(float2 pos) { return Read(pos); }", false },
+		{ "包含文件", SAME_SIZE, "#include \"Common.hlsli\"",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos, 0); }", false },
+		{ "改变尺寸", "//!WIDTH INPUT_WIDTH * 2\n//!HEIGHT INPUT_HEIGHT * 2", "",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos, 0); }", false },
+		{ "可缩放", "", "",
+			"float4 Pass1(float2 pos) { return INPUT.SampleLevel(sam, pos, 0); }", false },
+	};
+
+	bool success = true;
+	for (const TestCase& testCase : testCases) {
+		EffectDesc desc;
+		std::string errorMsg;
+		if (!ParseEffect(MakeTestEffect(testCase.outputSize, testCase.common, testCase.pass),
+			testCase.name, desc, errorMsg)) {
+			fmt::print(stderr, "检测测试 {}: 解析失败: {}\n", testCase.name, errorMsg);
+			success = false;
+			continue;
+		}
+
+		const bool isPixelwise = desc.flags & EffectFlags::Pixelwise;
+		if (isPixelwise != testCase.isPixelwise) {
+			fmt::print(stderr, "检测测试 {}: 应{}逐像素\n", testCase.name, testCase.isPixelwise ? "" : "不");
+			success = false;
+		}
+	}
+
+	fmt::print("检测测试: {} 个\n", std::size(testCases));
+	return success;
+}
+
+struct LoadedEffect {
+	std::string name;
+	std::string source;
+	EffectDesc desc;
+};
+
+// 检查融合后的效果并为各种编译选项生成 HLSL
+static bool VerifyFused(std::span<const LoadedEffect* const> effects, std::string& errorMsg) {
+	std::vector<std::string_view> sources;
+	for (const LoadedEffect* effect : effects) {
+		sources.push_back(effect->source);
+	}
+
+	std::string fusedSource;
+	if (EffectFusion::GenerateSource(sources, fusedSource, errorMsg)) {
+		return false;
+	}
+
+	{
+		std::string again;
+		if (EffectFusion::GenerateSource(sources, again, errorMsg) || again != fusedSource) {
+			errorMsg = "生成的源码不确定";
+			return false;
+		}
+	}
+
+	size_t paramCount = 0;
+	size_t samplerCount = 0;
+	bool useDynamic = false;
+	for (const LoadedEffect* effect : effects) {
+		paramCount += effect->desc.params.size();
+		samplerCount += effect->desc.samplers.size();
+		useDynamic |= bool(effect->desc.flags & EffectFlags::UseDynamic);
+	}
+
+	for (uint32_t flags : { 0u, EffectFlags::FP16, EffectFlags::InlineParams }) {
+		std::string source = fusedSource;
+		EffectBlocks blocks;
+		EffectDesc desc;
+		desc.flags = flags;
+		if (EffectParser::RemoveComments(source, blocks) || EffectParser::SplitBlocks(source, blocks)
+			|| EffectParser::ResolveBlocks(blocks, desc, false, errorMsg)) {
+			errorMsg = "无法解析融合后的效果: " + errorMsg;
+			return false;
+		}
+
+		if (desc.passes.size() != 1 || !desc.passes[0].isPSStyle || desc.params.size() != paramCount
+			|| desc.samplers.size() != samplerCount || bool(desc.flags & EffectFlags::UseDynamic) != useDynamic
+			|| desc.GetOutputSizeExpr() != effects[0]->desc.GetOutputSizeExpr()) {
+			errorMsg = "融合后的效果不完整";
+			return false;
+		}
+
+		// 内联参数时使用融合后的参数名
+		std::unordered_map<std::string, float> inlineParams;
+		if (flags & EffectFlags::InlineParams) {
+			for (uint32_t i = 0; i < (uint32_t)effects.size(); ++i) {
+				for (const EffectParameterDesc& paramDesc : effects[i]->desc.params) {
+					inlineParams.emplace(EffectFusion::GetParamPrefix(i) + paramDesc.name, 0.0f);
+				}
+			}
+		}
+
+		std::string hlsl;
+		std::vector<std::pair<std::string, std::string>> macros;
+		if (EffectParser::GeneratePassSource(desc, 1, EffectParser::GenerateConstantBuffer(desc),
+			blocks.commons, blocks.passes[0], &inlineParams, hlsl, macros)) {
+			errorMsg = fmt::format("生成 HLSL 失败 (flags={})", flags);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fmt::print(stderr, "用法: {} <effects 文件夹> [效果...]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+
+	if (argc > 2) {
+		// 输出指定效果融合后的源码
+		std::vector<std::string> sources;
+		for (int i = 2; i < argc; ++i) {
+			std::string name = argv[i];
+			std::replace(name.begin(), name.end(), '\\', '/');
+			if (!ReadFile(effectsDir / (name + ".hlsl"), sources.emplace_back())) {
+				fmt::print(stderr, "读取 {} 失败\n", argv[i]);
+				return 1;
+			}
+		}
+
+		std::vector<std::string_view> sourceViews(sources.begin(), sources.end());
+		std::string result;
+		std::string errorMsg;
+		if (EffectFusion::GenerateSource(sourceViews, result, errorMsg)) {
+			fmt::print(stderr, "融合失败: {}\n", errorMsg);
+			return 1;
+		}
+
+		fmt::print("{}", result);
+		return 0;
+	}
+
+	bool success = RunDetectionTests();
+
+	std::vector<LoadedEffect> effects;
+	for (const std::filesystem::path& path : FindEffects(effectsDir)) {
+		LoadedEffect effect;
+		effect.name = GetEffectName(effectsDir, path);
+		std::string errorMsg;
+		if (!ReadFile(path, effect.source) || !ParseEffect(effect.source, effect.name, effect.desc, errorMsg)) {
+			// 不是效果，如被包含的文件
+			continue;
+		}
+		effects.push_back(std::move(effect));
+	}
+
+	std::vector<const LoadedEffect*> firsts;
+	std::vector<const LoadedEffect*> pixelwises;
+	for (const LoadedEffect& effect : effects) {
+		if (EffectFusion::CanBeFirst(effect.desc)) {
+			firsts.push_back(&effect);
+		}
+		if (effect.desc.flags & EffectFlags::Pixelwise) {
+			pixelwises.push_back(&effect);
+		}
+	}
+
+	fmt::print("{} 个效果，{} 个可以作为第一个效果，{} 个逐像素:", effects.size(), firsts.size(), pixelwises.size());
+	for (const LoadedEffect* effect : pixelwises) {
+		fmt::print(" {}", effect->name);
+	}
+	fmt::print("\n");
+
+	// 每个可以作为第一个效果的效果和每个逐像素的效果，以及连续两个逐像素的效果
+	uint32_t fusedCount = 0;
+	for (const LoadedEffect* first : firsts) {
+		for (const LoadedEffect* pixelwise : pixelwises) {
+			SmallVector<const LoadedEffect*> chains[] = { { first, pixelwise }, { first, pixelwise, pixelwise } };
+			for (const SmallVector<const LoadedEffect*>& chain : chains) {
+				std::string errorMsg;
+				if (!VerifyFused(chain, errorMsg)) {
+					std::string chainName;
+					for (const LoadedEffect* effect : chain) {
+						chainName += (chainName.empty() ? "" : " + ") + effect->name;
+					}
+					fmt::print(stderr, "{}: {}\n", chainName, errorMsg);
+					success = false;
+				}
+				++fusedCount;
+			}
+		}
+	}
+
+	// 每融合一个效果省去一次 4K R8G8B8A8_UNORM 纹理的写入和读取
+	fmt::print("融合测试: {} 组，4K 下每融合一个效果每帧少读写 {:.1f} MiB\n",
+		fusedCount, 3840.0 * 2160 * 4 * 2 / 1048576);
+
+	return success ? 0 : 1;
+}
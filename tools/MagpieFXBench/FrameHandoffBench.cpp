@@ -0,0 +1,234 @@
+// FrameHandoffBench.cpp : 验证 FrameHandoff 并测量交换的开销
+//
+// 用法: magpiefx-handoff-bench [-r 随机测试次数] [-n 压力测试发布的帧数]
+//
+// 先以随机的顺序在单线程中发布和取走帧，和简单的模型比较: 三个缓冲区始终互不相同，取走的总是最新发布的帧，
+// 有无新帧以及是否替换了未取走的帧都和模型一致。然后后端和前端线程同时运行，每个缓冲区有一个占用标志和多个
+// 数据字，检查双方从不同时访问同一个缓冲区，读到的帧没有被撕裂，序号单调递增且不早于取走前已发布的最新帧。
+// 最后输出每次交换的平均用时。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "FrameHandoff.h"
+
+using namespace Magpie::Core;
+
+static constexpr uint32_t BUFFER_COUNT = FrameHandoff::BUFFER_COUNT;
+
+static bool RunRandomTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+
+		FrameHandoff handoff;
+		// 每个缓冲区中的帧序号，0 表示没有内容
+		std::array<uint64_t, BUFFER_COUNT> contents{};
+		uint64_t publishedSeq = 0;
+		uint64_t frontSeq = 0;
+		bool hasNewFrame = false;
+
+		std::string errorMsg;
+		const uint32_t opCount = std::uniform_int_distribution<uint32_t>(1, 200)(rng);
+		// 偏向发布或取走，覆盖连续替换和连续没有新帧的情况
+		const uint32_t publishPercent = std::uniform_int_distribution<uint32_t>(10, 90)(rng);
+		for (uint32_t i = 0; i < opCount && errorMsg.empty(); ++i) {
+			const uint32_t backIdx = handoff.BackBufferIndex();
+
+			if (std::uniform_int_distribution<uint32_t>(0, 99)(rng) < publishPercent) {
+				contents[backIdx] = ++publishedSeq;
+				if (handoff.Publish() != hasNewFrame) {
+					errorMsg = fmt::format("第 {} 次操作: Publish 的返回值不正确", i);
+				}
+				hasNewFrame = true;
+			} else {
+				if (handoff.HasNewFrame() != hasNewFrame) {
+					errorMsg = fmt::format("第 {} 次操作: HasNewFrame 不正确", i);
+				} else if (handoff.Acquire() != hasNewFrame) {
+					errorMsg = fmt::format("第 {} 次操作: Acquire 的返回值不正确", i);
+				} else {
+					if (hasNewFrame) {
+						frontSeq = publishedSeq;
+					}
+					hasNewFrame = false;
+
+					if (handoff.HasFrontBuffer() != (frontSeq != 0)) {
+						errorMsg = fmt::format("第 {} 次操作: HasFrontBuffer 不正确", i);
+					} else if (contents[handoff.FrontBufferIndex()] != frontSeq) {
+						errorMsg = fmt::format("第 {} 次操作: 取得帧 {}，应为 {}",
+							i, contents[handoff.FrontBufferIndex()], frontSeq);
+					}
+				}
+			}
+
+			const uint32_t newBackIdx = handoff.BackBufferIndex();
+			const uint32_t frontIdx = handoff.FrontBufferIndex();
+			if (errorMsg.empty() && (newBackIdx >= BUFFER_COUNT || frontIdx >= BUFFER_COUNT || newBackIdx == frontIdx)) {
+				errorMsg = fmt::format("第 {} 次操作: 后端和前端的缓冲区冲突", i);
+			}
+		}
+
+		if (errorMsg.empty()) {
+			handoff.Reset();
+			if (handoff.HasNewFrame() || handoff.HasFrontBuffer() || handoff.Acquire()) {
+				errorMsg = "Reset 后仍有帧";
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{}: {}\n", r, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+// 模拟共享纹理: 写入和读取都要逐字进行，若双方同时访问则可能读到撕裂的帧
+struct StressBuffer {
+	static constexpr uint32_t WORD_COUNT = 64;
+
+	// 1 表示后端正在写入，2 表示前端正在读取
+	std::atomic<uint32_t> owner = 0;
+	std::array<std::atomic<uint64_t>, WORD_COUNT> words{};
+};
+
+static bool RunStressTest(uint64_t frameCount) {
+	FrameHandoff handoff;
+	std::array<StressBuffer, BUFFER_COUNT> buffers;
+	// 后端发布后更新，用于检查前端取走的是否为最新的帧
+	std::atomic<uint64_t> publishedSeq = 0;
+	std::atomic<bool> isDone = false;
+
+	std::atomic<uint32_t> errorCount = 0;
+	uint64_t supersededCount = 0;
+	uint64_t acquiredCount = 0;
+	uint64_t readCount = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::thread frontend([&]() {
+		uint64_t lastSeq = 0;
+		while (!isDone.load(std::memory_order_acquire)) {
+			const uint64_t minSeq = publishedSeq.load(std::memory_order_acquire);
+			if (handoff.Acquire()) {
+				++acquiredCount;
+			}
+			if (!handoff.HasFrontBuffer()) {
+				continue;
+			}
+
+			StressBuffer& buffer = buffers[handoff.FrontBufferIndex()];
+			if (buffer.owner.exchange(2, std::memory_order_acquire) != 0) {
+				errorCount.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			const uint64_t seq = buffer.words[0].load(std::memory_order_relaxed);
+			bool isValid = seq >= lastSeq && seq >= minSeq;
+			for (uint32_t i = 0; i < StressBuffer::WORD_COUNT; ++i) {
+				if (i == StressBuffer::WORD_COUNT / 2 && readCount % 8 == 0) {
+					// 在读取中途让出，核心较少时也能覆盖各种交错
+					std::this_thread::yield();
+				}
+				isValid = isValid && buffer.words[i].load(std::memory_order_relaxed) == seq;
+			}
+
+			buffer.owner.store(0, std::memory_order_release);
+			++readCount;
+
+			if (!isValid) {
+				errorCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			lastSeq = seq;
+		}
+	});
+
+	for (uint64_t seq = 1; seq <= frameCount; ++seq) {
+		StressBuffer& buffer = buffers[handoff.BackBufferIndex()];
+		if (buffer.owner.exchange(1, std::memory_order_acquire) != 0) {
+			errorCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		for (uint32_t i = 0; i < StressBuffer::WORD_COUNT; ++i) {
+			if (i == StressBuffer::WORD_COUNT / 2 && seq % 8 == 0) {
+				std::this_thread::yield();
+			}
+			buffer.words[i].store(seq, std::memory_order_relaxed);
+		}
+
+		buffer.owner.store(0, std::memory_order_release);
+
+		if (handoff.Publish()) {
+			++supersededCount;
+		}
+		publishedSeq.store(seq, std::memory_order_release);
+	}
+
+	isDone.store(true, std::memory_order_release);
+	frontend.join();
+
+	const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// 每一帧要么被取走要么被替换，最后一帧一定能被取走
+	if (handoff.Acquire()) {
+		++acquiredCount;
+	}
+	if (acquiredCount + supersededCount != frameCount) {
+		errorCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (buffers[handoff.FrontBufferIndex()].words[0].load() != frameCount) {
+		errorCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	fmt::print("压力测试: 发布 {} 帧，前端取走 {} 帧，替换 {} 帧，读取 {} 次，用时 {:.1f} 毫秒，{} 个错误\n",
+		frameCount, acquiredCount, supersededCount, readCount, elapsedMs, errorCount.load());
+	return errorCount == 0;
+}
+
+static void MeasureOverhead() {
+	static constexpr uint32_t ITERATIONS = 10'000'000;
+
+	FrameHandoff handoff;
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		handoff.Publish();
+		handoff.Acquire();
+	}
+	const double exchangeNs = std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+	// 没有新帧时 Acquire 只有一次读取
+	uint32_t sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		sum += handoff.Acquire();
+	}
+	const double idleNs = std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+	// 输出 sum 防止读取被优化掉，没有新帧时它应为 0
+	fmt::print("每次 Publish+Acquire {:.1f} 纳秒，没有新帧时每次 Acquire {:.1f} 纳秒 (取到 {} 帧)\n",
+		exchangeNs, idleNs, sum);
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t randomTestCount = 1000;
+	uint64_t stressFrameCount = 2'000'000;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-n") {
+			stressFrameCount = (uint64_t)std::max(1, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-r 随机测试次数] [-n 压力测试发布的帧数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunRandomTests(randomTestCount);
+	success = RunStressTest(stressFrameCount) && success;
+	MeasureOverhead();
+	return success ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// FramePacerBench.cpp : 用合成的捕获和垂直同步时间线验证 FramePacer
+//
+// 用法: magpiefx-pacing-bench [-s 每个场景的秒数] [-r 随机测试次数]
+//
+// 先用随机的垂直同步时间检查 VBlankAtOrAfter 和逐个枚举的结果相同。然后模拟后端的渲染循环：帧源按合成的
+// 时间线产生新帧（或像 GDI 那样在渲染前捕获），唤醒和渲染的用时带有随机的抖动，新帧在呈现后的第一个垂直同步
+// 显示，同一个垂直同步只显示最新的帧。比较固定间隔和两种帧节奏策略，输出从捕获到显示的延迟、相邻帧延迟之差
+// （抖动）的分位数以及每秒渲染和显示的帧数。检查“最流畅”策略下每个垂直同步最多渲染一帧，估计的显示时间不早于实际
+// 时间且最多晚一个周期，统计结果和最近几帧的估计一致。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "FramePacer.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+static bool RunVBlankTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](int64_t min, int64_t max) {
+			return std::uniform_int_distribution<int64_t>(min, max)(rng);
+		};
+
+		const int64_t period = rand(1, 50 * MS);
+		const int64_t vblankTime = rand(-1000 * MS, 1000 * MS);
+		FramePacer pacer;
+		pacer.Initialize(FramePacer::Policy::LowestLatency);
+		pacer.OnVBlank(vblankTime, period);
+
+		std::string errorMsg;
+		for (uint32_t i = 0; i < 100 && errorMsg.empty(); ++i) {
+			// 包括恰好落在垂直同步上的时间
+			const int64_t time = i % 4 == 0 ? vblankTime + rand(-20, 20) * period : rand(-2000 * MS, 2000 * MS);
+
+			int64_t expected = vblankTime;
+			while (expected < time) {
+				expected += period;
+			}
+			while (expected - period >= time) {
+				expected -= period;
+			}
+
+			if (pacer.VBlankAtOrAfter(time) != expected) {
+				errorMsg = fmt::format("时间 {} 的下一个垂直同步应为 {}，得到 {}", time, expected, pacer.VBlankAtOrAfter(time));
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{}: {}\n", r, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+enum class PacingMode {
+	// 和 StepTimer 相同，轮询捕获时按刷新率的固定间隔，否则新帧到达后立即渲染
+	Fixed,
+	LowestLatency,
+	Smoothest
+};
+
+static const char* PacingModeName(PacingMode mode) {
+	switch (mode) {
+	case PacingMode::Fixed:
+		return "固定间隔";
+	case PacingMode::LowestLatency:
+		return "最低延迟";
+	default:
+		return "最流畅";
+	}
+}
+
+struct Scenario {
+	const char* name;
+	double refreshRate;
+	// 相邻两个新帧到达的间隔，为空表示在渲染前捕获，如 GDI
+	std::function<int64_t(std::mt19937& rng)> frameInterval;
+	std::function<int64_t(std::mt19937& rng)> renderTime;
+};
+
+struct Frame {
+	int64_t captureTime;
+	int64_t renderStart;
+	int64_t renderEnd;
+	int64_t displayTime;
+	// FramePacer 估计的显示时间
+	int64_t estimatedDisplayTime;
+};
+
+struct SimulationResult {
+	std::vector<int64_t> latencies;
+	std::vector<int64_t> jitters;
+	uint32_t renderedCount = 0;
+	uint32_t displayedCount = 0;
+};
+
+static int64_t NormalTime(std::mt19937& rng, double meanMs, double stddevMs) {
+	return std::max((int64_t)(std::normal_distribution<double>(meanMs, stddevMs)(rng) * MS), MS / 2);
+}
+
+static bool Simulate(
+	const Scenario& scenario,
+	PacingMode mode,
+	uint32_t seconds,
+	SimulationResult& result,
+	std::string& errorMsg
+) {
+	// 不同来源的随机数互不影响，使各模式下帧源和渲染用时的序列相同
+	std::mt19937 sourceRng(1);
+	std::mt19937 renderRng(2);
+	std::mt19937 osRng(3);
+
+	const int64_t period = (int64_t)std::llround(1e9 / scenario.refreshRate);
+	// 垂直同步的相位和时钟的原点无关
+	const int64_t vblankPhase = period * 3 / 10;
+	const auto vblankAtOrAfter = [&](int64_t time) {
+		return vblankPhase + (time - vblankPhase + period - 1) / period * period;
+	};
+
+	const int64_t endTime = (int64_t)seconds * 1'000'000'000;
+
+	// 帧源产生新帧的时间
+	std::vector<int64_t> arrivals;
+	if (scenario.frameInterval) {
+		for (int64_t time = 5 * MS; time < endTime; time += scenario.frameInterval(sourceRng)) {
+			arrivals.push_back(time);
+		}
+	}
+
+	FramePacer pacer;
+	pacer.Initialize(mode == PacingMode::Smoothest ? FramePacer::Policy::Smoothest : FramePacer::Policy::LowestLatency);
+	std::optional<int64_t> lastVBlankQueryTime;
+
+	std::vector<Frame> frames;
+	size_t nextArrival = 0;
+	int64_t time = 0;
+	while (time < endTime) {
+		int64_t wakeTime = time;
+		if (mode == PacingMode::Fixed) {
+			if (!scenario.frameInterval) {
+				// 定时器的相位和垂直同步无关，这里取相差半个周期
+				const int64_t timerPhase = vblankPhase + period / 2;
+				wakeTime = timerPhase + (time - timerPhase + period - 1) / period * period;
+			}
+		} else {
+			// 和 StepTimer 相同，每秒更新一次垂直同步的时间
+			if (!lastVBlankQueryTime || time - *lastVBlankQueryTime >= 1000 * MS) {
+				lastVBlankQueryTime = time;
+				pacer.OnVBlank(vblankAtOrAfter(time) - period, period);
+			}
+			wakeTime = std::max(time, pacer.NextWakeTime(time));
+		}
+
+		if (wakeTime > time) {
+			// 定时器的唤醒延迟，偶尔被系统调度推迟
+			time = wakeTime + std::uniform_int_distribution<int64_t>(0, MS / 5)(osRng);
+			if (std::uniform_int_distribution<int>(0, 99)(osRng) == 0) {
+				time += 2 * MS;
+			}
+		}
+
+		int64_t captureTime = time;
+		if (scenario.frameInterval) {
+			if (nextArrival == arrivals.size()) {
+				break;
+			}
+
+			if (arrivals[nextArrival] > time) {
+				// 等待新帧
+				time = arrivals[nextArrival] + MS / 20;
+			}
+
+			// 只取最新的帧，如 Desktop Duplication
+			while (nextArrival + 1 < arrivals.size() && arrivals[nextArrival + 1] <= time) {
+				++nextArrival;
+			}
+			captureTime = arrivals[nextArrival++];
+		}
+
+		Frame& frame = frames.emplace_back();
+		frame.captureTime = captureTime;
+		frame.renderStart = time;
+		frame.renderEnd = time + scenario.renderTime(renderRng);
+		const int64_t presentTime = frame.renderEnd
+			+ std::uniform_int_distribution<int64_t>(MS / 5, FramePacer::PRESENT_MARGIN)(osRng);
+		frame.displayTime = vblankAtOrAfter(presentTime);
+		frame.estimatedDisplayTime = pacer.OnFrameRendered(frame.captureTime, frame.renderStart, frame.renderEnd);
+
+		time = frame.renderEnd;
+	}
+
+	if (frames.empty()) {
+		errorMsg = "没有渲染任何帧";
+		return false;
+	}
+
+	// 同一个垂直同步只显示最新的帧
+	const Frame* lastDisplayed = nullptr;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		const Frame& frame = frames[i];
+
+		if (mode != PacingMode::Fixed && (frame.estimatedDisplayTime < frame.displayTime
+			|| frame.estimatedDisplayTime - frame.displayTime > period)) {
+			errorMsg = fmt::format("第 {} 帧估计的显示时间不正确", i);
+			return false;
+		}
+
+		if (i + 1 < frames.size() && frames[i + 1].displayTime == frame.displayTime) {
+			if (mode == PacingMode::Smoothest) {
+				errorMsg = fmt::format("第 {} 帧和下一帧安排在同一个垂直同步", i);
+				return false;
+			}
+			continue;
+		}
+
+		const int64_t latency = frame.displayTime - frame.captureTime;
+		if (lastDisplayed) {
+			result.jitters.push_back(std::abs(latency - (lastDisplayed->displayTime - lastDisplayed->captureTime)));
+		}
+		result.latencies.push_back(latency);
+		lastDisplayed = &frame;
+	}
+
+	result.renderedCount = (uint32_t)frames.size();
+	result.displayedCount = (uint32_t)result.latencies.size();
+
+	if (mode != PacingMode::Fixed) {
+		// FramePacer 只统计最近几帧估计的延迟
+		std::vector<int64_t> recent;
+		for (size_t i = frames.size() - std::min<size_t>(frames.size(), FramePacer::HISTORY_SIZE); i < frames.size(); ++i) {
+			recent.push_back(frames[i].estimatedDisplayTime - frames[i].captureTime);
+		}
+		std::sort(recent.begin(), recent.end());
+
+		const FramePacer::Statistics statistics = pacer.GetStatistics();
+		if (statistics.frameCount != frames.size()
+			|| statistics.latencyP50 != recent[std::min(recent.size() - 1, recent.size() / 2)]
+			|| statistics.latencyP99 != recent[std::min(recent.size() - 1, (size_t)(0.99 * recent.size()))]
+			|| (mode == PacingMode::Smoothest && statistics.supersededCount != 0)) {
+			errorMsg = "统计结果和估计的延迟不同";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool RunSimulations(uint32_t seconds) {
+	const Scenario scenarios[] = {
+		{ "轮询捕获，60Hz", 60, nullptr, [](std::mt19937& rng) {
+			return std::uniform_int_distribution<int>(0, 99)(rng) == 0 ? 10 * MS : NormalTime(rng, 3, 0.3);
+		} },
+		{ "轮询捕获，144Hz", 144, nullptr, [](std::mt19937& rng) { return NormalTime(rng, 2.5, 0.3); } },
+		{ "59.94 FPS 的游戏，60Hz", 60, [](std::mt19937& rng) {
+			return (int64_t)(1e9 / 59.94) + std::uniform_int_distribution<int64_t>(-MS / 2, MS / 2)(rng);
+		}, [](std::mt19937& rng) {
+			return std::uniform_int_distribution<int>(0, 49)(rng) == 0 ? 9 * MS : NormalTime(rng, 4, 0.5);
+		} },
+		{ "30 FPS 的视频，60Hz", 60, [](std::mt19937&) {
+			return (int64_t)(1e9 / 29.97);
+		}, [](std::mt19937& rng) { return NormalTime(rng, 4, 0.5); } },
+		{ "不稳定的帧率，144Hz", 144, [](std::mt19937& rng) {
+			return std::uniform_int_distribution<int64_t>(5 * MS, 20 * MS)(rng);
+		}, [](std::mt19937& rng) { return NormalTime(rng, 3, 1); } },
+	};
+
+	const PacingMode modes[] = { PacingMode::Fixed, PacingMode::LowestLatency, PacingMode::Smoothest };
+
+	return RunScenarios<SimulationResult>(scenarios, modes,
+		[&](const Scenario& scenario, PacingMode mode, SimulationResult& result, std::string& errorMsg) {
+			return Simulate(scenario, mode, seconds, result, errorMsg);
+		},
+		PacingModeName,
+		[&](const SimulationResult& result) {
+			return fmt::format("延迟 p50 {:.2f}，p95 {:.2f}，p99 {:.2f} 毫秒；抖动 p50 {:.2f}，p99 {:.2f} 毫秒；每秒渲染 {:.1f} 帧，显示 {:.1f} 帧",
+				PercentileMs(result.latencies, 0.5), PercentileMs(result.latencies, 0.95),
+				PercentileMs(result.latencies, 0.99), PercentileMs(result.jitters, 0.5), PercentileMs(result.jitters, 0.99),
+				(double)result.renderedCount / seconds, (double)result.displayedCount / seconds);
+		},
+		[](const Scenario&, const auto&) { return std::vector<std::string>(); });
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t seconds = 60;
+	uint32_t randomTestCount = 1000;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-s") {
+			seconds = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-s 每个场景的秒数] [-r 随机测试次数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunVBlankTests(randomTestCount);
+	success = RunSimulations(seconds) && success;
+	return success ? 0 : 1;
+}
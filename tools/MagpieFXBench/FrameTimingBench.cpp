@@ -0,0 +1,272 @@
+// FrameTimingBench.cpp : 验证 FrameTimingRecorder 并测量记录和读取的开销
+//
+// 用法: magpiefx-timing-bench [-r 随机测试次数] [-n 压力测试每个阶段的样本数]
+//
+// 先用随机分布的用时检查直方图得到的 p50/p95/p99 和对最近 WINDOW_SIZE 个样本排序的结果相差不超过一个桶，
+// 窗口外的样本不再参与统计，导出的 CSV 和 JSON 包含窗口中所有的样本。然后每个阶段由一个线程写入，同时另一个
+// 线程不断读取分位数和样本，检查读到的值都来自对应阶段且样本数不超过窗口大小，写入结束后结果和单线程时相同。
+// 之后检查空的阶段和 NaN、无穷大的样本在 JSON 中导出为 null。最后输出每次记录和读取的平均用时。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "FrameTimingRecorder.h"
+#include <limits>
+
+using namespace Magpie::Core;
+
+using Stage = FrameTimingRecorder::Stage;
+
+static constexpr uint32_t STAGE_COUNT = FrameTimingRecorder::STAGE_COUNT;
+static constexpr uint32_t WINDOW_SIZE = FrameTimingRecorder::WINDOW_SIZE;
+
+// 第 ceil(p * n) 个样本
+static float ExactPercentile(std::vector<float> values, float p) {
+	std::sort(values.begin(), values.end());
+	const size_t rank = std::max((size_t)std::ceil(p * values.size()), (size_t)1);
+	return values[rank - 1];
+}
+
+static bool IsSameBucket(float estimated, float exact) {
+	return FrameTimingRecorder::BucketValue(FrameTimingRecorder::BucketIndex(exact)) == estimated;
+}
+
+static size_t CountChar(const std::string& str, char c) {
+	return (size_t)std::count(str.begin(), str.end(), c);
+}
+
+static bool RunRandomTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		FrameTimingRecorder recorder;
+		std::array<std::vector<float>, STAGE_COUNT> expected;
+
+		for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+			// 对数正态分布的用时，偶尔有很长的卡顿。数量可能不足或超过窗口
+			const float median = std::exp2(std::uniform_real_distribution<float>(-6, 5)(rng));
+			std::lognormal_distribution<float> dist(std::log(median), std::uniform_real_distribution<float>(0.05f, 1.0f)(rng));
+
+			const uint32_t sampleCount = rand(0, 3) == 0 ? rand(1, WINDOW_SIZE) : rand(WINDOW_SIZE, WINDOW_SIZE * 4);
+			for (uint32_t j = 0; j < sampleCount; ++j) {
+				float ms = rand(0, 99) == 0 ? median * 20 : dist(rng);
+				if (rand(0, 199) == 0) {
+					// 小于最小的桶
+					ms = 0;
+				}
+				recorder.Record((Stage)i, ms);
+				expected[i].push_back(ms);
+			}
+
+			if (expected[i].size() > WINDOW_SIZE) {
+				expected[i].erase(expected[i].begin(), expected[i].end() - WINDOW_SIZE);
+			}
+		}
+
+		std::string errorMsg;
+		std::vector<float> samples;
+		for (uint32_t i = 0; i < STAGE_COUNT && errorMsg.empty(); ++i) {
+			const FrameTimingRecorder::Percentiles percentiles = recorder.GetPercentiles((Stage)i);
+			recorder.GetSamples((Stage)i, samples);
+
+			if (percentiles.count != expected[i].size()) {
+				errorMsg = fmt::format("{} 的样本数为 {}，应为 {}",
+					FrameTimingRecorder::StageName((Stage)i), percentiles.count, expected[i].size());
+			} else if (samples != expected[i]) {
+				errorMsg = fmt::format("{} 的样本不正确", FrameTimingRecorder::StageName((Stage)i));
+			} else if (!IsSameBucket(percentiles.p50, ExactPercentile(expected[i], 0.50f))
+				|| !IsSameBucket(percentiles.p95, ExactPercentile(expected[i], 0.95f))
+				|| !IsSameBucket(percentiles.p99, ExactPercentile(expected[i], 0.99f))) {
+				errorMsg = fmt::format("{} 的分位数不正确", FrameTimingRecorder::StageName((Stage)i));
+			}
+		}
+
+		if (errorMsg.empty()) {
+			size_t totalCount = 0;
+			for (const std::vector<float>& values : expected) {
+				totalCount += values.size();
+			}
+
+			// CSV 每个样本一行加上标题，JSON 每个阶段一个对象
+			const std::string csv = recorder.ExportCsv();
+			const std::string json = recorder.ExportJson();
+			if (CountChar(csv, '\n') != totalCount + 1) {
+				errorMsg = "导出的 CSV 不完整";
+			} else if (CountChar(json, '{') != STAGE_COUNT + 1 || CountChar(json, '{') != CountChar(json, '}')
+				|| CountChar(json, '[') != STAGE_COUNT + 1 || CountChar(json, '[') != CountChar(json, ']')) {
+				errorMsg = "导出的 JSON 不完整";
+			}
+		}
+
+		if (errorMsg.empty()) {
+			recorder.Reset();
+			for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+				recorder.GetSamples((Stage)i, samples);
+				if (recorder.GetPercentiles((Stage)i).count != 0 || !samples.empty()) {
+					errorMsg = "Reset 后仍有样本";
+					break;
+				}
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{}: {}\n", r, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+// 第 stage 个阶段的第 i 个样本，不同阶段的值互不重叠
+static float StressSample(uint32_t stage, uint32_t i) {
+	return (stage + 1) * 100.0f + (i % 97) * 0.5f;
+}
+
+static bool RunStressTest(uint32_t sampleCount) {
+	FrameTimingRecorder recorder;
+	std::atomic<bool> isDone = false;
+	std::atomic<uint32_t> errorCount = 0;
+	uint64_t readCount = 0;
+
+	std::thread reader([&]() {
+		std::vector<float> samples;
+		while (!isDone.load(std::memory_order_acquire)) {
+			for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+				const FrameTimingRecorder::Percentiles percentiles = recorder.GetPercentiles((Stage)i);
+				recorder.GetSamples((Stage)i, samples);
+				++readCount;
+
+				const float min = StressSample(i, 0);
+				const float max = StressSample(i, 96);
+				bool isValid = percentiles.count <= WINDOW_SIZE && samples.size() <= WINDOW_SIZE;
+				if (percentiles.count > 0) {
+					// 分位数是桶的中点，可能略微超出范围
+					isValid = isValid && percentiles.p50 > min * 0.95f && percentiles.p99 < max * 1.05f;
+				}
+				for (float sample : samples) {
+					isValid = isValid && sample >= min && sample <= max;
+				}
+
+				if (!isValid) {
+					errorCount.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		}
+	});
+
+	std::vector<std::thread> writers;
+	for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+		writers.emplace_back([&, i]() {
+			for (uint32_t j = 0; j < sampleCount; ++j) {
+				recorder.Record((Stage)i, StressSample(i, j));
+			}
+		});
+	}
+
+	for (std::thread& writer : writers) {
+		writer.join();
+	}
+	isDone.store(true, std::memory_order_release);
+	reader.join();
+
+	// 写入结束后和单线程的结果相同
+	FrameTimingRecorder expected;
+	for (uint32_t i = 0; i < STAGE_COUNT; ++i) {
+		for (uint32_t j = 0; j < sampleCount; ++j) {
+			expected.Record((Stage)i, StressSample(i, j));
+		}
+	}
+
+	if (recorder.ExportJson() != expected.ExportJson()) {
+		errorCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	fmt::print("压力测试: {} 个阶段各写入 {} 个样本，读取 {} 次，{} 个错误\n",
+		STAGE_COUNT, sampleCount, readCount, errorCount.load());
+	return errorCount == 0;
+}
+
+// 空的阶段和 NaN、无穷大的样本导出为 null，而不是 JSON 不允许的 nan 和 inf
+static bool RunJsonTest() {
+	FrameTimingRecorder recorder;
+	recorder.Record(Stage::Effects, std::numeric_limits<float>::quiet_NaN());
+	recorder.Record(Stage::Effects, std::numeric_limits<float>::infinity());
+	recorder.Record(Stage::Effects, 1.0f);
+
+	const std::string json = recorder.ExportJson();
+	// 其他阶段的三个分位数和 Effects 的两个样本
+	const size_t expectedNullCount = (STAGE_COUNT - 1) * 3 + 2;
+	size_t nullCount = 0;
+	for (size_t pos = json.find("null"); pos != std::string::npos; pos = json.find("null", pos + 1)) {
+		++nullCount;
+	}
+
+	const bool success = json.find("nan") == std::string::npos && json.find("inf") == std::string::npos
+		&& nullCount == expectedNullCount;
+	fmt::print("JSON 中的无效数值: {}\n", success ? "通过" : "失败");
+	if (!success) {
+		fmt::print(stderr, "{}\n", json);
+	}
+	return success;
+}
+
+static void MeasureOverhead() {
+	static constexpr uint32_t ITERATIONS = 1'000'000;
+
+	FrameTimingRecorder recorder;
+	std::mt19937 rng(0);
+	std::vector<float> values(4096);
+	for (float& value : values) {
+		value = std::lognormal_distribution<float>(1, 0.5f)(rng);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; ++i) {
+		recorder.Record((Stage)(i % STAGE_COUNT), values[i % values.size()]);
+	}
+	const double recordNs = std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+	float sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS / 100; ++i) {
+		sum += recorder.GetPercentiles((Stage)(i % STAGE_COUNT)).p99;
+	}
+	const double readNs = std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now() - start).count() / (ITERATIONS / 100);
+
+	start = std::chrono::steady_clock::now();
+	const size_t jsonSize = recorder.ExportJson().size();
+	const double exportUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	// 输出 sum 防止读取被优化掉
+	fmt::print("每次 Record {:.1f} 纳秒，每次 GetPercentiles {:.1f} 纳秒 (p99 之和 {:.0f})，导出 JSON ({} 字节) {:.1f} 微秒\n",
+		recordNs, readNs, sum, jsonSize, exportUs);
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t randomTestCount = 1000;
+	uint32_t stressSampleCount = 1'000'000;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-n") {
+			stressSampleCount = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-r 随机测试次数] [-n 压力测试每个阶段的样本数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunRandomTests(randomTestCount);
+	success = RunStressTest(stressSampleCount) && success;
+	success = RunJsonTest() && success;
+	MeasureOverhead();
+	return success ? 0 : 1;
+}
@@ -0,0 +1,447 @@
+// LetterboxBench.cpp : 验证自动裁剪黑边的检测并估计可以节省的效果输入
+//
+// 用法: magpiefx-letterbox-bench [-r 随机测试次数]
+//
+// 先用随机的画面检查模拟 LetterboxCS 的线程组得到的归约和逐像素计算的 CPU 参考实现相同。然后让 LetterboxDetector
+// 处理随机的画面序列，检查有效区域总是包含当前帧所有非黑色的像素，且只会比它大不到一个单元。
+// 之后检查几个典型场景: 信箱式和柱状黑边被裁剪，没有黑边或黑边太窄时不裁剪，带噪声的视频黑色仍被视为黑边，
+// 间歇出现在黑边上的字幕不会导致频繁重建资源。最后输出常见比例下效果输入节省的面积。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "LetterboxDetector.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+using Rect = LetterboxDetector::Rect;
+
+static constexpr uint32_t CELL_SIZE = LetterboxDetector::CELL_SIZE;
+
+// 像素为 0xAARRGGBB
+struct Image {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint32_t> pixels;
+
+	Image(uint32_t width_, uint32_t height_) : width(width_), height(height_), pixels((size_t)width_ * height_) {}
+
+	uint32_t& At(uint32_t x, uint32_t y) {
+		return pixels[(size_t)y * width + x];
+	}
+
+	uint32_t At(uint32_t x, uint32_t y) const {
+		return pixels[(size_t)y * width + x];
+	}
+
+	void Fill(const Rect& rect, const auto& pixel) {
+		for (uint32_t y = rect.top; y < rect.bottom; ++y) {
+			for (uint32_t x = rect.left; x < rect.right; ++x) {
+				At(x, y) = pixel(x, y);
+			}
+		}
+	}
+};
+
+static uint32_t MaxComponent(uint32_t pixel) {
+	return std::max({ (pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF });
+}
+
+static uint32_t Gray(uint32_t value) {
+	return 0xFF000000 | (value << 16) | (value << 8) | value;
+}
+
+struct Reduction {
+	std::vector<uint32_t> rowMax;
+	std::vector<uint32_t> columnMax;
+
+	bool operator==(const Reduction&) const = default;
+};
+
+// CPU 参考实现，逐像素计算每行和每列单元的最大值
+static Reduction Reduce(const Image& image) {
+	Reduction result{
+		std::vector<uint32_t>(LetterboxDetector::RowCount(image.height)),
+		std::vector<uint32_t>(LetterboxDetector::ColumnCount(image.width))
+	};
+	for (uint32_t y = 0; y < image.height; ++y) {
+		for (uint32_t x = 0; x < image.width; ++x) {
+			const uint32_t value = MaxComponent(image.At(x, y));
+			uint32_t& rowMax = result.rowMax[y / CELL_SIZE];
+			rowMax = std::max(rowMax, value);
+			uint32_t& columnMax = result.columnMax[x / CELL_SIZE];
+			columnMax = std::max(columnMax, value);
+		}
+	}
+	return result;
+}
+
+// 和 LetterboxCS 相同: 每个线程组 8x8 个线程，每个线程读取 2x2 个像素，先在组内归约到 2x2 个单元，
+// 再用原子操作写入结果
+static Reduction EmulateShader(const Image& image) {
+	const uint32_t rowCount = LetterboxDetector::RowCount(image.height);
+	std::vector<uint32_t> result(rowCount + LetterboxDetector::ColumnCount(image.width));
+
+	const uint32_t groupsX = (image.width + 15) / 16;
+	const uint32_t groupsY = (image.height + 15) / 16;
+	for (uint32_t gy = 0; gy < groupsY; ++gy) {
+		for (uint32_t gx = 0; gx < groupsX; ++gx) {
+			uint32_t rowMax[2]{};
+			uint32_t colMax[2]{};
+
+			for (uint32_t ty = 0; ty < 8; ++ty) {
+				for (uint32_t tx = 0; tx < 8; ++tx) {
+					const uint32_t posX = (gx << 4) + (tx << 1);
+					const uint32_t posY = (gy << 4) + (ty << 1);
+					if (posX >= image.width || posY >= image.height) {
+						continue;
+					}
+
+					uint32_t value = 0;
+					for (uint32_t i = 0; i < 4; ++i) {
+						const uint32_t x = posX + (i & 1);
+						const uint32_t y = posY + (i >> 1);
+						if (x < image.width && y < image.height) {
+							value = std::max(value, MaxComponent(image.At(x, y)));
+						}
+					}
+
+					rowMax[ty >> 2] = std::max(rowMax[ty >> 2], value);
+					colMax[tx >> 2] = std::max(colMax[tx >> 2], value);
+				}
+			}
+
+			for (uint32_t gi = 0; gi < 2; ++gi) {
+				const uint32_t cellX = (gx << 1) + gi;
+				const uint32_t cellY = (gy << 1) + gi;
+				if ((cellY << 3) < image.height) {
+					result[cellY] = std::max(result[cellY], rowMax[gi]);
+				}
+				if ((cellX << 3) < image.width) {
+					result[rowCount + cellX] = std::max(result[rowCount + cellX], colMax[gi]);
+				}
+			}
+		}
+	}
+
+	return {
+		std::vector<uint32_t>(result.begin(), result.begin() + rowCount),
+		std::vector<uint32_t>(result.begin() + rowCount, result.end())
+	};
+}
+
+// 所有非黑色像素的包围盒，全黑时为空
+static std::optional<Rect> ContentBounds(const Image& image) {
+	std::optional<Rect> bounds;
+	for (uint32_t y = 0; y < image.height; ++y) {
+		for (uint32_t x = 0; x < image.width; ++x) {
+			if (MaxComponent(image.At(x, y)) <= LetterboxDetector::BLACK_THRESHOLD) {
+				continue;
+			}
+
+			if (!bounds) {
+				bounds = Rect{ x, y, x + 1, y + 1 };
+			} else {
+				bounds->left = std::min(bounds->left, x);
+				bounds->top = std::min(bounds->top, y);
+				bounds->right = std::max(bounds->right, x + 1);
+				bounds->bottom = std::max(bounds->bottom, y + 1);
+			}
+		}
+	}
+	return bounds;
+}
+
+static bool Contains(const Rect& outer, const Rect& inner) {
+	return inner.left >= outer.left && inner.top >= outer.top
+		&& inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+static bool Update(LetterboxDetector& detector, const Reduction& reduction) {
+	return detector.Update(reduction.rowMax, reduction.columnMax);
+}
+
+static bool RunRandomTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		const uint32_t width = rand(1, 100);
+		const uint32_t height = rand(1, 100);
+
+		LetterboxDetector detector;
+		detector.Initialize(width, height);
+
+		std::string errorMsg;
+		// 每个序列的黑边保持一段时间，使检测器有机会缩小有效区域
+		Rect bars;
+		for (uint32_t frame = 0; frame < 400 && errorMsg.empty(); ++frame) {
+			if (frame % 100 == 0) {
+				const uint32_t left = rand(0, width / 3);
+				const uint32_t top = rand(0, height / 3);
+				bars = { left, top, width - rand(0, width / 3), height - rand(0, height / 3) };
+			}
+
+			// 偶尔全黑或只有一小块画面，模拟黑屏和暗场景
+			Image image(width, height);
+			const uint32_t kind = rand(0, 19);
+			if (kind > 1 && bars.right > bars.left && bars.bottom > bars.top) {
+				Rect content = bars;
+				if (kind == 2) {
+					content.left = rand(bars.left, bars.right - 1);
+					content.top = rand(bars.top, bars.bottom - 1);
+					content.right = rand(content.left + 1, bars.right);
+					content.bottom = rand(content.top + 1, bars.bottom);
+				}
+				image.Fill(content, [&](uint32_t, uint32_t) { return (uint32_t)rng() | 0xFF000000; });
+			}
+			// 黑边中的噪声
+			for (uint32_t i = rand(0, 3); i > 0; --i) {
+				image.At(rand(0, width - 1), rand(0, height - 1)) = Gray(rand(0, LetterboxDetector::BLACK_THRESHOLD));
+			}
+
+			const Reduction reduction = Reduce(image);
+			if (EmulateShader(image) != reduction) {
+				errorMsg = "和着色器的结果不同";
+				break;
+			}
+
+			detector.Update(reduction.rowMax, reduction.columnMax);
+
+			const Rect& active = detector.ActiveRect();
+			if (active.right > width || active.bottom > height || active.left >= active.right || active.top >= active.bottom) {
+				errorMsg = fmt::format("第 {} 帧: 有效区域 {} 超出范围", frame, ToString(active));
+				break;
+			}
+
+			const std::optional<Rect> bounds = ContentBounds(image);
+			if (bounds && !Contains(active, *bounds)) {
+				errorMsg = fmt::format("第 {} 帧: 有效区域 {} 未包含画面 {}", frame, ToString(active), ToString(*bounds));
+				break;
+			}
+		}
+
+		if (errorMsg.empty() && bars.left * 2 < width && bars.top * 2 < height) {
+			// 最后保持对称的画面，有效区域应缩小到和画面相差不到一个单元，除非这样节省的面积太少
+			const Rect content{ bars.left, bars.top, width - bars.left, height - bars.top };
+			Image image(width, height);
+			image.Fill(content, [](uint32_t, uint32_t) { return Gray(255); });
+			// 可能有未完成的一轮检测
+			const Reduction reduction = Reduce(image);
+			for (uint32_t i = 0; i < LetterboxDetector::MAX_SHRINK_DELAY * 2; ++i) {
+				Update(detector, reduction);
+			}
+
+			const Rect& active = detector.ActiveRect();
+			const Rect loose{
+				content.left >= CELL_SIZE ? content.left - CELL_SIZE + 1 : 0,
+				content.top >= CELL_SIZE ? content.top - CELL_SIZE + 1 : 0,
+				std::min(content.right + CELL_SIZE - 1, width),
+				std::min(content.bottom + CELL_SIZE - 1, height)
+			};
+			const double savedArea = double(active.Width()) * active.Height() - double(loose.Width()) * loose.Height();
+			if (!Contains(loose, active) && savedArea >= LetterboxDetector::MIN_SAVED_AREA * width * height) {
+				errorMsg = fmt::format("有效区域 {} 比画面 {} 大一个单元以上", ToString(active), ToString(content));
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{} ({}x{}): {}\n", r, width, height, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+// 以 contentWidth x contentHeight 的画面居中于 width x height 的帧中
+static Rect CenteredRect(uint32_t width, uint32_t height, uint32_t contentWidth, uint32_t contentHeight) {
+	const uint32_t left = (width - contentWidth) / 2;
+	const uint32_t top = (height - contentHeight) / 2;
+	return { left, top, left + contentWidth, top + contentHeight };
+}
+
+static bool RunScenarios() {
+	bool success = true;
+	const auto check = [&](bool condition, std::string_view name, std::string_view detail) {
+		fmt::print("  {}: {}\n", name, condition ? "通过" : "失败");
+		if (!condition) {
+			fmt::print(stderr, "    {}\n", detail);
+			success = false;
+		}
+	};
+
+	constexpr uint32_t WIDTH = 1920;
+	constexpr uint32_t HEIGHT = 1080;
+
+	// 画面中的像素不能是黑色，否则包围盒会小于画面
+	std::mt19937 rng(0);
+	const auto contentPixel = [&](uint32_t, uint32_t) {
+		return Gray(LetterboxDetector::BLACK_THRESHOLD + 1 + (uint32_t)rng() % 200);
+	};
+
+	// 模拟持续 frameCount 帧的画面，返回有效区域变化的次数
+	const auto play = [&](LetterboxDetector& detector, const Image& image, uint32_t frameCount) {
+		const Reduction reduction = Reduce(image);
+		uint32_t changeCount = 0;
+		for (uint32_t i = 0; i < frameCount; ++i) {
+			changeCount += Update(detector, reduction);
+		}
+		return changeCount;
+	};
+
+	const auto expectCrop = [&](std::string_view name, const Rect& content, uint32_t blackLevel, uint32_t noise) {
+		Image image(WIDTH, HEIGHT);
+		image.Fill({ 0, 0, WIDTH, HEIGHT }, [&](uint32_t, uint32_t) {
+			return Gray(blackLevel + (noise ? (uint32_t)rng() % (noise + 1) : 0));
+		});
+		image.Fill(content, contentPixel);
+
+		LetterboxDetector detector;
+		detector.Initialize(WIDTH, HEIGHT);
+		const uint32_t changeCount = play(detector, image, LetterboxDetector::SHRINK_DELAY);
+
+		const Rect& active = detector.ActiveRect();
+		const bool isTight = Contains(active, content) && content.left - active.left < CELL_SIZE
+			&& content.top - active.top < CELL_SIZE && active.right - content.right < CELL_SIZE
+			&& active.bottom - content.bottom < CELL_SIZE;
+		check(isTight && changeCount == 1, name, fmt::format("画面 {}，有效区域 {}，变化 {} 次",
+			ToString(content), ToString(active), changeCount));
+	};
+
+	const auto expectNoCrop = [&](std::string_view name, const Rect& content) {
+		Image image(WIDTH, HEIGHT);
+		image.Fill(content, contentPixel);
+
+		LetterboxDetector detector;
+		detector.Initialize(WIDTH, HEIGHT);
+		const uint32_t changeCount = play(detector, image, LetterboxDetector::MAX_SHRINK_DELAY);
+		check(!detector.IsCropped() && changeCount == 0, name,
+			fmt::format("有效区域 {}，变化 {} 次", ToString(detector.ActiveRect()), changeCount));
+	};
+
+	fmt::print("典型场景 ({}x{}):\n", WIDTH, HEIGHT);
+
+	// 2.39:1 的电影
+	expectCrop("信箱式黑边", CenteredRect(WIDTH, HEIGHT, WIDTH, 803), 0, 0);
+	// 4:3 的视频
+	expectCrop("柱状黑边", CenteredRect(WIDTH, HEIGHT, 1440, HEIGHT), 0, 0);
+	// 窗口化的 4:3 视频
+	expectCrop("四周都有黑边", CenteredRect(WIDTH, HEIGHT, 1024, 768), 0, 0);
+	// 有限范围的视频中黑色为 16
+	expectCrop("带噪声的视频黑色", CenteredRect(WIDTH, HEIGHT, WIDTH, 803), 16, 6);
+	expectNoCrop("没有黑边", { 0, 0, WIDTH, HEIGHT });
+	// 1.85:1 的电影上下各约 21 像素，不值得重建资源
+	expectNoCrop("黑边太窄", CenteredRect(WIDTH, HEIGHT, WIDTH, 1038));
+
+	{
+		// 裁剪后进入只有中央偏左一小块画面的暗场景，有效区域保持对称
+		const Rect movie = CenteredRect(WIDTH, HEIGHT, WIDTH, 803);
+		Image image(WIDTH, HEIGHT);
+		image.Fill(movie, contentPixel);
+
+		LetterboxDetector detector;
+		detector.Initialize(WIDTH, HEIGHT);
+		play(detector, image, LetterboxDetector::SHRINK_DELAY);
+		const Rect cropped = detector.ActiveRect();
+
+		Image darkScene(WIDTH, HEIGHT);
+		darkScene.Fill({ 400, 500, 700, 600 }, contentPixel);
+		play(detector, darkScene, LetterboxDetector::MAX_SHRINK_DELAY);
+		const Rect& active = detector.ActiveRect();
+		const bool isSymmetric = active.left == WIDTH - active.right && active.top == HEIGHT - active.bottom;
+		check(active == cropped || isSymmetric, "偏向一侧的暗场景", fmt::format("有效区域 {}", ToString(active)));
+	}
+
+	{
+		// 字幕每 200 帧在下方的黑边中出现 20 帧，重建资源的次数应有上限
+		const Rect movie = CenteredRect(WIDTH, HEIGHT, WIDTH, 803);
+		Image image(WIDTH, HEIGHT);
+		image.Fill(movie, contentPixel);
+		Image withSubtitles = image;
+		withSubtitles.Fill({ 600, movie.bottom + 40, 1320, movie.bottom + 90 }, contentPixel);
+
+		const Reduction reduction = Reduce(image);
+		const Reduction withSubtitlesReduction = Reduce(withSubtitles);
+
+		LetterboxDetector detector;
+		detector.Initialize(WIDTH, HEIGHT);
+		uint32_t changeCount = 0;
+		bool isSubtitleCropped = false;
+		constexpr uint32_t FRAME_COUNT = 20000;
+		for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame) {
+			const bool hasSubtitles = frame % 200 >= 180;
+			changeCount += Update(detector, hasSubtitles ? withSubtitlesReduction : reduction);
+			if (hasSubtitles && detector.ActiveRect().bottom < movie.bottom + 90) {
+				isSubtitleCropped = true;
+			}
+		}
+
+		check(!isSubtitleCropped && changeCount <= 12, "间歇出现的字幕",
+			fmt::format("{} 帧中有效区域变化 {} 次，字幕{}被裁掉", FRAME_COUNT, changeCount, isSubtitleCropped ? "" : "未"));
+	}
+
+	return success;
+}
+
+static void PrintSavings() {
+	struct Case {
+		const char* name;
+		uint32_t width;
+		uint32_t height;
+		uint32_t contentWidth;
+		uint32_t contentHeight;
+	};
+	static constexpr Case CASES[] = {
+		{ "16:9 中的 2.39:1", 1920, 1080, 1920, 803 },
+		{ "16:9 中的 2:1", 1920, 1080, 1920, 960 },
+		{ "16:9 中的 4:3", 1920, 1080, 1440, 1080 },
+		{ "21:9 中的 16:9", 2560, 1080, 1920, 1080 },
+		{ "16:10 中的 16:9", 1920, 1200, 1920, 1080 },
+	};
+
+	fmt::print("效果输入的面积 (向外取整到 {} 像素的单元):\n", CELL_SIZE);
+	for (const Case& c : CASES) {
+		Image image(c.width, c.height);
+		image.Fill(CenteredRect(c.width, c.height, c.contentWidth, c.contentHeight),
+			[](uint32_t, uint32_t) { return Gray(255); });
+
+		const Reduction reduction = Reduce(image);
+		LetterboxDetector detector;
+		detector.Initialize(c.width, c.height);
+		for (uint32_t i = 0; i < LetterboxDetector::SHRINK_DELAY; ++i) {
+			Update(detector, reduction);
+		}
+
+		const Rect& active = detector.ActiveRect();
+		const double ratio = double(active.Width()) * active.Height() / (double(c.width) * c.height);
+		// CuNNy 等效果的开销和输入面积成正比
+		fmt::print("  {}: {}x{} -> {}x{}，面积 {:.1f}%，按面积计的加速 {:.2f}x\n", c.name,
+			c.width, c.height, active.Width(), active.Height(), ratio * 100, 1 / ratio);
+	}
+
+	const uint32_t reductionSize = (LetterboxDetector::RowCount(2160) + LetterboxDetector::ColumnCount(3840)) * 4;
+	fmt::print("3840x2160 的归约结果为 {} 字节\n", reductionSize);
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t randomTestCount = 200;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-r 随机测试次数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunRandomTests(randomTestCount);
+	success &= RunScenarios();
+	PrintSavings();
+	return success ? 0 : 1;
+}
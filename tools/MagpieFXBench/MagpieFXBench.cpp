@@ -0,0 +1,259 @@
+// MagpieFXBench.cpp : 测量 MagpieFX 前端各阶段的耗时和内存分配次数
+//
+// 用法: magpiefx-bench <effects 文件夹> [-n 迭代次数]
+
+#include "pch.h"
+#include "EffectParser.h"
+#include "EffectDesc.h"
+#include "EffectCacheFormat.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+// 统计内存分配次数
+static std::atomic<uint64_t> allocCount = 0;
+
+void* operator new(size_t size) {
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
+
+enum Stage {
+	RemoveComments,
+	SplitBlocks,
+	ResolveBlocks,
+	GenerateSource,
+	SaveCache,
+	LoadCache,
+	STAGE_COUNT
+};
+
+static constexpr const char* STAGE_NAMES[STAGE_COUNT] = {
+	"RemoveComments",
+	"SplitBlocks",
+	"ResolveBlocks",
+	"GenerateSource",
+	"SaveCache",
+	"LoadCache"
+};
+
+struct StageStats {
+	double us = 0;
+	uint64_t allocs = 0;
+};
+
+struct FileResult {
+	std::string name;
+	size_t size = 0;
+	StageStats stages[STAGE_COUNT];
+	std::string errorMsg;
+};
+
+class StageScope {
+public:
+	StageScope(StageStats& stats) : _stats(stats),
+		_allocs(allocCount.load(std::memory_order_relaxed)), _start(std::chrono::steady_clock::now()) {}
+
+	~StageScope() {
+		auto end = std::chrono::steady_clock::now();
+		_stats.us += std::chrono::duration<double, std::micro>(end - _start).count();
+		_stats.allocs += allocCount.load(std::memory_order_relaxed) - _allocs;
+	}
+
+private:
+	StageStats& _stats;
+	uint64_t _allocs;
+	std::chrono::steady_clock::time_point _start;
+};
+
+// 和 EffectCompiler::Compile 执行相同的步骤，但不调用 D3DCompile
+static bool RunOnce(std::string_view originSource, const std::string& name, FileResult& result) {
+	std::string source(originSource);
+	EffectBlocks blocks;
+
+	{
+		StageScope scope(result.stages[RemoveComments]);
+		if (EffectParser::RemoveComments(source, blocks)) {
+			result.errorMsg = "删除注释失败";
+			return false;
+		}
+	}
+
+	{
+		StageScope scope(result.stages[SplitBlocks]);
+		if (uint32_t ret = EffectParser::SplitBlocks(source, blocks)) {
+			result.errorMsg = ret == 2 ? "检查 MagpieFX 头失败" : "划分块失败";
+			return false;
+		}
+	}
+
+	EffectDesc desc;
+	desc.name = name;
+	{
+		StageScope scope(result.stages[ResolveBlocks]);
+		if (EffectParser::ResolveBlocks(blocks, desc, false, result.errorMsg)) {
+			return false;
+		}
+	}
+
+	std::vector<std::string> passSources(blocks.passes.size());
+	{
+		StageScope scope(result.stages[GenerateSource]);
+		const std::string cbHlsl = EffectParser::GenerateConstantBuffer(desc);
+		for (uint32_t i = 0; i < (uint32_t)blocks.passes.size(); ++i) {
+			std::vector<std::pair<std::string, std::string>> macros;
+			if (EffectParser::GeneratePassSource(desc, i + 1, cbHlsl,
+				blocks.commons, blocks.passes[i], nullptr, passSources[i], macros)) {
+				result.errorMsg = fmt::format("生成 Pass{} 失败", i + 1);
+				return false;
+			}
+		}
+	}
+
+	// 没有 D3DCompile，使用生成的源码代替字节码验证缓存格式
+	for (size_t i = 0; i < passSources.size(); ++i) {
+		desc.passes[i].cso = std::span((const uint8_t*)passSources[i].data(), passSources[i].size());
+	}
+
+	std::vector<uint8_t> cache;
+	{
+		StageScope scope(result.stages[SaveCache]);
+		if (!EffectCacheFormat::Write(desc, cache)) {
+			result.errorMsg = "序列化缓存失败";
+			return false;
+		}
+	}
+
+	EffectDesc cachedDesc;
+	{
+		StageScope scope(result.stages[LoadCache]);
+		if (!EffectCacheFormat::Read(cache, nullptr, cachedDesc)) {
+			result.errorMsg = "反序列化缓存失败";
+			return false;
+		}
+	}
+
+	if (!IsSameDesc(desc, cachedDesc)) {
+		result.errorMsg = "缓存往返后不一致";
+		return false;
+	}
+
+	return true;
+}
+
+static void PrintRow(std::string_view name, size_t size, const StageStats* stages, uint32_t iterations) {
+	double totalUs = 0;
+	uint64_t totalAllocs = 0;
+	fmt::print("{:<40} {:>8.1f}", name, size / 1024.0);
+	for (int i = 0; i < STAGE_COUNT; ++i) {
+		fmt::print(" {:>10.1f} {:>8}", stages[i].us / iterations, stages[i].allocs / iterations);
+		totalUs += stages[i].us;
+		totalAllocs += stages[i].allocs;
+	}
+	fmt::print(" {:>10.1f} {:>8}\n", totalUs / iterations, totalAllocs / iterations);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fmt::print(stderr, "用法: {} <effects 文件夹> [-n 迭代次数]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+	uint32_t iterations = 10;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		if (std::string_view(argv[i]) == "-n") {
+			iterations = std::max(1, std::atoi(argv[i + 1]));
+		}
+	}
+
+	std::vector<std::filesystem::path> files = FindEffects(effectsDir);
+	if (files.empty()) {
+		fmt::print(stderr, "未找到效果: {}\n", effectsDir.string());
+		return 1;
+	}
+
+	std::vector<FileResult> results;
+	results.reserve(files.size());
+	for (const std::filesystem::path& path : files) {
+		FileResult& result = results.emplace_back();
+
+		result.name = GetEffectName(effectsDir, path);
+
+		std::string source;
+		if (!ReadFile(path, source)) {
+			result.errorMsg = "读取源文件失败";
+			continue;
+		}
+		result.size = source.size();
+
+		for (uint32_t i = 0; i < iterations; ++i) {
+			if (!RunOnce(source, result.name, result)) {
+				break;
+			}
+		}
+	}
+
+	fmt::print("{:<40} {:>8}", "效果", "KiB");
+	for (const char* stageName : STAGE_NAMES) {
+		fmt::print(" {:>10} {:>8}", stageName, "allocs");
+	}
+	fmt::print(" {:>10} {:>8}\n", "Total", "allocs");
+
+	StageStats totalStages[STAGE_COUNT];
+	size_t totalSize = 0;
+	uint32_t failedCount = 0;
+	for (const FileResult& result : results) {
+		if (!result.errorMsg.empty()) {
+			++failedCount;
+			continue;
+		}
+
+		PrintRow(result.name, result.size, result.stages, iterations);
+
+		totalSize += result.size;
+		for (int i = 0; i < STAGE_COUNT; ++i) {
+			totalStages[i].us += result.stages[i].us;
+			totalStages[i].allocs += result.stages[i].allocs;
+		}
+	}
+
+	fmt::print("\n");
+	PrintRow(fmt::format("总计 ({} 个效果, 迭代 {} 次)", results.size() - failedCount, iterations),
+		totalSize, totalStages, iterations);
+
+	if (failedCount > 0) {
+		fmt::print("\n{} 个效果解析失败:\n", failedCount);
+		for (const FileResult& result : results) {
+			if (!result.errorMsg.empty()) {
+				fmt::print("  {}: {}\n", result.name, result.errorMsg);
+			}
+		}
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,406 @@
+// MagpieFXPack.cpp : 把 effects 文件夹中的效果预编译为一个效果包
+//
+// 用法: magpiefx-pack <effects 文件夹> <输出文件> [--stub]
+//
+// 为每个效果生成不内联参数的两个变体（FP16 关闭和开启）。Windows 上使用 D3DCompile 编译，选项和
+// DirectXHelper::CompileComputeShader 在 Release 配置下相同；其他平台或指定 --stub 时使用生成的
+// 源码代替字节码，这样的效果包带有 EffectBundle::HeaderFlags::Stub，只用于验证打包、查找和校验，
+// 运行时会拒绝它。写入前重新读取并检查每个条目，任何错误都会使返回值非零
+
+#include "pch.h"
+#include "EffectParser.h"
+#include "EffectDesc.h"
+#include "EffectBundle.h"
+#include "BenchUtils.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <d3dcompiler.h>
+#endif
+
+using namespace Magpie::Core;
+
+// 效果包只包含默认的编译选项
+static constexpr uint32_t VARIANT_FLAGS[] = { 0, EffectFlags::FP16 };
+
+struct PackedEffect {
+	EffectDesc desc;
+	// desc.passes 中的 cso 指向这里
+	std::vector<std::vector<uint8_t>> csos;
+};
+
+// 和 Win32Utils::ReadTextFile 相同，将 CRLF 转换为 LF
+static void NormalizeNewLines(std::string& text) {
+	size_t j = 0;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n') {
+			continue;
+		}
+		text[j++] = text[i];
+	}
+	text.resize(j);
+}
+
+// 和 PassInclude 相同，包含的文件总是相对于效果所在的文件夹，嵌套包含也是如此。
+// 扫描源码中的 #include 而不是记录编译器打开的文件，这样 --stub 模式也能得到依赖。
+// 包含的文件中的注释没有删除，不存在的文件视为被注释掉，真正缺失时编译会失败
+static void CollectDependencies(
+	std::string_view source,
+	const std::filesystem::path& effectsDir,
+	const std::filesystem::path& includeDir,
+	std::vector<std::pair<std::string, uint64_t>>& dependencies
+) {
+	static constexpr std::string_view INCLUDE = "#include";
+
+	for (size_t pos = source.find(INCLUDE); pos != std::string_view::npos; pos = source.find(INCLUDE, pos + 1)) {
+		const size_t begin = source.find('"', pos + INCLUDE.size());
+		const size_t lineEnd = source.find('\n', pos);
+		if (begin == std::string_view::npos || begin > lineEnd) {
+			continue;
+		}
+		const size_t end = source.find('"', begin + 1);
+		if (end == std::string_view::npos || end > lineEnd) {
+			continue;
+		}
+
+		const std::filesystem::path path =
+			(includeDir / std::string(source.substr(begin + 1, end - begin - 1))).lexically_normal();
+		std::string relPath = path.lexically_relative(effectsDir).generic_string();
+		std::replace(relPath.begin(), relPath.end(), '/', '\\');
+
+		if (std::any_of(dependencies.begin(), dependencies.end(),
+			[&](const auto& dependency) { return dependency.first == relPath; })) {
+			continue;
+		}
+
+		std::string text;
+		if (!ReadFile(path, text)) {
+			continue;
+		}
+
+		dependencies.emplace_back(relPath, EffectBundle::HashText(text));
+
+		NormalizeNewLines(text);
+		CollectDependencies(text, effectsDir, includeDir, dependencies);
+	}
+}
+
+#ifdef _WIN32
+class PackInclude : public ID3DInclude {
+public:
+	PackInclude(const std::filesystem::path& localDir) : _localDir(localDir) {}
+
+	HRESULT CALLBACK Open(
+		D3D_INCLUDE_TYPE /*IncludeType*/,
+		LPCSTR pFileName,
+		LPCVOID /*pParentData*/,
+		LPCVOID* ppData,
+		UINT* pBytes
+	) noexcept override {
+		std::string file;
+		if (!ReadFile(_localDir / pFileName, file)) {
+			return E_FAIL;
+		}
+		NormalizeNewLines(file);
+
+		char* result = new char[file.size()];
+		std::memcpy(result, file.data(), file.size());
+
+		*ppData = result;
+		*pBytes = (UINT)file.size();
+		return S_OK;
+	}
+
+	HRESULT CALLBACK Close(LPCVOID pData) noexcept override {
+		delete[](char*)pData;
+		return S_OK;
+	}
+
+private:
+	std::filesystem::path _localDir;
+};
+
+static bool CompilePass(
+	std::string_view hlsl,
+	const std::string& sourceName,
+	const std::filesystem::path& includeDir,
+	const std::vector<std::pair<std::string, std::string>>& macros,
+	std::vector<uint8_t>& cso,
+	std::string& errorMsg
+) {
+	std::vector<D3D_SHADER_MACRO> d3dMacros;
+	d3dMacros.reserve(macros.size() + 1);
+	for (const auto& [name, value] : macros) {
+		d3dMacros.push_back({ name.c_str(), value.c_str() });
+	}
+	d3dMacros.push_back({ nullptr, nullptr });
+
+	PackInclude include(includeDir);
+	ID3DBlob* blob = nullptr;
+	ID3DBlob* errorMsgs = nullptr;
+	const HRESULT hr = D3DCompile(hlsl.data(), hlsl.size(), sourceName.c_str(), d3dMacros.data(), &include, "__M",
+		"cs_5_0", D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_ALL_RESOURCES_BOUND | D3DCOMPILE_OPTIMIZATION_LEVEL3,
+		0, &blob, &errorMsgs);
+
+	if (errorMsgs) {
+		errorMsg.assign((const char*)errorMsgs->GetBufferPointer(), errorMsgs->GetBufferSize());
+		errorMsgs->Release();
+	}
+	if (FAILED(hr)) {
+		return false;
+	}
+
+	const uint8_t* data = (const uint8_t*)blob->GetBufferPointer();
+	cso.assign(data, data + blob->GetBufferSize());
+	blob->Release();
+	return true;
+}
+#endif
+
+static bool PackEffect(
+	const std::filesystem::path& effectsDir,
+	const std::filesystem::path& path,
+	bool isStub,
+	std::vector<std::unique_ptr<PackedEffect>>& packedEffects,
+	std::vector<EffectBundle::Item>& items,
+	std::string& errorMsg
+) {
+	std::string originSource;
+	if (!ReadFile(path, originSource)) {
+		errorMsg = "读取源文件失败";
+		return false;
+	}
+	NormalizeNewLines(originSource);
+
+	const std::string name = GetEffectName(effectsDir, path);
+	const std::filesystem::path includeDir = path.parent_path();
+
+	for (uint32_t effectFlags : VARIANT_FLAGS) {
+		std::string source = originSource;
+		EffectBlocks blocks;
+		if (EffectParser::RemoveComments(source, blocks)) {
+			errorMsg = "删除注释失败";
+			return false;
+		}
+
+		// 运行时同样对删除注释后的源码求哈希
+		EffectBundle::Item item;
+		item.name = name;
+		item.effectFlags = effectFlags;
+		item.sourceHash = EffectBundle::HashText(source);
+		CollectDependencies(source, effectsDir, includeDir, item.dependencies);
+
+		if (uint32_t ret = EffectParser::SplitBlocks(source, blocks)) {
+			errorMsg = ret == 2 ? "检查 MagpieFX 头失败" : "划分块失败";
+			return false;
+		}
+
+		PackedEffect& packed = *packedEffects.emplace_back(std::make_unique<PackedEffect>());
+		EffectDesc& desc = packed.desc;
+		desc.name = name;
+		desc.flags = effectFlags;
+		if (EffectParser::ResolveBlocks(blocks, desc, false, errorMsg)) {
+			return false;
+		}
+
+		const std::string cbHlsl = EffectParser::GenerateConstantBuffer(desc);
+		packed.csos.resize(blocks.passes.size());
+		for (uint32_t i = 0; i < (uint32_t)blocks.passes.size(); ++i) {
+			std::string passSource;
+			std::vector<std::pair<std::string, std::string>> macros;
+			if (EffectParser::GeneratePassSource(desc, i + 1, cbHlsl,
+				blocks.commons, blocks.passes[i], nullptr, passSource, macros)) {
+				errorMsg = fmt::format("生成 Pass{} 失败", i + 1);
+				return false;
+			}
+
+			std::vector<uint8_t>& cso = packed.csos[i];
+			if (isStub) {
+				cso.assign(passSource.begin(), passSource.end());
+			} else {
+#ifdef _WIN32
+				if (!CompilePass(passSource, fmt::format("{}_Pass{}.hlsl", name, i + 1),
+					includeDir, macros, cso, errorMsg)) {
+					errorMsg = fmt::format("编译 Pass{} 失败: {}", i + 1, errorMsg);
+					return false;
+				}
+#endif
+			}
+
+			desc.passes[i].cso = cso;
+		}
+
+		item.desc = &desc;
+		items.push_back(std::move(item));
+	}
+
+	return true;
+}
+
+// 检查效果包能否还原每个条目，并能拒绝损坏的数据
+static bool VerifyBundle(
+	const std::vector<uint8_t>& data,
+	const std::filesystem::path& effectsDir,
+	const std::vector<EffectBundle::Item>& items,
+	bool isStub
+) {
+	EffectBundle bundle;
+	if (!bundle.Open(data, nullptr, isStub)) {
+		fmt::print(stderr, "无法打开生成的效果包\n");
+		return false;
+	}
+
+	// 运行时不允许使用桩字节码
+	if (isStub && EffectBundle().Open(data, nullptr)) {
+		fmt::print(stderr, "运行时能打开桩效果包\n");
+		return false;
+	}
+
+	bool success = true;
+	if (bundle.Entries().size() != items.size()) {
+		fmt::print(stderr, "条目数不一致\n");
+		success = false;
+	}
+
+	for (const EffectBundle::Item& item : items) {
+		const EffectBundle::Entry* entry = bundle.Find(item.name, item.effectFlags);
+		if (!entry) {
+			fmt::print(stderr, "{} ({:#x}): 未找到条目\n", item.name, item.effectFlags);
+			success = false;
+			continue;
+		}
+
+		EffectDesc desc;
+		if (!bundle.Load(*entry, desc) || !IsSameDesc(*item.desc, desc)) {
+			fmt::print(stderr, "{} ({:#x}): 读取后不一致\n", item.name, item.effectFlags);
+			success = false;
+		}
+
+		if (entry->sourceHash != item.sourceHash) {
+			fmt::print(stderr, "{} ({:#x}): 源码哈希不一致\n", item.name, item.effectFlags);
+			success = false;
+		}
+
+		// 和运行时相同，从 effects 文件夹读取包含的文件并校验
+		for (const EffectBundle::Dependency& dependency : bundle.GetDependencies(*entry)) {
+			std::string relPath(bundle.GetPath(dependency));
+			std::replace(relPath.begin(), relPath.end(), '\\', '/');
+
+			std::string text;
+			if (!ReadFile(effectsDir / relPath, text) || EffectBundle::HashText(text) != dependency.hash) {
+				fmt::print(stderr, "{} ({:#x}): 依赖 {} 校验失败\n", item.name, item.effectFlags, relPath);
+				success = false;
+			}
+		}
+
+		// 内联参数的变体总是需要编译
+		if (bundle.Find(item.name, item.effectFlags | EffectFlags::InlineParams)) {
+			fmt::print(stderr, "{} ({:#x}): 找到了不存在的条目\n", item.name, item.effectFlags);
+			success = false;
+		}
+	}
+
+	// 损坏的数据必须被拒绝
+	const auto expectRejected = [&](std::string_view desc, std::span<const uint8_t> corrupted) {
+		EffectBundle corruptedBundle;
+		if (corruptedBundle.Open(corrupted, nullptr, isStub)) {
+			fmt::print(stderr, "未能拒绝损坏的效果包: {}\n", desc);
+			success = false;
+		}
+	};
+
+	expectRejected("截断", std::span(data).first(data.size() - 1));
+
+	std::vector<uint8_t> corrupted = data;
+	corrupted[0] ^= 0xff;
+	expectRejected("魔数", corrupted);
+
+	if (!items.empty()) {
+		// 第一个条目的数据区未对齐
+		corrupted = data;
+		EffectBundle::Entry entry;
+		std::memcpy(&entry, data.data() + sizeof(EffectBundle::Header), sizeof(entry));
+		++entry.data.offset;
+		std::memcpy(corrupted.data() + sizeof(EffectBundle::Header), &entry, sizeof(entry));
+		expectRejected("数据区", corrupted);
+
+		// 依赖越界
+		entry.data.offset -= 1;
+		entry.dependencyCount = UINT32_MAX;
+		std::memcpy(corrupted.data() + sizeof(EffectBundle::Header), &entry, sizeof(entry));
+		expectRejected("依赖", corrupted);
+	}
+
+	return success;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		fmt::print(stderr, "用法: {} <effects 文件夹> <输出文件> [--stub]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+	const std::filesystem::path outputPath = argv[2];
+#ifdef _WIN32
+	bool isStub = false;
+#else
+	// 没有 D3DCompile
+	bool isStub = true;
+#endif
+	for (int i = 3; i < argc; ++i) {
+		if (std::string_view(argv[i]) == "--stub") {
+			isStub = true;
+		}
+	}
+
+	std::vector<std::filesystem::path> files = FindEffects(effectsDir);
+	if (files.empty()) {
+		fmt::print(stderr, "未找到效果: {}\n", effectsDir.string());
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::unique_ptr<PackedEffect>> packedEffects;
+	std::vector<EffectBundle::Item> items;
+	uint32_t failedCount = 0;
+	for (const std::filesystem::path& path : files) {
+		std::string errorMsg;
+		if (!PackEffect(effectsDir, path, isStub, packedEffects, items, errorMsg)) {
+			fmt::print(stderr, "{}: {}\n", GetEffectName(effectsDir, path), errorMsg);
+			++failedCount;
+		}
+	}
+	if (failedCount > 0) {
+		fmt::print(stderr, "{} 个效果打包失败\n", failedCount);
+		return 1;
+	}
+
+	std::vector<uint8_t> bundle;
+	if (!EffectBundle::Write(items, bundle, isStub ? EffectBundle::HeaderFlags::Stub : 0)) {
+		fmt::print(stderr, "序列化效果包失败\n");
+		return 1;
+	}
+
+	if (!VerifyBundle(bundle, effectsDir, items, isStub)) {
+		return 1;
+	}
+
+	std::ofstream fs(outputPath, std::ios::binary);
+	if (!fs.write((const char*)bundle.data(), bundle.size())) {
+		fmt::print(stderr, "写入 {} 失败\n", outputPath.string());
+		return 1;
+	}
+
+	size_t dependencyCount = 0;
+	for (const EffectBundle::Item& item : items) {
+		dependencyCount += item.dependencies.size();
+	}
+
+	fmt::print("{} 个效果，{} 个条目，{} 个依赖，{:.1f} KiB{}，用时 {:.0f} 毫秒\n",
+		files.size(), items.size(), dependencyCount, bundle.size() / 1024.0, isStub ? "（桩字节码）" : "",
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return 0;
+}
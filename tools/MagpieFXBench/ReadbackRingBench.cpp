@@ -0,0 +1,282 @@
+// ReadbackRingBench.cpp : 用模拟的 GPU 验证 ReadbackRing
+//
+// 用法: magpiefx-readback-bench [-f 每个场景的帧数] [-r 随机测试次数]
+//
+// 先用随机的操作序列和一个简单的队列模型比较环的状态。然后模拟按顺序执行命令、耗时不定的 GPU：
+// 每帧提交一个回读请求，GPU 完成前读取槽位会失败，就像 Map 使用 D3D11_MAP_FLAG_DO_NOT_WAIT 时
+// 返回 DXGI_ERROR_WAS_STILL_DRAWING。检查每个结果都按提交顺序取回且恰好一次，读到的数据属于请求的
+// 那一帧，即槽位不会在取回前被重用。最后输出不同深度下结果的延迟和被放弃的请求数，以及每帧直接等待
+// 结果时 CPU 需要等待的时间。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "ReadbackRing.h"
+
+using namespace Magpie::Core;
+
+static uint64_t Payload(uint64_t frameIndex) {
+	return frameIndex * 0x9E3779B97F4A7C15ull + 1;
+}
+
+static bool RunModelTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		const uint32_t depth = rand(1, 5);
+		ReadbackRing ring;
+		ring.Initialize(depth);
+
+		// (槽位, 帧号)
+		std::deque<std::pair<uint32_t, uint64_t>> model;
+		uint64_t dropped = 0;
+		uint64_t frameIndex = 0;
+
+		std::string errorMsg;
+		for (uint32_t op = 0; op < 200 && errorMsg.empty(); ++op) {
+			const uint32_t kind = rand(0, 9);
+			if (kind < 5) {
+				const std::optional<uint32_t> slot = ring.Submit(frameIndex);
+				if (model.size() == depth) {
+					++dropped;
+					if (slot) {
+						errorMsg = "环已满时仍分配了槽位";
+					}
+				} else if (!slot || *slot >= depth) {
+					errorMsg = "未分配槽位";
+				} else {
+					for (const auto& item : model) {
+						if (item.first == *slot) {
+							errorMsg = "分配了未取回的槽位";
+						}
+					}
+					model.emplace_back(*slot, frameIndex);
+				}
+				++frameIndex;
+			} else if (kind < 9) {
+				// 随机数量的请求已完成
+				const uint32_t ready = rand(0, (uint32_t)model.size());
+				uint32_t readCount = 0;
+				const uint32_t polled = ring.Poll([&](uint32_t slot, uint64_t frame) {
+					if (readCount == ready) {
+						return false;
+					}
+					if (model.empty() || model.front() != std::make_pair(slot, frame)) {
+						errorMsg = "取回的顺序不正确";
+					} else {
+						model.pop_front();
+					}
+					++readCount;
+					return true;
+				});
+				if (polled != ready) {
+					errorMsg = "取回的请求数不正确";
+				}
+			} else {
+				ring.Reset();
+				model.clear();
+			}
+
+			if (errorMsg.empty() && (ring.PendingCount() != model.size() || ring.DroppedCount() != dropped
+				|| ring.OldestPendingFrame() != (model.empty() ? std::nullopt : std::optional(model.front().second)))) {
+				errorMsg = "状态和模型不同";
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "模型测试 #{} (深度 {}): {}\n", r, depth, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("模型测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+// 按顺序执行命令的 GPU，时间以毫秒为单位
+class FakeGpu {
+public:
+	explicit FakeGpu(uint32_t slotCount) : _slots(slotCount) {}
+
+	// 把 payload 复制到槽位，在之前的命令完成后再用 duration 完成
+	void Copy(double now, double duration, uint32_t slot, uint64_t payload) {
+		const double start = _commands.empty() ? std::max(now, _idleTime) : std::max(now, _commands.back().doneTime);
+		_commands.push_back({ start + duration, slot, payload });
+	}
+
+	void Advance(double now) {
+		while (!_commands.empty() && _commands.front().doneTime <= now) {
+			const Command& command = _commands.front();
+			_slots[command.slot] = command.payload;
+			_idleTime = command.doneTime;
+			_commands.pop_front();
+		}
+	}
+
+	// 和 Map 使用 D3D11_MAP_FLAG_DO_NOT_WAIT 相同，槽位还有未完成的写入时失败
+	bool TryRead(uint32_t slot, uint64_t& payload) const {
+		for (const Command& command : _commands) {
+			if (command.slot == slot) {
+				return false;
+			}
+		}
+		payload = _slots[slot];
+		return true;
+	}
+
+private:
+	struct Command {
+		double doneTime;
+		uint32_t slot;
+		uint64_t payload;
+	};
+
+	std::deque<Command> _commands;
+	std::vector<uint64_t> _slots;
+	double _idleTime = 0;
+};
+
+struct Scenario {
+	const char* name;
+	// 第 frame 帧 GPU 的耗时
+	std::function<double(uint32_t frame, std::mt19937& rng)> gpuTime;
+};
+
+struct SimulationResult {
+	std::vector<double> latencies;
+	uint64_t dropped = 0;
+	// 每帧直接等待结果时 CPU 的总等待时间
+	double blockingWait = 0;
+};
+
+static bool Simulate(
+	const Scenario& scenario,
+	uint32_t depth,
+	uint32_t frameCount,
+	SimulationResult& result,
+	std::string& errorMsg
+) {
+	static constexpr double FRAME_TIME = 1000.0 / 60;
+
+	std::mt19937 rng(42);
+	FakeGpu gpu(depth);
+	ReadbackRing ring;
+	ring.Initialize(depth);
+
+	std::vector<double> submitTimes(frameCount);
+	std::vector<bool> isSubmitted(frameCount);
+	int64_t lastFrame = -1;
+	uint64_t received = 0;
+
+	const auto poll = [&](double now) {
+		gpu.Advance(now);
+		ring.Poll([&](uint32_t slot, uint64_t frame) {
+			uint64_t payload;
+			if (!gpu.TryRead(slot, payload)) {
+				return false;
+			}
+
+			if (payload != Payload(frame)) {
+				errorMsg = fmt::format("第 {} 帧读到了其他帧的数据", frame);
+			} else if ((int64_t)frame <= lastFrame || !isSubmitted[frame]) {
+				errorMsg = fmt::format("第 {} 帧的结果顺序不正确或重复", frame);
+			}
+
+			lastFrame = (int64_t)frame;
+			++received;
+			result.latencies.push_back(now - submitTimes[frame]);
+			return true;
+		});
+	};
+
+	for (uint32_t frame = 0; frame < frameCount && errorMsg.empty(); ++frame) {
+		const double now = frame * FRAME_TIME;
+		poll(now);
+
+		const double gpuTime = scenario.gpuTime(frame, rng);
+		if (const std::optional<uint32_t> slot = ring.Submit(frame)) {
+			gpu.Copy(now, gpuTime, *slot, Payload(frame));
+			submitTimes[frame] = now;
+			isSubmitted[frame] = true;
+		}
+
+		// 直接等待时 CPU 阻塞到 GPU 完成本帧
+		result.blockingWait += gpuTime;
+	}
+
+	// 取回剩余的结果
+	for (uint32_t i = 0; ring.PendingCount() > 0 && i < 1000 && errorMsg.empty(); ++i) {
+		poll((frameCount + i) * FRAME_TIME);
+	}
+
+	result.dropped = ring.DroppedCount();
+	if (errorMsg.empty() && received + result.dropped != frameCount) {
+		errorMsg = fmt::format("{} 个请求，取回 {} 个，放弃 {} 个", frameCount, received, result.dropped);
+	}
+
+	return errorMsg.empty();
+}
+
+static double Percentile(std::vector<double> values, double p) {
+	if (values.empty()) {
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static bool RunSimulations(uint32_t frameCount) {
+	const Scenario scenarios[] = {
+		{ "GPU 空闲", [](uint32_t, std::mt19937&) { return 2.0; } },
+		{ "GPU 满载", [](uint32_t, std::mt19937& rng) {
+			return std::uniform_real_distribution<double>(14, 20)(rng);
+		} },
+		{ "偶尔卡顿", [](uint32_t frame, std::mt19937& rng) {
+			return frame % 97 == 0 ? 80.0 : std::uniform_real_distribution<double>(2, 8)(rng);
+		} },
+		{ "持续落后", [](uint32_t, std::mt19937&) { return 40.0; } },
+	};
+
+	bool success = true;
+	for (const Scenario& scenario : scenarios) {
+		fmt::print("{}\n", scenario.name);
+		for (uint32_t depth = 1; depth <= 4; ++depth) {
+			SimulationResult result;
+			std::string errorMsg;
+			if (!Simulate(scenario, depth, frameCount, result, errorMsg)) {
+				fmt::print(stderr, "  深度 {}: {}\n", depth, errorMsg);
+				success = false;
+				continue;
+			}
+
+			fmt::print("  深度 {}: 延迟 p50 {:.1f} 毫秒，p99 {:.1f} 毫秒，放弃 {:.1f}% 的请求，直接等待时每帧阻塞 {:.2f} 毫秒\n",
+				depth, Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.99),
+				result.dropped * 100.0 / frameCount, result.blockingWait / frameCount);
+		}
+	}
+
+	return success;
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t frameCount = 10000;
+	uint32_t randomTestCount = 1000;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-f") {
+			frameCount = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-f 每个场景的帧数] [-r 随机测试次数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunModelTests(randomTestCount);
+	success = RunSimulations(frameCount) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,506 @@
+// RegionPropagatorBench.cpp : 验证 RegionPropagator 并统计真实效果链只渲染变化区域时调度的块
+//
+// 用法: magpiefx-region-bench <effects 文件夹> [-w 输入宽度] [-h 输入高度] [-s 缩放] [-r 随机测试次数] [效果...]
+//
+// 先检查 MapRect 和 MergeRects 的固定用例。然后用随机生成的效果链在 CPU 上模拟渲染：每个输出像素
+// 是它读取范围内的输入像素的哈希，和着色器相同地用浮点数计算采样位置。每一帧修改输入中随机的矩形，
+// 只渲染 RegionPropagator 给出的块，结果必须和完整渲染完全相同。最后和 Renderer 相同地展开指定的
+// 效果链，输出几种典型的画面变化下调度的块占完整渲染的比例。没有指定输出尺寸的效果按 -s 缩放，
+// 默认的效果链为 FSR_EASU 和 FSR_RCAS，输入尺寸为 1920x1080。任何检查失败时返回非零值
+
+#include "pch.h"
+#include "EffectDesc.h"
+#include "RegionPropagator.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+using Rect = RegionPropagator::Rect;
+
+static bool IsDisjoint(std::span<const Rect> rects) {
+	for (size_t i = 0; i < rects.size(); ++i) {
+		for (size_t j = i + 1; j < rects.size(); ++j) {
+			if (std::max(rects[i].left, rects[j].left) < std::min(rects[i].right, rects[j].right)
+				&& std::max(rects[i].top, rects[j].top) < std::min(rects[i].bottom, rects[j].bottom)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool RunFixedTests() {
+	bool success = true;
+
+	struct MapCase {
+		Rect rect;
+		std::pair<uint32_t, uint32_t> footprint;
+		std::pair<uint32_t, uint32_t> inputSize;
+		std::pair<uint32_t, uint32_t> outputSize;
+		Rect expected;
+	};
+	static const MapCase mapCases[] = {
+		// 逐像素
+		{ { 10, 10, 11, 11 }, { 0, 0 }, { 100, 100 }, { 100, 100 }, { 10, 10, 11, 11 } },
+		// 双线性
+		{ { 10, 10, 11, 11 }, { 1, 1 }, { 100, 100 }, { 100, 100 }, { 9, 9, 12, 12 } },
+		// 放大两倍
+		{ { 10, 20, 11, 22 }, { 0, 0 }, { 100, 100 }, { 200, 200 }, { 20, 40, 22, 44 } },
+		// 缩小一半，Bicubic
+		{ { 10, 10, 11, 11 }, { 2, 2 }, { 200, 200 }, { 100, 100 }, { 4, 4, 7, 7 } },
+		// 水平和竖直方向不同
+		{ { 10, 10, 11, 11 }, { 3, 0 }, { 100, 100 }, { 100, 100 }, { 7, 10, 14, 11 } },
+		// 裁剪到输出
+		{ { 0, 0, 1, 1 }, { 3, 3 }, { 100, 100 }, { 100, 100 }, { 0, 0, 4, 4 } },
+		{ { 98, 98, 100, 100 }, { 3, 3 }, { 100, 100 }, { 150, 150 }, { 142, 142, 150, 150 } },
+		// 空矩形
+		{ { 5, 5, 5, 9 }, { 1, 1 }, { 100, 100 }, { 100, 100 }, {} },
+	};
+	for (const MapCase& c : mapCases) {
+		const Rect result = RegionPropagator::MapRect(c.rect, c.footprint, c.inputSize, c.outputSize);
+		if (!(result == c.expected || (result.IsEmpty() && c.expected.IsEmpty()))) {
+			fmt::print(stderr, "MapRect {}: 结果为 {}，应为 {}\n",
+				ToString(c.rect), ToString(result), ToString(c.expected));
+			success = false;
+		}
+	}
+
+	struct MergeCase {
+		const char* name;
+		SmallVector<Rect> rects;
+		uint32_t maxCount;
+		SmallVector<Rect> expected;
+	};
+	const MergeCase mergeCases[] = {
+		{ "删除空矩形", { { 0, 0, 0, 5 }, { 1, 1, 2, 2 } }, 8, { { 1, 1, 2, 2 } } },
+		{ "重叠", { { 0, 0, 4, 4 }, { 2, 2, 6, 6 } }, 8, { { 0, 0, 6, 6 } } },
+		{ "相邻且对齐", { { 0, 0, 2, 2 }, { 2, 0, 4, 2 } }, 8, { { 0, 0, 4, 2 } } },
+		{ "包含", { { 0, 0, 8, 8 }, { 2, 2, 3, 3 } }, 8, { { 0, 0, 8, 8 } } },
+		{ "分离", { { 0, 0, 1, 1 }, { 10, 10, 11, 11 } }, 8, { { 0, 0, 1, 1 }, { 10, 10, 11, 11 } } },
+		{ "超过上限时合并最近的", { { 0, 0, 1, 1 }, { 2, 0, 3, 1 }, { 20, 20, 21, 21 } }, 2,
+			{ { 0, 0, 3, 1 }, { 20, 20, 21, 21 } } },
+		{ "合并后和其他矩形重叠", { { 0, 0, 1, 1 }, { 4, 4, 5, 5 }, { 2, 2, 3, 3 }, { 40, 40, 41, 41 } }, 2,
+			{ { 0, 0, 5, 5 }, { 40, 40, 41, 41 } } },
+	};
+	for (const MergeCase& c : mergeCases) {
+		SmallVector<Rect> rects = c.rects;
+		RegionPropagator::MergeRects(rects, c.maxCount);
+
+		std::vector<Rect> sorted(rects.begin(), rects.end());
+		std::vector<Rect> expected(c.expected.begin(), c.expected.end());
+		const auto less = [](const Rect& l, const Rect& r) {
+			return std::tie(l.left, l.top, l.right, l.bottom) < std::tie(r.left, r.top, r.right, r.bottom);
+		};
+		std::sort(sorted.begin(), sorted.end(), less);
+		std::sort(expected.begin(), expected.end(), less);
+		if (sorted != expected) {
+			std::string result;
+			for (const Rect& rect : sorted) {
+				result += ToString(rect);
+			}
+			fmt::print(stderr, "MergeRects {}: 结果为 {}\n", c.name, result);
+			success = false;
+		}
+	}
+
+	fmt::print("固定测试: {} 个\n", std::size(mapCases) + std::size(mergeCases));
+	return success;
+}
+
+static uint32_t Mix(uint32_t h, uint32_t v) {
+	h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+	return h;
+}
+
+// 在 CPU 上模拟效果链的渲染，每个纹理是一个 uint32_t 数组
+class Simulator {
+public:
+	Simulator(std::span<const RegionPropagator::Texture> textures, std::span<const RegionPropagator::Pass> passes)
+		: _textures(textures), _passes(passes), _data(textures.size()) {
+		for (size_t i = 0; i < textures.size(); ++i) {
+			_data[i].resize((size_t)textures[i].width * textures[i].height);
+			// 常量纹理和初始内容
+			for (size_t j = 0; j < _data[i].size(); ++j) {
+				_data[i][j] = Mix((uint32_t)i, (uint32_t)j);
+			}
+		}
+	}
+
+	std::vector<uint32_t>& Data(uint32_t idx) {
+		return _data[idx];
+	}
+
+	// passTiles 为空时完整渲染
+	void Render(uint32_t frame, std::span<const SmallVector<Rect>> passTiles) {
+		for (uint32_t i = 0; i < (uint32_t)_passes.size(); ++i) {
+			const RegionPropagator::Pass& pass = _passes[i];
+			const RegionPropagator::Texture& output = _textures[pass.outputs[0]];
+
+			const int32_t blockWidth = (int32_t)pass.blockSize.first;
+			const int32_t blockHeight = (int32_t)pass.blockSize.second;
+			const auto drawTiles = [&](const Rect& tiles) {
+				const int32_t right = std::min(tiles.right * blockWidth, (int32_t)output.width);
+				const int32_t bottom = std::min(tiles.bottom * blockHeight, (int32_t)output.height);
+				for (int32_t y = tiles.top * blockHeight; y < bottom; ++y) {
+					for (int32_t x = tiles.left * blockWidth; x < right; ++x) {
+						_DrawPixel(i, frame, x, y);
+					}
+				}
+			};
+
+			if (passTiles.empty()) {
+				drawTiles({ 0, 0, (int32_t)output.width, (int32_t)output.height });
+			} else {
+				for (const Rect& tiles : passTiles[i]) {
+					drawTiles(tiles);
+				}
+			}
+		}
+	}
+
+private:
+	void _DrawPixel(uint32_t passIdx, uint32_t frame, int32_t x, int32_t y) {
+		const RegionPropagator::Pass& pass = _passes[passIdx];
+		const RegionPropagator::Texture& output = _textures[pass.outputs[0]];
+
+		uint32_t h = Mix(0x1234567, passIdx);
+		if (pass.isDynamic) {
+			h = Mix(h, frame);
+		}
+
+		for (uint32_t idx : pass.inputs) {
+			const RegionPropagator::Texture& input = _textures[idx];
+
+			// 和 PS 样式的着色器相同
+			const float posX = (x + 0.5f) * (1.0f / output.width);
+			const float posY = (y + 0.5f) * (1.0f / output.height);
+			const int32_t centerX = (int32_t)std::floor(posX * input.width);
+			const int32_t centerY = (int32_t)std::floor(posY * input.height);
+
+			// 没有 FOOTPRINT 的通道读取镜像位置的像素
+			const int32_t radiusX = pass.hasFootprint ? (int32_t)pass.footprint.first : 0;
+			const int32_t radiusY = pass.hasFootprint ? (int32_t)pass.footprint.second : 0;
+			const int32_t baseX = pass.hasFootprint ? centerX : (int32_t)input.width - 1 - centerX;
+			const int32_t baseY = pass.hasFootprint ? centerY : (int32_t)input.height - 1 - centerY;
+
+			const std::vector<uint32_t>& data = _data[idx];
+			for (int32_t dy = -radiusY; dy <= radiusY; ++dy) {
+				for (int32_t dx = -radiusX; dx <= radiusX; ++dx) {
+					// 夹取寻址
+					const int32_t sx = std::clamp(baseX + dx, 0, (int32_t)input.width - 1);
+					const int32_t sy = std::clamp(baseY + dy, 0, (int32_t)input.height - 1);
+					h = Mix(h, data[(size_t)sy * input.width + sx]);
+				}
+			}
+		}
+
+		for (uint32_t j = 0; j < (uint32_t)pass.outputs.size(); ++j) {
+			_data[pass.outputs[j]][(size_t)y * output.width + x] = Mix(h, j);
+		}
+	}
+
+	std::span<const RegionPropagator::Texture> _textures;
+	std::span<const RegionPropagator::Pass> _passes;
+	std::vector<std::vector<uint32_t>> _data;
+};
+
+static bool RunRandomTests(uint32_t count) {
+	if (count == 0) {
+		return true;
+	}
+
+	uint32_t failedCount = 0;
+	uint64_t dispatchedPixels = 0;
+	uint64_t totalPixels = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		const auto randomSize = [&]() {
+			return std::pair<uint32_t, uint32_t>(rand(4, 48), rand(4, 48));
+		};
+
+		std::vector<RegionPropagator::Texture> textures;
+		{
+			const auto [width, height] = randomSize();
+			textures.push_back({ .width = width, .height = height });
+		}
+		if (rand(0, 2) == 0) {
+			const auto [width, height] = randomSize();
+			textures.push_back({ .width = width, .height = height, .isConstant = true });
+		}
+
+		// 先创建每个通道的输出，使通道可以读取之后的通道写入的纹理，即上一帧的内容
+		const uint32_t passCount = rand(1, 6);
+		const uint32_t firstOutput = (uint32_t)textures.size();
+		for (uint32_t i = 0; i < passCount; ++i) {
+			const auto [width, height] = randomSize();
+			textures.push_back({ .width = width, .height = height });
+		}
+
+		std::vector<RegionPropagator::Pass> passes(passCount);
+		for (uint32_t i = 0; i < passCount; ++i) {
+			RegionPropagator::Pass& pass = passes[i];
+
+			uint32_t output = firstOutput + i;
+			if (i > 0 && rand(0, 7) == 0) {
+				// 写入之前的通道的输出
+				output = firstOutput + rand(0, i - 1);
+			}
+			pass.outputs.push_back(output);
+
+			std::set<uint32_t> inputs;
+			for (uint32_t j = rand(1, 2); j > 0; --j) {
+				// INPUT、常量纹理和之前的通道的输出
+				inputs.insert(rand(0, firstOutput + i - 1));
+			}
+			if (rand(0, 5) == 0) {
+				inputs.insert(rand(firstOutput, firstOutput + passCount - 1));
+			}
+			inputs.erase(output);
+			if (inputs.empty()) {
+				inputs.insert(0);
+			}
+			pass.inputs.assign(inputs.begin(), inputs.end());
+
+			static constexpr uint32_t blockSizes[] = { 1, 4, 8, 16 };
+			pass.blockSize = { blockSizes[rand(0, 3)], blockSizes[rand(0, 3)] };
+			pass.hasFootprint = rand(0, 3) != 0;
+			pass.footprint = { rand(0, 3), rand(0, 3) };
+			pass.isDynamic = rand(0, 9) == 0;
+		}
+
+		Simulator reference(textures, passes);
+		Simulator regional(textures, passes);
+
+		RegionPropagator propagator;
+		propagator.Initialize(textures, passes, 0);
+
+		bool success = true;
+		for (uint32_t frame = 0; frame < 4 && success; ++frame) {
+			// 第一帧完整渲染
+			SmallVector<Rect> dirtyRects;
+			const bool isFull = frame == 0 || rand(0, 9) == 0;
+			if (!isFull) {
+				const RegionPropagator::Texture& input = textures[0];
+				for (uint32_t j = rand(0, 4); j > 0; --j) {
+					const int32_t left = (int32_t)rand(0, input.width - 1);
+					const int32_t top = (int32_t)rand(0, input.height - 1);
+					const Rect rect{ left, top,
+						left + (int32_t)rand(1, input.width - left), top + (int32_t)rand(1, input.height - top) };
+					dirtyRects.push_back(rect);
+
+					for (int32_t y = rect.top; y < rect.bottom; ++y) {
+						for (int32_t x = rect.left; x < rect.right; ++x) {
+							const size_t k = (size_t)y * input.width + x;
+							const uint32_t value = Mix(frame, (uint32_t)k);
+							reference.Data(0)[k] = value;
+							regional.Data(0)[k] = value;
+						}
+					}
+				}
+			}
+
+			propagator.Propagate(isFull ? nullptr : &dirtyRects);
+			reference.Render(frame, {});
+			regional.Render(frame, propagator.PassTiles());
+
+			for (uint32_t i = 0; i < passCount; ++i) {
+				const RegionPropagator::Pass& pass = passes[i];
+				const RegionPropagator::Texture& output = textures[pass.outputs[0]];
+				const std::span<const Rect> tiles = propagator.PassTiles()[i];
+
+				if (tiles.size() > RegionPropagator::MAX_RECTS_PER_PASS || !IsDisjoint(tiles)) {
+					fmt::print(stderr, "随机测试 #{} 帧 {}: 通道 {} 的块过多或重叠\n", r, frame, i);
+					success = false;
+				}
+
+				for (const Rect& tile : tiles) {
+					const int64_t width = std::min<int64_t>((int64_t)tile.right * pass.blockSize.first, output.width)
+						- (int64_t)tile.left * pass.blockSize.first;
+					const int64_t height = std::min<int64_t>((int64_t)tile.bottom * pass.blockSize.second, output.height)
+						- (int64_t)tile.top * pass.blockSize.second;
+					dispatchedPixels += (uint64_t)std::max<int64_t>(width, 0) * std::max<int64_t>(height, 0);
+				}
+				totalPixels += (uint64_t)output.width * output.height;
+			}
+
+			for (uint32_t i = firstOutput; i < (uint32_t)textures.size(); ++i) {
+				if (reference.Data(i) != regional.Data(i)) {
+					fmt::print(stderr, "随机测试 #{} 帧 {}: 纹理 {} 和完整渲染不同\n", r, frame, i);
+					success = false;
+					break;
+				}
+			}
+		}
+
+		if (!success) {
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过，调度的像素占完整渲染的 {:.1f}%\n",
+		count - failedCount, count, dispatchedPixels * 100.0 / std::max<uint64_t>(totalPixels, 1));
+	return failedCount == 0;
+}
+
+// 和 Renderer::_CreateEffectTextures 相同地展开效果链
+static bool RunChain(
+	const std::filesystem::path& effectsDir,
+	std::span<const std::string> effectNames,
+	Size inputSize,
+	float scale
+) {
+	std::vector<RegionPropagator::Texture> textures;
+	std::vector<RegionPropagator::Pass> passes;
+
+	// 帧源的输出
+	textures.push_back({ .width = (uint32_t)inputSize.cx, .height = (uint32_t)inputSize.cy });
+	const Size frameSize = inputSize;
+	uint32_t inputIdx = 0;
+
+	for (const std::string& name : effectNames) {
+		EffectDesc desc;
+		if (!ParseEffectFile(effectsDir, name, desc)) {
+			return false;
+		}
+
+		Size outputSize{ std::lround(inputSize.cx * scale), std::lround(inputSize.cy * scale) };
+		if (!desc.GetOutputSizeExpr().first.empty()) {
+			SizeExprEvaluator evaluator(inputSize, {});
+			if (!EvalSize(evaluator, desc.GetOutputSizeExpr(), outputSize)) {
+				fmt::print(stderr, "{}: 无法计算输出尺寸\n", name);
+				return false;
+			}
+		}
+
+		SizeExprEvaluator evaluator(inputSize, outputSize);
+		std::vector<uint32_t> indices(desc.textures.size());
+		indices[0] = inputIdx;
+		for (size_t j = 1; j < desc.textures.size(); ++j) {
+			const EffectIntermediateTextureDesc& texDesc = desc.textures[j];
+
+			Size size = outputSize;
+			const bool isConstant = !texDesc.source.empty();
+			if (j > 1 && !isConstant && !EvalSize(evaluator, texDesc.sizeExpr, size)) {
+				fmt::print(stderr, "{}: 无法计算纹理 {} 的尺寸\n", name, texDesc.name);
+				return false;
+			}
+
+			indices[j] = (uint32_t)textures.size();
+			// 从文件加载的纹理的尺寸无关紧要
+			textures.push_back({ .width = (uint32_t)size.cx, .height = (uint32_t)size.cy, .isConstant = isConstant });
+		}
+
+		const bool hasWrapSampler = std::any_of(desc.samplers.begin(), desc.samplers.end(),
+			[](const EffectSamplerDesc& sampler) { return sampler.addressType == EffectSamplerAddressType::Wrap; });
+
+		for (const EffectPassDesc& passDesc : desc.passes) {
+			RegionPropagator::Pass& pass = passes.emplace_back();
+			for (uint32_t idx : passDesc.inputs) {
+				pass.inputs.push_back(indices[idx]);
+			}
+			for (uint32_t idx : passDesc.outputs) {
+				pass.outputs.push_back(indices[idx]);
+			}
+			pass.blockSize = passDesc.blockSize;
+			pass.footprint = passDesc.footprint;
+			pass.hasFootprint = passDesc.hasFootprint && !hasWrapSampler;
+			pass.isDynamic = desc.flags & EffectFlags::UseDynamic;
+		}
+
+		inputIdx = indices[1];
+		inputSize = outputSize;
+	}
+
+	std::string chainName;
+	for (const std::string& name : effectNames) {
+		if (!chainName.empty()) {
+			chainName += " -> ";
+		}
+		chainName += name;
+	}
+	fmt::print("{}\n  输入 {}x{}，输出 {}x{}，{} 个通道\n",
+		chainName, frameSize.cx, frameSize.cy, inputSize.cx, inputSize.cy, passes.size());
+
+	RegionPropagator propagator;
+	if (!propagator.Initialize(textures, passes, 0)) {
+		fmt::print("  没有可以只渲染一部分的通道\n");
+		return true;
+	}
+
+	// 以输入尺寸的比例表示，模拟视觉小说、模拟器和桌面程序中常见的变化
+	struct Scenario {
+		const char* name;
+		SmallVector<Rect> rects;
+	};
+	const auto scaled = [&](float left, float top, float right, float bottom) {
+		return Rect{
+			(int32_t)std::lround(frameSize.cx * left),
+			(int32_t)std::lround(frameSize.cy * top),
+			(int32_t)std::lround(frameSize.cx * right),
+			(int32_t)std::lround(frameSize.cy * bottom)
+		};
+	};
+	const Scenario scenarios[] = {
+		{ "文本框逐字显示", { scaled(0.10f, 0.78f, 0.30f, 0.82f) } },
+		{ "闪烁的光标", { scaled(0.50f, 0.50f, 0.51f, 0.52f) } },
+		{ "时钟和进度条", { scaled(0.90f, 0.96f, 0.98f, 0.99f), scaled(0.05f, 0.90f, 0.60f, 0.91f) } },
+		{ "半屏滚动", { scaled(0.0f, 0.0f, 0.5f, 1.0f) } },
+		{ "整帧", { scaled(0.0f, 0.0f, 1.0f, 1.0f) } },
+	};
+
+	for (const Scenario& scenario : scenarios) {
+		const auto start = std::chrono::steady_clock::now();
+		propagator.Propagate(&scenario.rects);
+		const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		uint32_t dispatchCount = 0;
+		for (const SmallVector<Rect>& tiles : propagator.PassTiles()) {
+			dispatchCount += (uint32_t)tiles.size();
+		}
+
+		fmt::print("  {}: 调度 {:.2f}% 的块，{} 次调度，计算用时 {:.1f} 微秒\n",
+			scenario.name, propagator.DispatchedRatio() * 100, dispatchCount, us);
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fmt::print(stderr, "用法: {} <effects 文件夹> [-w 输入宽度] [-h 输入高度] [-s 缩放] [-r 随机测试次数] [效果...]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+	Size inputSize{ 1920, 1080 };
+	float scale = 2.0f;
+	uint32_t randomTestCount = 1000;
+	std::vector<std::string> effectNames;
+	for (int i = 2; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-w") {
+			inputSize.cx = std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-h") {
+			inputSize.cy = std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-s") {
+			scale = std::max(0.01f, (float)std::atof(argv[++i]));
+		} else if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			effectNames.emplace_back(arg);
+		}
+	}
+	if (effectNames.empty()) {
+		effectNames = { "FSR\\FSR_EASU", "FSR\\FSR_RCAS" };
+	}
+
+	bool success = RunFixedTests();
+	success = RunRandomTests(randomTestCount) && success;
+	success = RunChain(effectsDir, effectNames, inputSize, scale) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// TaskSchedulerBench.cpp : 使用模拟的编译任务验证 TaskScheduler 并测量调度效率
+//
+// 用法: magpiefx-sched-bench [-t 线程数] [-r 重复次数]
+//
+// 每个模拟的效果和 EffectCompiler 相同，由解析任务提交每个通道的编译任务，所有通道完成后执行
+// 完成回调。任务用忙等待模拟 D3DCompile 的耗时。检查每个任务恰好执行一次、完成回调在所有通道
+// 之后执行。然后从多个线程同时向共享的线程池提交效果，检查所有任务都在常驻的工作线程上执行。
+// 任何错误都会使返回值非零
+
+#include "pch.h"
+#include "TaskScheduler.h"
+
+using namespace Magpie::Core;
+
+// 模拟 Renderer 中常见的效果链，通道数相差悬殊
+static constexpr uint32_t PASS_COUNTS[] = { 18, 1, 4, 9, 2, 1, 6, 12 };
+
+static void Spin(double ms) {
+	const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(ms);
+	while (std::chrono::steady_clock::now() < end) {}
+}
+
+struct FakeEffect {
+	double parseMs = 0;
+	std::vector<double> passMs;
+	std::unique_ptr<std::atomic<uint32_t>[]> passRuns;
+	std::atomic<uint32_t> completedPasses = 0;
+	std::atomic<uint32_t> finishRuns = 0;
+	bool isFinishedTooEarly = false;
+};
+
+// 模拟 EffectsService 从很多线程同时编译效果，所有通道都应在共享的线程池中执行
+static bool RunSharedTest() {
+	constexpr uint32_t CALLER_COUNT = 32;
+
+	std::vector<FakeEffect> effects(CALLER_COUNT);
+	std::mutex mutex;
+	std::set<std::thread::id> workerIds;
+
+	std::vector<std::thread> callers;
+	callers.reserve(CALLER_COUNT);
+	for (uint32_t c = 0; c < CALLER_COUNT; ++c) {
+		callers.emplace_back([&, c]() {
+			FakeEffect& effect = effects[c];
+			effect.passMs.assign(PASS_COUNTS[c % std::size(PASS_COUNTS)], 0.5);
+			effect.passRuns = std::make_unique<std::atomic<uint32_t>[]>(effect.passMs.size());
+
+			TaskScheduler::Shared().RunAndWait([&](TaskScheduler::Context& context) {
+				for (uint32_t i = 0; i < (uint32_t)effect.passMs.size(); ++i) {
+					context.Spawn([&, i](TaskScheduler::Context&) {
+						Spin(effect.passMs[i]);
+						{
+							std::scoped_lock lock(mutex);
+							workerIds.insert(std::this_thread::get_id());
+						}
+						effect.passRuns[i].fetch_add(1, std::memory_order_relaxed);
+						effect.completedPasses.fetch_add(1, std::memory_order_release);
+					});
+				}
+			}, [&effect]() {
+				if (effect.completedPasses.load(std::memory_order_acquire) != effect.passMs.size()) {
+					effect.isFinishedTooEarly = true;
+				}
+				effect.finishRuns.fetch_add(1, std::memory_order_relaxed);
+			});
+
+			// 返回时所有通道都已完成
+			if (effect.completedPasses.load(std::memory_order_acquire) != effect.passMs.size()) {
+				effect.isFinishedTooEarly = true;
+			}
+		});
+	}
+
+	for (std::thread& t : callers) {
+		t.join();
+	}
+
+	bool success = true;
+	for (const FakeEffect& effect : effects) {
+		if (effect.finishRuns != 1 || effect.isFinishedTooEarly) {
+			success = false;
+		}
+		for (size_t i = 0; i < effect.passMs.size(); ++i) {
+			if (effect.passRuns[i] != 1) {
+				success = false;
+			}
+		}
+	}
+
+	// 调用线程不参与执行，因此执行任务的线程数不超过线程池的大小
+	const uint32_t poolSize = std::max(1u, std::thread::hardware_concurrency());
+	if (workerIds.size() > poolSize) {
+		success = false;
+	}
+
+	fmt::print("共享线程池: {} 个调用线程，任务在 {} 个线程上执行，{}\n",
+		CALLER_COUNT, workerIds.size(), success ? "通过" : "失败");
+	return success;
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t repeat = 5;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string_view arg(argv[i]);
+		if (arg == "-t") {
+			threadCount = std::max(1, std::atoi(argv[i + 1]));
+		} else if (arg == "-r") {
+			repeat = std::max(1, std::atoi(argv[i + 1]));
+		}
+	}
+
+	fmt::print("{} 个线程，{} 个效果\n", threadCount, std::size(PASS_COUNTS));
+	fmt::print("{:>4} {:>10} {:>10} {:>10} {:>10} {:>8} {:>8}\n",
+		"#", "wall", "critical", "work", "bound", "eff", "steals");
+
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < repeat; ++r) {
+		// 固定种子使每次运行的任务相同
+		std::mt19937 rng(r);
+		std::uniform_real_distribution<double> parseDist(1.0, 3.0);
+		std::uniform_real_distribution<double> passDist(2.0, 30.0);
+
+		std::vector<FakeEffect> effects(std::size(PASS_COUNTS));
+		uint32_t expectedTaskCount = 0;
+		for (size_t i = 0; i < effects.size(); ++i) {
+			FakeEffect& effect = effects[i];
+			effect.parseMs = parseDist(rng);
+			effect.passMs.resize(PASS_COUNTS[i]);
+			for (double& ms : effect.passMs) {
+				ms = passDist(rng);
+			}
+			effect.passRuns = std::make_unique<std::atomic<uint32_t>[]>(PASS_COUNTS[i]);
+			expectedTaskCount += 1 + PASS_COUNTS[i];
+		}
+
+		TaskScheduler scheduler;
+		for (FakeEffect& effect : effects) {
+			scheduler.Submit([&effect](TaskScheduler::Context& context) {
+				Spin(effect.parseMs);
+
+				for (uint32_t i = 0; i < (uint32_t)effect.passMs.size(); ++i) {
+					context.Spawn([&effect, i](TaskScheduler::Context&) {
+						Spin(effect.passMs[i]);
+						effect.passRuns[i].fetch_add(1, std::memory_order_relaxed);
+						effect.completedPasses.fetch_add(1, std::memory_order_release);
+					});
+				}
+			}, [&effect]() {
+				if (effect.completedPasses.load(std::memory_order_acquire) != effect.passMs.size()) {
+					effect.isFinishedTooEarly = true;
+				}
+				effect.finishRuns.fetch_add(1, std::memory_order_relaxed);
+			});
+		}
+
+		scheduler.Run(threadCount);
+
+		const TaskScheduler::Stats& stats = scheduler.GetStats();
+
+		bool success = stats.taskCount == expectedTaskCount;
+		for (const FakeEffect& effect : effects) {
+			if (effect.finishRuns != 1 || effect.isFinishedTooEarly) {
+				success = false;
+			}
+			for (size_t i = 0; i < effect.passMs.size(); ++i) {
+				if (effect.passRuns[i] != 1) {
+					success = false;
+				}
+			}
+		}
+
+		// 任何调度都无法快于关键路径，也无法快于工作量均分到所有线程
+		const double bound = std::max(stats.criticalPathMs, stats.workMs / threadCount);
+		fmt::print("{:>4} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>7.1f}% {:>8}{}\n",
+			r, stats.wallMs, stats.criticalPathMs, stats.workMs, bound,
+			bound / stats.wallMs * 100, stats.stealCount, success ? "" : "  失败");
+
+		if (!success) {
+			++failedCount;
+		}
+	}
+
+	if (!RunSharedTest()) {
+		++failedCount;
+	}
+
+	return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// TestPatternBench.cpp : 验证回放帧源使用的测试画面并估计每帧变化的面积
+//
+// 用法: magpiefx-pattern-bench [-r 随机测试次数]
+//
+// 对随机的尺寸逐帧检查: 只重新渲染 ChangedRects 返回的区域得到的画面和完整渲染的画面相同，渲染任意区域的结果和
+// 完整渲染中的对应区域相同，能从画面解码出帧序号。然后输出常见分辨率下每帧变化的面积和 CPU 生成变化区域的耗时。
+// 任何检查失败时返回非零值
+
+#include "pch.h"
+#include "TestPattern.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+using Rect = TestPattern::Rect;
+
+struct Frame {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	Frame(uint32_t width_, uint32_t height_) : width(width_), height(height_), pixels((size_t)width_ * height_ * 4) {}
+
+	uint32_t Pitch() const {
+		return width * 4;
+	}
+
+	uint8_t* At(uint32_t x, uint32_t y) {
+		return pixels.data() + ((size_t)y * width + x) * 4;
+	}
+};
+
+static void Render(const TestPattern& pattern, uint64_t frameIndex, const Rect& rect, Frame& frame) {
+	pattern.Render(frameIndex, rect, frame.At(rect.left, rect.top), frame.Pitch());
+}
+
+static bool RunRandomTests(uint32_t count) {
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		// 宽度可能容纳或容纳不下帧序号的编码
+		const uint32_t width = rand(1, 200);
+		const uint32_t height = rand(1, 40);
+		const Rect fullRect{ 0, 0, width, height };
+
+		TestPattern pattern;
+		pattern.Initialize(width, height);
+
+		Frame incremental(width, height);
+		Render(pattern, 0, fullRect, incremental);
+
+		Frame full(width, height);
+		Frame partial(width, height);
+		std::vector<Rect> changedRects;
+
+		std::string errorMsg;
+		for (uint64_t frameIndex = 1; frameIndex <= 100 && errorMsg.empty(); ++frameIndex) {
+			pattern.ChangedRects(frameIndex, changedRects);
+			for (const Rect& rect : changedRects) {
+				if (rect.right > width || rect.bottom > height || rect.left >= rect.right || rect.top >= rect.bottom) {
+					errorMsg = fmt::format("第 {} 帧: 变化区域 {} 超出范围", frameIndex, ToString(rect));
+					break;
+				}
+				Render(pattern, frameIndex, rect, incremental);
+			}
+			if (!errorMsg.empty()) {
+				break;
+			}
+
+			Render(pattern, frameIndex, fullRect, full);
+			if (incremental.pixels != full.pixels) {
+				errorMsg = fmt::format("第 {} 帧: 只渲染变化区域的结果和完整渲染不同", frameIndex);
+				break;
+			}
+
+			const uint32_t left = rand(0, width - 1);
+			const uint32_t top = rand(0, height - 1);
+			const Rect rect{ left, top, rand(left + 1, width), rand(top + 1, height) };
+			Render(pattern, frameIndex, rect, partial);
+			for (uint32_t y = rect.top; y < rect.bottom; ++y) {
+				if (!std::equal(partial.At(rect.left, y), partial.At(rect.right - 1, y) + 4, full.At(rect.left, y))) {
+					errorMsg = fmt::format("第 {} 帧: 区域 {} 的渲染结果和完整渲染不同", frameIndex, ToString(rect));
+					break;
+				}
+			}
+			if (!errorMsg.empty()) {
+				break;
+			}
+
+			if (width >= TestPattern::INDEX_BITS * TestPattern::INDEX_BLOCK_SIZE && height >= TestPattern::INDEX_BLOCK_SIZE) {
+				const uint32_t decoded = pattern.DecodeIndex(full.pixels.data(), full.Pitch());
+				const uint32_t expected = uint32_t(frameIndex & ((1u << TestPattern::INDEX_BITS) - 1));
+				if (decoded != expected) {
+					errorMsg = fmt::format("第 {} 帧: 解码得到的帧序号为 {}", frameIndex, decoded);
+				}
+			}
+		}
+
+		if (!errorMsg.empty()) {
+			fmt::print(stderr, "随机测试 #{} ({}x{}): {}\n", r, width, height, errorMsg);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+static bool RunWrapTest() {
+	// 帧序号超出编码的位数后回绕，竖条到达右边后回到最左边
+	constexpr uint32_t WIDTH = 256;
+	constexpr uint32_t HEIGHT = 16;
+
+	TestPattern pattern;
+	pattern.Initialize(WIDTH, HEIGHT);
+
+	Frame frame(WIDTH, HEIGHT);
+	bool success = true;
+	for (uint64_t frameIndex : { 0ull, 1ull, 65535ull, 65536ull, 65537ull, (1ull << 40) + 3 }) {
+		Render(pattern, frameIndex, { 0, 0, WIDTH, HEIGHT }, frame);
+		const uint32_t decoded = pattern.DecodeIndex(frame.pixels.data(), frame.Pitch());
+		if (decoded != uint32_t(frameIndex & 0xFFFF)) {
+			fmt::print(stderr, "帧序号 {} 解码为 {}\n", frameIndex, decoded);
+			success = false;
+		}
+	}
+
+	fmt::print("帧序号回绕: {}\n", success ? "通过" : "失败");
+	return success;
+}
+
+static void PrintChangedArea() {
+	struct Case {
+		uint32_t width;
+		uint32_t height;
+	};
+	static constexpr Case CASES[] = {
+		{ 1280, 720 },
+		{ 1920, 1080 },
+		{ 2560, 1440 },
+	};
+
+	fmt::print("每帧变化的面积:\n");
+	for (const Case& c : CASES) {
+		TestPattern pattern;
+		pattern.Initialize(c.width, c.height);
+
+		Frame frame(c.width, c.height);
+		Render(pattern, 0, { 0, 0, c.width, c.height }, frame);
+
+		constexpr uint32_t FRAME_COUNT = 600;
+		std::vector<Rect> changedRects;
+		double changedArea = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint64_t frameIndex = 1; frameIndex <= FRAME_COUNT; ++frameIndex) {
+			pattern.ChangedRects(frameIndex, changedRects);
+			for (const Rect& rect : changedRects) {
+				Render(pattern, frameIndex, rect, frame);
+				changedArea += double(rect.right - rect.left) * (rect.bottom - rect.top);
+			}
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		fmt::print("  {}x{}: {:.1f}%，生成每帧 {:.3f} ms\n", c.width, c.height,
+			changedArea / FRAME_COUNT / (double(c.width) * c.height) * 100, ms / FRAME_COUNT);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t randomTestCount = 200;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			fmt::print(stderr, "用法: {} [-r 随机测试次数]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool success = RunRandomTests(randomTestCount);
+	success &= RunWrapTest();
+	PrintChangedArea();
+	return success ? 0 : 1;
+}
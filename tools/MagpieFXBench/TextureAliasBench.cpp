@@ -0,0 +1,286 @@
+// TextureAliasBench.cpp : 验证 TextureAliasPlanner 并统计真实效果链可节省的显存
+//
+// 用法: magpiefx-alias-bench <effects 文件夹> [-w 输入宽度] [-h 输入高度] [-r 随机测试次数] [效果...]
+//
+// 首先对随机生成的纹理和通道检查规划结果: 共享同一物理纹理的纹理尺寸和格式相同、生命周期不重叠，
+// 需要跨帧保留的纹理不共享，且每组尺寸和格式相同的纹理使用的物理纹理数等于同时存活的最大数量。
+// 然后和 Renderer 相同地把指定的效果链展开，输出共享前后的纹理数和显存。默认的效果链为
+// Anime4K_Restore_M、Anime4K_Upscale_Denoise_L 和 FSR_RCAS，输入尺寸为 1920x1080，即输出 4K。
+// 任何检查失败时返回非零值
+
+#include "pch.h"
+#include "EffectDesc.h"
+#include "EffectHelper.h"
+#include "TextureAliasPlanner.h"
+#include "BenchUtils.h"
+
+using namespace Magpie::Core;
+
+using Planner = TextureAliasPlanner;
+
+// 检查规划结果，失败时输出原因
+static bool VerifyPlan(
+	std::span<const Planner::Texture> textures,
+	std::span<const Planner::Pass> passes,
+	const Planner::Result& plan
+) {
+	const auto fail = [](std::string_view msg) {
+		fmt::print(stderr, "  {}\n", msg);
+		return false;
+	};
+
+	const uint32_t passCount = (uint32_t)passes.size();
+
+	for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i) {
+		const Planner::Lifetime& lifetime = plan.lifetimes[i];
+		const bool isUsed = lifetime.firstPass != Planner::NO_ALLOCATION;
+		const bool hasAllocation = plan.allocations[i] != Planner::NO_ALLOCATION;
+		if (hasAllocation != (isUsed && !textures[i].isExternal)) {
+			return fail(fmt::format("纹理 {} 的分配不正确", i));
+		}
+		if (hasAllocation) {
+			const Planner::Texture& owner = textures[plan.allocationTextures[plan.allocations[i]]];
+			if (owner.width != textures[i].width || owner.height != textures[i].height
+				|| owner.format != textures[i].format) {
+				return fail(fmt::format("纹理 {} 和物理纹理的尺寸或格式不同", i));
+			}
+		}
+	}
+
+	// 每个通道中每个物理纹理最多被一个纹理使用，这样生命周期一定不重叠
+	std::vector<uint32_t> users(plan.allocationTextures.size());
+	for (uint32_t p = 0; p < passCount; ++p) {
+		std::fill(users.begin(), users.end(), Planner::NO_ALLOCATION);
+		for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i) {
+			const Planner::Lifetime& lifetime = plan.lifetimes[i];
+			const uint32_t allocation = plan.allocations[i];
+			if (allocation == Planner::NO_ALLOCATION || p < lifetime.firstPass || p > lifetime.lastPass) {
+				continue;
+			}
+			if (users[allocation] != Planner::NO_ALLOCATION) {
+				return fail(fmt::format("纹理 {} 和 {} 在通道 {} 同时使用物理纹理 {}",
+					users[allocation], i, p, allocation));
+			}
+			users[allocation] = i;
+		}
+	}
+
+	// 需要跨帧保留的纹理独占物理纹理
+	for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i) {
+		const uint32_t allocation = plan.allocations[i];
+		if (allocation == Planner::NO_ALLOCATION
+			|| !(textures[i].isPersistent || plan.lifetimes[i].isReadFirst)) {
+			continue;
+		}
+		for (uint32_t j = 0; j < (uint32_t)textures.size(); ++j) {
+			if (j != i && plan.allocations[j] == allocation) {
+				return fail(fmt::format("需要保留的纹理 {} 和纹理 {} 共享", i, j));
+			}
+		}
+	}
+
+	// 区间图着色的下限: 每组纹理同时存活的最大数量
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::pair<uint32_t, std::set<uint32_t>>> groups;
+	for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i) {
+		if (plan.allocations[i] != Planner::NO_ALLOCATION) {
+			groups[{ textures[i].width, textures[i].height, textures[i].format }].second.insert(plan.allocations[i]);
+		}
+	}
+	for (uint32_t p = 0; p < passCount; ++p) {
+		std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> live;
+		for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i) {
+			const Planner::Lifetime& lifetime = plan.lifetimes[i];
+			if (plan.allocations[i] != Planner::NO_ALLOCATION && p >= lifetime.firstPass && p <= lifetime.lastPass) {
+				++live[{ textures[i].width, textures[i].height, textures[i].format }];
+			}
+		}
+		for (const auto& [key, count] : live) {
+			uint32_t& maxLive = groups[key].first;
+			maxLive = std::max(maxLive, count);
+		}
+	}
+	for (const auto& [key, group] : groups) {
+		if (group.second.size() != group.first) {
+			return fail(fmt::format("{}x{} 格式 {} 使用了 {} 个物理纹理，最少需要 {} 个",
+				std::get<0>(key), std::get<1>(key), std::get<2>(key), group.second.size(), group.first));
+		}
+	}
+
+	return true;
+}
+
+static bool RunRandomTests(uint32_t count) {
+	if (count == 0) {
+		return true;
+	}
+
+	uint32_t failedCount = 0;
+	for (uint32_t r = 0; r < count; ++r) {
+		// 固定种子使每次运行的测试相同
+		std::mt19937 rng(r);
+		const auto rand = [&](uint32_t min, uint32_t max) {
+			return std::uniform_int_distribution<uint32_t>(min, max)(rng);
+		};
+
+		std::vector<Planner::Texture> textures(rand(1, 40));
+		for (Planner::Texture& texture : textures) {
+			// 只使用少量尺寸和格式，使共享的机会更多
+			texture.width = texture.height = 64u << rand(0, 2);
+			texture.format = rand(0, 1);
+			texture.byteSize = (uint64_t)texture.width * texture.height * 4;
+			texture.isExternal = rand(0, 9) == 0;
+			texture.isPersistent = rand(0, 9) == 0;
+		}
+
+		std::vector<Planner::Pass> passes(rand(1, 60));
+		for (Planner::Pass& pass : passes) {
+			std::set<uint32_t> used;
+			for (uint32_t i = rand(0, 4); i > 0; --i) {
+				const uint32_t idx = rand(0, (uint32_t)textures.size() - 1);
+				if (used.insert(idx).second) {
+					pass.inputs.push_back(idx);
+				}
+			}
+			for (uint32_t i = rand(1, 3); i > 0; --i) {
+				const uint32_t idx = rand(0, (uint32_t)textures.size() - 1);
+				if (used.insert(idx).second && !textures[idx].isExternal) {
+					pass.outputs.push_back(idx);
+				}
+			}
+		}
+
+		const Planner::Result plan = Planner::Plan(textures, passes);
+		if (!VerifyPlan(textures, passes, plan)) {
+			fmt::print(stderr, "随机测试 #{} 失败\n", r);
+			++failedCount;
+		}
+	}
+
+	fmt::print("随机测试: {}/{} 通过\n", count - failedCount, count);
+	return failedCount == 0;
+}
+
+// 和 Renderer::_CreateEffectTextures 相同地展开效果链
+static bool RunChain(
+	const std::filesystem::path& effectsDir,
+	std::span<const std::string> effectNames,
+	Size inputSize
+) {
+	std::vector<Planner::Texture> textures;
+	std::vector<Planner::Pass> passes;
+
+	// 帧源的输出
+	textures.push_back({ .isExternal = true });
+	uint32_t inputIdx = 0;
+
+	for (const std::string& name : effectNames) {
+		EffectDesc desc;
+		if (!ParseEffectFile(effectsDir, name, desc)) {
+			return false;
+		}
+
+		// 没有指定输出尺寸的效果由缩放选项决定，这里视为不缩放
+		Size outputSize = inputSize;
+		if (!desc.GetOutputSizeExpr().first.empty()) {
+			SizeExprEvaluator evaluator(inputSize, {});
+			if (!EvalSize(evaluator, desc.GetOutputSizeExpr(), outputSize)) {
+				fmt::print(stderr, "{}: 无法计算输出尺寸\n", name);
+				return false;
+			}
+		}
+
+		SizeExprEvaluator evaluator(inputSize, outputSize);
+		std::vector<uint32_t> indices(desc.textures.size());
+		indices[0] = inputIdx;
+		for (size_t j = 1; j < desc.textures.size(); ++j) {
+			const EffectIntermediateTextureDesc& texDesc = desc.textures[j];
+
+			Size size = outputSize;
+			const bool isExternal = !texDesc.source.empty();
+			if (j > 1 && !isExternal && !EvalSize(evaluator, texDesc.sizeExpr, size)) {
+				fmt::print(stderr, "{}: 无法计算纹理 {} 的尺寸\n", name, texDesc.name);
+				return false;
+			}
+
+			const auto& formatDesc = EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format];
+			indices[j] = (uint32_t)textures.size();
+			textures.push_back({
+				.width = (uint32_t)size.cx,
+				.height = (uint32_t)size.cy,
+				.format = (uint32_t)formatDesc.dxgiFormat,
+				.byteSize = (uint64_t)size.cx * size.cy * formatDesc.bytesPerPixel,
+				.isExternal = isExternal
+			});
+		}
+
+		for (const EffectPassDesc& passDesc : desc.passes) {
+			Planner::Pass& pass = passes.emplace_back();
+			for (uint32_t idx : passDesc.inputs) {
+				pass.inputs.push_back(indices[idx]);
+			}
+			for (uint32_t idx : passDesc.outputs) {
+				pass.outputs.push_back(indices[idx]);
+			}
+		}
+
+		inputIdx = indices[1];
+		inputSize = outputSize;
+	}
+
+	textures[inputIdx].isPersistent = true;
+
+	const auto start = std::chrono::steady_clock::now();
+	const Planner::Result plan = Planner::Plan(textures, passes);
+	const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	const size_t plannedCount = std::count_if(plan.allocations.begin(), plan.allocations.end(),
+		[](uint32_t allocation) { return allocation != Planner::NO_ALLOCATION; });
+
+	std::string chainName;
+	for (const std::string& name : effectNames) {
+		if (!chainName.empty()) {
+			chainName += " -> ";
+		}
+		chainName += name;
+	}
+	fmt::print("{}\n  输出 {}x{}，{} 个通道，规划用时 {:.1f} 微秒\n", chainName, inputSize.cx, inputSize.cy, passes.size(), us);
+	fmt::print("  共享前 {} 个纹理 {:.1f} MiB，共享后 {} 个纹理 {:.1f} MiB\n",
+		plannedCount, plan.unaliasedBytes / 1048576.0, plan.allocationTextures.size(), plan.aliasedBytes / 1048576.0);
+
+	if (!VerifyPlan(textures, passes, plan)) {
+		fmt::print(stderr, "规划结果错误\n");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fmt::print(stderr, "用法: {} <effects 文件夹> [-w 输入宽度] [-h 输入高度] [-r 随机测试次数] [效果...]\n", argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path effectsDir = argv[1];
+	Size inputSize{ 1920, 1080 };
+	uint32_t randomTestCount = 1000;
+	std::vector<std::string> effectNames;
+	for (int i = 2; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 < argc && arg == "-w") {
+			inputSize.cx = std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-h") {
+			inputSize.cy = std::max(1, std::atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "-r") {
+			randomTestCount = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		} else {
+			effectNames.emplace_back(arg);
+		}
+	}
+	if (effectNames.empty()) {
+		effectNames = { "Anime4K\\Anime4K_Restore_M", "Anime4K\\Anime4K_Upscale_Denoise_L", "FSR\\FSR_RCAS" };
+	}
+
+	bool success = RunRandomTests(randomTestCount);
+	success = RunChain(effectsDir, effectNames, inputSize) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// magpiefx-bench 的预编译头，同时供 src/Shared 中包含 "pch.h" 的源文件使用
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>